@@ -10,14 +10,25 @@ public class Ria
    public static final int riaExecUnknown = 0;
    public static final int riaExecOk      = 1;
    public static final int riaExecFailed  = 2;
+   public static final int riaExecPending = 4;
+   public static final int riaExecLimit   = 7;
 
    /* 
-    * Execution context
+    * Execution context; Result holds string returned by script. Native
+    * integer result is 8 octets, big endian, and is not passed as string,
+    * scripts called from Java return int_to_string() of it
     *
     */
    public int    Status;
    public String Result;
 
+   /* 
+    * Batch execution context, one entry per parameter set
+    *
+    */
+   public int[]    Statuses;
+   public String[] Results;
+
    /* 
     * Creates RIA engine
     *
@@ -28,6 +39,18 @@ public class Ria
     */
    public native int riaInit(String tempdir);
 
+   /* 
+    * Creates RIA engine from the state of existing one: loaded script is 
+    * shared, global variables, cookies and headers are copied, so that 
+    * login made by source engine is valid for the clone
+    *
+    * Parameters:     engine           engine handle
+    *
+    * Return:         engine handle or NULL if error
+    *
+    */
+   public native int riaClone(int engine);
+
    /*
     * Destroy RIA engine
     *
@@ -60,6 +83,19 @@ public class Ria
     *
     */
    public native boolean riaLoad(String path, int engine);
+
+   /*
+    * Reloads scenario script, functions which were not changed since 
+    * previous load keep their code
+    *
+    * Parameters:     path           path to script
+    *                 engine         engine handle
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaReload(String path, int engine);
      
    /*
     * Executes script
@@ -73,8 +109,135 @@ public class Ria
     *
     */
    public native boolean riaExecute(String name, String[] params, int engine); 
-     
-   /* 
+
+   /*
+    * Resolves script function, so that it can be executed without name
+    * lookup; handle becomes stale when script is reloaded
+    *
+    * Parameters:     name           script name
+    *                 engine         engine handle
+    *
+    * Return:         function handle or 0 if error
+    *
+    */
+   public native int riaResolve(String name, int engine);
+
+   /*
+    * Executes script resolved by riaResolve
+    *
+    * Parameters:     func           function handle
+    *                 params         parameters array (nul-terminated strings)
+    *                 engine         engine handle
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaExecuteFn(int func, String[] params, int engine); 
+
+   /*
+    * Executes script resolved by riaResolve once per parameter set; 
+    * results are stored into Statuses and Results
+    *
+    * Parameters:     func           function handle
+    *                 params         parameter sets, cparams strings each
+    *                 cparams        number of parameters in each set
+    *                 engine         engine handle
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaExecuteBatch(
+      int func, String[] params, int cparams, int engine);
+
+   /*
+    * Sets limits applied to each following execution; script exceeding 
+    * any of them is stopped with riaExecLimit status, engine stays usable
+    *
+    * Parameters:     time           wall-clock time, ms, 0 - no limit
+    *                 ops            executed commands, 0 - no limit
+    *                 memory         memory held by variables, bytes, 
+    *                                0 - no limit
+    *                 engine         engine handle
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaSetLimits(
+      int time, int ops, int memory, int engine);
+
+   /*
+    * Turns profiler on or off, counters are reset when it is turned on;
+    * requires native part built with USE_RIA_PROFILER
+    *
+    * Parameters:     enable         true to turn on
+    *                 engine         engine handle
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaProfile(boolean enable, int engine);
+
+   /*
+    * Returns profiler report, one counter per line: "op <opcode> <count>
+    * <ns>", "func <name> <count> <ns>" or "line <line> <count> <ns>"
+    *
+    * Parameters:     engine         engine handle
+    *
+    * Return:         report text or null if error
+    *
+    */
+   public native String riaProfileReport(int engine);
+
+   /*
+    * Selects trace level for all engines
+    *
+    * Parameters:     level          0 - off, 1 - ring buffer, 2 - log
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaTrace(int level);
+
+   /*
+    * Returns trace records collected in ring buffer, one line per record;
+    * may be called from any thread while engines are running
+    *
+    * Return:         trace text or null if error
+    *
+    */
+   public native String riaTraceDrain();
+
+   /*
+    * Continues script which returned riaExecPending, status and result 
+    * are stored as by riaExecute; requires native part built with 
+    * USE_RIA_ASYNC_CALLS
+    *
+    * Parameters:     engine         engine handle
+    *
+    * Return:         true           if successful
+    *                 false          if failed
+    *
+    */
+   public native boolean riaContinue(int engine);
+
+   /*
+    * Drives pending network requests of all engines, so that one thread
+    * can serve many scripts; engines still pending after riaContinue 
+    * report riaExecPending again
+    *
+    * Parameters:     timeout        time to wait for network activity, ms
+    *
+    * Return:         number of completed requests or -1 if error
+    *
+    */
+   public native int riaPoll(int timeout);
+
+   /*
     * Load native part
     *
     */
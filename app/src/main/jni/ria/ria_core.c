@@ -1,5 +1,6 @@
 #include "ria_core.h"
 #include "ria_func.h"
+#include "ria_papi.h"
 #ifdef ANDROID
 #include <android/log.h>
 #endif
@@ -45,12 +46,33 @@ bool
        }
 
 #ifdef USE_RIA_TRACE
+/*
+ * Trace items and ring buffer; record text is limited by staged items
+ * (integer of 5 octets gives up to 11 chars)
+ *
+ */
+enum {
+   ria_trace_item_str  = 0x01,
+   ria_trace_item_int  = 0x02,
+   ria_trace_ring_size = 0x10000,
+   ria_trace_ring_mask = ria_trace_ring_size - 1,
+   ria_trace_text_size = 0x200
+};
+
+ria_trace_level_t ria_trace_level = ria_trace_off;
+
+static byte   _trace_ring[ria_trace_ring_size];
+static usize  _trace_head = 0;
+static usize  _trace_tail = 0;
+static usize  _trace_lost = 0;
+static uint32 _trace_sync = 0;
+
 #ifdef ANDROID
 /* 
  * Android logging support
  *
  */
-void 
+static void 
    do_android_log(
       char*         IN OUT   buf,
       uint*         IN OUT   cval,
@@ -89,6 +111,213 @@ void
    
 }      
 #endif      
+
+/*****************************************************************************/
+static usize
+   ria_trace_format(
+      char*         OUT   text,
+      const byte*   IN    rec,
+      usize         IN    crec)
+/*
+ * Formats staged trace record, text buffer has ria_trace_text_size 
+ * chars; returns text length
+ *
+ */
+{
+
+   usize i, l = 0;
+   int n;
+
+   for (i=0; i<crec; ) {
+      if ((rec[i] == ria_trace_item_str) && (i+2 <= crec) && 
+          (i+2+rec[i+1] <= crec)) {
+         MemCpy(text+l, rec+i+2, rec[i+1]);
+         l += rec[i+1];
+         i += 2 + rec[i+1];
+      }
+      else
+      if ((rec[i] == ria_trace_item_int) && (i+5 <= crec)) {
+         n = (int)(((uint32)rec[i+1] << 24) | ((uint32)rec[i+2] << 16) | 
+                   ((uint32)rec[i+3] <<  8) |  (uint32)rec[i+4]);
+         Sprintf(text+l, ria_trace_text_size-l, "%d", n);
+         l += StrLen(text+l);
+         i += 5;
+      }
+      else
+         break;
+   }
+   return l;
+
+}
+
+/*****************************************************************************/
+void 
+   ria_trace_put_str(
+      ria_trace_buf_t*    IN OUT   buf,
+      const char*         IN       str,
+      usize               IN       len,
+      ria_trace_level_t   IN       level)
+/*
+ * Stages string into trace record
+ *
+ */
+{
+
+   usize c;
+
+   assert(buf != NULL);
+   assert((str != NULL) || (len == 0));
+
+   for (; len>0; str+=c, len-=c) {
+      if (buf->c + 3 > sizeof(buf->p))
+         ria_trace_flush(buf, level);
+      c = sizeof(buf->p) - buf->c - 2;
+      if (c > len)
+         c = len;
+      buf->p[buf->c]   = ria_trace_item_str;
+      buf->p[buf->c+1] = (byte)c;
+      MemCpy(buf->p+buf->c+2, str, c);
+      buf->c += c + 2;
+   }
+
+}
+
+/*****************************************************************************/
+void 
+   ria_trace_put_int(
+      ria_trace_buf_t*    IN OUT   buf,
+      int                 IN       value,
+      ria_trace_level_t   IN       level)
+/*
+ * Stages integer into trace record
+ *
+ */
+{
+
+   assert(buf != NULL);
+
+   if (buf->c + 5 > sizeof(buf->p))
+      ria_trace_flush(buf, level);
+   buf->p[buf->c]   = ria_trace_item_int;
+   buf->p[buf->c+1] = (byte)((uint32)value >> 24);
+   buf->p[buf->c+2] = (byte)((uint32)value >> 16);
+   buf->p[buf->c+3] = (byte)((uint32)value >>  8);
+   buf->p[buf->c+4] = (byte)((uint32)value >>  0);
+   buf->c += 5;
+
+}
+
+/*****************************************************************************/
+void 
+   ria_trace_flush(
+      ria_trace_buf_t*    IN OUT   buf,
+      ria_trace_level_t   IN       level)
+/*
+ * Writes staged trace record to log or ring buffer
+ *
+ */
+{
+
+   char  sz[ria_trace_text_size];
+   usize i, l;
+#ifdef ANDROID
+   char  sl[100];
+   uint  cl = 0;
+#endif
+
+   assert(buf != NULL);
+
+   if (buf->c == 0)
+      return;
+
+   switch (level) {
+
+   /* Record of 2-octet length and items, dropped if there is no room */
+   case ria_trace_ring:
+      while (sync_interlocked_exchange32(&_trace_sync, 1) == 1);
+      if (buf->c + 2 > ria_trace_ring_size - (_trace_head - _trace_tail))
+         _trace_lost++;
+      else {
+         _trace_ring[_trace_head++ & ria_trace_ring_mask] = (byte)(buf->c >> 8);
+         _trace_ring[_trace_head++ & ria_trace_ring_mask] = (byte)(buf->c);
+         for (i=0; i<buf->c; i++)
+            _trace_ring[_trace_head++ & ria_trace_ring_mask] = buf->p[i];
+      }
+      sync_interlocked_exchange32(&_trace_sync, 0);
+      break;
+
+   /* Text */
+   case ria_trace_log:
+      l = ria_trace_format(sz, buf->p, buf->c);
+#ifdef ANDROID
+      do_android_log(sl, &cl, sizeof(sl), sz, l, true);
+#else
+      sz[l] = 0x00;
+      Fprintf(Stdout, "%s", sz);
+      Fflush(Stdout);
+#endif
+      break;
+
+   default:
+      break;
+   }
+   buf->c = 0;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_trace_drain(
+      char*    OUT      text,
+      usize*   IN OUT   ctext)
+/*
+ * Moves records from ring buffer into text
+ *
+ */
+{
+
+   byte  rec[ria_trace_buf_size];
+   char  sz[ria_trace_text_size];
+   usize i, c, l, n = 0;
+
+   assert(text  != NULL);
+   assert(ctext != NULL);
+
+   while (sync_interlocked_exchange32(&_trace_sync, 1) == 1);
+   for (; _trace_tail != _trace_head; ) {
+      c = (_trace_ring[_trace_tail & ria_trace_ring_mask] << 8) |
+           _trace_ring[(_trace_tail+1) & ria_trace_ring_mask];
+      if (c > sizeof(rec)) {
+         _trace_tail = _trace_head;
+         sync_interlocked_exchange32(&_trace_sync, 0);
+         ERR_SET(err_internal);
+      }
+      for (i=0; i<c; i++)
+         rec[i] = _trace_ring[(_trace_tail+2+i) & ria_trace_ring_mask];
+      l = ria_trace_format(sz, rec, c);
+      if ((l == 0) || (sz[l-1] != '\n'))
+         sz[l++] = '\n';
+      if (n + l > *ctext)
+         break;
+      MemCpy(text+n, sz, l);
+      n += l;
+      _trace_tail += 2 + c;
+   }
+   if ((_trace_lost > 0) && (_trace_tail == _trace_head)) {
+      Sprintf(sz, sizeof(sz), "%u trace records lost\n", (unsigned)_trace_lost);
+      l = StrLen(sz);
+      if (n + l <= *ctext) {
+         MemCpy(text+n, sz, l);
+         n += l;
+         _trace_lost = 0;
+      }
+   }
+   sync_interlocked_exchange32(&_trace_sync, 0);
+
+   *ctext = n;
+   return true;
+
+}
 #endif
 
 
@@ -104,9 +333,24 @@ enum {
    ria_mask_var_name_len = 0x00FFFFFF,
    ria_mask_var_type     = 0xFF000000,
    ria_shift_var_type    = 24,
-   ria_var_unknown       = (unumber)-1
+   ria_var_unknown       = (unumber)-1,
+   ria_hash_buckets      = 0x40,
+   ria_hash_load         = 2,
+   ria_hash_entry        = 2
 };
 
+/*
+ * Symbol hash tables layout:
+ * BH...H(NF)...(NF)
+ * B - number of buckets, power of 2, starts from ria_hash_buckets and is
+ *     doubled when there are more than ria_hash_load symbols per bucket
+ * H - bucket heads (B entries), index of symbol plus 1
+ * N - chain link (one per symbol), index of next symbol plus 1
+ * F - full hash of symbol name, so that table may be rehashed without 
+ *     names and most mismatches are rejected without comparing names
+ *
+ */
+
 /*****************************************************************************/
 bool
    ria_find_char(
@@ -202,12 +446,201 @@ bool
 
 }
 
+/*****************************************************************************/
+uint32
+   ria_hash_data(
+      uint32        IN   h,
+      const byte*   IN   p,
+      usize         IN   c)
+/*
+ * Continues FNV-1a hash over data
+ *
+ */
+{
+
+   assert((c == 0) || (p != NULL));
+
+   for (; c>0; c--, p++)
+      h = (h ^ *p) * 0x01000193;
+
+   return h;
+
+}
+
+/*****************************************************************************/
+usize
+   ria_hash_count(
+      const buf_t*   IN   hash)
+/*
+ * Returns number of symbols in hash table
+ *
+ */
+{
+
+   const usize* ph;
+   usize c;
+
+   assert(hash != NULL);
+
+   c  = buf_get_length(hash);
+   ph = buf_get_ptr_usizes(hash);
+   if ((c == 0) || (c < 1+ph[0]))
+      return 0;
+   return (c-1-ph[0]) / ria_hash_entry;
+
+}
+
+/*****************************************************************************/
+usize
+   ria_hash_first(
+      const buf_t*   IN   hash,
+      uint32         IN   h)
+/*
+ * Returns index plus 1 of last added symbol with given hash, 0 if none
+ *
+ */
+{
+
+   const usize* ph;
+   usize j;
+
+   assert(hash != NULL);
+
+   ph = buf_get_ptr_usizes(hash);
+   j  = ph[1 + (h & (ph[0]-1))];
+   while ((j > 0) && (ph[1+ph[0]+(j-1)*ria_hash_entry+1] != h))
+      j = ph[1+ph[0]+(j-1)*ria_hash_entry];
+
+   return j;
+
+}
+
+/*****************************************************************************/
+usize
+   ria_hash_next(
+      const buf_t*   IN   hash,
+      usize          IN   j,
+      uint32         IN   h)
+/*
+ * Returns index plus 1 of previous symbol with the same hash, 0 if none
+ *
+ */
+{
+
+   const usize* ph;
+
+   assert(hash != NULL);
+   assert(j    >  0);
+
+   ph = buf_get_ptr_usizes(hash);
+   do
+      j = ph[1+ph[0]+(j-1)*ria_hash_entry];
+   while ((j > 0) && (ph[1+ph[0]+(j-1)*ria_hash_entry+1] != h));
+
+   return j;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_hash_reset(
+      buf_t*   IN OUT   hash)
+/*
+ * Empties symbol hash table
+ *
+ */
+{
+
+   assert(hash != NULL);
+
+   buf_set_empty(hash);
+   if (!buf_fill(0, 0, 1+ria_hash_buckets, hash))
+      return false;
+   buf_get_ptr_usizes(hash)[0] = ria_hash_buckets;
+
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_hash_grow(
+      buf_t*   IN OUT   hash)
+/*
+ * Doubles number of buckets and relinks all symbols
+ *
+ */
+{
+
+   usize b, c, j, h;
+   usize* ph;
+
+   assert(hash != NULL);
+
+   ph = buf_get_ptr_usizes(hash);
+   b  = ph[0];
+   c  = ria_hash_count(hash);
+   if (!buf_expand(1+2*b+c*ria_hash_entry, hash))
+      return false;
+   ph = buf_get_ptr_usizes(hash);
+   MemMove(ph+1+2*b, ph+1+b, c*ria_hash_entry*sizeof(usize));
+   MemSet(ph+1, 0, 2*b*sizeof(usize));
+   ph[0] = b = 2*b;
+   for (j=0; j<c; j++) {
+      h = 1 + (ph[1+b+j*ria_hash_entry+1] & (b-1));
+      ph[1+b+j*ria_hash_entry] = ph[h];
+      ph[h] = j + 1;
+   }
+
+   return buf_set_length(1+b+c*ria_hash_entry, hash);
+
+}
+
+/*****************************************************************************/
+bool
+   ria_hash_insert(
+      buf_t*        IN OUT   hash,
+      usize         IN       idx,
+      const byte*   IN       pname,
+      usize         IN       cname)
+/*
+ * Links new symbol into hash table
+ *
+ */
+{
+
+   uint32 h;
+   usize b;
+   usize* ph;
+
+   assert(hash  != NULL);
+   assert(pname != NULL);
+
+   if ((buf_get_length(hash) == 0) || (ria_hash_count(hash) != idx))
+      ERR_SET(err_internal);
+   if (idx >= buf_get_ptr_usizes(hash)[0]*ria_hash_load)
+      if (!ria_hash_grow(hash))
+         return false;
+   b = buf_get_ptr_usizes(hash)[0];
+   if (!buf_expand(1+b+(idx+1)*ria_hash_entry, hash))
+      return false;
+   h  = ria_hash_data(ria_hash_seed, pname, cname);
+   ph = buf_get_ptr_usizes(hash);
+   ph[1+b+idx*ria_hash_entry]   = ph[1+(h & (b-1))];
+   ph[1+b+idx*ria_hash_entry+1] = h;
+   ph[1+(h & (b-1))] = idx + 1;
+
+   return buf_set_length(1+b+(idx+1)*ria_hash_entry, hash);
+
+}
+
 /*****************************************************************************/
 bool
    ria_find_var_index(
       usize*                OUT      varidx,
       const buf_t*          IN       names,
       const buf_t*          IN       sizes,
+      const buf_t*          IN       hash,
       const byte*           IN       pname,
       usize                 IN       cname,
       ria_compiler_ctx_t*   IN OUT   ctx)
@@ -220,10 +653,12 @@ bool
    usize j, c;
    byte** pp;
    usize* pc;
+   uint32 h;
 
    assert(varidx != NULL);
    assert(names  != NULL);
    assert(sizes  != NULL);
+   assert(hash   != NULL);
    assert(pname  != NULL);
    assert(ctx    != NULL);
 
@@ -236,17 +671,20 @@ bool
    c = buf_get_length(names);
    if (buf_get_length(sizes) != c)
       ERR_SET(err_internal);
+   if ((buf_get_length(hash) == 0) || (ria_hash_count(hash) != c))
+      ERR_SET(err_internal);
    pp = buf_get_ptr_ptrs(names);
    pc = buf_get_ptr_usizes(sizes);
-   for (j=0; j<c; j++) {
-      if ((pc[j] & ria_mask_var_name_len) != cname)
+   h  = ria_hash_data(ria_hash_seed, pname, cname);
+   for (j=ria_hash_first(hash, h); j>0; j=ria_hash_next(hash, j, h)) {
+      if ((pc[j-1] & ria_mask_var_name_len) != cname)
          continue;
-      if (!MemCmp(pp[j], pname, cname))
+      if (!MemCmp(pp[j-1], pname, cname))
          break;
    }
-   if (j < c) {
-      *varidx = j;
-      ctx->expr_type = (pc[j] & ria_mask_var_type) >> ria_shift_var_type;
+   if (j > 0) {
+      *varidx = j - 1;
+      ctx->expr_type = (pc[j-1] & ria_mask_var_type) >> ria_shift_var_type;
    }
 
    return true;
@@ -299,6 +737,7 @@ bool
            varidx, 
            &ctx->globalp, 
            &ctx->globalc, 
+           &ctx->globalh, 
            buf->p, 
            i, 
            ctx))
@@ -312,7 +751,14 @@ bool
     * Try to find variable in local pool
     *
     */
-   return ria_find_var_index(varidx, &ctx->varp, &ctx->varc, buf->p, i, ctx);
+   return ria_find_var_index(
+             varidx, 
+             &ctx->varp, 
+             &ctx->varc, 
+             &ctx->varh, 
+             buf->p, 
+             i, 
+             ctx);
 
 }
 
@@ -333,6 +779,7 @@ bool
 
    buf_t* names = (global) ? &ctx->globalp : &ctx->varp;
    buf_t* sizes = (global) ? &ctx->globalc : &ctx->varc;
+   buf_t* hash  = (global) ? &ctx->globalh : &ctx->varh;
    usize c;
 
    assert(varidx != NULL);
@@ -352,6 +799,8 @@ bool
    buf_get_ptr_ptrs(names)[c] = (byte*)pname;
    if (!buf_set_length(c+1, names))
       return false;
+   if (!ria_hash_insert(hash, c, pname, cname))
+      return false;
       
    *varidx = (global) ? c+ria_var_threshold : c;
    return true;      
@@ -360,41 +809,74 @@ bool
 
 /*****************************************************************************/
 bool
-   ria_find_string(
-      usize*                OUT      strlen,
+   ria_append_string(
       usize*                OUT      stridx,
-      const mem_blk_t*      IN       buf,
+      const byte*           IN       pstr,
+      usize                 IN       cstr,
       ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Extracts string constant from stream and searches for its index
+ * Adds string constant to pool unconditionally
+ *
+ */
+{
+
+   usize c;
+
+   assert(stridx != NULL);
+   assert((cstr == 0) || (pstr != NULL));
+   assert(ctx    != NULL);
+
+   c = buf_get_length(&ctx->strp);
+   if (!buf_expand(c+1, &ctx->strc))
+      return false;
+   buf_get_ptr_usizes(&ctx->strc)[c] = cstr;
+   if (!buf_set_length(c+1, &ctx->strc))
+      return false;
+   if (!buf_expand(c+1, &ctx->strp))
+      return false;
+   buf_get_ptr_ptrs(&ctx->strp)[c] = (byte*)pstr;
+   if (!buf_set_length(c+1, &ctx->strp))
+      return false;
+   if (!ria_hash_insert(&ctx->strh, c, pstr, cstr))
+      return false;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Adding new string constant\n");
+   RIA_TRACE_STR(pstr, cstr);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif      
+
+   *stridx = c;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_add_string(
+      bool*                 OUT      added,
+      usize*                OUT      stridx,
+      const byte*           IN       pstr,
+      usize                 IN       cstr,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Searches for string constant in pool, adds if not found
  *
  */
 {
 
    usize j, c;
-   mem_blk_t tmp;
-   byte* p;
    byte** pp;
    usize* pc;
+   uint32 h;
 
-   assert(strlen != NULL);
+   assert(added  != NULL);
    assert(stridx != NULL);
-   assert(buf    != NULL);
-
-   /*
-    * Find end of string
-    *
-    */
-   tmp.p = buf->p + 1;
-   tmp.c = buf->c - 1;
-   if (!ria_find_end_of_string(&p, &tmp))
-      return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, buf->p, "unterminated string");
-      return true;
-   }
+   assert((cstr == 0) || (pstr != NULL));
+   assert(ctx    != NULL);
 
-   *strlen = p - tmp.p;
+   *added = false;
 
    /*
     * Try to find string in pool
@@ -403,44 +885,160 @@ bool
    c = buf_get_length(&ctx->strp);
    if (buf_get_length(&ctx->strc) != c)
       ERR_SET(err_internal);
+   if ((buf_get_length(&ctx->strh) == 0) || 
+       (ria_hash_count(&ctx->strh) != c))
+      ERR_SET(err_internal);
    pp = buf_get_ptr_ptrs(&ctx->strp);
    pc = buf_get_ptr_usizes(&ctx->strc);
-   for (j=0; j<c; j++) {
-      if (pc[j] != *strlen)
+   h  = ria_hash_data(ria_hash_seed, pstr, cstr);
+   for (j = ria_hash_first(&ctx->strh, h); 
+        j > 0; 
+        j = ria_hash_next(&ctx->strh, j, h)) {
+      if (pc[j-1] != cstr)
          continue;
-      if (!MemCmp(pp[j], tmp.p, *strlen))
+      if (!MemCmp(pp[j-1], pstr, cstr))
          break;
    }
+   if (j > 0) {
+      *stridx = j - 1;
+      return true;
+   }
 
    /*
     * Add if not found
     *
     */
-   if (j >= c) {
-      if (!buf_expand(c+1, &ctx->strc))
-         return false;
-      buf_get_ptr_usizes(&ctx->strc)[c] = *strlen;
-      if (!buf_set_length(c+1, &ctx->strc))
-         return false;
-      if (!buf_expand(c+1, &ctx->strp))
-         return false;
-      buf_get_ptr_ptrs(&ctx->strp)[c] = tmp.p;
-      if (!buf_set_length(c+1, &ctx->strp))
-         return false;
-      j = c;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("Adding new string constant\n");
-      RIA_TRACE_STR(tmp.p, *strlen);
-      RIA_TRACE_MSG("\n");
-#endif      
+   if (!ria_append_string(stridx, pstr, cstr, ctx))
+      return false;
+   *added = true;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_find_string(
+      usize*                OUT      strlen,
+      usize*                OUT      stridx,
+      const mem_blk_t*      IN       buf,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Extracts string constant from stream and searches for its index
+ *
+ */
+{
+
+   mem_blk_t tmp;
+   byte* p;
+   bool added;
+
+   assert(strlen != NULL);
+   assert(stridx != NULL);
+   assert(buf    != NULL);
+
+   /*
+    * Find end of string
+    *
+    */
+   tmp.p = buf->p + 1;
+   tmp.c = buf->c - 1;
+   if (!ria_find_end_of_string(&p, &tmp))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, buf->p, "unterminated string");
+      return true;
    }
 
-   *stridx = j;
+   *strlen = p - tmp.p;
+
+   /*
+    * Find string in pool or add new one
+    *
+    */
+   if (!ria_add_string(&added, stridx, tmp.p, *strlen, ctx))
+      return false;
+
    ctx->expr_type = ria_string;
    return true;
 
 }
 
+/*****************************************************************************/
+bool
+   ria_fold_string(
+      usize*                OUT      stridx,
+      usize                 IN       idx1,
+      usize                 IN       idx2,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Concatenates two string constants into new one
+ *
+ */
+{
+
+   usize c, c1, c2;
+   byte* p;
+   bool added;
+
+   assert(stridx != NULL);
+   assert(ctx    != NULL);
+
+   c = buf_get_length(&ctx->strp);
+   if ((idx1 >= c) || (idx2 >= c))
+      ERR_SET(err_internal);
+
+   /*
+    * Strings are kept in source form, so escape sequences
+    * remain valid after concatenation
+    *
+    */
+   c1 = buf_get_ptr_usizes(&ctx->strc)[idx1];
+   c2 = buf_get_ptr_usizes(&ctx->strc)[idx2];
+   c  = buf_get_length(&ctx->strf);
+   if (!buf_expand(c+1, &ctx->strf))
+      return false;
+   if (!heap_alloc((void**)&p, c1+c2+1, ctx->mem))
+      return false;
+   MemCpy(p, buf_get_ptr_ptrs(&ctx->strp)[idx1], c1);
+   MemCpy(p+c1, buf_get_ptr_ptrs(&ctx->strp)[idx2], c2);
+
+   /*
+    * Add to pool, keep storage until module is done
+    *
+    */
+   if (!ria_add_string(&added, stridx, p, c1+c2, ctx)) {
+      heap_free(p, ctx->mem);
+      return false;
+   }
+   if (!added)
+      return heap_free(p, ctx->mem);
+   buf_get_ptr_ptrs(&ctx->strf)[c] = p;
+   return buf_set_length(c+1, &ctx->strf);
+
+}
+
+/*****************************************************************************/
+bool
+   ria_free_folded_strings(
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Releases storage of string constants made by folding
+ *
+ */
+{
+
+   usize i;
+   bool ret = true;
+
+   assert(ctx != NULL);
+
+   for (i=buf_get_length(&ctx->strf); i>0; i--) 
+      ret = heap_free(buf_get_ptr_ptrs(&ctx->strf)[i-1], ctx->mem) && ret;
+   buf_set_empty(&ctx->strf);
+   return ret;
+
+}
+
 /*****************************************************************************/
 bool
    ria_find_param(
@@ -482,1921 +1080,6512 @@ bool
 
 }
 
-/******************************************************************************
- *  Compiler
- */
-
+/*****************************************************************************/
+bool
+   ria_decode_varint(
+      usize*        OUT   value,
+      usize*        OUT   size,
+      const byte*   IN    p,
+      usize         IN    c)
 /*
- * Lexem types
+ * Decodes varint value
  *
  */
-#define FUNCTYPE(_x) ria_lex_##_x = ria_func_##_x
-typedef enum ria_lextype_e {
-   ria_lex_return = 0x01,
-   ria_lex_if     = 0x02,
-   ria_lex_while  = 0x03,
-   FUNCTYPE(add_parsing_rule),
-   FUNCTYPE(create_parser_for_file),
-   FUNCTYPE(dehtml),
-   FUNCTYPE(extract_string),
-   FUNCTYPE(extract_string_from_file),
-   FUNCTYPE(get_binary_to_file),
-   FUNCTYPE(get_header),
-   FUNCTYPE(get_html),
-   FUNCTYPE(get_html_with_dump),
-   FUNCTYPE(get_html_to_file),
-   FUNCTYPE(get_html_to_file_with_dump),
-   FUNCTYPE(int_to_string),
-   FUNCTYPE(last_response),
-   FUNCTYPE(length),
-   FUNCTYPE(load_cookie),
-   FUNCTYPE(load_from_file),
-   FUNCTYPE(post),
-   FUNCTYPE(post_to_file),
-   FUNCTYPE(post_to_file_with_dump),
-   FUNCTYPE(post_with_dump),
-   FUNCTYPE(save_cookie),
-   FUNCTYPE(save_to_file),
-   FUNCTYPE(set_header),
-   FUNCTYPE(string_to_int),
-   FUNCTYPE(substring)
-} ria_lextype_t;
+{
 
-/*
- * Lexem description
- *
- */
-typedef struct ria_lexem_s {
-   const char*     p;
-   usize           c;
-   ria_lextype_t   t;
-   unumber         params;
-} ria_lexem_t;
+   usize i, u;
+
+   assert(value != NULL);
+   assert(size  != NULL);
+   assert(p     != NULL);
+
+   for (i=u=0; ; i++) {
+      if ((i == c) || (i == ria_varint_size))
+         ERR_SET(err_bad_length);
+      u |= (usize)(p[i] & 0x7F) << (7*i);
+      if (!(p[i] & 0x80))
+         break;
+   }
+
+   *value = u;
+   *size  = i + 1;
+   return true;
 
+}
+
+/*****************************************************************************/
+bool
+   ria_encode_varint(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      usize    IN       value)
 /*
- * Function lexem description
+ * Encodes varint value
  *
  */
-typedef struct ria_func_lexem_s {
-   ria_lexem_t    info;
-   unumber        params;
-   ria_type_t     ret;
-   function_fn*   impl;
-} ria_func_lexem_t;
+{
+
+   usize i;
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (value >> (7*ria_varint_size))
+      ERR_SET(err_not_supported);
+   for (i=0; ; i++) {
+      if (i == *pc)
+         ERR_SET(err_bad_length);
+      (*pp)[i] = (byte)(value & 0x7F);
+      value >>= 7;
+      if (value == 0)
+         break;
+      (*pp)[i] |= 0x80;
+   }
 
+   (*pp) += i + 1;
+   (*pc) -= i + 1;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_get_module_info(
+      usize*             OUT   version,
+      usize*             OUT   count,
+      usize*             OUT   table,
+      usize*             OUT   strs,
+      const mem_blk_t*   IN    module)
 /*
- * Lexems
+ * Parses executable module header
  *
  */
-#define LEXEM(_s) { #_s"(", sizeof(#_s), ria_lex_##_s }
-static const ria_lexem_t 
-   _lex[] =
 {
-   LEXEM(return),
-   LEXEM(if),
-   LEXEM(while)
-};
 
+   const byte* p;
+
+   assert(version != NULL);
+   assert(count   != NULL);
+   assert(table   != NULL);
+   assert(strs    != NULL);
+   assert(module  != NULL);
+
+   p = module->p;
+   if (module->c <= ria_header_size)
+      ERR_SET(err_bad_param);
+   if (p[0] != ria_module_mark) {
+      *version = ria_module_v1;
+      *count   = p[0];
+      *table   = ria_header_size;
+      *strs    = (p[1] << 16) | (p[2] << 8) | p[3];
+   }
+   else {
+      if (module->c <= ria_header_size_v2)
+         ERR_SET(err_bad_param);
+      if (p[1] != ria_module_v2)
+         ERR_SET(err_not_supported);
+      *version = ria_module_v2;
+      *count   = 
+         ((usize)p[2] << 24) | (p[3] << 16) | (p[4] << 8) | p[5];
+      *table   = ria_header_size_v2;
+      *strs    = 
+         ((usize)p[6] << 24) | (p[7] << 16) | (p[8] << 8) | p[9];
+   }
+   if ((module->c < *strs) || (*strs < *table))
+      ERR_SET(err_bad_param);
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_get_module_entry(
+      const byte**   OUT   name,
+      usize*         OUT   len,
+      usize*         OUT   params,
+      usize*         OUT   offset,
+      uint32*        OUT   hash,
+      usize*         OUT   size,
+      usize          IN    version,
+      const byte*    IN    p,
+      usize          IN    c)
 /*
- * Function lexems
+ * Parses entry of executable module functions table
  *
  */
-#define FUNC_LEXEM(_s, _par, _ret)                                           \
-   { LEXEM(_s), _par, ria_##_ret, ria_implement_##_s }
-static const ria_func_lexem_t 
-   _func_lex[] =
 {
-   FUNC_LEXEM(add_parsing_rule, 4, unknown),
-   FUNC_LEXEM(create_parser_for_file, 2, unknown),
-   FUNC_LEXEM(dehtml, 1, string),
-   FUNC_LEXEM(extract_string, 4, string),
-   FUNC_LEXEM(extract_string_from_file, 4, string),
-   FUNC_LEXEM(get_binary_to_file, 2, int),
-   FUNC_LEXEM(get_header, 1, string),
-   FUNC_LEXEM(get_html, 1, int),
-   FUNC_LEXEM(get_html_with_dump, 2, int),
-   FUNC_LEXEM(get_html_to_file, 2, int),
-   FUNC_LEXEM(get_html_to_file_with_dump, 3, int),
-   FUNC_LEXEM(int_to_string, 1, string),
-   FUNC_LEXEM(last_response, 0, string),
-   FUNC_LEXEM(length, 1, int),
-   FUNC_LEXEM(load_cookie, 3, string),
-   FUNC_LEXEM(load_from_file, 1, string),
-   FUNC_LEXEM(post, 2, int),
-   FUNC_LEXEM(post_to_file, 3, int),
-   FUNC_LEXEM(post_to_file_with_dump, 4, int),
-   FUNC_LEXEM(post_with_dump, 3, int),
-   FUNC_LEXEM(save_cookie, 3, unknown),
-   FUNC_LEXEM(save_to_file, 2, unknown),
-   FUNC_LEXEM(set_header, 2, unknown),
-   FUNC_LEXEM(string_to_int, 1, int),
-   FUNC_LEXEM(substring, 3, string)
-};
+
+   usize i, k;
+
+   assert(name   != NULL);
+   assert(len    != NULL);
+   assert(params != NULL);
+   assert(offset != NULL);
+   assert(hash   != NULL);
+   assert(size   != NULL);
+   assert(p      != NULL);
+
+   if (version == ria_module_v1) {
+      if ((c < 1) || (c < (usize)p[0] + ria_fextra_size))
+         ERR_SET(err_bad_param);
+      *len    = p[0];
+      *name   = p + 1;
+      *params = p[*len+1];
+      *offset = (p[*len+2] << 16) | (p[*len+3] << 8) | p[*len+4];
+      *hash   = 0;
+      *size   = *len + ria_fextra_size;
+      return true;
+   }
+
+   if (!ria_decode_varint(len, &k, p, c))
+      return false;
+   i = k;
+   if (c-i < *len)
+      ERR_SET(err_bad_param);
+   *name = p + i;
+   i += *len;
+   if (!ria_decode_varint(params, &k, p+i, c-i))
+      return false;
+   i += k;
+   if (c-i < 8)
+      ERR_SET(err_bad_param);
+   *offset = 
+      ((usize)p[i] << 24) | (p[i+1] << 16) | (p[i+2] << 8) | p[i+3];
+   *hash = 
+      ((uint32)p[i+4] << 24) | (p[i+5] << 16) | (p[i+6] << 8) | p[i+7];
+   *size = i + 8;
+   return true;
+
+}
 
 /*****************************************************************************/
-bool 
-   ria_match_op_and_type(
-      ria_type_t*   IN OUT   type,
-      bool          IN       unary,
-      byte          IN       op1,
-      byte          IN       op2)
+bool
+   ria_find_module_entry(
+      usize*             OUT   entry,
+      const byte*        IN    name,
+      usize              IN    len,
+      const mem_blk_t*   IN    module)
 /*
- * Validates operation against data type
+ * Searches executable module functions table for function
  *
  */
 {
 
-   assert(type != NULL);
+   usize v, n, t, u, k, j, x, o, c;
+   const byte* pn;
+   uint32 h;
 
-   if (*type == ria_unknown)
+   assert(entry  != NULL);
+   assert(name   != NULL);
+   assert(module != NULL);
+
+   *entry = 0;
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
       return false;
-
-   switch (op2) {
-   case 0x00:
-      switch (op1) {
-      case '+':
-         if (*type == ria_boolean) 
-            return false;
-         break;
-      case '<':
-      case '>':
-         if (*type == ria_boolean) 
-            return false;
-         *type = ria_boolean;
-         break;
-      case '_':
-      case '~':
-         if (!unary) 
-            return false;
-      case '-':
-      case '*':
-      case '/':
-      case '%':
-      case '&':
-      case '|':
-      case '^':
-         if (*type != ria_int) 
-            return false;
-         break;
-      case '!':
-         if (*type != ria_boolean) 
-            return false;
-         break;
-      default:
-        return false;
-      }
-      break;
-   case '=':
-      switch (op1) {
-      case '<':
-      case '>':
-         if (*type == ria_boolean) 
-            return false;
-         *type = ria_boolean;
-         break;
-      case '=':
-      case '!':
-         *type = ria_boolean;
-         break;
-      default:
-         return false;
-      }
-      break;
-   case '|':
-      switch (op1) {
-      case '|':
-         if (*type == ria_boolean) 
-            break;
-      default:
-         return false;
-      }
-      break;
-   case '&':
-      switch (op1) {
-      case '&':
-         if (*type == ria_boolean) 
-            break;
-      default:
-         return false;
-      }
-      break;
-   default:
-      return false;
-   }
-
-   return true;
+   for (k=0; k<n; k++, t+=c) {
+      if (!ria_get_module_entry(
+              &pn, &j, &x, &o, &h, &c, v, module->p+t, u-t))
+         return false;
+      if (j == len)
+         if (!MemCmp(pn, name, len)) {
+            *entry = t;
+            break;
+         }
+   }
+   return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_get_function_info(                                            
-      ria_type_t*     OUT   type,
-      unumber*        OUT   params,
-      function_fn**   OUT   impl,
-      unumber         IN    func)
+bool
+   ria_get_module_chunk(
+      usize*             OUT   offset,
+      usize*             OUT   size,
+      usize              IN    entry,
+      const mem_blk_t*   IN    module)
 /*
- * Returns information about predefind function 
+ * Gets extent of function code, which runs up to next entry point
  *
  */
 {
 
-   usize i;
+   usize v, n, t, u, k, j, x, o, e, c;
+   const byte* pn;
+   uint32 h;
 
-   assert(params != NULL);
-   assert(impl   != NULL);
-   assert(type   != NULL);
+   assert(offset != NULL);
+   assert(size   != NULL);
+   assert(module != NULL);
 
-   for (i=0; i<sizeof(_func_lex)/sizeof(_func_lex[0]); i++) 
-      if ((unsigned)_func_lex[i].info.t == func) {
-         if (_func_lex[i].impl == NULL)
-            ERR_SET(err_internal);
-         *params = _func_lex[i].params;
-         *impl   = _func_lex[i].impl;
-         *type   = _func_lex[i].ret;
-         return true;
-      }
-   
-   ERR_SET(err_internal);
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
+      return false;
+   if ((entry < t) || (entry >= u))
+      ERR_SET(err_bad_param);
+   if (!ria_get_module_entry(
+           &pn, &j, &x, offset, &h, &c, v, module->p+entry, u-entry))
+      return false;
+   if (*offset >= u)
+      ERR_SET(err_bad_param);
+   for (k=0, e=u; k<n; k++, t+=c) {
+      if (!ria_get_module_entry(&pn, &j, &x, &o, &h, &c, v, module->p+t, u-t))
+         return false;
+      if ((o > *offset) && (o < e))
+         e = o;
+   }
+   *size = e - *offset;
+   return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_encode_push_var(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      usize    IN       idx)
+bool
+   ria_load_module_strings(
+      const mem_blk_t*      IN       module,
+      ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Encodes push-var command 
+ * Adds string constants of executable module to pool in the same order,
+ * converting them back to source form
  *
  */
 {
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+   usize v, n, t, u, i, j, k, c, x;
+   const byte* p;
+   byte* q;
 
-   if (*pc < 2)
-      ERR_SET(err_bad_length);
-   if (idx > 0xFF)
-      ERR_SET(err_internal);
-   (*pp)[0] = ria_opcode_pushv;
-   (*pp)[1] = (byte)idx;
+   assert(module != NULL);
+   assert(ctx    != NULL);
 
-   (*pp) += 2;
-   (*pc) -= 2;
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
+      return false;
+   for (i=u; i<module->c; i+=c+2) {
+      if (module->p[i] == 0)
+         ERR_SET(err_bad_param);
+      c = module->p[i] - 1;
+      if (module->c-i < c+2)
+         ERR_SET(err_bad_param);
+      p = module->p + i + 1;
+
+      /*
+       * Count characters which need escaping
+       *
+       */
+      for (j=k=0; j<c; j++)
+         switch (p[j]) {
+         case '\\':
+         case '"':
+         case 0x09:
+         case 0x0D:
+         case 0x0A:
+            k++;
+         }
+      if (k == 0) {
+         if (!ria_append_string(&x, p, c, ctx))
+            return false;
+         continue;
+      }
+
+      /*
+       * Make escaped copy, keep storage until module is done
+       *
+       */
+      x = buf_get_length(&ctx->strf);
+      if (!buf_expand(x+1, &ctx->strf))
+         return false;
+      if (!heap_alloc((void**)&q, c+k, ctx->mem))
+         return false;
+      buf_get_ptr_ptrs(&ctx->strf)[x] = q;
+      if (!buf_set_length(x+1, &ctx->strf)) {
+         heap_free(q, ctx->mem);
+         return false;
+      }
+      for (j=k=0; j<c; j++) {
+         switch (p[j]) {
+         case '\\':
+         case '"':
+            q[k++] = '\\';
+            q[k++] = p[j];
+            break;
+         case 0x09:
+            q[k++] = '\\';
+            q[k++] = 't';
+            break;
+         case 0x0D:
+            q[k++] = '\\';
+            q[k++] = 'r';
+            break;
+         case 0x0A:
+            q[k++] = '\\';
+            q[k++] = 'n';
+            break;
+         default:
+            q[k++] = p[j];
+         }
+      }
+      if (!ria_append_string(&x, q, k, ctx))
+         return false;
+   }
    return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_encode_push_string(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      usize    IN       idx)
+bool
+   ria_get_command_size(
+      usize*        OUT   size,
+      const byte*   IN    p,
+      usize         IN    c)
 /*
- * Encodes push-string command 
+ * Returns size of executable command
  *
  */
 {
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+   usize u;
 
-   if (idx > 0xFFFF)
-      ERR_SET(err_internal);
-   if (*pc < (unsigned)((idx > 0xFF) ? 3 : 2))
+   assert(size != NULL);
+   assert(p    != NULL);
+
+   if (c < 1)
       ERR_SET(err_bad_length);
-   if (idx <= 0xFF) {
-      (*pp)[0] = ria_opcode_pushs;
-      (*pp)[1] = (byte)idx;
-      (*pp) += 2;
-      (*pc) -= 2;
-   }
-   else {
-      (*pp)[0] = ria_opcode_pushs2;
-      (*pp)[1] = (byte)(idx >> 8);
-      (*pp)[2] = (byte)(idx >> 0);
-      (*pp) += 3;
-      (*pc) -= 3;
+
+   switch (p[0]) {
+   case ria_opcode_pushvw:
+   case ria_opcode_popw:
+   case ria_opcode_line:
+      if (!ria_decode_varint(&u, size, p+1, c-1))
+         return false;
+      (*size)++;
+      break;
+   case ria_opcode_pushi4:
+   case ria_opcode_jif4:
+   case ria_opcode_jit4:
+   case ria_opcode_jmp4:
+      *size = 5;
+      break;
+   case ria_opcode_pushi3:
+   case ria_opcode_call2v:
+      *size = 4;
+      break;
+   case ria_opcode_pushvs:
+   case ria_opcode_pushs2:
+   case ria_opcode_pushi2:
+   case ria_opcode_call2p:
+   case ria_opcode_call2i:
+   case ria_opcode_callv:
+   case ria_opcode_incv:
+   case ria_opcode_decv:
+   case ria_opcode_jif2:
+   case ria_opcode_jit2:
+   case ria_opcode_jmp2:
+      *size = 3;
+      break;
+   case ria_opcode_pushv:
+   case ria_opcode_pushs:
+   case ria_opcode_pushi1:
+   case ria_opcode_pushp:
+   case ria_opcode_callp:
+   case ria_opcode_calli:
+   case ria_opcode_pop:
+   case ria_opcode_appv:
+   case ria_opcode_kill:
+   case ria_opcode_jif:
+   case ria_opcode_jit:
+   case ria_opcode_jmp:
+      *size = 2;
+      break;
+   default:
+      if ((p[0] >= ria_opcode_add) && (p[0] <= ria_opcode_neg)) {
+         *size = 1;
+         break;
+      }
+      switch (p[0]) {
+      case ria_opcode_ret:
+      case ria_opcode_retn:
+         *size = 1;
+         break;
+      default:
+         ERR_SET(err_internal);
+      }
    }
 
+   if (*size > c)
+      ERR_SET(err_bad_length);
    return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_encode_push_param(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      usize    IN       idx)
+bool
+   ria_compact_strings(
+      mem_blk_t*            IN OUT   code,
+      ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Encodes push-param command 
+ * Drops string constants not referenced by code and renumbers the rest
  *
  */
 {
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+   usize i, j, k, c;
+   byte*  p;
+   byte** pp;
+   usize* pc;
+   usize* pm;
+   buf_t  map;
+   bool   ret = false;
 
-   if (*pc < 2)
-      ERR_SET(err_bad_length);
-   if (idx > 0xFF)
-      ERR_SET(err_internal);
-   (*pp)[0] = ria_opcode_pushp;
-   (*pp)[1] = (byte)idx;
+   assert(code != NULL);
+   assert(ctx  != NULL);
 
-   (*pp) += 2;
-   (*pc) -= 2;
-   return true;
+   c = buf_get_length(&ctx->strp);
+   if (c == 0)
+      return true;
+   if (!buf_create(sizeof(usize), 0, 0, &map, ctx->mem))
+      return false;
+   if (!buf_fill(0, 0, c, &map))
+      goto exit;
+   pm = buf_get_ptr_usizes(&map);
 
-}
+   /*
+    * Mark referenced strings
+    *
+    */
+   for (i=0, p=code->p; i<code->c; i+=k) {
+      if (!ria_get_command_size(&k, p+i, code->c-i))
+         goto exit;
+      switch (p[i]) {
+      case ria_opcode_pushs:
+         j = p[i+1];
+         break;
+      case ria_opcode_pushvs:
+         j = p[i+2];
+         break;
+      case ria_opcode_pushs2:
+         j = (p[i+1] << 8) | p[i+2];
+         break;
+      default:
+         continue;
+      }
+      if (j >= c) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
+      }
+      pm[j] = 1;
+   }
 
-/*****************************************************************************/
-bool 
-   ria_encode_push_int(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      int      IN       i)
-/*
- * Encodes push-param command 
- *
- */
-{
+   /*
+    * Assign new indexes, compact the pool 
+    *
+    */
+   pp = buf_get_ptr_ptrs(&ctx->strp);
+   pc = buf_get_ptr_usizes(&ctx->strc);
+   if (!ria_hash_reset(&ctx->strh))
+      goto exit;
+   for (j=k=0; j<c; j++) {
+      if (pm[j] == 0)
+         continue;
+      pm[j] = k + 1;
+      pp[k] = pp[j];
+      pc[k] = pc[j];
+      if (!ria_hash_insert(&ctx->strh, k, pp[k], pc[k]))
+         goto exit;
+      k++;
+   }
+   if (!buf_set_length(k, &ctx->strp))
+      goto exit;
+   if (!buf_set_length(k, &ctx->strc))
+      goto exit;
 
-   byte opcode;
-   unumber c, j;
+   /*
+    * Patch references, keep command sizes intact
+    *
+    */
+   for (i=0; i<code->c; i+=k) {
+      if (!ria_get_command_size(&k, p+i, code->c-i))
+         goto exit;
+      switch (p[i]) {
+      case ria_opcode_pushs:
+         p[i+1] = (byte)(pm[p[i+1]] - 1);
+         break;
+      case ria_opcode_pushvs:
+         p[i+2] = (byte)(pm[p[i+2]] - 1);
+         break;
+      case ria_opcode_pushs2:
+         j = pm[(p[i+1] << 8) | p[i+2]] - 1;
+         p[i+1] = (byte)(j >> 8);
+         p[i+2] = (byte)(j >> 0);
+         break;
+      }
+   }
+   ret = true;
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+exit:
+   return buf_destroy(&map) && ret;
+
+}
+
+
+/******************************************************************************
+ *  Compiler
+ */
+
+/*
+ * Lexem types
+ *
+ */
+#define FUNCTYPE(_x) ria_lex_##_x = ria_func_##_x
+typedef enum ria_lextype_e {
+   ria_lex_return = 0x01,
+   ria_lex_if     = 0x02,
+   ria_lex_while  = 0x03,
+   FUNCTYPE(add_parsing_rule),
+   FUNCTYPE(append),
+   FUNCTYPE(create_parser_for_file),
+   FUNCTYPE(dehtml),
+   FUNCTYPE(extract_string),
+   FUNCTYPE(extract_string_from_file),
+   FUNCTYPE(get_binary_to_file),
+   FUNCTYPE(get_header),
+   FUNCTYPE(get_html),
+   FUNCTYPE(get_html_many),
+   FUNCTYPE(get_html_with_dump),
+   FUNCTYPE(get_html_to_file),
+   FUNCTYPE(get_html_to_file_with_dump),
+   FUNCTYPE(int_to_string),
+   FUNCTYPE(item),
+   FUNCTYPE(join),
+   FUNCTYPE(last_response),
+   FUNCTYPE(length),
+   FUNCTYPE(list),
+   FUNCTYPE(load_cookie),
+   FUNCTYPE(load_from_file),
+   FUNCTYPE(post),
+   FUNCTYPE(post_to_file),
+   FUNCTYPE(post_to_file_with_dump),
+   FUNCTYPE(post_with_dump),
+   FUNCTYPE(save_cookie),
+   FUNCTYPE(save_to_file),
+   FUNCTYPE(set_header),
+   FUNCTYPE(split),
+   FUNCTYPE(string_to_int),
+   FUNCTYPE(substring)
+} ria_lextype_t;
+
+/*
+ * Lexem description
+ *
+ */
+typedef struct ria_lexem_s {
+   const char*     p;
+   usize           c;
+   ria_lextype_t   t;
+   unumber         params;
+} ria_lexem_t;
+
+/*
+ * Function lexem description
+ *
+ */
+typedef struct ria_func_lexem_s {
+   ria_lexem_t    info;
+   unumber        params;
+   ria_type_t     ret;
+   function_fn*   impl;
+} ria_func_lexem_t;
+
+/*
+ * Lexems
+ *
+ */
+#define LEXEM(_s) { #_s"(", sizeof(#_s), ria_lex_##_s }
+static const ria_lexem_t 
+   _lex[] =
+{
+   LEXEM(return),
+   LEXEM(if),
+   LEXEM(while)
+};
+
+/*
+ * Function lexems
+ *
+ */
+#define FUNC_LEXEM(_s, _par, _ret)                                           \
+   { LEXEM(_s), _par, ria_##_ret, ria_implement_##_s }
+static const ria_func_lexem_t 
+   _func_lex[] =
+{
+   FUNC_LEXEM(add_parsing_rule, 4, unknown),
+   FUNC_LEXEM(append, 2, unknown),
+   FUNC_LEXEM(create_parser_for_file, 2, unknown),
+   FUNC_LEXEM(dehtml, 1, string),
+   FUNC_LEXEM(extract_string, 4, string),
+   FUNC_LEXEM(extract_string_from_file, 4, string),
+   FUNC_LEXEM(get_binary_to_file, 2, int),
+   FUNC_LEXEM(get_header, 1, string),
+   FUNC_LEXEM(get_html, 1, int),
+   FUNC_LEXEM(get_html_many, 3, list),
+   FUNC_LEXEM(get_html_with_dump, 2, int),
+   FUNC_LEXEM(get_html_to_file, 2, int),
+   FUNC_LEXEM(get_html_to_file_with_dump, 3, int),
+   FUNC_LEXEM(int_to_string, 1, string),
+   FUNC_LEXEM(item, 2, string),
+   FUNC_LEXEM(join, 2, string),
+   FUNC_LEXEM(last_response, 0, string),
+   FUNC_LEXEM(length, 1, int),
+   FUNC_LEXEM(list, 0, list),
+   FUNC_LEXEM(load_cookie, 3, string),
+   FUNC_LEXEM(load_from_file, 1, string),
+   FUNC_LEXEM(post, 2, int),
+   FUNC_LEXEM(post_to_file, 3, int),
+   FUNC_LEXEM(post_to_file_with_dump, 4, int),
+   FUNC_LEXEM(post_with_dump, 3, int),
+   FUNC_LEXEM(save_cookie, 3, unknown),
+   FUNC_LEXEM(save_to_file, 2, unknown),
+   FUNC_LEXEM(set_header, 2, unknown),
+   FUNC_LEXEM(split, 2, list),
+   FUNC_LEXEM(string_to_int, 1, int),
+   FUNC_LEXEM(substring, 3, string)
+};
+
+/*****************************************************************************/
+bool 
+   ria_match_op_and_type(
+      ria_type_t*   IN OUT   type,
+      bool          IN       unary,
+      byte          IN       op1,
+      byte          IN       op2)
+/*
+ * Validates operation against data type
+ *
+ */
+{
+
+   assert(type != NULL);
+
+   /* Lists are handled by predefined functions only */
+   if ((*type == ria_unknown) || (*type == ria_list))
+      return false;
+
+   switch (op2) {
+   case 0x00:
+      switch (op1) {
+      case '+':
+         if (*type == ria_boolean) 
+            return false;
+         break;
+      case '<':
+      case '>':
+         if (*type == ria_boolean) 
+            return false;
+         *type = ria_boolean;
+         break;
+      case '_':
+      case '~':
+         if (!unary) 
+            return false;
+      case '-':
+      case '*':
+      case '/':
+      case '%':
+      case '&':
+      case '|':
+      case '^':
+         if (*type != ria_int) 
+            return false;
+         break;
+      case '!':
+         if (*type != ria_boolean) 
+            return false;
+         break;
+      default:
+        return false;
+      }
+      break;
+   case '=':
+      switch (op1) {
+      case '<':
+      case '>':
+         if (*type == ria_boolean) 
+            return false;
+         *type = ria_boolean;
+         break;
+      case '=':
+      case '!':
+         *type = ria_boolean;
+         break;
+      default:
+         return false;
+      }
+      break;
+   case '|':
+      switch (op1) {
+      case '|':
+         if (*type == ria_boolean) 
+            break;
+      default:
+         return false;
+      }
+      break;
+   case '&':
+      switch (op1) {
+      case '&':
+         if (*type == ria_boolean) 
+            break;
+      default:
+         return false;
+      }
+      break;
+   default:
+      return false;
+   }
+
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_get_function_info(                                            
+      ria_type_t*     OUT   type,
+      unumber*        OUT   params,
+      function_fn**   OUT   impl,
+      unumber         IN    func)
+/*
+ * Returns information about predefind function 
+ *
+ */
+{
+
+   usize i;
+
+   assert(params != NULL);
+   assert(impl   != NULL);
+   assert(type   != NULL);
+
+   for (i=0; i<sizeof(_func_lex)/sizeof(_func_lex[0]); i++) 
+      if ((unsigned)_func_lex[i].info.t == func) {
+         if (_func_lex[i].impl == NULL)
+            ERR_SET(err_internal);
+         *params = _func_lex[i].params;
+         *impl   = _func_lex[i].impl;
+         *type   = _func_lex[i].ret;
+         return true;
+      }
+   
+   ERR_SET(err_internal);
+
+}
+
+#ifdef USE_RIA_PROFILER
+/*****************************************************************************/
+bool 
+   ria_get_function_name(                                            
+      const char**   OUT   name,
+      usize*         OUT   len,
+      unumber        IN    func)
+/*
+ * Returns name of predefind function 
+ *
+ */
+{
+
+   usize i;
+
+   assert(name != NULL);
+   assert(len  != NULL);
+
+   for (i=0; i<sizeof(_func_lex)/sizeof(_func_lex[0]); i++) 
+      if ((unsigned)_func_lex[i].info.t == func) {
+         *name = _func_lex[i].info.p;
+         *len  = _func_lex[i].info.c - 1;
+         return true;
+      }
+   
+   ERR_SET(err_internal);
+
+}
+#endif
+
+/*
+ * Variable index to reference conversion, short (1 octet) reference 
+ * is available to first locals and globals only
+ *
+ */
+#define /* bool */ ria_is_narrow_var(_i)                                     \
+   (((_i) < ria_var_narrow) ||                                                \
+    (((_i) >= ria_var_threshold) &&                                           \
+     ((_i) - ria_var_threshold < 0x100 - ria_var_narrow)))
+#define /* byte */ ria_set_narrow_var(_i)                                    \
+   (byte)(((_i) < ria_var_threshold) ?                                        \
+      (_i) : (_i) - ria_var_threshold + ria_var_narrow)
+#define /* usize */ ria_set_wide_var(_i)                                     \
+   (((_i) < ria_var_threshold) ?                                              \
+      (usize)(_i) << 1 : (((usize)(_i) - ria_var_threshold) << 1) | 1)
+
+/*****************************************************************************/
+bool 
+   ria_encode_push_var(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      usize    IN       idx)
+/*
+ * Encodes push-var command 
+ *
+ */
+{
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (*pc < 2)
+      ERR_SET(err_bad_length);
+   if (ria_is_narrow_var(idx)) {
+      (*pp)[0] = ria_opcode_pushv;
+      (*pp)[1] = ria_set_narrow_var(idx);
+      (*pp) += 2;
+      (*pc) -= 2;
+      return true;
+   }
+
+   (*pp)[0] = ria_opcode_pushvw;
+   (*pp)++;
+   (*pc)--;
+   return ria_encode_varint(pp, pc, ria_set_wide_var(idx));
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_push_string(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      usize    IN       idx)
+/*
+ * Encodes push-string command 
+ *
+ */
+{
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (idx > 0xFFFF)
+      ERR_SET(err_internal);
+   if (*pc < (unsigned)((idx > 0xFF) ? 3 : 2))
+      ERR_SET(err_bad_length);
+   if (idx <= 0xFF) {
+      (*pp)[0] = ria_opcode_pushs;
+      (*pp)[1] = (byte)idx;
+      (*pp) += 2;
+      (*pc) -= 2;
+   }
+   else {
+      (*pp)[0] = ria_opcode_pushs2;
+      (*pp)[1] = (byte)(idx >> 8);
+      (*pp)[2] = (byte)(idx >> 0);
+      (*pp) += 3;
+      (*pc) -= 3;
+   }
+
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_push_param(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      usize    IN       idx)
+/*
+ * Encodes push-param command 
+ *
+ */
+{
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (*pc < 2)
+      ERR_SET(err_bad_length);
+   if (idx > 0xFF)
+      ERR_SET(err_internal);
+   (*pp)[0] = ria_opcode_pushp;
+   (*pp)[1] = (byte)idx;
+
+   (*pp) += 2;
+   (*pc) -= 2;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_push_int(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      int      IN       i)
+/*
+ * Encodes push-param command 
+ *
+ */
+{
+
+   byte opcode;
+   unumber c, j;
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+   
+   if ((unumber)i < 0xFF) {
+      c = 1;
+      opcode = ria_opcode_pushi1;
+   }
+   else      
+   if ((unumber)i < 0xFFFF) {
+      c = 2;
+      opcode = ria_opcode_pushi2;
+   }
+   else
+   if ((unumber)i < 0xFFFFFF) {
+      c = 3;
+      opcode = ria_opcode_pushi3;
+   }
+   else {
+      c = 4;
+      opcode = ria_opcode_pushi4;
+   }
+
+   if (*pc < c+1)
+      ERR_SET(err_bad_length);
+   (*pp)[0] = opcode;
+   for (j=c; j>0; j--, i>>=8) 
+      (*pp)[j] = (byte)i;
+   (*pc) -= c + 1;      
+   (*pp) += c + 1;      
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_pop(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      usize    IN       idx)
+/*
+ * Encodes pop command 
+ *
+ */
+{
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (*pc < 2)
+      ERR_SET(err_bad_length);
+   if (ria_is_narrow_var(idx)) {
+      (*pp)[0] = ria_opcode_pop;
+      (*pp)[1] = ria_set_narrow_var(idx);
+      (*pp) += 2;
+      (*pc) -= 2;
+      return true;
+   }
+
+   (*pp)[0] = ria_opcode_popw;
+   (*pp)++;
+   (*pc)--;
+   return ria_encode_varint(pp, pc, ria_set_wide_var(idx));
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_ret(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc)
+/*
+ * Encodes ret command 
+ *
+ */
+{
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (*pc < 1)
+      ERR_SET(err_bad_length);
+   (*pp)[0] = ria_opcode_ret;
+
+   (*pp)++;
+   (*pc)--;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_op(
+      byte**       IN OUT   pp, 
+      usize*       IN OUT   pc,
+      byte         IN       op1,
+      byte         IN       op2)
+/*
+ * Encodes operation command 
+ *
+ */
+{
+
+   byte opcode;
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   if (*pc < 1)
+      ERR_SET(err_bad_length);
+
+   switch (op1) {
+   case '+':
+      opcode = ria_opcode_add;
+      break;
+   case '|':
+      if (op2 == op1)
+         opcode = ria_opcode_lor;
+      else
+         opcode = ria_opcode_bor;
+      break;
+   case '<':
+      if (op2 == '=')
+         opcode = ria_opcode_less_eq;
+      else
+         opcode = ria_opcode_less;
+      break;
+   case '>':
+      if (op2 == '=')
+         opcode = ria_opcode_more_eq;
+      else
+         opcode = ria_opcode_more;
+      break;
+   case '=':
+      if (op2 == '=')
+         opcode = ria_opcode_eq;
+      else
+         ERR_SET(err_internal);
+      break;
+   case '!':
+      if (op2 == '=')
+         opcode = ria_opcode_not_eq;
+      else
+         opcode = ria_opcode_not;
+      break;
+   case '-':
+      opcode = ria_opcode_sub;
+      break;
+   case '*':
+      opcode = ria_opcode_mul;
+      break;
+   case '&':
+      if (op2 == op1)
+         opcode = ria_opcode_land;
+      else
+         opcode = ria_opcode_band;
+      break;
+   case '/':
+      opcode = ria_opcode_div;
+      break;
+   case '%':
+      opcode = ria_opcode_rem;
+      break;
+   case '^':
+      opcode = ria_opcode_xor;
+      break;
+   case '~':
+      opcode = ria_opcode_bneg;
+      break;
+   case '_':
+      opcode = ria_opcode_neg;
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
+
+   **pp = opcode;
+   (*pp)++;
+   (*pc)--;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_call(
+      byte**          IN OUT   pp, 
+      usize*          IN OUT   pc,
+      bool            IN       ignore_ret,
+      ria_lextype_t   IN       lex)
+/*
+ * Encodes function call
+ *
+ */
+{
+
+   byte b0 = 0x00;
+   byte b1 = 0x00;
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   /*
+    * Check for lex
+    *
+    */
+   switch (lex) {
+   case ria_lex_add_parsing_rule:
+   case ria_lex_append:
+   case ria_lex_create_parser_for_file:
+   case ria_lex_dehtml:
+   case ria_lex_extract_string:
+   case ria_lex_extract_string_from_file:
+   case ria_lex_get_binary_to_file:
+   case ria_lex_get_header:
+   case ria_lex_get_html:
+   case ria_lex_get_html_many:
+   case ria_lex_get_html_with_dump:
+   case ria_lex_get_html_to_file:
+   case ria_lex_get_html_to_file_with_dump:
+   case ria_lex_int_to_string:
+   case ria_lex_item:
+   case ria_lex_join:
+   case ria_lex_last_response:
+   case ria_lex_length:
+   case ria_lex_list:
+   case ria_lex_load_cookie:
+   case ria_lex_load_from_file:
+   case ria_lex_post:
+   case ria_lex_post_to_file:
+   case ria_lex_post_to_file_with_dump:
+   case ria_lex_post_with_dump:
+   case ria_lex_save_cookie:
+   case ria_lex_save_to_file:
+   case ria_lex_set_header:
+   case ria_lex_split:
+   case ria_lex_string_to_int:
+   case ria_lex_substring:
+      b0 = lex;
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
+
+   if (*pc < (unsigned)((b1==0x00) ? 2 : 3))
+      ERR_SET(err_bad_length);
+   if (b1 != 0x00)
+      (*pp)[0] = (ignore_ret) ? ria_opcode_call2i : ria_opcode_call2p;
+   else
+      (*pp)[0] = (ignore_ret) ? ria_opcode_calli : ria_opcode_callp;
+   (*pp)[1] = b0;
+   (*pp) += 2;
+   (*pc) -= 2;
+
+   if (b1 != 0x00) {
+      (*pp)[0] = b1;
+      (*pp)++;
+      (*pc)--;
+   }
+   return true;
+
+}
+
+/*****************************************************************************/
+usize 
+   ria_get_jump_size(
+      usize    IN       offset)
+/*
+ * Returns size of jump command for offset, backward jumps are never short
+ *
+ */
+{
+
+   if (offset <= 0x7F)
+      return 2;
+   if (((int)offset >= -0x8000) && ((int)offset <= 0x7FFF))
+      return 3;
+   return 5;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_jump(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      usize    IN       offset)
+/*
+ * Encodes unconditional jump 
+ *
+ */
+{
+
+   unumber c;
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   c = ria_get_jump_size(offset);
+   if (*pc < c)
+      ERR_SET(err_bad_length);
+   switch (c) {
+   case 2:
+      (*pp)[0] = ria_opcode_jmp;
+      (*pp)[1] = (byte)offset;
+      break;
+   case 3:
+      (*pp)[0] = ria_opcode_jmp2;
+      (*pp)[1] = (byte)(offset >> 8);
+      (*pp)[2] = (byte)(offset >> 0);
+      break;
+   default:
+      (*pp)[0] = ria_opcode_jmp4;
+      (*pp)[1] = (byte)(offset >> 24);
+      (*pp)[2] = (byte)(offset >> 16);
+      (*pp)[3] = (byte)(offset >>  8);
+      (*pp)[4] = (byte)(offset >>  0);
+   }
+
+   (*pp) += c;
+   (*pc) -= c;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_encode_jump_if(
+      byte**   IN OUT   pp, 
+      usize*   IN OUT   pc,
+      bool     IN       what,
+      usize    IN       offset)
+/*
+ * Encodes conditional jump 
+ *
+ */
+{
+
+   unumber c;
+
+   assert(pp != NULL);
+   assert(pc != NULL);
+
+   c = ria_get_jump_size(offset);
+   if (*pc < c)
+      ERR_SET(err_bad_length);
+   switch (c) {
+   case 2:
+      (*pp)[0] = (what) ? ria_opcode_jit : ria_opcode_jif;
+      (*pp)[1] = (byte)offset;
+      break;
+   case 3:
+      (*pp)[0] = (what) ? ria_opcode_jit2 : ria_opcode_jif2;
+      (*pp)[1] = (byte)(offset >> 8);
+      (*pp)[2] = (byte)(offset >> 0);
+      break;
+   default:
+      (*pp)[0] = (what) ? ria_opcode_jit4 : ria_opcode_jif4;
+      (*pp)[1] = (byte)(offset >> 24);
+      (*pp)[2] = (byte)(offset >> 16);
+      (*pp)[3] = (byte)(offset >>  8);
+      (*pp)[4] = (byte)(offset >>  0);
+   }
+
+   (*pp) += c;
+   (*pc) -= c;
+   return true;
+
+}
+
+/*
+ * Constant value known at compile time
+ *
+ */
+typedef struct ria_const_s {
+   ria_type_t   type;
+   ria_int_t    n;
+   usize        idx;
+} ria_const_t;
+
+enum {
+   ria_const_depth   = 0x08,
+   ria_const_str_len = 0xFE
+};
+
+/*****************************************************************************/
+bool 
+   ria_eval_const(
+      bool*                 OUT      known,
+      ria_const_t*          OUT      val,
+      const byte*           IN       p,
+      usize                 IN       c,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Evaluates compiled expression if it depends on constants only
+ *
+ */
+{
+
+   ria_const_t st[ria_const_depth];
+   const byte* q;
+   usize i, k, n, c1, c2;
+   byte** pp;
+   usize* pc;
+   int r;
+
+   assert(known != NULL);
+   assert(val   != NULL);
+   assert(p     != NULL);
+   assert(ctx   != NULL);
+
+   *known = false;
+
+   /*
+    * Replay commands over stack of constants,
+    * anything else makes expression non-constant
+    *
+    */
+   for (n=0; c>0; p+=k, c-=k) {
+      if (!ria_get_command_size(&k, p, c))
+         return false;
+      switch (p[0]) {
+
+      /* Constants */
+      case ria_opcode_pushi1:
+      case ria_opcode_pushi2:
+      case ria_opcode_pushi3:
+      case ria_opcode_pushi4:
+      case ria_opcode_pushs:
+      case ria_opcode_pushs2:
+         if (n == ria_const_depth)
+            return true;
+         if (p[0] == ria_opcode_pushs) {
+            st[n].type = ria_string;
+            st[n].idx  = p[1];
+         }
+         else
+         if (p[0] == ria_opcode_pushs2) {
+            st[n].type = ria_string;
+            st[n].idx  = (p[1] << 8) | p[2];
+         }
+         else {
+            st[n].type = ria_int;
+            for (q=p+1, st[n].n=0; q<p+k; q++)
+               st[n].n = (st[n].n << 8) | *q;
+         }
+         n++;
+         break;
+
+      /* Unary arithmetics */
+      case ria_opcode_neg:
+         if ((n < 1) || (st[n-1].type != ria_int))
+            return true;
+         st[n-1].n = -st[n-1].n;
+         break;
+
+      /* Binary arithmetics */
+      case ria_opcode_add: /* or LOR  */
+      case ria_opcode_sub: /* or LAND */
+         if ((n < 2) || (st[n-2].type != st[n-1].type))
+            return true;
+         n--;
+         switch (st[n].type) {
+         case ria_int:
+            if (p[0] == ria_opcode_add)
+               st[n-1].n += st[n].n;
+            else
+               st[n-1].n -= st[n].n;
+            break;
+         case ria_boolean:
+            if (p[0] == ria_opcode_lor)
+               st[n-1].n = st[n-1].n || st[n].n;
+            else
+               st[n-1].n = st[n-1].n && st[n].n;
+            break;
+         case ria_string:
+            if (p[0] != ria_opcode_add)
+               return true;
+            /*
+             * Result must fit into string constant of module
+             *
+             */
+            pc = buf_get_ptr_usizes(&ctx->strc);
+            if ((st[n-1].idx >= buf_get_length(&ctx->strp)) || 
+                (st[n].idx   >= buf_get_length(&ctx->strp)))
+               ERR_SET(err_internal);
+            if (pc[st[n-1].idx] + pc[st[n].idx] > ria_const_str_len)
+               return true;
+            if (!ria_fold_string(&st[n-1].idx, st[n-1].idx, st[n].idx, ctx))
+               return false;
+            break;
+         default:
+            return true;
+         }
+         break;
+
+      /* Comparations */
+      case ria_opcode_less:
+      case ria_opcode_more:
+      case ria_opcode_less_eq:
+      case ria_opcode_more_eq:
+      case ria_opcode_eq:
+      case ria_opcode_not_eq:
+         if ((n < 2) || (st[n-2].type != st[n-1].type))
+            return true;
+         n--;
+         if (st[n].type == ria_string) {
+            /*
+             * Compare only strings without escape sequences 
+             *
+             */
+            pp = buf_get_ptr_ptrs(&ctx->strp);
+            pc = buf_get_ptr_usizes(&ctx->strc);
+            if ((st[n-1].idx >= buf_get_length(&ctx->strp)) || 
+                (st[n].idx   >= buf_get_length(&ctx->strp)))
+               ERR_SET(err_internal);
+            c1 = pc[st[n-1].idx];
+            c2 = pc[st[n].idx];
+            for (i=0; i<c1; i++)
+               if (pp[st[n-1].idx][i] == '\\')
+                  return true;
+            for (i=0; i<c2; i++)
+               if (pp[st[n].idx][i] == '\\')
+                  return true;
+            r = MemCmp(pp[st[n-1].idx], pp[st[n].idx], (c1 < c2) ? c1 : c2);
+            if (r == 0)
+               r = (c1 < c2) ? -1 : (c1 > c2) ? 1 : 0;
+         }
+         else
+            r = (st[n-1].n < st[n].n) ? -1 : (st[n-1].n > st[n].n) ? 1 : 0;
+         switch (p[0]) {
+         case ria_opcode_less:
+            st[n-1].n = (r <  0);
+            break;
+         case ria_opcode_more:
+            st[n-1].n = (r >  0);
+            break;
+         case ria_opcode_less_eq:
+            st[n-1].n = (r <= 0);
+            break;
+         case ria_opcode_more_eq:
+            st[n-1].n = (r >= 0);
+            break;
+         case ria_opcode_eq:
+            st[n-1].n = (r == 0);
+            break;
+         case ria_opcode_not_eq:
+            st[n-1].n = (r != 0);
+            break;
+         }
+         st[n-1].type = ria_boolean;
+         break;
+
+      default:
+         return true;
+      }
+   }
+
+   if (n != 1)
+      return true;
+
+   *val   = st[0];
+   *known = true;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_fold_expression(
+      byte*                 IN       pstart,
+      byte**                IN OUT   pp,
+      usize*                IN OUT   pc,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Replaces constant expression by single push command
+ *
+ */
+{
+
+   byte  b[5];
+   byte* p;
+   usize c;
+   bool  known;
+   ria_const_t val;
+
+   assert(pstart != NULL);
+   assert(pp     != NULL);
+   assert(pc     != NULL);
+   assert(ctx    != NULL);
+
+   if (!ria_eval_const(&known, &val, pstart, *pp-pstart, ctx))
+      return false;
+   if (!known)
+      return true;
+
+   /*
+    * Boolean constants have no push command
+    *
+    */
+   p = b;
+   c = sizeof(b);
+   switch (val.type) {
+   case ria_int:
+      /* Literals are unsigned and 4 octets at most */
+      if ((val.n < 0) || (val.n > 0xFFFFFFFF))
+         return true;
+      if (!ria_encode_push_int(&p, &c, (int)val.n))
+         return false;
+      break;
+   case ria_string:
+      if (!ria_encode_push_string(&p, &c, val.idx))
+         return false;
+      break;
+   default:
+      return true;
+   }
+
+   /*
+    * Never let folded code grow
+    *
+    */
+   c = p - b;
+   if (c > (usize)(*pp-pstart))
+      return true;
+   MemCpy(pstart, b, c);
+   *pc += (*pp - pstart) - c;
+   *pp  = pstart + c;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("FOLDED constant expression\n");
+   RIA_TRACE_STOP;
+#endif         
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_fuse_assignment(
+      bool*                 OUT      fused,
+      byte*                 IN       pstart,
+      byte**                IN OUT   pp,
+      usize*                IN OUT   pc,
+      usize                 IN       var,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Replaces expression and following pop-to-var by single command
+ *
+ */
+{
+
+   usize i, k, n, d, last, first, uses;
+   unumber j;
+   function_fn* impl;
+   ria_type_t type;
+   bool  ok;
+   byte* p;
+   byte  v;
+
+   assert(fused  != NULL);
+   assert(pstart != NULL);
+   assert(pp     != NULL);
+   assert(pc     != NULL);
+   assert(ctx    != NULL);
+
+   *fused = false;
+   if (!ria_is_narrow_var(var))
+      return true;
+   v = ria_set_narrow_var(var);
+
+   /*
+    * Count commands, locate last one, check variable use
+    *
+    */
+   for (i=n=last=uses=0; i<(usize)(*pp-pstart); i+=k, n++) {
+      if (!ria_get_command_size(&k, pstart+i, *pp-pstart-i))
+         return false;
+      if ((pstart[i] == ria_opcode_pushv) && (pstart[i+1] == v))
+         uses++;
+      last = i;
+   }
+   if (n == 0)
+      return true;
+   p = pstart + last;
+
+   /*
+    * $var = $var +/- <byte constant>
+    *
+    */
+   if ((n == 3) && (ctx->expr_type == ria_int) && 
+       (pstart[0] == ria_opcode_pushv) && (pstart[1] == v) &&
+       (pstart[2] == ria_opcode_pushi1) &&
+       ((pstart[4] == ria_opcode_add) || (pstart[4] == ria_opcode_sub))) {
+      pstart[0] = (pstart[4] == ria_opcode_add) ? 
+         ria_opcode_incv : ria_opcode_decv;
+      pstart[1] = v;
+      pstart[2] = pstart[3];
+      *pc += (*pp - pstart) - 3;
+      *pp  = pstart + 3;
+      *fused = true;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("FUSED increment of variable\n");
+      RIA_TRACE_STOP;
+#endif         
+      return true;
+   }
+
+   /*
+    * $var = $var + <string> ..., the variable is appended in place; stack 
+    * depth is tracked to find concatenations taking the variable value 
+    * as left operand: the first one is dropped together with push of the 
+    * variable, so that the rest concatenate appended strings only
+    *
+    */
+   if ((n >= 3) && (ctx->expr_type == ria_string) && (uses == 1) &&
+       (pstart[0] == ria_opcode_pushv) && (pstart[1] == v) &&
+       (p[0] == ria_opcode_add)) {
+      for (i=2, d=1, first=0, ok=true; ok && (i<=last); i+=k) {
+         if (!ria_get_command_size(&k, pstart+i, *pp-pstart-i))
+            return false;
+         switch (pstart[i]) {
+         case ria_opcode_pushv:
+         case ria_opcode_pushvw:
+         case ria_opcode_pushs:
+         case ria_opcode_pushs2:
+         case ria_opcode_pushi1:
+         case ria_opcode_pushi2:
+         case ria_opcode_pushi3:
+         case ria_opcode_pushi4:
+         case ria_opcode_pushp:
+            d++;
+            break;
+         case ria_opcode_not:
+         case ria_opcode_neg:
+            ok = (d > 1);
+            break;
+         case ria_opcode_callp:
+         case ria_opcode_call2p:
+            if (!ria_get_function_info(
+                    &type, 
+                    &j, 
+                    &impl, 
+                    (pstart[i] == ria_opcode_callp) ? 
+                       pstart[i+1] : (pstart[i+1] << 8) | pstart[i+2]))
+               return false;
+            ok = (d > j);
+            d  = d - j + 1;
+            break;
+         default:
+            if ((pstart[i] < ria_opcode_add) || (pstart[i] > ria_opcode_xor)) {
+               ok = false;
+               break;
+            }
+            if (d == 2) {
+               ok = (pstart[i] == ria_opcode_add);
+               if (first == 0)
+                  first = i;
+            }
+            d--;
+         }
+      }
+      if (ok && (d == 1) && (first != 0)) {
+         k = *pp - pstart;
+         MemMove(pstart+first, pstart+first+1, k-first-1);
+         MemMove(pstart, pstart+2, k-3);
+         k -= 3;
+         pstart[k++] = ria_opcode_appv;
+         pstart[k++] = v;
+         *pc += (*pp - pstart) - k;
+         *pp  = pstart + k;
+         *fused = true;
+#ifdef COMPILER_TRACE      
+         RIA_TRACE_START;
+         RIA_TRACE_MSG("FUSED append to variable\n");
+         RIA_TRACE_STOP;
+#endif         
+         return true;
+      }
+   }
+
+   /*
+    * $var = func(...), function must not get the same variable by reference
+    *
+    */
+   if ((uses > 0) || (*pc < 1))
+      return true;
+   switch (p[0]) {
+   case ria_opcode_callp:
+      p[0] = ria_opcode_callv;
+      break;
+   case ria_opcode_call2p:
+      p[0] = ria_opcode_call2v;
+      break;
+   default:
+      return true;
+   }
+   *(*pp)++ = v;
+   (*pc)--;
+   *fused = true;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("FUSED call with store to variable\n");
+   RIA_TRACE_STOP;
+#endif         
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_operand(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles operand
+ *
+ */
+{
+
+   usize i, j, c;
+   byte* p;
+   mem_blk_t expr;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   /*
+    * Operand is:
+    * - '(' <expression> ')'
+    * - '$' <var>
+    * - '@' <parameter>
+    * - '"' <string> '"'
+    * - <decimal digit>{1,}
+    *
+    */
+   
+   /*
+    * Check operand type
+    *
+    */
+   if (script->c < 1) {
+      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+      return true;
+   }
+   switch (script->p[0]) {
+
+   /* Nested expression */
+   case '(':
+      expr.p = script->p + 1;
+      expr.c = script->c - 1;
+      if (!ria_find_char(&p, &expr, ')', 1))
+         return false;
+      if (p == NULL) {
+         SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
+         return true;
+      }
+      expr.c = p - expr.p;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("Compiling operand, nested expression ");
+      RIA_TRACE_STR(script->p, expr.c+2);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+#endif      
+      if (!ria_compile_expression(exec, &expr, ctx))
+         return false;
+      if (!ctx->ok)
+         return true;
+      script->c -= expr.p - script->p + 1;
+      script->p  = expr.p + 1;
+      break;
+
+   /* Variable */
+   case '$':
+      if (!ria_find_var(&i, &j, script, ctx))
+         return false;
+      if (j == ria_var_unknown) {
+         SET_COMPILE_ERROR(ctx, script->p, "unknown variable");
+         return true;
+      }
+      p = exec->p;
+      c = exec->c;
+      if (!ria_encode_push_var(&p, &c, j))
+         return false;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("COMPILED pushv ");
+      RIA_TRACE_INT(j);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+#endif      
+      exec->c = p - exec->p;
+      script->c -= i;
+      script->p += i;
+      break;
+
+   /* Parameter */
+   case '@':
+      if (!ria_find_param(&i, &j, script, ctx))
+         return false;
+      p = exec->p;
+      c = exec->c;
+      if (!ria_encode_push_param(&p, &c, j))
+         return false;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("COMPILED pushp ");
+      RIA_TRACE_INT(j);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+#endif      
+      exec->c = p - exec->p;
+      script->c -= i;
+      script->p += i;
+      break;
+
+   /* String constant */
+   case '"':
+      if (!ria_find_string(&i, &j, script, ctx))
+         return false;
+      p = exec->p;
+      c = exec->c;
+      if (!ria_encode_push_string(&p, &c, j))
+         return false;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("COMPILED pushs ");
+      RIA_TRACE_INT(j);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+#endif      
+      exec->c = p - exec->p;
+      script->c -= i + 2;
+      script->p += i + 2;
+      break;
+
+   default:
+      if ((script->p[0] >= '0') && (script->p[0] <= '9')) {
+         /*
+          * Numeric constant case
+          *
+          */
+         bool nonzero = false; 
+         for (j=0; script->c>0; script->p++, script->c--, nonzero=true) {
+            if ((script->p[0] < '0') || (script->p[0] > '9')) 
+               break;
+            if (nonzero && (j == 0)) {
+               SET_COMPILE_ERROR(ctx, script->p, "bad numeric constant");
+               return true;
+            }   
+            j = j*10 + script->p[0] - '0';
+         }               
+         p = exec->p;
+         c = exec->c;
+         if (!ria_encode_push_int(&p, &c, (int)j))
+            return false;
+#ifdef COMPILER_TRACE      
+         RIA_TRACE_START;
+         RIA_TRACE_MSG("COMPILED pushi ");
+         RIA_TRACE_INT(j);
+         RIA_TRACE_MSG("\n");
+         RIA_TRACE_STOP;
+#endif         
+         exec->c = p - exec->p;
+         ctx->expr_type = ria_int;
+      }
+      else {
+         /*
+          * Predefined function call 
+          *
+          */
+         if (!ria_compile_func(exec, script, false, ctx))
+            return false;
+      }
+
+   }
+
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_expression(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles expression
+ *
+ */
+{
+
+   char op[2];
+   bool unary;
+   ria_type_t type;
+   mem_blk_t oper;
+   byte* p;
+   byte* pe;
+   usize ce;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling expression ");
+   RIA_TRACE_STR(script->p, script->c);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif   
+
+   /*
+    * Evaluate complex expression:
+    * (<op>){0,1} <operand> (<op> <operand>){0,} 
+    * where operand can be nested expression
+    *
+    */
+
+   /* 
+    * Check for unary operation:
+    * (<op>){0,1}
+    * and cache it
+    *
+    */
+   if (script->c < 1) {
+      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+      return true;
+   }
+   type = ria_unknown;
+   switch (script->p[0]) {
+   case '~':
+   case '!':
+   case '-':
+      /* Handle unary '-' as '_' */
+      op[0] = (script->p[0] == '-') ? '_' : script->p[0];
+      op[1] = 0x00;
+      script->p++;
+      script->c--;
+      unary = true;
+      break;
+   default:
+      op[0] = 0x00;
+      unary = false;
+   }
+
+   /* 
+    * Evaluate sequence of 
+    * <operand> (<op> <operand>){0,} 
+    *
+    */
+   pe = exec->p;
+   ce = exec->c;
+   while (script->c > 0) {
+
+      /*
+       * Compile operand
+       *
+       */
+      oper.p = pe;
+      oper.c = ce;
+      p = script->p;
+      if (!ria_compile_operand(&oper, script, ctx))
+         return false;
+      if (!ctx->ok)
+         return true;
+      if (oper.p != pe) 
+         ERR_SET(err_internal);
+      ce -= oper.c;
+      pe += oper.c;
+      if (type != ria_unknown) {
+         if (type != ctx->expr_type) {
+            SET_COMPILE_ERROR(ctx, p, "bad operands type");
+            return true;
+         }
+      }
+      else {
+         if (ctx->expr_type == ria_unknown) {
+            SET_COMPILE_ERROR(ctx, p, "use of uninitialized variable");
+            return true;
+         }
+         type = ctx->expr_type;
+      }
+
+      /*
+       * Apply cached operation
+       *
+       */
+      if (op[0] != 0x00) {
+         if (!ria_match_op_and_type(&type, unary, op[0], op[1])) {
+            SET_COMPILE_ERROR(ctx, p, "bad operands type");
+            return true;
+         }
+         ctx->expr_type = type;
+         if (!ria_encode_op(&pe, &ce, op[0], op[1])) 
+            return true;
+#ifdef COMPILER_TRACE      
+         RIA_TRACE_START;
+         RIA_TRACE_MSG("COMPILED op ");
+         RIA_TRACE_STR(op, (op[1]==0x00)?1:2);
+         RIA_TRACE_MSG("\n");
+         RIA_TRACE_STOP;
+#endif         
+         if (!ria_fold_expression(exec->p, &pe, &ce, ctx))
+            return false;
+         op[0] = 0x00;
+         unary = false;
+      }
+
+      /*
+       * Extract next operation
+       *
+       */
+      if (script->c > 0) {
+         if (script->c < 2) {
+            SET_COMPILE_ERROR(ctx, p, "syntax error");
+            return true;
+         }
+         op[0] = script->p[0];
+         switch (script->p[0]) {
+         case '+':
+         case '-':
+         case '*':
+         case '/':
+         case '%':
+         case '^':
+         case '~':
+            op[1] = 0x00;
+            break;
+         case '<':
+         case '>':
+         case '!':
+            if (script->p[1] == '=')
+               op[1] = '=';
+            else 
+               op[1] = 0x00;
+            break;
+         case '=':
+            if (script->p[1] != '=') {
+               SET_COMPILE_ERROR(ctx, p, "syntax error");
+               return true;
+            }
+            op[1] = '=';
+            break;
+         case '&':
+         case '|':
+            if (script->p[1] == op[0])
+               op[1] = op[0];
+            else 
+               op[1] = 0x00;
+            break;
+         default:
+            SET_COMPILE_ERROR(ctx, p, "syntax error");
+            return true;
+         }
+         script->p++;
+         script->c--;
+         if (op[1] != 0x00) {
+            script->p++;
+            script->c--;
+         }
+      }
+
+   }
+
+   /*
+    * Finalize output buffer
+    *
+    */
+   exec->c = pe - exec->p;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Expression compilation finished\n");
+   RIA_TRACE_STOP;
+#endif   
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_assignment(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles assignment statement
+ *
+ */
+{
+
+   usize c, i, j;
+   byte* p;
+   bool  fused;
+   mem_blk_t expr;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   /*
+    * Assignment is:
+    * $var=expression
+    *
+    */
+
+   assert(script->c > 0);
+   assert(script->p[0] == '$');
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling assignment ");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Extract variable info
+    *
+    */
+   if (!ria_find_var(&i, &j, script, ctx))
+      return false;
+   if ((i >= script->c) || (script->p[i] != '=')) {
+      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+      return true;
+   }
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("to variable ");
+   RIA_TRACE_STR(script->p, i);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Create new if not found 
+    *
+    */
+   if (j == ria_var_unknown) {
+      if (!ria_create_var(&j, script->p, i, ria_unknown, false, ctx))
+         return false;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("No such variable was found, adding new one\n");
+      RIA_TRACE_STOP;
+#endif      
+   }
+
+   /*
+    * Extract expression script
+    *
+    */
+   script->p += i + 1;
+   script->c -= i + 1;
+   expr = *script;
+   if (!ria_find_char(&p, &expr, ';', 0))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, script->p, "; is absent");
+      return true;
+   }
+   expr.c = p - expr.p;
+
+   /*
+    * Compile expression
+    *
+    */
+   p = exec->p;
+   c = exec->c;
+   if (!ria_compile_expression(exec, &expr, ctx))
+      return false;
+   if (!ctx->ok)
+      return true;
+   if (ctx->expr_type == ria_unknown)
+      ERR_SET(err_internal);
+   script->c -= expr.p - script->p + 1;
+   script->p  = expr.p + 1;
+
+   /*
+    * Setup variable type
+    *
+    */
+   if (j >= ria_var_threshold) {
+      usize* pu = buf_get_ptr_usizes(&ctx->globalc) + j - ria_var_threshold;
+      *pu = (*pu & ria_mask_var_name_len) | 
+         ((usize)ctx->expr_type << ria_shift_var_type);
+   }         
+   else {  
+      usize* pu = buf_get_ptr_usizes(&ctx->varc) + j;
+      *pu = (*pu & ria_mask_var_name_len) |
+         ((usize)ctx->expr_type << ria_shift_var_type);
+   }         
+
+   /*
+    * Add pop-to-var command
+    *
+    */
+   if (p != exec->p)
+      ERR_SET(err_internal);
+   c -= exec->c;
+   p += exec->c;
+   if (!ria_fuse_assignment(&fused, exec->p, &p, &c, j, ctx))
+      return false;
+   if (!fused) {
+      if (!ria_encode_pop(&p, &c, j))
+         return false;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("COMPILED: pop ");
+      RIA_TRACE_INT(j);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+#endif
+   }
+   exec->c = p - exec->p;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Assignment compilation finished\n");
+   RIA_TRACE_STOP;
+#endif
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_return(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles return statement
+ *
+ */
+{
+
+   usize c;
+   byte* p;
+   mem_blk_t expr;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   /*
+    * Return statement is
+    * return(<expression>);
+    * Script to parse is:
+    * (expression);
+    *
+    */
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling return statement\n");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Extract expression script
+    *
+    */
+   expr = *script;
+   if (!ria_find_char(&p, &expr, ';', 0))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, script->p, "; is absent");
+      return true;
+   }
+   expr.c = p - expr.p;
+
+   /*
+    * Compile expression
+    *
+    */
+   p = exec->p;
+   c = exec->c;
+   if (!ria_compile_expression(exec, &expr, ctx))
+      return false;
+   if (!ctx->ok)
+      return true;
+   if (ctx->expr_type == ria_unknown)
+      ERR_SET(err_internal);
+   if (ctx->expr_type == ria_list) {
+      SET_COMPILE_ERROR(ctx, script->p, "list cannot be returned");
+      return true;
+   }
+   script->c -= expr.p - script->p + 1;
+   script->p  = expr.p + 1;
+
+   /*
+    * Add ret command
+    *
+    */
+   if (p != exec->p)
+      ERR_SET(err_internal);
+   c -= exec->c;
+   p += exec->c;
+   if (!ria_encode_ret(&p, &c))
+      return false;
+   exec->c = p - exec->p;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("COMPILED: ret\n");
+   RIA_TRACE_MSG("Return statement compilation finished\n");
+   RIA_TRACE_STOP;
+#endif
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_if(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles if statement
+ *
+ */
+{
+
+   static const char _else[] = "else{";
+
+   usize c, j, k, l;
+   byte* p;
+   mem_blk_t expr;
+   mem_blk_t xtmp;
+   byte* pjmp1 = NULL;
+   byte* pjmp2 = NULL;
+   byte* pbranch;
+   bool known;
+   ria_const_t cond;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   /*
+    * If statement is
+    * if (<expression>) { <chunk1>...<chunkn> } else { <chunk1>...<chunkm> }
+    * or 
+    * if (<expression>) { <chunk1>...<chunkn> }
+    * Script to parse is:
+    * (<expression>) { <chunk1>...<chunkn> } else { <chunk1>...<chunkm> }
+    *
+    */
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling if statement\n");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Find end of condition 
+    *
+    */
+   expr = *script;
+   if (!ria_find_char(&p, &expr, ')', 0))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
+      return true;
+   }
+   expr.c = p - expr.p + 1;
+ 
+   /*
+    * Compile expression for condition
+    *
+    */
+   xtmp = *exec;
+   p = xtmp.p;
+   c = xtmp.c;
+   if (!ria_compile_expression(&xtmp, &expr, ctx))
+      return false;
+   if (!ctx->ok)
+      return true;
+   if (ctx->expr_type != ria_boolean)
+      ERR_SET(err_internal);
+   script->c -= expr.p - script->p;
+   script->p  = expr.p;
+
+   /*
+    * Constant condition selects single branch, 
+    * its code is dropped as well as jumps
+    *
+    */
+   if (!ria_eval_const(&known, &cond, xtmp.p, xtmp.c, ctx))
+      return false;
+   if (known)
+      xtmp.c = 0;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   if (known)
+      RIA_TRACE_MSG("Condition is constant, dropping dead branch\n");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Save pos for putting 1st jump 
+    *
+    */
+   if (p != xtmp.p)
+      ERR_SET(err_internal);
+   xtmp.p += xtmp.c;
+   xtmp.c  = c - xtmp.c;
+   pjmp1   = xtmp.p;
+
+   /*
+    * Check for main branch
+    *
+    */
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling main branch\n");
+   RIA_TRACE_STOP;
+#endif
+   if ((script->c < 1) || (script->p[0] != '{')) {
+      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+      return true;
+   }
+   script->p++;
+   script->c--;
+
+   /*
+    * Duplicated actions
+    *
+    */
+   for (k=0; k<2; k++) {
+
+      /*
+       * Extract branch
+       *
+       */
+      expr = *script;
+      if (!ria_find_char(&p, &expr, '}', 1))
+         return false;
+      if (p == NULL) {
+         SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+         return true;
+      }
+      expr.c = p - expr.p;
+
+      /*  
+       * Compile branch
+       *
+       */
+      pbranch = xtmp.p;
+      for (; expr.c>0; ) {
+         p = xtmp.p;
+         c = xtmp.c;
+         if (!ria_compile_chunk(&xtmp, &expr, ctx))
+            return false;
+         if (!ctx->ok)
+            return true;
+         if (p != xtmp.p)
+            ERR_SET(err_internal);
+         xtmp.p += xtmp.c;
+         xtmp.c  = c - xtmp.c;
+      }
+      script->c -= expr.p - script->p + 1;
+      script->p  = expr.p + 1;
+
+      /*
+       * Dead branch is still compiled to validate syntax
+       *
+       */
+      if (known && ((cond.n != 0) == (k == 1))) {
+         xtmp.c += xtmp.p - pbranch;
+         xtmp.p  = pbranch;
+      }
+   
+      if (k == 1)
+         break;
+
+      /*
+       * Check alternate branch
+       *
+       */
+      if (script->c < sizeof(_else)-1)
+         break;
+      if (MemCmp(script->p, _else, sizeof(_else)-1))
+         break;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("Compiling alternate branch\n");
+      RIA_TRACE_STOP;
+#endif
+      script->c -= sizeof(_else) - 1;
+      script->p += sizeof(_else) - 1;
+
+      /*
+       * Save pos for putting 2nd jump 
+       *
+       */
+      pjmp2 = xtmp.p;
+
+   }
+
+   /*
+    * No jumps for constant condition
+    *
+    */
+   if (known) {
+      exec->c = xtmp.p - exec->p;
+      return true;
+   }
+
+   /*
+    * Add 2nd jump first
+    *
+    */
+   if (pjmp2 != NULL) {
+      l = xtmp.p - pjmp2;
+      c = j = ria_get_jump_size(l);
+      if (xtmp.c < c) 
+         ERR_SET(err_bad_length);
+      MemMove(pjmp2+c, pjmp2, xtmp.p-pjmp2);
+      if (!ria_encode_jump(&pjmp2, &c, l))
+         return false;
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("COMPILED: jmp ");
+      RIA_TRACE_INT(l);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+#endif
+      xtmp.c -= j;
+      xtmp.p += j;
+   }
+
+   /*
+    * Add 1st jump then
+    *
+    */
+   l = (pjmp2 == NULL) ? xtmp.p-pjmp1 : pjmp2-pjmp1;
+   c = j = ria_get_jump_size(l);
+   if (xtmp.c < c) 
+      ERR_SET(err_bad_length);
+   MemMove(pjmp1+c, pjmp1, xtmp.p-pjmp1);
+   if (!ria_encode_jump_if(&pjmp1, &c, false, l))
+      return false;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("COMPILED: jif ");
+   RIA_TRACE_INT(l);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif
+   xtmp.c -= j;
+   xtmp.p += j;
+
+   /*
+    * Finalize
+    *
+    */
+   exec->c = xtmp.p - exec->p;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_while(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles while statement
+ *
+ */
+{
+
+   usize c, j, k, l;
+   byte* p;
+   mem_blk_t expr;
+   mem_blk_t xtmp;
+   byte* pexpr;
+   byte* pjump;
+   bool known;
+   ria_const_t cond;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   /*
+    * While statement is
+    * while (<expression>) { <chunk1>...<chunkn> }
+    * Script to parse is:
+    * (<expression>) { <chunk1>...<chunkn> } 
+    *
+    */
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling while statement\n");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Find end of condition 
+    *
+    */
+   expr = *script;
+   if (!ria_find_char(&p, &expr, ')', 0))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
+      return true;
+   }
+   expr.c = p - expr.p + 1;
+ 
+   /*
+    * Save pos to expression
+    *
+    */
+   pexpr = exec->p; 
    
-   if ((unumber)i < 0xFF) {
-      c = 1;
-      opcode = ria_opcode_pushi1;
+   /*
+    * Compile expression for condition
+    *
+    */
+   xtmp = *exec;
+   p = xtmp.p;
+   c = xtmp.c;
+   if (!ria_compile_expression(&xtmp, &expr, ctx))
+      return false;
+   if (!ctx->ok)
+      return true;
+   if (ctx->expr_type != ria_boolean)
+      ERR_SET(err_internal);
+   script->c -= expr.p - script->p;
+   script->p  = expr.p;
+   if (!ria_eval_const(&known, &cond, xtmp.p, xtmp.c, ctx))
+      return false;
+
+   /*
+    * Save pos for putting first jump 
+    *
+    */
+   if (p != xtmp.p)
+      ERR_SET(err_internal);
+   xtmp.p += xtmp.c;
+   xtmp.c  = c - xtmp.c;
+   pjump   = xtmp.p;
+
+   /*
+    * Check for loop body
+    *
+    */
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling loop body\n");
+   RIA_TRACE_STOP;
+#endif
+   if ((script->c < 1) || (script->p[0] != '{')) {
+      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+      return true;
+   }
+   script->p++;
+   script->c--;
+
+   /*
+    * Extract body
+    *
+    */
+   expr = *script;
+   if (!ria_find_char(&p, &expr, '}', 1))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
+      return true;
+   }
+   expr.c = p - expr.p;
+
+   /*  
+    * Compile body
+    *
+    */
+   for (; expr.c>0; ) {
+      p = xtmp.p;
+      c = xtmp.c;
+      if (!ria_compile_chunk(&xtmp, &expr, ctx))
+         return false;
+      if (!ctx->ok)
+         return true;
+      if (p != xtmp.p)
+         ERR_SET(err_internal);
+      xtmp.p += xtmp.c;
+      xtmp.c  = c - xtmp.c;
+   }
+   script->c -= expr.p - script->p + 1;
+   script->p  = expr.p + 1;
+
+   /*
+    * Loop that never runs is dropped entirely
+    *
+    */
+   if (known && (cond.n == 0)) {
+#ifdef COMPILER_TRACE      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("Condition is always false, dropping loop\n");
+      RIA_TRACE_STOP;
+#endif
+      exec->c = 0;
+      return true;
+   }
+   
+   /*
+    * Add 1st jump, its size and size of 2nd one depend on each other
+    *
+    */
+   k = 3;
+   l = xtmp.p - pjump + k;
+   j = ria_get_jump_size(l);
+   if (ria_get_jump_size(pexpr - xtmp.p - j) != k) {
+      k = 5;
+      l = xtmp.p - pjump + k;
+      j = ria_get_jump_size(l);
+   }
+   c = j;
+   if (xtmp.c < c) 
+      ERR_SET(err_bad_length);
+   MemMove(pjump+c, pjump, xtmp.p-pjump);
+   if (!ria_encode_jump_if(&pjump, &c, false, l))
+      return false;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("COMPILED: jif ");
+   RIA_TRACE_INT(l);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif
+   xtmp.c -= j;
+   xtmp.p += j;
+
+   /*
+    * Add 2nd jump
+    *
+    */
+   l = pexpr - xtmp.p;
+   c = k;
+   if (xtmp.c < c) 
+      ERR_SET(err_bad_length);
+   p = xtmp.p;
+   if (!ria_encode_jump(&p, &c, l))
+      return false;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("COMPILED: jmp ");
+   RIA_TRACE_INT(l);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif
+   xtmp.c -= k;
+   xtmp.p += k;
+
+   /*
+    * Finalize
+    *
+    */
+   exec->c = xtmp.p - exec->p;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_func(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      bool                  IN       ignore_ret,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles predefined function call
+ *
+ */
+{
+
+   usize c, i, j;
+   byte* p;
+   mem_blk_t eseq;
+   mem_blk_t expr;
+   mem_blk_t xtmp;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   /*
+    * Check for predefined function
+    *
+    */
+   for (j=0; j<sizeof(_func_lex)/sizeof(_func_lex[0]); j++) {
+      if (script->c < _func_lex[j].info.c) 
+         continue;
+      if (MemCmp(_func_lex[j].info.p, script->p, _func_lex[j].info.c)) 
+         continue;
+      /* '(' shall remain */
+      script->p += _func_lex[j].info.c - 1;
+      script->c -= _func_lex[j].info.c - 1;
+      break;
+   }
+   if (j == sizeof(_func_lex)/sizeof(_func_lex[0])) {
+      SET_COMPILE_ERROR(ctx, script->p, "unknown function");
+      return true;
+   }
+
+   /*
+    * Function call is:
+    * name(<expression1>, ... <expressionn>) ';'{0,}
+    * Script to parse is:
+    * (<expression1>, ... <expressionn>) ';'{0,}
+    *
+    */
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Compiling function ");
+   RIA_TRACE_STR(_func_lex[j].info.p, _func_lex[j].info.c-1);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif
+
+   /*
+    * Find end of function call
+    *
+    */
+   eseq = *script;
+   if (!ria_find_char(&p, &eseq, ')', 0))
+      return false;
+   if (p == NULL) {
+      SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
+      return true;
    }
-   else      
-   if ((unumber)i < 0xFFFF) {
-      c = 2;
-      opcode = ria_opcode_pushi2;
+   eseq.c = p - eseq.p;
+
+   /*
+    * Iterate thru expressions
+    *
+    */
+   if (eseq.p[0] != '(')
+      ERR_SET(err_internal);
+   eseq.p++;
+   eseq.c--;
+   xtmp = *exec;
+   for (i=0; eseq.c>0; ) {
+
+      /* 
+       * Extract expression
+       *
+       */
+      if (!ria_find_char(&p, &eseq, ',', 0))
+         return false;
+      if (p == NULL) 
+         expr = eseq;
+      else {
+         expr.p = eseq.p;
+         expr.c = p - eseq.p;
+      }
+
+      /* 
+       * Compile expression
+       *
+       */
+      p = xtmp.p;
+      c = xtmp.c;
+      if (!ria_compile_expression(&xtmp, &expr, ctx))
+         return false;
+      if (!ctx->ok)
+         return true;
+      if (ctx->expr_type == ria_unknown)
+         ERR_SET(err_internal);
+      eseq.c -= expr.p - eseq.p;
+      eseq.p  = expr.p;
+      if (eseq.c != 0) {
+         if (eseq.p[0] != ',')
+            ERR_SET(err_internal);
+         eseq.c--;
+         eseq.p++;
+      }          
+
+      /* 
+       * Advance compilation pointer
+       *
+       */
+      if (p != xtmp.p)
+         ERR_SET(err_internal);
+      xtmp.p += xtmp.c;
+      xtmp.c  = c - xtmp.c;
+      i++;
+
    }
-   else
-   if ((unumber)i < 0xFFFFFF) {
-      c = 3;
-      opcode = ria_opcode_pushi3;
+
+   /*
+    * Check parameters 
+    *
+    */
+   if (i != _func_lex[j].params) {
+      SET_COMPILE_ERROR(ctx, script->p, "wrong number of parameters");
+      return true;
+   }
+
+   /*
+    * Advance parsing pointer
+    *
+    */
+   script->c -= eseq.p - script->p + 1;
+   script->p  = eseq.p + 1;
+
+   /*
+    * Add call command
+    *
+    */
+   c = xtmp.c;
+   p = xtmp.p;
+   if (!ria_encode_call(&p, &c, ignore_ret, _func_lex[j].info.t))
+      return false;
+   exec->c = p - exec->p;
+   ctx->expr_type = _func_lex[j].ret;
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("COMPILED: call ");
+   if (xtmp.p[0] & 0x01) {
+      RIA_TRACE_INT((p[-2] << 8)|p[-1]);
    }
    else {
-      c = 4;
-      opcode = ria_opcode_pushi4;
+      RIA_TRACE_INT(p[-1]);
    }
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_MSG("Function call compilation finished\n");
+   RIA_TRACE_STOP;
+#endif
 
-   if (*pc < c+1)
+   /*
+    * ';' could be at the end
+    *
+    */
+   if (script->c > 0) 
+      if (script->p[0] == ';') {
+         script->c--;
+         script->p++;
+      }
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_statement(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles statement of scenario script into executable representation 
+ *
+ */
+{
+
+   usize i;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+   
+   /*
+    * Initial state. Expected chunks are:
+    *  - assignment chunk
+    *  - statement chunk
+    *  - predefined function call chunk
+    *
+    */
+
+   /*
+    * Check for assignment chunk '$'
+    *
+    */
+   if (script->c < 1)
       ERR_SET(err_bad_length);
-   (*pp)[0] = opcode;
-   for (j=c; j>0; j--, i>>=8) 
-      (*pp)[j] = (byte)i;
-   (*pc) -= c + 1;      
-   (*pp) += c + 1;      
+   switch (script->p[0]) {
+   case '$':
+      return ria_compile_assignment(exec, script, ctx);
+   }
+   
+   /*
+    * Check for statements 
+    *
+    */
+   for (i=0; i<sizeof(_lex)/sizeof(_lex[0]); i++) {
+   
+      if (script->c < _lex[i].c) 
+         continue;
+      if (MemCmp(_lex[i].p, script->p, _lex[i].c)) 
+         continue;
+
+      /* '(' shall remain */
+      script->p += _lex[i].c - 1;
+      script->c -= _lex[i].c - 1;
+      switch (_lex[i].t) {
+      case ria_lex_return:
+         return ria_compile_return(exec, script, ctx);
+      case ria_lex_if:
+         return ria_compile_if(exec, script, ctx);
+      case ria_lex_while:
+         return ria_compile_while(exec, script, ctx);
+      default:
+         ERR_SET(err_internal);
+      }
+
+   }
+
+   /*
+    * Should be predefined function
+    *
+    */
+   return ria_compile_func(exec, script, true, ctx);
+
+}
+
+#ifdef USE_RIA_PROFILER
+/*****************************************************************************/
+bool 
+   ria_get_source_line(                                            
+      usize*                      OUT   line,
+      const byte*                 IN    pos,
+      const ria_compiler_ctx_t*   IN    ctx)
+/*
+ * Returns source line of canonized script position
+ *
+ */
+{
+
+   usize l, h, m, o;
+
+   assert(line != NULL);
+   assert(pos  != NULL);
+   assert(ctx  != NULL);
+
+   o = pos - ctx->pstart;
+   for (l=0, h=ctx->csrclines; l<h; ) {
+      m = (l + h) / 2;
+      if (ctx->psrclines[m] <= o)
+         l = m + 1;
+      else
+         h = m;
+   }
+   *line = l;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_line_mark(                                            
+      mem_blk_t*            IN OUT   exec,
+      const byte*           IN       pos,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Emits mark of source line of statement at given position
+ *
+ */
+{
+
+   usize l;
+   byte* p;
+   usize c;
+
+   assert(exec != NULL);
+   assert(pos  != NULL);
+   assert(ctx  != NULL);
+
+   if (!ria_get_source_line(&l, pos, ctx))
+      return false;
+   p = exec->p;
+   c = exec->c;
+   if (c < 1)
+      ERR_SET(err_bad_length);
+   *(p++) = ria_opcode_line;
+   c--;
+   if (!ria_encode_varint(&p, &c, l))
+      return false;
+   exec->c = p - exec->p;
+   return true;
+
+}
+#endif
+
+/*****************************************************************************/
+bool 
+   ria_compile_chunk(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles chunk of scenario script into executable representation,
+ * statement is preceded by mark of its source line if profiler needs it
+ *
+ */
+{
+
+#ifdef USE_RIA_PROFILER
+   mem_blk_t te;
+   usize c;
+
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
+
+   if (ctx->psrclines == NULL)
+      return ria_compile_statement(exec, script, ctx);
+   te = *exec;
+   if (!ria_compile_line_mark(&te, script->p, ctx))
+      return false;
+   c    = te.c;
+   te.p = exec->p + c;
+   te.c = exec->c - c;
+   if (!ria_compile_statement(&te, script, ctx))
+      return false;
+   exec->c = c + te.c;
    return true;
+#else
+   return ria_compile_statement(exec, script, ctx);
+#endif
 
 }
 
 /*****************************************************************************/
 bool 
-   ria_encode_pop(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      usize    IN       idx)
+   ria_compile_script(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Encodes pop command 
+ * Compiles single scenario script 
  *
  */
 {
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+   usize i;
+   mem_blk_t te;
 
-   if (*pc < 2)
-      ERR_SET(err_bad_length);
-   if (idx > 0xFF)
-      ERR_SET(err_internal);
-   (*pp)[0] = ria_opcode_pop;
-   (*pp)[1] = (byte)idx;
+   assert(ctx    != NULL);
+   assert(script != NULL);
+   assert(exec   != NULL);
 
-   (*pp) += 2;
-   (*pc) -= 2;
+   /*
+    * Initialize context 
+    *
+    */
+   buf_set_empty(&ctx->varp);
+   buf_set_empty(&ctx->varc);
+   if (!ria_hash_reset(&ctx->varh))
+      return false;
+
+   /*
+    * Compile chunk by chunk
+    *
+    */
+   for (i=0; script->c>0; i+=te.c) {
+      te.p = exec->p + i;
+      te.c = exec->c - i;
+      if (!ria_compile_chunk(&te, script, ctx))
+         return false;
+      if (!ctx->ok)
+         return true;
+   }
+
+   /*
+    * Finalize, unreachable return is removed by optimizer
+    *
+    */
+   if (exec->c < i+1)
+      ERR_SET(err_bad_length);
+   exec->p[i] = ria_opcode_retn;
+   i++;   
+   exec->c = i;
    return true;
 
 }
 
+
+/******************************************************************************
+ *  Optimizer
+ */
+
+/*
+ * Peephole optimizer command marks
+ *
+ */
+enum {
+   ria_mask_cmd_offset = 0x00FFFFFF,
+   ria_cmd_label       = 0x01000000,
+   ria_cmd_entry       = 0x02000000,
+   ria_cmd_dead        = 0x04000000,
+   ria_cmd_long        = 0x08000000,
+   ria_cmd_wide        = 0x10000000,
+   ria_peep_max_hops   = 0x10
+};
+
 /*****************************************************************************/
-bool 
-   ria_encode_ret(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc)
+bool
+   ria_peep_is_jump(
+      byte   IN   opcode)
 /*
- * Encodes ret command 
+ * Checks whether command is jump
  *
  */
 {
 
-   assert(pp != NULL);
-   assert(pc != NULL);
-
-   if (*pc < 1)
-      ERR_SET(err_bad_length);
-   (*pp)[0] = ria_opcode_ret;
+   switch (opcode) {
+   case ria_opcode_jif:
+   case ria_opcode_jif2:
+   case ria_opcode_jit:
+   case ria_opcode_jit2:
+   case ria_opcode_jmp:
+   case ria_opcode_jmp2:
+   case ria_opcode_jif4:
+   case ria_opcode_jit4:
+   case ria_opcode_jmp4:
+      return true;
+   }
 
-   (*pp)++;
-   (*pc)--;
-   return true;
+   return false;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_encode_op(
-      byte**       IN OUT   pp, 
-      usize*       IN OUT   pc,
-      byte         IN       op1,
-      byte         IN       op2)
+bool
+   ria_peep_find_cmd(
+      usize*         OUT   idx,
+      const usize*   IN    pcmd,
+      usize          IN    ccmd,
+      usize          IN    offset,
+      usize          IN    csize)
 /*
- * Encodes operation command 
+ * Searches for command index by its offset
  *
  */
 {
 
-   byte opcode;
-
-   assert(pp != NULL);
-   assert(pc != NULL);
+   usize l, h, m;
 
-   if (*pc < 1)
-      ERR_SET(err_bad_length);
+   assert(idx  != NULL);
+   assert(pcmd != NULL);
 
-   switch (op1) {
-   case '+':
-      opcode = ria_opcode_add;
-      break;
-   case '|':
-      if (op2 == op1)
-         opcode = ria_opcode_lor;
-      else
-         opcode = ria_opcode_bor;
-      break;
-   case '<':
-      if (op2 == '=')
-         opcode = ria_opcode_less_eq;
-      else
-         opcode = ria_opcode_less;
-      break;
-   case '>':
-      if (op2 == '=')
-         opcode = ria_opcode_more_eq;
-      else
-         opcode = ria_opcode_more;
-      break;
-   case '=':
-      if (op2 == '=')
-         opcode = ria_opcode_eq;
-      else
-         ERR_SET(err_internal);
-      break;
-   case '!':
-      if (op2 == '=')
-         opcode = ria_opcode_not_eq;
-      else
-         opcode = ria_opcode_not;
-      break;
-   case '-':
-      opcode = ria_opcode_sub;
-      break;
-   case '*':
-      opcode = ria_opcode_mul;
-      break;
-   case '&':
-      if (op2 == op1)
-         opcode = ria_opcode_land;
+   if (offset == csize) {
+      *idx = ccmd;
+      return true;
+   }
+   for (l=0, h=ccmd; l<h; ) {
+      m = (l + h) / 2;
+      if ((pcmd[m] & ria_mask_cmd_offset) < offset)
+         l = m + 1;
       else
-         opcode = ria_opcode_band;
-      break;
-   case '/':
-      opcode = ria_opcode_div;
-      break;
-   case '%':
-      opcode = ria_opcode_rem;
-      break;
-   case '^':
-      opcode = ria_opcode_xor;
-      break;
-   case '~':
-      opcode = ria_opcode_bneg;
-      break;
-   case '_':
-      opcode = ria_opcode_neg;
-      break;
-   default:
+         h = m;
+   }
+   if ((l == ccmd) || ((pcmd[l] & ria_mask_cmd_offset) != offset))
       ERR_SET(err_internal);
+
+   *idx = l;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_peep_set_labels(
+      usize*         IN OUT   pcmd,
+      const usize*   IN       plink,
+      usize          IN       ccmd)
+/*
+ * Marks live jump targets and entry points as labels
+ *
+ */
+{
+
+   usize k;
+
+   assert(pcmd  != NULL);
+   assert(plink != NULL);
+
+   for (k=0; k<ccmd; k++) {
+      pcmd[k] &= ~ria_cmd_label;
+      if (pcmd[k] & ria_cmd_entry)
+         pcmd[k] |= ria_cmd_label;
    }
+   for (k=0; k<ccmd; k++) 
+      if (!(pcmd[k] & ria_cmd_dead) && (plink[k] < ccmd))
+         pcmd[plink[k]] |= ria_cmd_label;
 
-   **pp = opcode;
-   (*pp)++;
-   (*pc)--;
    return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_encode_call(
-      byte**          IN OUT   pp, 
-      usize*          IN OUT   pc,
-      bool            IN       ignore_ret,
-      ria_lextype_t   IN       lex)
+usize
+   ria_peep_next_live(
+      const usize*   IN   pcmd,
+      usize          IN   ccmd,
+      usize          IN   k)
 /*
- * Encodes function call
+ * Returns index of next live command
  *
  */
 {
 
-   byte b0 = 0x00;
-   byte b1 = 0x00;
+   for (k++; (k<ccmd) && (pcmd[k] & ria_cmd_dead); k++);
+   return k;
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+}
+
+/*****************************************************************************/
+bool
+   ria_peep_rewrite(
+      bool*    OUT      changed,
+      byte*    IN OUT   code,
+      usize*   IN OUT   pcmd,
+      usize*   IN OUT   plink,
+      usize    IN       ccmd)
+/*
+ * Single pass of peephole rewriting rules 
+ *
+ */
+{
+
+   usize i, j, k, t, h;
+   bool hit = false;
+   byte* p;
+   byte* q;
+
+   assert(changed != NULL);
+   assert(code    != NULL);
+   assert(pcmd    != NULL);
+   assert(plink   != NULL);
+
+   *changed = false;
 
    /*
-    * Check for lex
+    * Thread jumps to unconditional jumps and returns
     *
     */
-   switch (lex) {
-   case ria_lex_add_parsing_rule:
-   case ria_lex_create_parser_for_file:
-   case ria_lex_dehtml:
-   case ria_lex_extract_string:
-   case ria_lex_extract_string_from_file:
-   case ria_lex_get_binary_to_file:
-   case ria_lex_get_header:
-   case ria_lex_get_html:
-   case ria_lex_get_html_with_dump:
-   case ria_lex_get_html_to_file:
-   case ria_lex_get_html_to_file_with_dump:
-   case ria_lex_int_to_string:
-   case ria_lex_last_response:
-   case ria_lex_length:
-   case ria_lex_load_cookie:
-   case ria_lex_load_from_file:
-   case ria_lex_post:
-   case ria_lex_post_to_file:
-   case ria_lex_post_to_file_with_dump:
-   case ria_lex_post_with_dump:
-   case ria_lex_save_cookie:
-   case ria_lex_save_to_file:
-   case ria_lex_set_header:
-   case ria_lex_string_to_int:
-   case ria_lex_substring:
-      b0 = lex;
-      break;
-   default:
-      ERR_SET(err_internal);
+   for (k=0; k<ccmd; k++) {
+      if (pcmd[k] & ria_cmd_dead)
+         continue;
+      p = code + (pcmd[k] & ria_mask_cmd_offset);
+      if (!ria_peep_is_jump(p[0]))
+         continue;
+      for (t=plink[k], h=0; (t<ccmd) && (h<ria_peep_max_hops); h++) {
+         if (pcmd[t] & ria_cmd_dead) {
+            t++;
+            continue;
+         }
+         q = code + (pcmd[t] & ria_mask_cmd_offset);
+         if ((q[0] != ria_opcode_jmp) && (q[0] != ria_opcode_jmp2) &&
+             (q[0] != ria_opcode_jmp4))
+            break;
+         if ((plink[t] == t) || (plink[t] == k))
+            break;
+         t = plink[t];
+      }
+      for (; (t < ccmd) && (pcmd[t] & ria_cmd_dead); t++);
+      if ((t < ccmd) && 
+          ((p[0] == ria_opcode_jmp) || (p[0] == ria_opcode_jmp2) ||
+           (p[0] == ria_opcode_jmp4)) &&
+          (code[pcmd[t] & ria_mask_cmd_offset] == ria_opcode_retn)) {
+         /* Jump to return is return */
+         p[0] = ria_opcode_retn;
+         plink[k] = (usize)ria_var_unknown;
+         *changed = true;
+         continue;
+      }
+      if (t != plink[k]) {
+         plink[k] = t;
+         *changed = true;
+      }
    }
+   if (!ria_peep_set_labels(pcmd, plink, ccmd))
+      return false;
+
+   /*
+    * Apply local patterns
+    *
+    */
+   for (k=0; k<ccmd; k++) {
+      if (pcmd[k] & ria_cmd_dead)
+         continue;
+      p = code + (pcmd[k] & ria_mask_cmd_offset);
+      j = ria_peep_next_live(pcmd, ccmd, k);
+      q = (j < ccmd) ? code + (pcmd[j] & ria_mask_cmd_offset) : NULL;
+
+      switch (p[0]) {
+
+      /* Unreachable code till next label */
+      case ria_opcode_jmp:
+      case ria_opcode_jmp2:
+      case ria_opcode_jmp4:
+      case ria_opcode_ret:
+      case ria_opcode_retn:
+         for (i=j; (i<ccmd) && !(pcmd[i] & ria_cmd_label); i++) 
+            if (!(pcmd[i] & ria_cmd_dead)) {
+               pcmd[i] |= ria_cmd_dead;
+               hit = true;
+            }
+         if ((p[0] == ria_opcode_ret) || (p[0] == ria_opcode_retn))
+            break;
+         j = ria_peep_next_live(pcmd, ccmd, k);
+         /* Jump to next command */
+         if (plink[k] <= j) 
+            if (ria_peep_next_live(pcmd, ccmd, plink[k]-1) == j) {
+               pcmd[k] |= ria_cmd_dead;
+               hit = true;
+            }
+         break;
+
+      /* Conditional jump over unconditional one */
+      case ria_opcode_jif:
+      case ria_opcode_jif2:
+      case ria_opcode_jif4:
+      case ria_opcode_jit:
+      case ria_opcode_jit2:
+      case ria_opcode_jit4:
+         if ((q == NULL) || (pcmd[j] & ria_cmd_label))
+            break;
+         if ((q[0] != ria_opcode_jmp) && (q[0] != ria_opcode_jmp2) &&
+             (q[0] != ria_opcode_jmp4))
+            break;
+         i = ria_peep_next_live(pcmd, ccmd, j);
+         if ((plink[k] > i) || (ria_peep_next_live(pcmd, ccmd, plink[k]-1) != i))
+            break;
+         switch (p[0]) {
+         case ria_opcode_jif:
+            p[0] = ria_opcode_jit;
+            break;
+         case ria_opcode_jif2:
+            p[0] = ria_opcode_jit2;
+            break;
+         case ria_opcode_jit:
+            p[0] = ria_opcode_jif;
+            break;
+         case ria_opcode_jit2:
+            p[0] = ria_opcode_jif2;
+            break;
+         case ria_opcode_jif4:
+            p[0] = ria_opcode_jit4;
+            break;
+         case ria_opcode_jit4:
+            p[0] = ria_opcode_jif4;
+            break;
+         }
+         plink[k] = plink[j];
+         pcmd[j] |= ria_cmd_dead;
+         hit = true;
+         break;
 
-   if (*pc < (unsigned)((b1==0x00) ? 2 : 3))
-      ERR_SET(err_bad_length);
-   if (b1 != 0x00)
-      (*pp)[0] = (ignore_ret) ? ria_opcode_call2i : ria_opcode_call2p;
-   else
-      (*pp)[0] = (ignore_ret) ? ria_opcode_calli : ria_opcode_callp;
-   (*pp)[1] = b0;
-   (*pp) += 2;
-   (*pc) -= 2;
+      /* Push of variable to itself */
+      case ria_opcode_pushv:
+         if ((q == NULL) || (pcmd[j] & ria_cmd_label))
+            break;
+         if ((q[0] == ria_opcode_pop) && (q[1] == p[1])) {
+            pcmd[k] |= ria_cmd_dead;
+            pcmd[j] |= ria_cmd_dead;
+            hit = true;
+            break;
+         }
+         /* Push of variable and string constant */
+         if ((q[0] == ria_opcode_pushs) && (q == p + 2)) {
+            p[0] = ria_opcode_pushvs;
+            p[2] = q[1];
+            pcmd[j] |= ria_cmd_dead;
+            hit = true;
+         }
+         break;
+      }
 
-   if (b1 != 0x00) {
-      (*pp)[0] = b1;
-      (*pp)++;
-      (*pc)--;
+      /* Push before return without value, next command may be fused */
+      j = ria_peep_next_live(pcmd, ccmd, k);
+      q = (j < ccmd) ? code + (pcmd[j] & ria_mask_cmd_offset) : NULL;
+      if (!(pcmd[k] & ria_cmd_dead))
+         switch (p[0]) {
+         case ria_opcode_pushv:
+         case ria_opcode_pushvs:
+         case ria_opcode_pushs:
+         case ria_opcode_pushs2:
+         case ria_opcode_pushi1:
+         case ria_opcode_pushi2:
+         case ria_opcode_pushi3:
+         case ria_opcode_pushi4:
+         case ria_opcode_pushp:
+            if ((q == NULL) || (pcmd[j] & ria_cmd_label))
+               break;
+            if (q[0] != ria_opcode_retn)
+               break;
+            pcmd[k] |= ria_cmd_dead;
+            hit = true;
+            break;
+         }
+
+      if (hit) {
+         if (!ria_peep_set_labels(pcmd, plink, ccmd))
+            return false;
+         *changed = true;
+         hit = false;
+      }
    }
+
    return true;
 
 }
 
+/*
+ * Liveness analysis of local variables: sets of narrow locals are kept 
+ * as bits of usize words; functions needing more than ria_live_limit 
+ * words for analysis are left as is
+ *
+ */
+enum {
+   ria_live_bits  = sizeof(usize) * 8,
+   ria_live_limit = 0x400
+};
+
 /*****************************************************************************/
-bool 
-   ria_encode_jump(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      usize    IN       offset)
+bool
+   ria_peep_get_var(
+      usize*        OUT   var,
+      usize*        OUT   pos,
+      bool*         OUT   read,
+      bool*         OUT   write,
+      const byte*   IN    p)
 /*
- * Encodes unconditional jump 
+ * Checks whether command refers to narrow local variable, returns its 
+ * index, offset of operand and whether variable is read or written
  *
  */
 {
 
-   unumber c;
+   assert(var   != NULL);
+   assert(pos   != NULL);
+   assert(read  != NULL);
+   assert(write != NULL);
+   assert(p     != NULL);
 
-   assert(pp != NULL);
-   assert(pc != NULL);
+   *pos   = 1;
+   *read  = false;
+   *write = false;
 
-   c = (offset > 0x7F) ? 3 : 2;
-   if (*pc < c)
-      ERR_SET(err_bad_length);
-   if (c == 2) {
-      (*pp)[0] = ria_opcode_jmp;
-      (*pp)[1] = (byte)offset;
-   }
-   else {
-      (*pp)[0] = ria_opcode_jmp2;
-      (*pp)[1] = (byte)(offset >> 8);
-      (*pp)[2] = (byte)(offset >> 0);
+   switch (p[0]) {
+   case ria_opcode_pushv:
+   case ria_opcode_pushvs:
+      *read = true;
+      break;
+   case ria_opcode_pop:
+      *write = true;
+      break;
+   case ria_opcode_incv:
+   case ria_opcode_decv:
+   case ria_opcode_appv:
+      *read  = true;
+      *write = true;
+      break;
+   case ria_opcode_callv:
+      *write = true;
+      *pos   = 2;
+      break;
+   case ria_opcode_call2v:
+      *write = true;
+      *pos   = 3;
+      break;
+   default:
+      return false;
    }
 
-   (*pp) += c;
-   (*pc) -= c;
-   return true;
+   *var = p[*pos];
+   return (*var < ria_var_narrow);
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_encode_jump_if(
-      byte**   IN OUT   pp, 
-      usize*   IN OUT   pc,
-      bool     IN       what,
-      usize    IN       offset)
+bool
+   ria_peep_get_succs(
+      usize*         OUT   succ,
+      usize*         OUT   pops,
+      usize*         OUT   pushes,
+      const byte*    IN    code,
+      const usize*   IN    pcmd,
+      const usize*   IN    plink,
+      usize          IN    ccmd,
+      usize          IN    k)
 /*
- * Encodes conditional jump 
+ * Returns two live commands which may follow command, ccmd if none, 
+ * and stack effect of the command
  *
  */
 {
 
-   unumber c;
-
-   assert(pp != NULL);
-   assert(pc != NULL);
-
-   c = (offset > 0x7F) ? 3 : 2;
-   if (*pc < c)
-      ERR_SET(err_bad_length);
-   if (c == 2) {
-      (*pp)[0] = (what) ? ria_opcode_jit : ria_opcode_jif;
-      (*pp)[1] = (byte)offset;
-   }
-   else {
-      (*pp)[0] = (what) ? ria_opcode_jit2 : ria_opcode_jif2;
-      (*pp)[1] = (byte)(offset >> 8);
-      (*pp)[2] = (byte)(offset >> 0);
+   ria_type_t type;
+   function_fn* impl;
+   unumber j;
+   bool next = true;
+   const byte* p;
+
+   assert(succ   != NULL);
+   assert(pops   != NULL);
+   assert(pushes != NULL);
+   assert(code   != NULL);
+   assert(pcmd   != NULL);
+   assert(plink  != NULL);
+
+   p = code + (pcmd[k] & ria_mask_cmd_offset);
+   *pops   = 0;
+   *pushes = 0;
+
+   switch (p[0]) {
+   case ria_opcode_pushvs:
+      (*pushes)++;
+   case ria_opcode_pushv:
+   case ria_opcode_pushvw:
+   case ria_opcode_pushs:
+   case ria_opcode_pushs2:
+   case ria_opcode_pushp:
+   case ria_opcode_pushi1:
+   case ria_opcode_pushi2:
+   case ria_opcode_pushi3:
+   case ria_opcode_pushi4:
+      (*pushes)++;
+      break;
+   case ria_opcode_pop:
+   case ria_opcode_popw:
+   case ria_opcode_appv:
+   case ria_opcode_jif:
+   case ria_opcode_jif2:
+   case ria_opcode_jif4:
+   case ria_opcode_jit:
+   case ria_opcode_jit2:
+   case ria_opcode_jit4:
+      *pops = 1;
+      break;
+   case ria_opcode_ret:
+      *pops = 1;
+      next  = false;
+      break;
+   case ria_opcode_retn:
+   case ria_opcode_jmp:
+   case ria_opcode_jmp2:
+   case ria_opcode_jmp4:
+      next = false;
+      break;
+   case ria_opcode_callp:
+   case ria_opcode_calli:
+   case ria_opcode_callv:
+   case ria_opcode_call2p:
+   case ria_opcode_call2i:
+   case ria_opcode_call2v:
+      switch (p[0]) {
+      case ria_opcode_call2p:
+      case ria_opcode_call2i:
+      case ria_opcode_call2v:
+         j = (p[1] << 8) | p[2];
+         break;
+      default:
+         j = p[1];
+      }
+      if (!ria_get_function_info(&type, &j, &impl, j))
+         return false;
+      *pops = (usize)j;
+      if ((p[0] == ria_opcode_callp) || (p[0] == ria_opcode_call2p))
+         *pushes = 1;
+      break;
+   default:
+      if ((p[0] >= ria_opcode_add) && (p[0] < ria_opcode_not)) {
+         *pops   = 2;
+         *pushes = 1;
+      }
+      else
+      if ((p[0] == ria_opcode_not) || (p[0] == ria_opcode_neg)) {
+         *pops   = 1;
+         *pushes = 1;
+      }
    }
 
-   (*pp) += c;
-   (*pc) -= c;
+   succ[0] = (next) ? ria_peep_next_live(pcmd, ccmd, k) : ccmd;
+   succ[1] = ccmd;
+   if (ria_peep_is_jump(p[0]) && (plink[k] < ccmd))
+      for (succ[1]=plink[k]; 
+           (succ[1] < ccmd) && (pcmd[succ[1]] & ria_cmd_dead); 
+           succ[1]++);
    return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_compile_operand(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
-      ria_compiler_ctx_t*   IN OUT   ctx)
+bool
+   ria_peep_liveness(
+      usize*         OUT   plive,
+      usize*         OUT   pdepth,
+      const byte*    IN    code,
+      const usize*   IN    pcmd,
+      const usize*   IN    plink,
+      usize          IN    ccmd,
+      usize          IN    f,
+      usize          IN    e,
+      usize          IN    w)
 /*
- * Compiles operand
+ * Computes sets of w words for commands of function running from command
+ * f up to e: local variables live before each command, live after it and
+ * touched since stack was empty, so that their values may be on stack;
+ * stack depth before each command is (usize)-1 if it is unreachable
  *
  */
 {
 
-   usize i, j, c;
-   byte* p;
-   mem_blk_t expr;
-
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
+   usize m, k, i, j, v, d, pos, pops, pushes;
+   usize succ[2];
+   usize x, b;
+   usize* pin;
+   usize* pout;
+   usize* ptouch;
+   bool read, write, refer, changed;
+
+   assert(plive  != NULL);
+   assert(pdepth != NULL);
+   assert(code   != NULL);
+   assert(pcmd   != NULL);
+   assert(plink  != NULL);
+
+   m      = e - f;
+   pin    = plive;
+   pout   = pin + m*w;
+   ptouch = pout + m*w;
+   MemSet(plive, 0x00, 3*m*w*sizeof(usize));
 
    /*
-    * Operand is:
-    * - '(' <expression> ')'
-    * - '$' <var>
-    * - '@' <parameter>
-    * - '"' <string> '"'
-    * - <decimal digit>{1,}
-    *
-    */
-   
-   /*
-    * Check operand type
+    * Variable is live before command, if command reads it, or if it is 
+    * live after command, which does not write it
     *
     */
-   if (script->c < 1) {
-      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-      return true;
-   }
-   switch (script->p[0]) {
-
-   /* Nested expression */
-   case '(':
-      expr.p = script->p + 1;
-      expr.c = script->c - 1;
-      if (!ria_find_char(&p, &expr, ')', 1))
-         return false;
-      if (p == NULL) {
-         SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
-         return true;
-      }
-      expr.c = p - expr.p;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("Compiling operand, nested expression ");
-      RIA_TRACE_STR(script->p, expr.c+2);
-      RIA_TRACE_MSG("\n");
-#endif      
-      if (!ria_compile_expression(exec, &expr, ctx))
-         return false;
-      if (!ctx->ok)
-         return true;
-      script->c -= expr.p - script->p + 1;
-      script->p  = expr.p + 1;
-      break;
-
-   /* Variable */
-   case '$':
-      if (!ria_find_var(&i, &j, script, ctx))
-         return false;
-      if (j == ria_var_unknown) {
-         SET_COMPILE_ERROR(ctx, script->p, "unknown variable");
-         return true;
-      }
-      p = exec->p;
-      c = exec->c;
-      if (!ria_encode_push_var(&p, &c, j))
-         return false;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("COMPILED pushv ");
-      RIA_TRACE_INT(j);
-      RIA_TRACE_MSG("\n");
-#endif      
-      exec->c = p - exec->p;
-      script->c -= i;
-      script->p += i;
-      break;
-
-   /* Parameter */
-   case '@':
-      if (!ria_find_param(&i, &j, script, ctx))
-         return false;
-      p = exec->p;
-      c = exec->c;
-      if (!ria_encode_push_param(&p, &c, j))
-         return false;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("COMPILED pushp ");
-      RIA_TRACE_INT(j);
-      RIA_TRACE_MSG("\n");
-#endif      
-      exec->c = p - exec->p;
-      script->c -= i;
-      script->p += i;
-      break;
-
-   /* String constant */
-   case '"':
-      if (!ria_find_string(&i, &j, script, ctx))
-         return false;
-      p = exec->p;
-      c = exec->c;
-      if (!ria_encode_push_string(&p, &c, j))
-         return false;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("COMPILED pushs ");
-      RIA_TRACE_INT(j);
-      RIA_TRACE_MSG("\n");
-#endif      
-      exec->c = p - exec->p;
-      script->c -= i + 2;
-      script->p += i + 2;
-      break;
-
-   default:
-      if ((script->p[0] >= '0') && (script->p[0] <= '9')) {
-         /*
-          * Numeric constant case
-          *
-          */
-         bool nonzero = false; 
-         for (j=0; script->c>0; script->p++, script->c--, nonzero=true) {
-            if ((script->p[0] < '0') || (script->p[0] > '9')) 
-               break;
-            if (nonzero && (j == 0)) {
-               SET_COMPILE_ERROR(ctx, script->p, "bad numeric constant");
-               return true;
-            }   
-            j = j*10 + script->p[0] - '0';
-         }               
-         p = exec->p;
-         c = exec->c;
-         if (!ria_encode_push_int(&p, &c, (int)j))
+   do {
+      changed = false;
+      for (k=e; k>f; ) {
+         k--;
+         if (pcmd[k] & ria_cmd_dead)
+            continue;
+         if (!ria_peep_get_succs(
+                 succ, &pops, &pushes, code, pcmd, plink, ccmd, k))
             return false;
-#ifdef COMPILER_TRACE      
-         RIA_TRACE_MSG("COMPILED pushi ");
-         RIA_TRACE_INT(j);
-         RIA_TRACE_MSG("\n");
-#endif         
-         exec->c = p - exec->p;
-         ctx->expr_type = ria_int;
+         refer = ria_peep_get_var(
+                    &v, &pos, &read, &write, 
+                    code + (pcmd[k] & ria_mask_cmd_offset));
+         for (i=0; i<w; i++) {
+            for (j=0, x=0; j<2; j++)
+               if ((succ[j] >= f) && (succ[j] < e))
+                  x |= pin[(succ[j]-f)*w+i];
+            pout[(k-f)*w+i] = x;
+            if (refer && (v/ria_live_bits == i)) {
+               b = (usize)1 << (v%ria_live_bits);
+               if (write)
+                  x &= ~b;
+               if (read)
+                  x |= b;
+            }
+            if (pin[(k-f)*w+i] != x) {
+               pin[(k-f)*w+i] = x;
+               changed = true;
+            }
+         }
       }
-      else {
-         /*
-          * Predefined function call 
-          *
-          */
-         if (!ria_compile_func(exec, script, false, ctx))
+   } while (changed);
+
+   /*
+    * Propagate stack depth and touched variables from function entry, 
+    * variables are touched by command which refers to them or if they 
+    * are live after it
+    *
+    */
+   for (k=0; k<m; k++)
+      pdepth[k] = (usize)-1;
+   k = (pcmd[f] & ria_cmd_dead) ? ria_peep_next_live(pcmd, ccmd, f) : f;
+   if (k >= e)
+      return true;
+   pdepth[k-f] = 0;
+   do {
+      changed = false;
+      for (k=f; k<e; k++) {
+         if ((pcmd[k] & ria_cmd_dead) || (pdepth[k-f] == (usize)-1))
+            continue;
+         if (!ria_peep_get_succs(
+                 succ, &pops, &pushes, code, pcmd, plink, ccmd, k))
             return false;
+         if (pdepth[k-f] < pops)
+            ERR_SET(err_internal);
+         d = pdepth[k-f] - pops + pushes;
+         refer = ria_peep_get_var(
+                    &v, &pos, &read, &write, 
+                    code + (pcmd[k] & ria_mask_cmd_offset));
+         for (j=0; j<2; j++) {
+            if ((succ[j] < f) || (succ[j] >= e))
+               continue;
+            if (pdepth[succ[j]-f] == (usize)-1) {
+               pdepth[succ[j]-f] = d;
+               changed = true;
+            }
+            else
+            if (pdepth[succ[j]-f] != d) {
+               ERR_SET(err_internal);
+            }
+            for (i=0; i<w; i++) {
+               x = pout[(k-f)*w+i];
+               if (pdepth[k-f] != 0)
+                  x |= ptouch[(k-f)*w+i];
+               if (refer && (v/ria_live_bits == i))
+                  x |= (usize)1 << (v%ria_live_bits);
+               if ((ptouch[(succ[j]-f)*w+i] | x) != ptouch[(succ[j]-f)*w+i]) {
+                  ptouch[(succ[j]-f)*w+i] |= x;
+                  changed = true;
+               }
+            }
+         }
       }
-
-   }
+   } while (changed);
 
    return true;
 
 }
 
+#ifndef USE_RIA_REGISTER_CODE
 /*****************************************************************************/
-bool 
-   ria_compile_expression(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
-      ria_compiler_ctx_t*   IN OUT   ctx)
+bool
+   ria_peep_share_vars(
+      byte*          IN OUT   code,
+      const usize*   IN       pcmd,
+      const usize*   IN       plive,
+      const usize*   IN       pdepth,
+      usize*         OUT      pconf,
+      usize*         OUT      pslot,
+      usize          IN       f,
+      usize          IN       e,
+      usize          IN       w,
+      usize          IN       nv)
 /*
- * Compiles expression
+ * Renames local variables of function running from command f up to e, 
+ * so that variables which are never live at the same time share slot;
+ * variable interferes with ones live after command writing it and with 
+ * ones whose values may be on stack there, variables read before written
+ * interfere with each other
  *
  */
 {
 
-   char op[2];
-   bool unary;
-   ria_type_t type;
-   mem_blk_t oper;
+   usize m, k, i, v, u, s, pos;
+   usize b;
+   const usize* pin;
+   const usize* pout;
+   const usize* ptouch;
+   bool read, write, entry;
    byte* p;
-   byte* pe;
-   usize ce;
-
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
 
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling expression ");
-   RIA_TRACE_STR(script->p, script->c);
-   RIA_TRACE_MSG("\n");
-#endif   
+   assert(code   != NULL);
+   assert(pcmd   != NULL);
+   assert(plive  != NULL);
+   assert(pdepth != NULL);
+   assert(pconf  != NULL);
+   assert(pslot  != NULL);
+
+   m      = e - f;
+   pin    = plive;
+   pout   = pin + m*w;
+   ptouch = pout + m*w;
+   MemSet(pconf, 0x00, nv*w*sizeof(usize));
+   for (v=0; v<nv; v++)
+      pslot[v] = (usize)-1;
 
    /*
-    * Evaluate complex expression:
-    * (<op>){0,1} <operand> (<op> <operand>){0,} 
-    * where operand can be nested expression
+    * Collect interferences of variables referred by reachable commands
     *
     */
+   for (k=f, entry=true; k<e; k++) {
+      if ((pcmd[k] & ria_cmd_dead) || (pdepth[k-f] == (usize)-1))
+         continue;
+      for (u=0; entry && (u<nv); u++)
+         for (v=0; v<nv; v++) {
+            i = (k-f)*w;
+            if ((pin[i+u/ria_live_bits] & ((usize)1 << (u%ria_live_bits))) &&
+                (pin[i+v/ria_live_bits] & ((usize)1 << (v%ria_live_bits))))
+               pconf[u*w+v/ria_live_bits] |= (usize)1 << (v%ria_live_bits);
+         }
+      entry = false;
+      p = code + (pcmd[k] & ria_mask_cmd_offset);
+      if (!ria_peep_get_var(&v, &pos, &read, &write, p))
+         continue;
+      pslot[v] = v;
+      if (!write)
+         continue;
+      for (u=0; u<nv; u++) {
+         i = (k-f)*w + u/ria_live_bits;
+         b = (usize)1 << (u%ria_live_bits);
+         if ((u == v) || !((pout[i] | ptouch[i]) & b))
+            continue;
+         pconf[u*w+v/ria_live_bits] |= (usize)1 << (v%ria_live_bits);
+         pconf[v*w+u/ria_live_bits] |= b;
+      }
+   }
 
-   /* 
-    * Check for unary operation:
-    * (<op>){0,1}
-    * and cache it
+   /*
+    * Give each variable the lowest slot not taken by variables before it
+    * which it interferes with, so that slot never exceeds variable index
     *
     */
-   if (script->c < 1) {
-      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-      return true;
-   }
-   type = ria_unknown;
-   switch (script->p[0]) {
-   case '~':
-   case '!':
-   case '-':
-      /* Handle unary '-' as '_' */
-      op[0] = (script->p[0] == '-') ? '_' : script->p[0];
-      op[1] = 0x00;
-      script->p++;
-      script->c--;
-      unary = true;
-      break;
-   default:
-      op[0] = 0x00;
-      unary = false;
+   for (v=0; v<nv; v++) {
+      if (pslot[v] == (usize)-1)
+         continue;
+      for (s=0; ; s++) {
+         for (u=0; u<v; u++)
+            if ((pslot[u] == s) && 
+                (pconf[v*w+u/ria_live_bits] & ((usize)1 << (u%ria_live_bits))))
+               break;
+         if (u == v)
+            break;
+      }
+      pslot[v] = s;
    }
 
-   /* 
-    * Evaluate sequence of 
-    * <operand> (<op> <operand>){0,} 
+   /*
+    * Rename variables in place
     *
     */
-   pe = exec->p;
-   ce = exec->c;
-   while (script->c > 0) {
+   for (k=f; k<e; k++) {
+      if (pcmd[k] & ria_cmd_dead)
+         continue;
+      p = code + (pcmd[k] & ria_mask_cmd_offset);
+      if (!ria_peep_get_var(&v, &pos, &read, &write, p))
+         continue;
+      if ((v < nv) && (pslot[v] != (usize)-1))
+         p[pos] = (byte)pslot[v];
+   }
+
+   return true;
+
+}
+#endif
+
+/*****************************************************************************/
+usize
+   ria_peep_live_size(
+      usize*         OUT   nv,
+      const byte*    IN    code,
+      const usize*   IN    pcmd,
+      usize          IN    f,
+      usize          IN    e)
+/*
+ * Returns number of words needed for analysis of function running from 
+ * command f up to e, 0 if function is not analyzed; nv is number of its
+ * narrow local variables
+ *
+ */
+{
+
+   usize k, v, w, l, pos;
+   bool read, write;
+
+   assert(nv   != NULL);
+   assert(code != NULL);
+   assert(pcmd != NULL);
+
+   *nv = 0;
+   if (!(pcmd[f] & ria_cmd_entry))
+      return 0;
+   for (k=f; k<e; k++) 
+      if (!(pcmd[k] & ria_cmd_dead) && 
+          ria_peep_get_var(
+             &v, &pos, &read, &write, code + (pcmd[k] & ria_mask_cmd_offset)))
+         *nv = (v >= *nv) ? v+1 : *nv;
+   if (*nv == 0)
+      return 0;
+   w = (*nv + ria_live_bits - 1) / ria_live_bits;
+   l = 3*(e-f)*w + (e-f) + *nv*w + *nv;
+   if (l > ria_live_limit) {
+      *nv = 0;
+      return 0;
+   }
+
+   return l;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_peep_release_vars(
+      byte*          IN OUT   code,
+      usize          IN       csize,
+      const usize*   IN       pcmd,
+      const usize*   IN       plink,
+      usize          IN       ccmd,
+      buf_t*         IN OUT   kcmds,
+      buf_t*         IN OUT   klinks,
+      buf_t*         IN OUT   map,
+      heap_ctx_t*    IN OUT   mem)
+/*
+ * Runs liveness analysis over local variables of each function: ones 
+ * whose lifetimes do not overlap share slot, unless code is translated 
+ * to register one, which keeps types of slots, and kill commands are put
+ * where slot becomes dead while stack is empty. Code of csize octets 
+ * is followed by room for kill commands of all narrow slots, new command 
+ * list refers to them; map gives its index for each command of old one.
+ * New list is left empty, if no function is analyzed
+ *
+ */
+{
+
+   usize f, e, k, s, m, w, i, l, nv;
+   usize x;
+   usize* pl     = NULL;
+   usize* pdepth = NULL;
+   usize* pn;
+   bool   ret = false;
+
+   assert(code   != NULL);
+   assert(pcmd   != NULL);
+   assert(plink  != NULL);
+   assert(kcmds  != NULL);
+   assert(klinks != NULL);
+   assert(map    != NULL);
+
+   for (s=0; s<ria_var_narrow; s++) {
+      code[csize+2*s]   = ria_opcode_kill;
+      code[csize+2*s+1] = (byte)s;
+   }
+   if (!buf_set_length(0, kcmds))
+      goto exit;
+   if (!buf_set_length(0, klinks))
+      goto exit;
+   for (f=0, x=0; f<ccmd; f=e) {
+      for (e=f+1; (e<ccmd) && !(pcmd[e] & ria_cmd_entry); e++);
+      if (ria_peep_live_size(&nv, code, pcmd, f, e) > 0)
+         x++;
+   }
+   if (x == 0)
+      return true;
+   if (!buf_expand(ccmd+1, kcmds))
+      goto exit;
+   if (!buf_expand(ccmd+1, klinks))
+      goto exit;
+   if (!buf_expand(ccmd+1, map))
+      goto exit;
+   if (!buf_set_length(ccmd+1, map))
+      goto exit;
+
+   for (f=0; f<ccmd; f=e) {
+      for (e=f+1; (e<ccmd) && !(pcmd[e] & ria_cmd_entry); e++);
 
       /*
-       * Compile operand
+       * Analyze function, if it refers to narrow locals and
+       * is small enough
        *
        */
-      oper.p = pe;
-      oper.c = ce;
-      p = script->p;
-      if (!ria_compile_operand(&oper, script, ctx))
-         return false;
-      if (!ctx->ok)
-         return true;
-      if (oper.p != pe) 
-         ERR_SET(err_internal);
-      ce -= oper.c;
-      pe += oper.c;
-      if (type != ria_unknown) {
-         if (type != ctx->expr_type) {
-            SET_COMPILE_ERROR(ctx, p, "bad operands type");
-            return true;
-         }
-      }
-      else {
-         if (ctx->expr_type == ria_unknown) {
-            SET_COMPILE_ERROR(ctx, p, "use of uninitialized variable");
-            return true;
-         }
-         type = ctx->expr_type;
+      l = ria_peep_live_size(&nv, code, pcmd, f, e);
+      m = e - f;
+      w = (nv + ria_live_bits - 1) / ria_live_bits;
+      if (nv > 0) {
+         if (!heap_alloc((void**)&pl, l*sizeof(usize), mem))
+            goto exit;
+         pdepth = pl + 3*m*w;
+         if (!ria_peep_liveness(pl, pdepth, code, pcmd, plink, ccmd, f, e, w))
+            goto exit;
+#ifndef USE_RIA_REGISTER_CODE
+         if (!ria_peep_share_vars(
+                 code, pcmd, pl, pdepth, pdepth+m, pdepth+m+nv*w, 
+                 f, e, w, nv))
+            goto exit;
+         if (!ria_peep_liveness(pl, pdepth, code, pcmd, plink, ccmd, f, e, w))
+            goto exit;
+#endif
       }
 
       /*
-       * Apply cached operation
+       * Copy commands, command reached with empty stack is preceded by 
+       * kills of slots touched before it and dead at it
        *
        */
-      if (op[0] != 0x00) {
-         if (!ria_match_op_and_type(&type, unary, op[0], op[1])) {
-            SET_COMPILE_ERROR(ctx, p, "bad operands type");
-            return true;
-         }
-         ctx->expr_type = type;
-         if (!ria_encode_op(&pe, &ce, op[0], op[1])) 
-            return true;
-#ifdef COMPILER_TRACE      
-         RIA_TRACE_MSG("COMPILED op ");
-         RIA_TRACE_STR(op, (op[1]==0x00)?1:2);
-         RIA_TRACE_MSG("\n");
-#endif         
-         op[0] = 0x00;
-         unary = false;
+      for (k=f; k<e; k++) {
+         buf_get_ptr_usizes(map)[k] = buf_get_length(kcmds);
+         if ((nv > 0) && !(pcmd[k] & ria_cmd_dead) && (pdepth[k-f] == 0))
+            for (s=0; s<nv; s++) {
+               i = (k-f)*w + s/ria_live_bits;
+               x = (usize)1 << (s%ria_live_bits);
+               if (!(pl[2*m*w+i] & x) || (pl[i] & x))
+                  continue;
+               x = csize + 2*s;
+               if (!buf_append(&x, 1, kcmds))
+                  goto exit;
+               x = (usize)ria_var_unknown;
+               if (!buf_append(&x, 1, klinks))
+                  goto exit;
+            }
+         if (!buf_append(&pcmd[k], 1, kcmds))
+            goto exit;
+         if (!buf_append(&plink[k], 1, klinks))
+            goto exit;
+      }
+      if (pl != NULL) {
+         if (!heap_free(pl, mem))
+            return false;
+         pl = NULL;
       }
+   }
+   buf_get_ptr_usizes(map)[ccmd] = buf_get_length(kcmds);
 
-      /*
-       * Extract next operation
-       *
-       */
-      if (script->c > 0) {
-         if (script->c < 2) {
-            SET_COMPILE_ERROR(ctx, p, "syntax error");
-            return true;
+   /*
+    * Retarget jumps to new command list
+    *
+    */
+   pn = buf_get_ptr_usizes(klinks);
+   for (k=0; k<buf_get_length(klinks); k++)
+      if (pn[k] <= ccmd)
+         pn[k] = buf_get_ptr_usizes(map)[pn[k]];
+   ret = true;
+
+exit:
+   if (pl != NULL)
+      ret = heap_free(pl, mem) && ret;
+   return ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_peep_layout(
+      usize*         OUT      csize,
+      const byte*    IN       code,
+      usize*         IN OUT   pcmd,
+      const usize*   IN       plink,
+      usize*         OUT      ppos,
+      usize          IN       ccmd)
+/*
+ * Assigns new offsets choosing shortest jump forms
+ *
+ */
+{
+
+   usize k, c;
+   int o;
+   bool grown;
+   const byte* p;
+
+   assert(csize != NULL);
+   assert(code  != NULL);
+   assert(pcmd  != NULL);
+   assert(plink != NULL);
+   assert(ppos  != NULL);
+
+   /*
+    * Start with short jumps, grow ones out of range until stable
+    *
+    */
+   for (k=0; k<ccmd; k++) 
+      pcmd[k] &= ~(ria_cmd_long|ria_cmd_wide);
+   do {
+      for (k=0, c=0; k<ccmd; k++) {
+         ppos[k] = c;
+         if (pcmd[k] & ria_cmd_dead)
+            continue;
+         p = code + (pcmd[k] & ria_mask_cmd_offset);
+         if (ria_peep_is_jump(p[0])) 
+            c += (pcmd[k] & ria_cmd_wide) ? 5 : 
+                 (pcmd[k] & ria_cmd_long) ? 3 : 2;
+         else {
+            usize j;
+            if (!ria_get_command_size(&j, p, 5))
+               return false;
+            c += j;
          }
-         op[0] = script->p[0];
-         switch (script->p[0]) {
-         case '+':
-         case '-':
-         case '*':
-         case '/':
-         case '%':
-         case '^':
-         case '~':
-            op[1] = 0x00;
-            break;
-         case '<':
-         case '>':
-         case '!':
-            if (script->p[1] == '=')
-               op[1] = '=';
-            else 
-               op[1] = 0x00;
-            break;
-         case '=':
-            if (script->p[1] != '=') {
-               SET_COMPILE_ERROR(ctx, p, "syntax error");
-               return true;
+      }
+      ppos[ccmd] = c;
+      for (k=0, grown=false; k<ccmd; k++) {
+         if (pcmd[k] & (ria_cmd_dead|ria_cmd_wide))
+            continue;
+         p = code + (pcmd[k] & ria_mask_cmd_offset);
+         if (!ria_peep_is_jump(p[0]))
+            continue;
+         o = (int)ppos[plink[k]] - (int)ppos[k];
+         if (!(pcmd[k] & ria_cmd_long)) {
+            if (o > 0)
+               o -= 2;
+            if ((o > 0x7F) || (o < -0x80)) {
+               pcmd[k] |= ria_cmd_long;
+               grown = true;
             }
-            op[1] = '=';
-            break;
-         case '&':
-         case '|':
-            if (script->p[1] == op[0])
-               op[1] = op[0];
-            else 
-               op[1] = 0x00;
-            break;
-         default:
-            SET_COMPILE_ERROR(ctx, p, "syntax error");
-            return true;
          }
-         script->p++;
-         script->c--;
-         if (op[1] != 0x00) {
-            script->p++;
-            script->c--;
+         else {
+            if (o > 0)
+               o -= 3;
+            if ((o > 0x7FFF) || (o < -0x8000)) {
+               pcmd[k] |= ria_cmd_wide;
+               grown = true;
+            }
          }
       }
-
+   } while (grown);
+
+   *csize = c;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_peep_emit(
+      byte*          OUT   dst,
+      const byte*    IN    code,
+      const usize*   IN    pcmd,
+      const usize*   IN    plink,
+      const usize*   IN    ppos,
+      usize          IN    ccmd)
+/*
+ * Writes optimized code
+ *
+ */
+{
+
+   usize k, c;
+   int o;
+   const byte* p;
+
+   assert(dst   != NULL);
+   assert(code  != NULL);
+   assert(pcmd  != NULL);
+   assert(plink != NULL);
+   assert(ppos  != NULL);
+
+   for (k=0; k<ccmd; k++) {
+      if (pcmd[k] & ria_cmd_dead)
+         continue;
+      p = code + (pcmd[k] & ria_mask_cmd_offset);
+      if (!ria_peep_is_jump(p[0])) {
+         if (!ria_get_command_size(&c, p, 5))
+            return false;
+         MemCpy(dst+ppos[k], p, c);
+         continue;
+      }
+      c = (pcmd[k] & ria_cmd_wide) ? 5 : (pcmd[k] & ria_cmd_long) ? 3 : 2;
+      o = (int)ppos[plink[k]] - (int)ppos[k];
+      if (o == 0)
+         ERR_SET(err_internal);
+      if (o > 0)
+         o -= (int)c;
+      if ((c != 5) && ((o > 0x7FFF) || (o < -0x8000)))
+         ERR_SET(err_internal);
+      switch (p[0]) {
+      case ria_opcode_jif:
+      case ria_opcode_jif2:
+      case ria_opcode_jif4:
+         dst[ppos[k]] = (c == 2) ? ria_opcode_jif : 
+                        (c == 3) ? ria_opcode_jif2 : ria_opcode_jif4;
+         break;
+      case ria_opcode_jit:
+      case ria_opcode_jit2:
+      case ria_opcode_jit4:
+         dst[ppos[k]] = (c == 2) ? ria_opcode_jit : 
+                        (c == 3) ? ria_opcode_jit2 : ria_opcode_jit4;
+         break;
+      default:
+         dst[ppos[k]] = (c == 2) ? ria_opcode_jmp : 
+                        (c == 3) ? ria_opcode_jmp2 : ria_opcode_jmp4;
+      }
+      switch (c) {
+      case 2:
+         dst[ppos[k]+1] = (byte)o;
+         break;
+      case 3:
+         dst[ppos[k]+1] = (byte)(o >> 8);
+         dst[ppos[k]+2] = (byte)(o >> 0);
+         break;
+      default:
+         dst[ppos[k]+1] = (byte)(o >> 24);
+         dst[ppos[k]+2] = (byte)(o >> 16);
+         dst[ppos[k]+3] = (byte)(o >>  8);
+         dst[ppos[k]+4] = (byte)(o >>  0);
+      }
    }
 
-   /*
-    * Finalize output buffer
-    *
-    */
-   exec->c = pe - exec->p;
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Expression compilation finished\n");
-#endif   
    return true;
 
 }
 
+#ifdef USE_RIA_PROFILER
 /*****************************************************************************/
-bool 
-   ria_compile_assignment(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
+bool
+   ria_peep_set_lines(
+      const byte*           IN       code,
+      const usize*          IN       pcmd,
+      const usize*          IN       ppos,
+      usize                 IN       ccmd,
       ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Compiles assignment statement
+ * Appends source line marks to line table, mark followed by no code 
+ * gives its offset to the next one
  *
  */
 {
 
-   usize c, i, j;
-   byte* p;
-   mem_blk_t expr;
-
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
+   usize k, l, c, u, x;
+   usize* p;
+   const byte* q;
 
-   /*
-    * Assignment is:
-    * $var=expression
-    *
-    */
+   assert(code != NULL);
+   assert(pcmd != NULL);
+   assert(ppos != NULL);
+   assert(ctx  != NULL);
 
-   assert(script->c > 0);
-   assert(script->p[0] == '$');
+   for (k=0; k<ccmd; k++) {
+      q = code + (pcmd[k] & ria_mask_cmd_offset);
+      if (q[0] != ria_opcode_line)
+         continue;
+      if (!ria_decode_varint(&u, &x, q+1, ria_varint_size))
+         return false;
+      l = buf_get_length(&ctx->lines);
+      p = buf_get_ptr_usizes(&ctx->lines);
+      if ((l >= 2) && (p[l-2] == ppos[k])) {
+         p[l-1] = u;
+         continue;
+      }
+      if (!buf_expand(l+2, &ctx->lines))
+         return false;
+      p = buf_get_ptr_usizes(&ctx->lines);
+      p[l]   = ppos[k];
+      p[l+1] = u;
+      if (!buf_set_length(l+2, &ctx->lines))
+         return false;
+   }
+   c = buf_get_length(&ctx->lines);
+   if ((c >= 2) && (buf_get_ptr_usizes(&ctx->lines)[c-2] == ppos[ccmd]))
+      return buf_set_length(c-2, &ctx->lines);
+   return true;
 
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling assignment ");
+}
 #endif
 
-   /*
-    * Extract variable info
-    *
-    */
-   if (!ria_find_var(&i, &j, script, ctx))
-      return false;
-   if ((i >= script->c) || (script->p[i] != '=')) {
-      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-      return true;
-   }
+#ifdef USE_RIA_PROFILER
+/*****************************************************************************/
+usize
+   ria_peep_removed(
+      const usize*   IN   marks,
+      usize          IN   count,
+      usize          IN   offset)
+/*
+ * Returns number of octets of line marks before offset; marks are
+ * (offset, octets up to mark end) pairs in order of offsets
+ *
+ */
+{
 
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("to variable ");
-   RIA_TRACE_STR(script->p, i);
-   RIA_TRACE_MSG("\n");
-#endif
+   usize l, h, m;
 
-   /*
-    * Create new if not found 
-    *
-    */
-   if (j == ria_var_unknown) {
-      if (!ria_create_var(&j, script->p, i, ria_unknown, false, ctx))
-         return false;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("No such variable was found, adding new one\n");
-#endif      
-   }
+   assert((count == 0) || (marks != NULL));
 
-   /*
-    * Extract expression script
-    *
-    */
-   script->p += i + 1;
-   script->c -= i + 1;
-   expr = *script;
-   if (!ria_find_char(&p, &expr, ';', 0))
-      return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, script->p, "; is absent");
-      return true;
+   for (l=0, h=count; l<h; ) {
+      m = (l + h) / 2;
+      if (marks[m*2] < offset)
+         l = m + 1;
+      else
+         h = m;
    }
-   expr.c = p - expr.p;
+   return (l > 0) ? marks[l*2-1] : 0;
 
-   /*
-    * Compile expression
-    *
-    */
-   p = exec->p;
-   c = exec->c;
-   if (!ria_compile_expression(exec, &expr, ctx))
-      return false;
-   if (!ctx->ok)
-      return true;
-   if (ctx->expr_type == ria_unknown)
-      ERR_SET(err_internal);
-   script->c -= expr.p - script->p + 1;
-   script->p  = expr.p + 1;
+}
 
-   /*
-    * Setup variable type
-    *
-    */
-   if (j >= ria_var_threshold) {
-      usize* pu = buf_get_ptr_usizes(&ctx->globalc) + j - ria_var_threshold;
-      *pu = (*pu & ria_mask_var_name_len) | 
-         ((usize)ctx->expr_type << ria_shift_var_type);
-   }         
-   else {  
-      usize* pu = buf_get_ptr_usizes(&ctx->varc) + j;
-      *pu = (*pu & ria_mask_var_name_len) |
-         ((usize)ctx->expr_type << ria_shift_var_type);
-   }         
+/*****************************************************************************/
+bool
+   ria_peep_count_marks(
+      usize*        OUT   count,
+      const byte*   IN    code,
+      usize         IN    from,
+      usize         IN    to)
+/*
+ * Counts octets of line marks between commands at from and to
+ *
+ */
+{
 
-   /*
-    * Add pop-to-var command
-    *
-    */
-   if (p != exec->p)
-      ERR_SET(err_internal);
-   c -= exec->c;
-   p += exec->c;
-   if (!ria_encode_pop(&p, &c, j))
-      return false;
-   exec->c = p - exec->p;
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("COMPILED: pop ");
-   RIA_TRACE_INT(j);
-   RIA_TRACE_MSG("\n");
-   RIA_TRACE_MSG("Assignment compilation finished\n");
-#endif
+   usize k;
+
+   assert(count != NULL);
+   assert(code  != NULL);
+
+   for (*count=0; from<to; from+=k) {
+      if (!ria_get_command_size(&k, code+from, to-from))
+         return false;
+      if (code[from] == ria_opcode_line)
+         *count += k;
+   }
    return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_compile_return(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
+bool
+   ria_peep_drop_lines(
+      mem_blk_t*            IN OUT   code,
       ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Compiles return statement
+ * Drops source line marks in place, when there is no memory for the
+ * peephole pass; jumps keep their size and go, as well as entry points,
+ * to the command following mark. Line table is filled as by the pass,
+ * if there is memory for it; otherwise marks are counted over code
  *
  */
 {
 
-   usize c;
+   usize i, j, k, l, n, r, t, u, x;
+   int o;
    byte* p;
-   mem_blk_t expr;
+   usize* pm = NULL;
 
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
+   assert(code != NULL);
+   assert(ctx  != NULL);
 
    /*
-    * Return statement is
-    * return(<expression>);
-    * Script to parse is:
-    * (expression);
+    * Collect marks in line table buffer
     *
     */
+   for (i=n=0; i<code->c; i+=k) {
+      if (!ria_get_command_size(&k, code->p+i, code->c-i))
+         return false;
+      if (code->p[i] == ria_opcode_line)
+         n++;
+   }
+   if (n == 0)
+      return true;
+   buf_set_empty(&ctx->lines);
+   if (buf_expand(2*n, &ctx->lines))
+      pm = buf_get_ptr_usizes(&ctx->lines);
+   else
+   if (GET_ERR_CONTEXT->err != err_no_memory)
+      return false;
+   else
+      ERR_SET_NO_RET(err_none);
+   for (i=r=l=0; (pm != NULL) && (i<code->c); i+=k) {
+      if (!ria_get_command_size(&k, code->p+i, code->c-i))
+         return false;
+      if (code->p[i] != ria_opcode_line)
+         continue;
+      r += k;
+      pm[l+0] = i;
+      pm[l+1] = r;
+      l += 2;
+   }
 
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling return statement\n");
-#endif
+   /*
+    * Shorten jumps over marks
+    *
+    */
+   for (i=0; i<code->c; i+=k) {
+      p = code->p + i;
+      if (!ria_get_command_size(&k, p, code->c-i))
+         return false;
+      switch (p[0]) {
+      case ria_opcode_jif:
+      case ria_opcode_jit:
+      case ria_opcode_jmp:
+         o = (int8)p[1];
+         break;
+      case ria_opcode_jif2:
+      case ria_opcode_jit2:
+      case ria_opcode_jmp2:
+         o = (int16)((p[1] << 8) | p[2]);
+         break;
+      case ria_opcode_jif4:
+      case ria_opcode_jit4:
+      case ria_opcode_jmp4:
+         o = ria_get_offset4(p+1);
+         break;
+      default:
+         continue;
+      }
+      o = (o < 0) ? o : o+(int)k;
+      if (((int)i+o < 0) || ((usize)((int)i+o) > code->c))
+         ERR_SET(err_internal);
+      t = (usize)((int)i+o);
+      if (pm != NULL)
+         r = (t < i) ? 
+            ria_peep_removed(pm, n, i) - ria_peep_removed(pm, n, t) :
+            ria_peep_removed(pm, n, t) - ria_peep_removed(pm, n, i);
+      else
+      if (!ria_peep_count_marks(
+              &r, code->p, (t < i) ? t : i, (t < i) ? i : t))
+         return false;
+      o = (t < i) ? o+(int)r : o-(int)r;
+      o = (o < 0) ? o : o-(int)k;
+      switch (k) {
+      case 2:
+         p[1] = (byte)o;
+         break;
+      case 3:
+         p[1] = (byte)(o >> 8);
+         p[2] = (byte)(o >> 0);
+         break;
+      default:
+         p[1] = (byte)(o >> 24);
+         p[2] = (byte)(o >> 16);
+         p[3] = (byte)(o >>  8);
+         p[4] = (byte)(o >>  0);
+      }
+   }
 
    /*
-    * Extract expression script
+    * Adjust entry points
     *
     */
-   expr = *script;
-   if (!ria_find_char(&p, &expr, ';', 0))
-      return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, script->p, "; is absent");
-      return true;
+   for (k=buf_get_length(&ctx->table), 
+        p=buf_get_ptr_bytes(&ctx->table); k>0; ) {
+      j = *p;
+      if (k < j+5)
+         ERR_SET(err_internal);
+      i = (p[j+2] << 16) | (p[j+3] << 8) | p[j+4];
+      if (pm != NULL)
+         r = ria_peep_removed(pm, n, i);
+      else
+      if (!ria_peep_count_marks(&r, code->p, 0, i))
+         return false;
+      i -= r;
+      p[j+2] = (byte)(i >> 16);
+      p[j+3] = (byte)(i >>  8);
+      p[j+4] = (byte)(i >>  0);
+      k -= j + 5;
+      p += j + 5;
    }
-   expr.c = p - expr.p;
 
    /*
-    * Compile expression
+    * Turn marks into (offset, line) pairs of line table, later mark
+    * at the same offset wins
     *
     */
-   p = exec->p;
-   c = exec->c;
-   if (!ria_compile_expression(exec, &expr, ctx))
-      return false;
-   if (!ctx->ok)
-      return true;
-   if (ctx->expr_type == ria_unknown)
-      ERR_SET(err_internal);
-   script->c -= expr.p - script->p + 1;
-   script->p  = expr.p + 1;
+   for (k=l=r=0; (pm != NULL) && (k<n); k++) {
+      i = pm[k*2+0];
+      x = pm[k*2+1];
+      if (!ria_decode_varint(&u, &t, code->p+i+1, code->c-i-1))
+         return false;
+      i -= r;
+      r  = x;
+      if ((l >= 2) && (pm[l-2] == i)) {
+         pm[l-1] = u;
+         continue;
+      }
+      pm[l+0] = i;
+      pm[l+1] = u;
+      l += 2;
+   }
 
    /*
-    * Add ret command
+    * Move commands over marks
     *
     */
-   if (p != exec->p)
-      ERR_SET(err_internal);
-   c -= exec->c;
-   p += exec->c;
-   if (!ria_encode_ret(&p, &c))
-      return false;
-   exec->c = p - exec->p;
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("COMPILED: ret\n");
-   RIA_TRACE_MSG("Return statement compilation finished\n");
-#endif
-   return true;
+   for (i=j=0; i<code->c; i+=k) {
+      if (!ria_get_command_size(&k, code->p+i, code->c-i))
+         return false;
+      if (code->p[i] == ria_opcode_line)
+         continue;
+      MemMove(code->p+j, code->p+i, k);
+      j += k;
+   }
+   code->c = j;
+   if ((l >= 2) && (pm[l-2] == code->c))
+      l -= 2;
+   return buf_set_length(l, &ctx->lines);
 
 }
+#endif
 
 /*****************************************************************************/
-bool 
-   ria_compile_if(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
+bool
+   ria_optimize_code(
+      mem_blk_t*            IN OUT   code,
+      usize                 IN       room,
       ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Compiles if statement
+ * Peephole optimization of compiled module code, code may grow up to 
+ * room octets with kill commands of dead variables; function table 
+ * entry points are fixed accordingly
  *
  */
 {
 
-   static const char _else[] = "else{";
-
-   usize c, k, l;
-   byte* p;
-   mem_blk_t expr;
-   mem_blk_t xtmp;
-   byte* pjmp1 = NULL;
-   byte* pjmp2 = NULL;
-
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
-
-   /*
-    * If statement is
-    * if (<expression>) { <chunk1>...<chunkn> } else { <chunk1>...<chunkm> }
-    * or 
-    * if (<expression>) { <chunk1>...<chunkn> }
-    * Script to parse is:
-    * (<expression>) { <chunk1>...<chunkn> } else { <chunk1>...<chunkm> }
+   usize i, j, k, c, n, t, w, kn;
+   int o;
+   bool changed;
+   bool kills;
+   byte*  p;
+   byte*  q  = NULL;
+   byte*  pk = NULL;
+   const byte* pc;
+   usize* pcmd;
+   usize* plink;
+   usize* ppos;
+   usize* pkcmd;
+   usize* pklink;
+   usize* pmap;
+   buf_t  cmds;
+   buf_t  links;
+   buf_t  pos;
+   buf_t  kcmds;
+   buf_t  klinks;
+   buf_t  map;
+   bool   ret = false;
+
+   enum {
+      cleanup_cmds   = 0x01,
+      cleanup_links  = 0x02,
+      cleanup_pos    = 0x04,
+      cleanup_kcmds  = 0x08,
+      cleanup_klinks = 0x10,
+      cleanup_map    = 0x20,
+      cleanup_pk     = 0x40,
+      cleanup_q      = 0x80
+   } cleanup = 0x00;
+
+   assert(code != NULL);
+   assert(ctx  != NULL);
+
+   if (code->c > ria_mask_cmd_offset)
+      ERR_SET(err_not_supported);
+
+   /*
+    * Count commands, output is not larger than input with all jumps
+    * in 4 octets form
     *
     */
+   for (i=n=w=0; i<code->c; i+=k, n++) {
+      if (!ria_get_command_size(&k, code->p+i, code->c-i))
+         return false;
+      w += (ria_peep_is_jump(code->p[i])) ? 5 : k;
+   }
+   if (n == 0)
+      return true;
 
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling if statement\n");
-#endif
+   if (!buf_create(sizeof(usize), 0, 0, &cmds, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_cmds;
+   if (!buf_create(sizeof(usize), 0, 0, &links, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_links;
+   if (!buf_create(sizeof(usize), 0, 0, &pos, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_pos;
+   if (!buf_create(sizeof(usize), 0, 0, &kcmds, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_kcmds;
+   if (!buf_create(sizeof(usize), 0, 0, &klinks, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_klinks;
+   if (!buf_create(sizeof(usize), 0, 0, &map, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_map;
+   if (!buf_expand(n, &cmds))
+      goto exit;
+   if (!buf_expand(n, &links))
+      goto exit;
+   if (!buf_expand(n+1, &pos))
+      goto exit;
+   if (!heap_alloc((void**)&q, w+1, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_q;
+   pcmd  = buf_get_ptr_usizes(&cmds);
+   plink = buf_get_ptr_usizes(&links);
+   ppos  = buf_get_ptr_usizes(&pos);
 
    /*
-    * Find end of condition 
+    * Decode commands
     *
     */
-   expr = *script;
-   if (!ria_find_char(&p, &expr, ')', 0))
-      return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
-      return true;
+   for (i=k=0; i<code->c; i+=c, k++) {
+      if (!ria_get_command_size(&c, code->p+i, code->c-i))
+         goto exit;
+      pcmd[k]  = i;
+      plink[k] = (usize)ria_var_unknown;
    }
-   expr.c = p - expr.p + 1;
- 
+
+#ifdef USE_RIA_PROFILER
    /*
-    * Compile expression for condition
+    * Source line marks are dropped, jumps and entry points to them 
+    * go to following command
     *
     */
-   xtmp = *exec;
-   p = xtmp.p;
-   c = xtmp.c;
-   if (!ria_compile_expression(&xtmp, &expr, ctx))
-      return false;
-   if (!ctx->ok)
-      return true;
-   if (ctx->expr_type != ria_boolean)
-      ERR_SET(err_internal);
-   script->c -= expr.p - script->p;
-   script->p  = expr.p;
+   for (k=0; k<n; k++)
+      if (code->p[pcmd[k]] == ria_opcode_line)
+         pcmd[k] |= ria_cmd_dead;
+#endif
 
    /*
-    * Save pos for putting 1st jump 
+    * Resolve jump targets
     *
     */
-   if (p != xtmp.p)
-      ERR_SET(err_internal);
-   xtmp.p += xtmp.c;
-   xtmp.c  = c - xtmp.c;
-   pjmp1   = xtmp.p;
+   for (k=0; k<n; k++) {
+      i = pcmd[k] & ria_mask_cmd_offset;
+      p = code->p + i;
+      switch (p[0]) {
+      case ria_opcode_jif:
+      case ria_opcode_jit:
+      case ria_opcode_jmp:
+         o = (int8)p[1];
+         o = (o < 0) ? o : o+2;
+         break;
+      case ria_opcode_jif2:
+      case ria_opcode_jit2:
+      case ria_opcode_jmp2:
+         o = (int16)((p[1] << 8) | p[2]);
+         o = (o < 0) ? o : o+3;
+         break;
+      case ria_opcode_jif4:
+      case ria_opcode_jit4:
+      case ria_opcode_jmp4:
+         o = ria_get_offset4(p+1);
+         o = (o < 0) ? o : o+5;
+         break;
+      default:
+         continue;
+      }
+      if (((int)i+o < 0) || ((usize)((int)i+o) > code->c)) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
+      }
+      if (!ria_peep_find_cmd(&plink[k], pcmd, n, (usize)((int)i+o), code->c))
+         goto exit;
+#ifdef USE_RIA_PROFILER
+      for (; (plink[k] < n) && (pcmd[plink[k]] & ria_cmd_dead); plink[k]++);
+#endif
+   }
 
    /*
-    * Check for main branch
+    * Mark entry points
     *
     */
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling main branch\n");
+   for (k=buf_get_length(&ctx->table), 
+        p=buf_get_ptr_bytes(&ctx->table); k>0; ) {
+      j = *p;
+      if (k < j+5) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
+      }
+      c = (p[j+2] << 16) | (p[j+3] << 8) | p[j+4];
+      if (!ria_peep_find_cmd(&t, pcmd, n, c, code->c))
+         goto exit;
+#ifdef USE_RIA_PROFILER
+      for (; (t < n) && (pcmd[t] & ria_cmd_dead); t++);
 #endif
-   if ((script->c < 1) || (script->p[0] != '{')) {
-      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-      return true;
+      if (t < n)
+         pcmd[t] |= ria_cmd_entry;
+      k -= j + 5;
+      p += j + 5;
    }
-   script->p++;
-   script->c--;
+   if (!ria_peep_set_labels(pcmd, plink, n))
+      goto exit;
 
    /*
-    * Duplicated actions
+    * Rewrite until nothing changes
     *
     */
-   for (k=0; k<2; k++) {
+   do {
+      if (!ria_peep_rewrite(&changed, code->p, pcmd, plink, n))
+         goto exit;
+   } while (changed);
 
-      /*
-       * Extract branch
-       *
-       */
-      expr = *script;
-      if (!ria_find_char(&p, &expr, '}', 1))
-         return false;
-      if (p == NULL) {
-         SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-         return true;
+   /*
+    * Share slots of local variables and release dead ones; commands are
+    * renamed in copy of code, which is used together with inserted kill
+    * commands if the result fits. Lack of memory for that only leaves 
+    * kill commands out, storage for code without them is taken above
+    *
+    */
+   pc     = code->p;
+   kn     = n;
+   pkcmd  = pcmd;
+   pklink = plink;
+   pmap   = NULL;
+   kills  = heap_alloc((void**)&pk, code->c+2*ria_var_narrow, ctx->mem);
+   if (kills) {
+      cleanup |= cleanup_pk;
+      MemCpy(pk, code->p, code->c);
+      kills = ria_peep_release_vars(
+                 pk, code->c, pcmd, plink, n, 
+                 &kcmds, &klinks, &map, ctx->mem) &&
+              buf_expand(buf_get_length(&kcmds)+1, &pos);
+   }
+   if (!kills) {
+      if (GET_ERR_CONTEXT->err != err_no_memory)
+         goto exit;
+      ERR_SET_NO_RET(err_none);
+   }
+   else
+   if (buf_get_length(&kcmds) == 0)
+      kills = false;
+   else {
+      ppos   = buf_get_ptr_usizes(&pos);
+      pkcmd  = buf_get_ptr_usizes(&kcmds);
+      pklink = buf_get_ptr_usizes(&klinks);
+      if (!ria_peep_layout(&c, pk, pkcmd, pklink, ppos, 
+              buf_get_length(&kcmds)))
+         goto exit;
+      kills = (c <= room);
+      if (kills && (c > w)) {
+         kills = heap_alloc((void**)&p, c+1, ctx->mem);
+         if (!kills)
+            ERR_SET_NO_RET(err_none);
+         else {
+            if (!heap_free(q, ctx->mem)) {
+               heap_free(p, ctx->mem);
+               goto exit;
+            }
+            q = p;
+         }
       }
-      expr.c = p - expr.p;
-
-      /*  
-       * Compile branch
-       *
-       */
-      for (; expr.c>0; ) {
-         p = xtmp.p;
-         c = xtmp.c;
-         if (!ria_compile_chunk(&xtmp, &expr, ctx))
-            return false;
-         if (!ctx->ok)
-            return true;
-         if (p != xtmp.p)
-            ERR_SET(err_internal);
-         xtmp.p += xtmp.c;
-         xtmp.c  = c - xtmp.c;
+   }
+   if (kills) {
+      pc     = pk;
+      kn     = buf_get_length(&kcmds);
+      pmap   = buf_get_ptr_usizes(&map);
+   }
+   else {
+      pkcmd  = pcmd;
+      pklink = plink;
+      ppos   = buf_get_ptr_usizes(&pos);
+      if (!ria_peep_layout(&c, pc, pkcmd, pklink, ppos, kn))
+         goto exit;
+      if (c > w) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
       }
-      script->c -= expr.p - script->p + 1;
-      script->p  = expr.p + 1;
-   
-      if (k == 1)
-         break;
-
-      /*
-       * Check alternate branch
-       *
-       */
-      if (script->c < sizeof(_else)-1)
-         break;
-      if (MemCmp(script->p, _else, sizeof(_else)-1))
-         break;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("Compiling alternate branch\n");
-#endif
-      script->c -= sizeof(_else) - 1;
-      script->p += sizeof(_else) - 1;
-
-      /*
-       * Save pos for putting 2nd jump 
-       *
-       */
-      pjmp2 = xtmp.p;
-
    }
 
    /*
-    * Add 2nd jump first
+    * Emit into temporary storage
     *
     */
-   if (pjmp2 != NULL) {
-      l = xtmp.p - pjmp2;
-      c = (l > 0x7F) ? 3 : 2;
-      if (xtmp.c < c) 
-         ERR_SET(err_bad_length);
-      MemMove(pjmp2+c, pjmp2, xtmp.p-pjmp2);
-      if (!ria_encode_jump(&pjmp2, &c, l))
-         return false;
-#ifdef COMPILER_TRACE      
-      RIA_TRACE_MSG("COMPILED: jmp ");
-      RIA_TRACE_INT(l);
-      RIA_TRACE_MSG("\n");
-#endif
-      xtmp.c -= (l > 0x7F) ? 3 : 2;
-      xtmp.p += (l > 0x7F) ? 3 : 2;
+   if (!ria_peep_emit(q, pc, pkcmd, pklink, ppos, kn))
+      goto exit;
+
+#ifdef USE_RIA_PROFILER
+   /*
+    * Keep new offsets of source line marks, lack of memory for them
+    * leaves module without line table
+    *
+    */
+   if (!ria_peep_set_lines(pc, pkcmd, ppos, kn, ctx)) {
+      if (GET_ERR_CONTEXT->err != err_no_memory)
+         goto exit;
+      ERR_SET_NO_RET(err_none);
+      buf_set_empty(&ctx->lines);
    }
+#endif
 
    /*
-    * Add 1st jump then
+    * Adjust entry points
     *
     */
-   l = (pjmp2 == NULL) ? xtmp.p-pjmp1 : pjmp2-pjmp1;
-   c = (l > 0x7F) ? 3 : 2;
-   if (xtmp.c < c) 
-      ERR_SET(err_bad_length);
-   MemMove(pjmp1+c, pjmp1, xtmp.p-pjmp1);
-   if (!ria_encode_jump_if(&pjmp1, &c, false, l))
-      return false;
+   for (k=buf_get_length(&ctx->table), 
+        p=buf_get_ptr_bytes(&ctx->table); k>0; ) {
+      j = *p;
+      i = (p[j+2] << 16) | (p[j+3] << 8) | p[j+4];
+      if (!ria_peep_find_cmd(&t, pcmd, n, i, code->c))
+         goto exit;
+      i = ppos[(pmap != NULL) ? pmap[t] : t];
+      p[j+2] = (byte)(i >> 16);
+      p[j+3] = (byte)(i >>  8);
+      p[j+4] = (byte)(i >>  0);
+      k -= j + 5;
+      p += j + 5;
+   }
+
 #ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("COMPILED: jif ");
-   RIA_TRACE_INT(l);
+   RIA_TRACE_START;
+   for (k=t=0; k<kn; k++) 
+      if (!(pkcmd[k] & ria_cmd_dead))
+         t++;
+   RIA_TRACE_MSG("Peephole: size ");
+   RIA_TRACE_INT(code->c);
+   RIA_TRACE_MSG(" -> ");
+   RIA_TRACE_INT(c);
+   RIA_TRACE_MSG(", commands ");
+   RIA_TRACE_INT(n);
+   RIA_TRACE_MSG(" -> ");
+   RIA_TRACE_INT(t);
    RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif      
+
+   MemCpy(code->p, q, c);
+   code->c = c;
+   ret = true;
+
+exit:
+   if (cleanup & cleanup_q)
+      ret = heap_free(q, ctx->mem) && ret;
+   if (cleanup & cleanup_pk)
+      ret = heap_free(pk, ctx->mem) && ret;
+   if (cleanup & cleanup_map)
+      ret = buf_destroy(&map) && ret;
+   if (cleanup & cleanup_klinks)
+      ret = buf_destroy(&klinks) && ret;
+   if (cleanup & cleanup_kcmds)
+      ret = buf_destroy(&kcmds) && ret;
+   if (cleanup & cleanup_pos)
+      ret = buf_destroy(&pos) && ret;
+   if (cleanup & cleanup_links)
+      ret = buf_destroy(&links) && ret;
+   if (cleanup & cleanup_cmds)
+      ret = buf_destroy(&cmds) && ret;
+
+   /*
+    * Lack of memory for command lists leaves code as compiled; source
+    * line marks of profiler are not executable and are dropped in place
+    *
+    */
+   if (!ret && !(cleanup & cleanup_q) && 
+       (GET_ERR_CONTEXT->err == err_no_memory)) {
+      ERR_SET_NO_RET(err_none);
+#ifdef USE_RIA_PROFILER
+      ret = ria_peep_drop_lines(code, ctx);
+#else
+      ret = true;
 #endif
-   xtmp.c -= (l > 0x7F) ? 3 : 2;
-   xtmp.p += (l > 0x7F) ? 3 : 2;
+   }
+   return ret;
+
+}
+
+/******************************************************************************
+ *  Register code
+ */
+
+#ifdef USE_RIA_REGISTER_CODE
+
+/*
+ * Translation limits and marks
+ *
+ */
+enum {
+   ria_reg_depth  = 0x20,
+   ria_reg_count  = 0x100,
+   ria_reg_none   = 0x100,
+   ria_reg_target = 0x01,
+   ria_reg_entry  = 0x02
+};
+
+/*
+ * Operand kept on translation stack
+ *
+ */
+typedef struct ria_reg_opnd_s {
+   byte         b[5];
+   usize        c;
+   ria_type_t   type;
+} ria_reg_opnd_t;
+
+/*****************************************************************************/
+bool
+   ria_reg_emit(
+      buf_t*        IN OUT   out,
+      const byte*   IN       p,
+      usize         IN       c)
+/*
+ * Appends data to register code, grows storage geometrically
+ *
+ */
+{
+
+   usize l;
+
+   assert(out != NULL);
+   assert(p   != NULL);
+
+   l = buf_get_length(out);
+   if (l+c > buf_get_allocated_size(out))
+      if (!buf_expand((l+c)*2, out))
+         return false;
+   return buf_append(p, c, out);
+
+}
+
+/*****************************************************************************/
+bool
+   ria_reg_keep_stack(
+      buf_t*        IN OUT   out,
+      buf_t*        IN OUT   fixes,
+      usize         IN       fout,
+      usize         IN       ffix,
+      const byte*   IN       p,
+      usize         IN       c)
+/*
+ * Replaces register code of function emitted from fout (its jump fixes
+ * from ffix) with its stack code, preceded by the command switching
+ * executor to stack code
+ *
+ */
+{
+
+   byte b = ria_opcode_stack;
+
+   assert(out   != NULL);
+   assert(fixes != NULL);
+   assert(p     != NULL);
+
+   if (!buf_set_length(fout, out))
+      return false;
+   if (!buf_set_length(ffix, fixes))
+      return false;
+   if (!ria_reg_emit(out, &b, 1))
+      return false;
+   return ria_reg_emit(out, p, c);
+
+}
+
+/*****************************************************************************/
+bool
+   ria_reg_keep_module(
+      mem_blk_t*            IN OUT   code,
+      usize                 IN       room,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Leaves every function in stack code, when there is no memory for
+ * translation: the command switching executor to stack code is inserted
+ * in place at each entry point, jumps within functions are not affected
+ *
+ */
+{
+
+   usize i, j, k, n, c, e, last;
+   byte* p;
+   byte* q;
+
+   assert(code != NULL);
+   assert(ctx  != NULL);
+
+   for (k=buf_get_length(&ctx->table), n=0,
+        p=buf_get_ptr_bytes(&ctx->table); k>0; n++) {
+      j = *p;
+      if (k < j+5)
+         ERR_SET(err_internal);
+      k -= j + 5;
+      p += j + 5;
+   }
+   if (code->c+n > room)
+      ERR_SET(err_bad_length);
+   c = code->c + n;
 
    /*
-    * Finalize
+    * Move functions from the last one, entry point of moved function
+    * is not below the rest any more
     *
     */
-   exec->c = xtmp.p - exec->p;
+   for (last=code->c; n>0; n--) {
+      for (k=buf_get_length(&ctx->table), q=NULL, e=0,
+           p=buf_get_ptr_bytes(&ctx->table); k>0; ) {
+         j = *p;
+         i = (p[j+2] << 16) | (p[j+3] << 8) | p[j+4];
+         if ((i < last) && ((q == NULL) || (i > e))) {
+            q = p + j + 2;
+            e = i;
+         }
+         k -= j + 5;
+         p += j + 5;
+      }
+      if (q == NULL)
+         ERR_SET(err_internal);
+      MemMove(code->p+e+n, code->p+e, last-e);
+      code->p[e+n-1] = ria_opcode_stack;
+      i = e + n - 1;
+      q[0] = (byte)(i >> 16);
+      q[1] = (byte)(i >>  8);
+      q[2] = (byte)(i >>  0);
+      last = e;
+   }
+   code->c = c;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_reg_get_target(
+      usize*        OUT   target,
+      const byte*   IN    p,
+      usize         IN    pos,
+      usize         IN    c)
+/*
+ * Returns target offset of stack code jump
+ *
+ */
+{
+
+   int o;
+
+   assert(target != NULL);
+   assert(p      != NULL);
+
+   switch (p[0]) {
+   case ria_opcode_jif:
+   case ria_opcode_jit:
+   case ria_opcode_jmp:
+      o = (int8)p[1];
+      o = (o < 0) ? o : o+2;
+      break;
+   case ria_opcode_jif2:
+   case ria_opcode_jit2:
+   case ria_opcode_jmp2:
+      o = (int16)((p[1] << 8) | p[2]);
+      o = (o < 0) ? o : o+3;
+      break;
+   case ria_opcode_jif4:
+   case ria_opcode_jit4:
+   case ria_opcode_jmp4:
+      o = ria_get_offset4(p+1);
+      o = (o < 0) ? o : o+5;
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
+   if (((int)pos+o < 0) || ((usize)((int)pos+o) > c))
+      ERR_SET(err_internal);
+   *target = (usize)((int)pos+o);
    return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_compile_while(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
-      ria_compiler_ctx_t*   IN OUT   ctx)
+bool
+   ria_reg_uses_var(
+      bool*         OUT   used,
+      const byte*   IN    p,
+      usize         IN    c,
+      usize         IN    var)
 /*
- * Compiles while statement
+ * Checks whether operands refer to variable
  *
  */
 {
 
-   usize c, l;
-   byte* p;
-   mem_blk_t expr;
-   mem_blk_t xtmp;
-   byte* pexpr;
-   byte* pjump;
+   usize k;
 
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
+   assert(used != NULL);
+   assert(p    != NULL);
 
-   /*
-    * While statement is
-    * while (<expression>) { <chunk1>...<chunkn> }
-    * Script to parse is:
-    * (<expression>) { <chunk1>...<chunkn> } 
-    *
-    */
+   for (*used=false; c>0; p+=k, c-=k) {
+      if (p[0] == ria_opcode_reg)
+         k = 2;
+      else
+      if (!ria_get_command_size(&k, p, c))
+         return false;
+      if (k > c)
+         ERR_SET(err_internal);
+      if ((p[0] == ria_opcode_pushv) && (p[1] == var))
+         *used = true;
+   }
+   return true;
 
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling while statement\n");
-#endif
+}
+
+/*****************************************************************************/
+bool
+   ria_reg_translate(
+      mem_blk_t*            IN OUT   code,
+      usize                 IN       room,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Translates stack code into register code, functions having commands
+ * without register form are left in stack code, as well as functions
+ * whose register code would not leave room for the rest of code;
+ * function table entry points are fixed accordingly
+ *
+ */
+{
+
+   ria_reg_opnd_t st[ria_reg_depth];
+   byte   vtype[ria_reg_count];
+   byte   b[8];
+   usize  i, j, k, c, n, r, t, last, dst;
+   usize  fstart, fout, ffix, fleft;
+   int    o;
+   bool   used;
+   bool   fstack;
+   bool   wide;
+   const byte* p;
+   byte*  q;
+   byte*  pm;
+   usize* pmap;
+   usize* pfix;
+   unumber cpar;
+   function_fn* impl;
+   ria_type_t type;
+   buf_t  marks;
+   buf_t  map;
+   buf_t  fixes;
+   buf_t  out;
+   bool   ret = false;
+
+   enum {
+      cleanup_marks = 0x01,
+      cleanup_map   = 0x02,
+      cleanup_fixes = 0x04,
+      cleanup_out   = 0x08
+   } cleanup = 0x00;
+
+   assert(code != NULL);
+   assert(ctx  != NULL);
+
+   if (!buf_create(sizeof(byte), 0, 0, &marks, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_marks;
+   if (!buf_create(sizeof(usize), 0, 0, &map, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_map;
+   if (!buf_create(sizeof(usize), 0, 0, &fixes, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_fixes;
+   if (!buf_create(sizeof(byte), 0, 0, &out, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_out;
+   if (!buf_fill(0, 0, code->c+1, &marks))
+      goto exit;
+   if (!buf_fill(0, 0, code->c+1, &map))
+      goto exit;
+   if (!buf_expand(code->c*2+1, &out))
+      goto exit;
 
    /*
-    * Find end of condition 
+    * Mark jump targets and entry points
     *
     */
-   expr = *script;
-   if (!ria_find_char(&p, &expr, ')', 0))
-      return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
-      return true;
+   pm = buf_get_ptr_bytes(&marks);
+   for (i=0; i<code->c; i+=k) {
+      p = code->p + i;
+      if (!ria_get_command_size(&k, p, code->c-i))
+         goto exit;
+      switch (p[0]) {
+      case ria_opcode_jif:
+      case ria_opcode_jit:
+      case ria_opcode_jmp:
+      case ria_opcode_jif2:
+      case ria_opcode_jit2:
+      case ria_opcode_jmp2:
+      case ria_opcode_jif4:
+      case ria_opcode_jit4:
+      case ria_opcode_jmp4:
+         if (!ria_reg_get_target(&t, p, i, code->c))
+            goto exit;
+         pm[t] |= ria_reg_target;
+      }
+   }
+   for (k=buf_get_length(&ctx->table), fleft=0,
+        q=buf_get_ptr_bytes(&ctx->table); k>0; ) {
+      j = *q;
+      if (k < j+5) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
+      }
+      t = (q[j+2] << 16) | (q[j+3] << 8) | q[j+4];
+      if (t > code->c) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
+      }
+      if (!(pm[t] & ria_reg_entry))
+         fleft++;
+      pm[t] |= ria_reg_entry;
+      k -= j + 5;
+      q += j + 5;
    }
-   expr.c = p - expr.p + 1;
- 
-   /*
-    * Save pos to expression
-    *
-    */
-   pexpr = exec->p; 
-   
-   /*
-    * Compile expression for condition
-    *
-    */
-   xtmp = *exec;
-   p = xtmp.p;
-   c = xtmp.c;
-   if (!ria_compile_expression(&xtmp, &expr, ctx))
-      return false;
-   if (!ctx->ok)
-      return true;
-   if (ctx->expr_type != ria_boolean)
-      ERR_SET(err_internal);
-   script->c -= expr.p - script->p;
-   script->p  = expr.p;
 
    /*
-    * Save pos for putting first jump 
+    * Register code is at most twice as long, take long jumps if needed
     *
     */
-   if (p != xtmp.p)
-      ERR_SET(err_internal);
-   xtmp.p += xtmp.c;
-   xtmp.c  = c - xtmp.c;
-   pjump   = xtmp.p;
+   wide = (code->c*2 > 0x7FFF);
 
    /*
-    * Check for loop body
+    * Translate command by command, operands are kept on stack
+    * till the command consuming them. Every computed value gets
+    * its own register within a statement, so destination never
+    * overlaps with operands. Function just translated is left 
+    * in stack code if the rest of code, each function in stack code
+    * in the worst case, would not fit into room after it.
     *
     */
+   MemSet(vtype, ria_unknown, sizeof(vtype));
+   fstart = fout = ffix = 0;
+   fstack = true;
+   for (i=n=r=0, last=dst=ria_reg_none; i<code->c; i+=k) {
+      p = code->p + i;
+      if (!ria_get_command_size(&k, p, code->c-i))
+         goto exit;
+      if ((pm[i] & (ria_reg_target|ria_reg_entry)) && (n != 0))
+         goto stack_code;
+      if ((pm[i] & ria_reg_entry) && !fstack &&
+          (buf_get_length(&out) + code->c-i + fleft > room))
+         goto stack_code;
+      if (pm[i] & ria_reg_entry) {
+         MemSet(vtype, ria_unknown, ria_var_narrow);
+         fstart = i;
+         fout   = buf_get_length(&out);
+         ffix   = buf_get_length(&fixes);
+         fstack = false;
+         fleft--;
+      }
+      buf_get_ptr_usizes(&map)[i] = buf_get_length(&out);
+
+      switch (p[0]) {
+
+      /* Operands */
+      case ria_opcode_pushvs:
+      case ria_opcode_pushv:
+      case ria_opcode_pushvw:
+      case ria_opcode_pushs:
+      case ria_opcode_pushs2:
+      case ria_opcode_pushi1:
+      case ria_opcode_pushi2:
+      case ria_opcode_pushi3:
+      case ria_opcode_pushi4:
+      case ria_opcode_pushp:
+         if (n+2 > ria_reg_depth)
+            goto stack_code;
+         if (p[0] == ria_opcode_pushvs) {
+            st[n].b[0] = ria_opcode_pushv;
+            st[n].b[1] = p[1];
+            st[n].c    = 2;
+            st[n].type = vtype[p[1]];
+            n++;
+            st[n].b[0] = ria_opcode_pushs;
+            st[n].b[1] = p[2];
+            st[n].c    = 2;
+            st[n].type = ria_string;
+            n++;
+            break;
+         }
+         MemCpy(st[n].b, p, k);
+         st[n].c = k;
+         switch (p[0]) {
+         case ria_opcode_pushv:
+            st[n].type = vtype[p[1]];
+            break;
+         case ria_opcode_pushvw:
+            st[n].type = ria_unknown;
+            break;
+         case ria_opcode_pushi1:
+         case ria_opcode_pushi2:
+         case ria_opcode_pushi3:
+         case ria_opcode_pushi4:
+            st[n].type = ria_int;
+            break;
+         default:
+            st[n].type = ria_string;
+         }
+         n++;
+         break;
+
+      /* Operations */
+      case ria_opcode_neg:
+      case ria_opcode_add:
+      case ria_opcode_less:
+      case ria_opcode_more:
+      case ria_opcode_less_eq:
+      case ria_opcode_more_eq:
+      case ria_opcode_eq:
+      case ria_opcode_not_eq:
+      case ria_opcode_sub:
+         j = (p[0] == ria_opcode_neg) ? 1 : 2;
+         if (n < j) {
+            ERR_SET_NO_RET(err_internal);
+            goto exit;
+         }
+         n -= j;
+         b[0] = p[0];
+         type = st[n].type;
+         switch (p[0]) {
+         case ria_opcode_add:
+            if (type == ria_int)
+               b[0] = ria_opcode_add_i;
+            else
+            if (type == ria_string)
+               b[0] = ria_opcode_add_s;
+            else
+            if (type == ria_boolean)
+               b[0] = ria_opcode_lor_b;
+            break;
+         case ria_opcode_sub:
+            if (type == ria_int)
+               b[0] = ria_opcode_sub_i;
+            else
+            if (type == ria_boolean)
+               b[0] = ria_opcode_land_b;
+            break;
+         case ria_opcode_neg:
+            break;
+         default:
+            type = ria_boolean;
+         }
+         c = 1;
+         goto emit_result;
+
+      /* Calls */
+      case ria_opcode_callp:
+      case ria_opcode_call2p:
+      case ria_opcode_calli:
+      case ria_opcode_call2i:
+      case ria_opcode_callv:
+      case ria_opcode_call2v:
+         switch (p[0]) {
+         case ria_opcode_call2p:
+         case ria_opcode_call2i:
+         case ria_opcode_call2v:
+            t = (p[1] << 8) | p[2];
+            b[0] = (p[0] == ria_opcode_call2i) ? 
+               ria_opcode_call2i : ria_opcode_call2p;
+            b[1] = p[1];
+            b[2] = p[2];
+            c = 3;
+            break;
+         default:
+            t = p[1];
+            b[0] = (p[0] == ria_opcode_calli) ? 
+               ria_opcode_calli : ria_opcode_callp;
+            b[1] = p[1];
+            c = 2;
+         }
+         if (!ria_get_function_info(&type, &cpar, &impl, t))
+            goto exit;
+         j = (usize)cpar;
+         if (n < j) {
+            ERR_SET_NO_RET(err_internal);
+            goto exit;
+         }
+         n -= j;
+         switch (p[0]) {
+         case ria_opcode_calli:
+         case ria_opcode_call2i:
+            if (r >= ria_reg_count)
+               goto stack_code;
+            b[c++] = ria_opcode_reg;
+            b[c++] = (byte)r;
+            if (!ria_reg_emit(&out, b, c))
+               goto exit;
+            for (t=0; t<j; t++)
+               if (!ria_reg_emit(&out, st[n+t].b, st[n+t].c))
+                  goto exit;
+            last = ria_reg_none;
+            break;
+         case ria_opcode_callv:
+         case ria_opcode_call2v:
+            b[c++] = ria_opcode_pushv;
+            b[c++] = p[k-1];
+            if (!ria_reg_emit(&out, b, c))
+               goto exit;
+            for (t=0; t<j; t++)
+               if (!ria_reg_emit(&out, st[n+t].b, st[n+t].c))
+                  goto exit;
+            vtype[p[k-1]] = type;
+            last = ria_reg_none;
+            break;
+         default:
+            goto emit_result;
+         }
+         break;
+
+      emit_result:
+         /*
+          * Command with register destination, c octets of b
+          * are command itself, j operands are on stack 
+          *
+          */
+         if (r >= ria_reg_count)
+            goto stack_code;
+         dst = buf_get_length(&out) + c;
+         b[c++] = ria_opcode_reg;
+         b[c++] = (byte)r;
+         if (!ria_reg_emit(&out, b, c))
+            goto exit;
+         for (t=0; t<j; t++)
+            if (!ria_reg_emit(&out, st[n+t].b, st[n+t].c))
+               goto exit;
+         last = r;
+         st[n].b[0] = ria_opcode_reg;
+         st[n].b[1] = (byte)r;
+         st[n].c    = 2;
+         st[n].type = type;
+         n++;
+         r++;
+         break;
+
+      /* Store to variable */
+      case ria_opcode_pop:
+         if (n < 1) {
+            ERR_SET_NO_RET(err_internal);
+            goto exit;
+         }
+         n--;
+         vtype[p[1]] = st[n].type;
+         if ((st[n].b[0] == ria_opcode_pushv) && (st[n].b[1] == p[1]))
+            break;
+         if ((st[n].b[0] == ria_opcode_reg) && (st[n].b[1] == last)) {
+            /*
+             * Let the command computing value write it directly,
+             * unless the variable is its own operand 
+             *
+             */
+            q = buf_get_ptr_bytes(&out);
+            if (!ria_reg_uses_var(
+                    &used, q+dst+2, buf_get_length(&out)-dst-2, p[1]))
+               goto exit;
+            if (!used) {
+               q[dst+0] = ria_opcode_pushv;
+               q[dst+1] = p[1];
+               last = ria_reg_none;
+               break;
+            }
+         }
+         b[0] = ria_opcode_pop;
+         b[1] = ria_opcode_pushv;
+         b[2] = p[1];
+         if (!ria_reg_emit(&out, b, 3))
+            goto exit;
+         if (!ria_reg_emit(&out, st[n].b, st[n].c))
+            goto exit;
+         last = ria_reg_none;
+         break;
+
+      case ria_opcode_popw:
+         if (n < 1) {
+            ERR_SET_NO_RET(err_internal);
+            goto exit;
+         }
+         n--;
+         if ((st[n].b[0] == ria_opcode_pushvw) && (st[n].c == k) && 
+             !MemCmp(st[n].b+1, p+1, k-1))
+            break;
+         b[0] = ria_opcode_pop;
+         b[1] = ria_opcode_pushvw;
+         MemCpy(b+2, p+1, k-1);
+         if (!ria_reg_emit(&out, b, k+1))
+            goto exit;
+         if (!ria_reg_emit(&out, st[n].b, st[n].c))
+            goto exit;
+         last = ria_reg_none;
+         break;
+
+      case ria_opcode_incv:
+      case ria_opcode_decv:
+         if (!ria_reg_emit(&out, p, k))
+            goto exit;
+         vtype[p[1]] = ria_int;
+         last = ria_reg_none;
+         break;
+
+      case ria_opcode_kill:
+         if (!ria_reg_emit(&out, p, k))
+            goto exit;
+         vtype[p[1]] = ria_unknown;
+         last = ria_reg_none;
+         break;
+
+      case ria_opcode_appv:
+         if (n < 1) {
+            ERR_SET_NO_RET(err_internal);
+            goto exit;
+         }
+         n--;
+         if (!ria_reg_emit(&out, p, k))
+            goto exit;
+         if (!ria_reg_emit(&out, st[n].b, st[n].c))
+            goto exit;
+         vtype[p[1]] = ria_string;
+         last = ria_reg_none;
+         break;
+
+      /* Jumps, offsets are fixed later */
+      case ria_opcode_jif:
+      case ria_opcode_jit:
+      case ria_opcode_jif2:
+      case ria_opcode_jit2:
+      case ria_opcode_jmp:
+      case ria_opcode_jmp2:
+      case ria_opcode_jif4:
+      case ria_opcode_jit4:
+      case ria_opcode_jmp4:
+         if (!ria_reg_get_target(&t, p, i, code->c))
+            goto exit;
+         j = buf_get_length(&fixes);
+         if (!buf_expand(j+3, &fixes))
+            goto exit;
+         if (!buf_set_length(j+3, &fixes))
+            goto exit;
+         buf_get_ptr_usizes(&fixes)[j+0] = buf_get_length(&out);
+         buf_get_ptr_usizes(&fixes)[j+2] = t;
+         switch (p[0]) {
+         case ria_opcode_jmp:
+         case ria_opcode_jmp2:
+         case ria_opcode_jmp4:
+            b[0] = (wide) ? ria_opcode_jmp4 : ria_opcode_jmp2;
+            if (!ria_reg_emit(&out, b, 1))
+               goto exit;
+            break;
+         default:
+            if (n < 1) {
+               ERR_SET_NO_RET(err_internal);
+               goto exit;
+            }
+            n--;
+            if ((p[0] == ria_opcode_jif) || (p[0] == ria_opcode_jif2) ||
+                (p[0] == ria_opcode_jif4))
+               b[0] = (wide) ? ria_opcode_jif4 : ria_opcode_jif2;
+            else
+               b[0] = (wide) ? ria_opcode_jit4 : ria_opcode_jit2;
+            if (!ria_reg_emit(&out, b, 1))
+               goto exit;
+            if (!ria_reg_emit(&out, st[n].b, st[n].c))
+               goto exit;
+         }
+         buf_get_ptr_usizes(&fixes)[j+1] = buf_get_length(&out);
+         b[0] = b[1] = b[2] = b[3] = 0x00;
+         if (!ria_reg_emit(&out, b, (wide) ? 4 : 2))
+            goto exit;
+         last = ria_reg_none;
+         break;
+
+      /* Returns */
+      case ria_opcode_ret:
+         if (n < 1) {
+            ERR_SET_NO_RET(err_internal);
+            goto exit;
+         }
+         n--;
+         if (!ria_reg_emit(&out, p, 1))
+            goto exit;
+         if (!ria_reg_emit(&out, st[n].b, st[n].c))
+            goto exit;
+         last = ria_reg_none;
+         break;
+      case ria_opcode_retn:
+         if (!ria_reg_emit(&out, p, 1))
+            goto exit;
+         n = 0;
+         last = ria_reg_none;
+         break;
+
+      default:
+         goto stack_code;
+      }
+
+      /*
+       * Registers are reused statement by statement
+       *
+       */
+      if (n == 0)
+         r = 0;
+      continue;
+
+   stack_code:
+      /*
+       * Command has no register form, function is emitted
+       * as is after the command switching executor to stack code
+       *
+       */
+      for (t=fstart+1; (t < code->c) && !(pm[t] & ria_reg_entry); t++)
+         ;
+      if (!ria_reg_keep_stack(
+              &out, &fixes, fout, ffix, code->p+fstart, t-fstart))
+         goto exit;
 #ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling loop body\n");
-#endif
-   if ((script->c < 1) || (script->p[0] != '{')) {
-      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-      return true;
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("Function at ");
+      RIA_TRACE_INT(fstart);
+      RIA_TRACE_MSG(" is left in stack code\n");
+      RIA_TRACE_STOP;
+#endif      
+      n = r = 0;
+      last = dst = ria_reg_none;
+      fstack = true;
+      k = t - i;
    }
-   script->p++;
-   script->c--;
+   if (!fstack && (buf_get_length(&out) > room))
+      if (!ria_reg_keep_stack(
+              &out, &fixes, fout, ffix, code->p+fstart, code->c-fstart))
+         goto exit;
+   pmap = buf_get_ptr_usizes(&map);
+   pmap[code->c] = buf_get_length(&out);
 
    /*
-    * Extract body
+    * Fix jump offsets
     *
     */
-   expr = *script;
-   if (!ria_find_char(&p, &expr, '}', 1))
-      return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, script->p, "syntax error");
-      return true;
+   q = buf_get_ptr_bytes(&out);
+   pfix = buf_get_ptr_usizes(&fixes);
+   for (j=0; j<buf_get_length(&fixes); j+=3) {
+      o = (int)pmap[pfix[j+2]] - (int)pfix[j];
+      if (wide) {
+         q[pfix[j+1]+0] = (byte)(o >> 24);
+         q[pfix[j+1]+1] = (byte)(o >> 16);
+         q[pfix[j+1]+2] = (byte)(o >>  8);
+         q[pfix[j+1]+3] = (byte)(o >>  0);
+         continue;
+      }
+      if ((o < -0x8000) || (o > 0x7FFF)) {
+         ERR_SET_NO_RET(err_internal);
+         goto exit;
+      }
+      q[pfix[j+1]+0] = (byte)(o >> 8);
+      q[pfix[j+1]+1] = (byte)(o >> 0);
    }
-   expr.c = p - expr.p;
 
-   /*  
-    * Compile body
+   /*
+    * Adjust entry points
     *
     */
-   for (; expr.c>0; ) {
-      p = xtmp.p;
-      c = xtmp.c;
-      if (!ria_compile_chunk(&xtmp, &expr, ctx))
-         return false;
-      if (!ctx->ok)
-         return true;
-      if (p != xtmp.p)
-         ERR_SET(err_internal);
-      xtmp.p += xtmp.c;
-      xtmp.c  = c - xtmp.c;
+   for (k=buf_get_length(&ctx->table), 
+        q=buf_get_ptr_bytes(&ctx->table); k>0; ) {
+      j = *q;
+      i = pmap[(q[j+2] << 16) | (q[j+3] << 8) | q[j+4]];
+      q[j+2] = (byte)(i >> 16);
+      q[j+3] = (byte)(i >>  8);
+      q[j+4] = (byte)(i >>  0);
+      k -= j + 5;
+      q += j + 5;
    }
-   script->c -= expr.p - script->p + 1;
-   script->p  = expr.p + 1;
-   
+
+#ifdef COMPILER_TRACE      
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("Register code: size ");
+   RIA_TRACE_INT(code->c);
+   RIA_TRACE_MSG(" -> ");
+   RIA_TRACE_INT(buf_get_length(&out));
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+#endif      
+
+   c = buf_get_length(&out);
+   if (c > room) {
+      ERR_SET_NO_RET(err_bad_length);
+      goto exit;
+   }
+   MemCpy(code->p, buf_get_ptr_bytes(&out), c);
+   code->c = c;
+   ret = true;
+
+exit:
+   if (cleanup & cleanup_out)
+      ret = buf_destroy(&out) && ret;
+   if (cleanup & cleanup_fixes)
+      ret = buf_destroy(&fixes) && ret;
+   if (cleanup & cleanup_map)
+      ret = buf_destroy(&map) && ret;
+   if (cleanup & cleanup_marks)
+      ret = buf_destroy(&marks) && ret;
+
    /*
-    * Add 1st jump
+    * Lack of memory leaves all functions in stack code
     *
     */
-   l = xtmp.p - pjump + 3;
-   c = (l > 0x7F) ? 3 : 2;
-   if (xtmp.c < c) 
-      ERR_SET(err_bad_length);
-   MemMove(pjump+c, pjump, xtmp.p-pjump);
-   if (!ria_encode_jump_if(&pjump, &c, false, l))
-      return false;
+   if (!ret && (GET_ERR_CONTEXT->err == err_no_memory)) {
+      ERR_SET_NO_RET(err_none);
+      ret = ria_reg_keep_module(code, room, ctx);
 #ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("COMPILED: jif ");
-   RIA_TRACE_INT(l);
-   RIA_TRACE_MSG("\n");
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("Register code: no memory, module is left in stack code\n");
+      RIA_TRACE_STOP;
+#endif      
+   }
+   return ret;
+
+}
+
 #endif
-   xtmp.c -= (l > 0x7F) ? 3 : 2;
-   xtmp.p += (l > 0x7F) ? 3 : 2;
 
-   /*
-    * Add 2nd jump
-    *
-    */
-   l = pexpr - xtmp.p;
-   c = 3;
-   if (xtmp.c < c) 
-      ERR_SET(err_bad_length);
-   p = xtmp.p;
-   if (!ria_encode_jump(&p, &c, l))
+
+/******************************************************************************
+ *  Parallel compiler
+ */
+
+#ifdef USE_RIA_PARALLEL_COMPILE
+
+/*
+ * Default number of workers, including calling thread; number of jobs
+ * collected before they are compiled and linked; code buffer of worker
+ * is twice as long as function body plus slack
+ *
+ */
+enum {
+   ria_compile_workers = 4,
+   ria_compile_narrow  = 0x100,
+   ria_compile_batch   = 0x40,
+   ria_compile_slack   = 0x20
+};
+
+/*
+ * Function compilation job, jobs are kept in byte buffer one by one
+ *
+ */
+typedef struct ria_compile_job_s {
+   const byte*   pbody;                     /* Function body                 */
+   usize         cbody;                     /* Size of function body         */
+   usize         entry;                     /* Offset of table entry         */
+   usize         globals;                   /* Number of visible globals     */
+   byte*         pcode;                     /* Compiled code                 */
+   usize         ccode;                     /* Size of compiled code         */
+   bool          inplace;                   /* Code is compiled into module  */
+   byte**        pstrs;                     /* String constants added        */
+   usize*        cstrs;                     /* Sizes of string constants     */
+   usize         nstrs;                     /* Number of string constants    */
+   usize         seed;                      /* Number of strings preloaded   */
+   bool          done;                      /* Completed without failures    */
+   bool          ok;                        /* Compiled without errors       */
+   const byte*   perror;                    /* Compilation error position    */
+   const char*   errmsg;                    /* Compilation error message     */
+} ria_compile_job_t;
+
+/*
+ * Jobs shared between workers
+ *
+ */
+typedef struct ria_compile_pool_s {
+   generic_mutex_t       mutex;             /* Sync mutex                    */
+   ria_compiler_ctx_t*   master;            /* Module compiler context       */
+   ria_compile_job_t*    jobs;              /* Jobs                          */
+   usize                 count;             /* Number of jobs                */
+   usize                 next;              /* Next job to take              */
+   usize                 last;              /* End of jobs to take           */
+   usize                 seed;              /* Number of strings to preload  */
+   usize                 room;              /* Size of module code buffer    */
+} ria_compile_pool_t;
+
+/*
+ * Compilation worker
+ *
+ */
+typedef struct ria_compile_worker_s {
+   ria_compile_pool_t*   pool;              /* Shared jobs                   */
+   ria_compiler_ctx_t    ctx;               /* Own compiler context          */
+   mem_blk_t             code;              /* Code buffer                   */
+   ria_papi_thread_t     thread;            /* Worker thread                 */
+   bool                  started;           /* Thread was started            */
+} ria_compile_worker_t;
+
+/*****************************************************************************/
+bool
+   ria_add_compile_job(
+      const mem_blk_t*      IN       body,
+      usize                 IN       entry,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Adds function to be compiled by workers
+ *
+ */
+{
+
+   usize c;
+   ria_compile_job_t* job;
+
+   assert(body != NULL);
+   assert(ctx  != NULL);
+
+   c = buf_get_length(&ctx->jobs);
+   if (!buf_expand(c+sizeof(*job), &ctx->jobs))
       return false;
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("COMPILED: jmp ");
-   RIA_TRACE_INT(l);
-   RIA_TRACE_MSG("\n");
-#endif
-   xtmp.c -= 3;
-   xtmp.p += 3;
+   job = (ria_compile_job_t*)(buf_get_ptr_bytes(&ctx->jobs) + c);
+   MemSet(job, 0, sizeof(*job));
+   job->pbody   = body->p;
+   job->cbody   = body->c;
+   job->entry   = entry;
+   job->globals = buf_get_length(&ctx->globalp);
+   return buf_set_length(c+sizeof(*job), &ctx->jobs);
 
-   /*
-    * Finalize
-    *
-    */
-   exec->c = xtmp.p - exec->p;
-   return true;
+}
+
+/*****************************************************************************/
+bool
+   ria_drop_compile_job(
+      ria_compile_job_t*   IN OUT   job,
+      heap_ctx_t*          IN OUT   mem)
+/*
+ * Frees code and strings kept by job
+ *
+ */
+{
+
+   bool ret = true;
+
+   assert(job != NULL);
+
+   if ((job->pcode != NULL) && !job->inplace)
+      ret = heap_free(job->pcode, mem) && ret;
+   if (job->pstrs != NULL)
+      ret = heap_free(job->pstrs, mem) && ret;
+   job->pcode   = NULL;
+   job->pstrs   = NULL;
+   job->inplace = false;
+   return ret;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_compile_func(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
-      bool                  IN       ignore_ret,
-      ria_compiler_ctx_t*   IN OUT   ctx)
+bool
+   ria_run_compile_job(
+      ria_compile_job_t*          IN OUT   job,
+      usize                       IN       seed,
+      const ria_compiler_ctx_t*   IN       master,
+      ria_compiler_ctx_t*         IN OUT   ctx,
+      const mem_blk_t*            IN       code)
 /*
- * Compiles predefined function call
+ * Compiles function in own context, which gets globals declared before
+ * the function and first seed strings of module compiler context; code
+ * is left in code buffer
  *
  */
 {
 
-   usize c, i, j;
-   byte* p;
-   mem_blk_t eseq;
-   mem_blk_t expr;
-   mem_blk_t xtmp;
+   usize i, c;
+   mem_blk_t te;
+   mem_blk_t ts;
+   byte** pp;
+   usize* pc;
 
+   assert(job    != NULL);
+   assert(master != NULL);
    assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
+   assert(code   != NULL);
 
    /*
-    * Check for predefined function
+    * Globals are never removed while module is compiled, so jobs
+    * taken in order just add ones declared since previous job
     *
     */
-   for (j=0; j<sizeof(_func_lex)/sizeof(_func_lex[0]); j++) {
-      if (script->c < _func_lex[j].info.c) 
-         continue;
-      if (MemCmp(_func_lex[j].info.p, script->p, _func_lex[j].info.c)) 
-         continue;
-      /* '(' shall remain */
-      script->p += _func_lex[j].info.c - 1;
-      script->c -= _func_lex[j].info.c - 1;
-      break;
-   }
-   if (j == sizeof(_func_lex)/sizeof(_func_lex[0])) {
-      SET_COMPILE_ERROR(ctx, script->p, "unknown function");
-      return true;
+   if (buf_get_length(&ctx->globalp) > job->globals) {
+      buf_set_empty(&ctx->globalp);
+      buf_set_empty(&ctx->globalc);
+      if (!ria_hash_reset(&ctx->globalh))
+         return false;
    }
+   pp = buf_get_ptr_ptrs(&master->globalp);
+   pc = buf_get_ptr_usizes(&master->globalc);
+   for (i=buf_get_length(&ctx->globalp); i<job->globals; i++)
+      if (!ria_create_var(
+              &c, 
+              pp[i], 
+              pc[i] & ria_mask_var_name_len, 
+              (pc[i] & ria_mask_var_type) >> ria_shift_var_type,
+              true,
+              ctx))
+         return false;
 
    /*
-    * Function call is:
-    * name(<expression1>, ... <expressionn>) ';'{0,}
-    * Script to parse is:
-    * (<expression1>, ... <expressionn>) ';'{0,}
+    * Load strings
     *
     */
-
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("Compiling function ");
-   RIA_TRACE_STR(_func_lex[j].info.p, _func_lex[j].info.c-1);
-   RIA_TRACE_MSG("\n");
-#endif
+   buf_set_empty(&ctx->strp);
+   buf_set_empty(&ctx->strc);
+   if (!ria_hash_reset(&ctx->strh))
+      return false;
+   pp = buf_get_ptr_ptrs(&master->strp);
+   pc = buf_get_ptr_usizes(&master->strc);
+   for (i=0; i<seed; i++)
+      if (!ria_append_string(&c, pp[i], pc[i], ctx))
+         return false;
 
    /*
-    * Find end of function call
+    * Compile
     *
     */
-   eseq = *script;
-   if (!ria_find_char(&p, &eseq, ')', 0))
+   if (!ria_drop_compile_job(job, ctx->mem))
       return false;
-   if (p == NULL) {
-      SET_COMPILE_ERROR(ctx, script->p, "unterminated expression");
+   ctx->ok     = true;
+   ctx->pstart = master->pstart;
+#ifdef USE_RIA_PROFILER
+   ctx->psrclines = master->psrclines;
+   ctx->csrclines = master->csrclines;
+#endif
+   ts.p = (byte*)job->pbody;
+   ts.c = job->cbody;
+   te.p = code->p;
+   te.c = code->c;
+   if (!ria_compile_script(&te, &ts, ctx))
+      return false;
+   job->ok = ctx->ok;
+   if (!ctx->ok) {
+      job->perror = ctx->perror;
+      job->errmsg = ctx->errmsg;
       return true;
    }
-   eseq.c = p - eseq.p;
+   if (ts.p != job->pbody+job->cbody) 
+      ERR_SET(err_internal);
 
    /*
-    * Iterate thru expressions
+    * Keep strings added to pool
     *
     */
-   if (eseq.p[0] != '(')
-      ERR_SET(err_internal);
-   eseq.p++;
-   eseq.c--;
-   xtmp = *exec;
-   for (i=0; eseq.c>0; ) {
-
-      /* 
-       * Extract expression
-       *
-       */
-      if (!ria_find_char(&p, &eseq, ',', 0))
+   job->pcode = te.p;
+   job->ccode = te.c;
+   job->seed  = seed;
+   job->nstrs = buf_get_length(&ctx->strp) - seed;
+   if (job->nstrs > 0) {
+      if (!heap_alloc(
+              (void**)&job->pstrs, 
+              job->nstrs * (sizeof(byte*) + sizeof(usize)), 
+              ctx->mem))
          return false;
-      if (p == NULL) 
-         expr = eseq;
-      else {
-         expr.p = eseq.p;
-         expr.c = p - eseq.p;
-      }
+      job->cstrs = (usize*)(job->pstrs + job->nstrs);
+      MemCpy(
+         job->pstrs, 
+         buf_get_ptr_ptrs(&ctx->strp) + seed, 
+         job->nstrs * sizeof(byte*));
+      MemCpy(
+         job->cstrs, 
+         buf_get_ptr_usizes(&ctx->strc) + seed, 
+         job->nstrs * sizeof(usize));
+   }
+   return true;
 
-      /* 
-       * Compile expression
-       *
-       */
-      p = xtmp.p;
-      c = xtmp.c;
-      if (!ria_compile_expression(&xtmp, &expr, ctx))
-         return false;
-      if (!ctx->ok)
-         return true;
-      if (ctx->expr_type == ria_unknown)
-         ERR_SET(err_internal);
-      eseq.c -= expr.p - eseq.p;
-      eseq.p  = expr.p;
-      if (eseq.c != 0) {
-         if (eseq.p[0] != ',')
-            ERR_SET(err_internal);
-         eseq.c--;
-         eseq.p++;
-      }          
+}
 
-      /* 
-       * Advance compilation pointer
-       *
-       */
-      if (p != xtmp.p)
-         ERR_SET(err_internal);
-      xtmp.p += xtmp.c;
-      xtmp.c  = c - xtmp.c;
-      i++;
+/*****************************************************************************/
+void
+   ria_compile_worker(
+      void*   IN OUT   arg)
+/*
+ * Takes jobs until all are taken; code buffer is sized to function body
+ * and compiled code is copied, job which fails here is compiled again
+ * while linking
+ *
+ */
+{
 
-   }
+   ria_compile_worker_t* worker = arg;
+   ria_compile_pool_t*   pool   = worker->pool;
+   ria_compile_job_t*    job;
+   heap_ctx_t*           mem    = worker->ctx.mem;
+   usize c;
+   byte* p;
 
-   /*
-    * Check parameters 
-    *
-    */
-   if (i != _func_lex[j].params) {
-      SET_COMPILE_ERROR(ctx, script->p, "wrong number of parameters");
-      return true;
+   for (;;) {
+      sync_mutex_lock(&pool->mutex);
+      job = (pool->next < pool->last) ? pool->jobs + pool->next++ : NULL;
+      sync_mutex_unlock(&pool->mutex);
+      if (job == NULL)
+         break;
+      job->done = false;
+      c = job->cbody*2 + ria_compile_slack;
+      if (c > pool->room)
+         c = pool->room;
+      if (worker->code.c < c) {
+         if (worker->code.p != NULL)
+            if (!heap_free(worker->code.p, mem))
+               continue;
+         worker->code.p = NULL;
+         worker->code.c = 0;
+         if (!heap_alloc((void**)&worker->code.p, c, mem))
+            continue;
+         worker->code.c = c;
+      }
+      if (!ria_run_compile_job(
+              job, pool->seed, pool->master, &worker->ctx, &worker->code))
+         continue;
+      if (job->ok) {
+         if (!heap_alloc((void**)&p, job->ccode+1, mem)) {
+            job->pcode = NULL;
+            continue;
+         }
+         MemCpy(p, job->pcode, job->ccode);
+         job->pcode = p;
+      }
+      job->done = true;
    }
 
-   /*
-    * Advance parsing pointer
-    *
-    */
-   script->c -= eseq.p - script->p + 1;
-   script->p  = eseq.p + 1;
+}
 
-   /*
-    * Add call command
-    *
-    */
-   c = xtmp.c;
-   p = xtmp.p;
-   if (!ria_encode_call(&p, &c, ignore_ret, _func_lex[j].info.t))
-      return false;
-   exec->c = p - exec->p;
-   ctx->expr_type = _func_lex[j].ret;
-#ifdef COMPILER_TRACE      
-   RIA_TRACE_MSG("COMPILED: call ");
-   if (xtmp.p[0] & 0x01) {
-      RIA_TRACE_INT((p[-2] << 8)|p[-1]);
+/*****************************************************************************/
+bool
+   ria_run_compile_pool(
+      ria_compile_pool_t*     IN OUT   pool,
+      ria_compile_worker_t*   IN OUT   workers,
+      usize                   IN       count)
+/*
+ * Runs workers until all jobs are taken, current thread is a worker 
+ * as well; if thread can't be started the rest of workers take its jobs
+ *
+ */
+{
+
+   usize k;
+   bool ret = true;
+
+   assert(pool    != NULL);
+   assert(workers != NULL);
+   assert(count   >  0);
+
+   for (k=1; k<count; k++) 
+      workers[k].started = 
+         ria_papi_thread_create(
+            &workers[k].thread, ria_compile_worker, workers+k);
+   ria_compile_worker(workers);
+   for (k=1; k<count; k++) 
+      if (workers[k].started) 
+         ret = ria_papi_thread_join(&workers[k].thread) && ret;
+   return ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_run_compile_batch(
+      ria_compile_pool_t*     IN OUT   pool,
+      usize*                  IN OUT   size,
+      ria_compile_worker_t*   IN OUT   workers,
+      usize                   IN       count)
+/*
+ * Compiles next batch of jobs. String index size depends on strings of
+ * functions before, so workers use own pools in growing batches until
+ * all one-octet indices are assigned; then the rest of jobs is compiled
+ * with these strings preloaded, others become wide as in module pool
+ *
+ */
+{
+
+   assert(pool    != NULL);
+   assert(size    != NULL);
+   assert(workers != NULL);
+
+   pool->next = pool->last;
+   if (buf_get_length(&pool->master->strp) < ria_compile_narrow) {
+      pool->seed = 0;
+      pool->last = pool->next + *size;
+      if (pool->last > pool->count)
+         pool->last = pool->count;
+      *size *= 2;
    }
    else {
-      RIA_TRACE_INT(p[-1]);
+      pool->seed = ria_compile_narrow;
+      pool->last = pool->count;
    }
-   RIA_TRACE_MSG("\n");
-   RIA_TRACE_MSG("Function call compilation finished\n");
-#endif
-
-   /*
-    * ';' could be at the end
-    *
-    */
-   if (script->c > 0) 
-      if (script->p[0] == ';') {
-         script->c--;
-         script->p++;
-      }
-   return true;
+   return ria_run_compile_pool(pool, workers, count);
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_compile_chunk(                                            
-      mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
+bool
+   ria_link_compile_job(
+      bool*                 OUT      fits,
+      ria_compile_job_t*    IN OUT   job,
+      buf_t*                IN OUT   map,
       ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Compiles chunk of scenario script into executable representation 
+ * Adds strings of compiled function to module pool and patches code,
+ * fails to fit if some index needs other command size
  *
  */
 {
 
-   usize i;
-
-   assert(ctx    != NULL);
-   assert(script != NULL);
-   assert(exec   != NULL);
-   
-   /*
-    * Initial state. Expected chunks are:
-    *  - assignment chunk
-    *  - statement chunk
-    *  - predefined function call chunk
-    *
-    */
-
-   /*
-    * Check for assignment chunk '$'
-    *
-    */
-   if (script->c < 1)
-      ERR_SET(err_bad_length);
-   switch (script->p[0]) {
-   case '$':
-      return ria_compile_assignment(exec, script, ctx);
-   }
-   
+   usize i, j, k;
+   byte* p;
+   usize* pm;
+   bool added;
+
+   assert(fits != NULL);
+   assert(job  != NULL);
+   assert(map  != NULL);
+   assert(ctx  != NULL);
+
    /*
-    * Check for statements 
+    * Map strings in order of appearance, as serial compiler does
     *
     */
-   for (i=0; i<sizeof(_lex)/sizeof(_lex[0]); i++) {
-   
-      if (script->c < _lex[i].c) 
-         continue;
-      if (MemCmp(_lex[i].p, script->p, _lex[i].c)) 
-         continue;
+   if (!buf_expand(job->nstrs, map))
+      return false;
+   pm = buf_get_ptr_usizes(map);
+   for (j=0; j<job->nstrs; j++)
+      if (!ria_add_string(&added, pm+j, job->pstrs[j], job->cstrs[j], ctx))
+         return false;
 
-      /* '(' shall remain */
-      script->p += _lex[i].c - 1;
-      script->c -= _lex[i].c - 1;
-      switch (_lex[i].t) {
-      case ria_lex_return:
-         return ria_compile_return(exec, script, ctx);
-      case ria_lex_if:
-         return ria_compile_if(exec, script, ctx);
-      case ria_lex_while:
-         return ria_compile_while(exec, script, ctx);
+   /*
+    * Check command sizes
+    *
+    */
+   *fits = false;
+   for (i=0, p=job->pcode; i<job->ccode; i+=k) {
+      if (!ria_get_command_size(&k, p+i, job->ccode-i))
+         return false;
+      switch (p[i]) {
+      case ria_opcode_pushs:
+         j = p[i+1];
+         break;
+      case ria_opcode_pushvs:
+         j = p[i+2];
+         break;
+      case ria_opcode_pushs2:
+         j = (p[i+1] << 8) | p[i+2];
+         break;
       default:
-         ERR_SET(err_internal);
+         continue;
       }
-
+      if (j >= job->seed+job->nstrs)
+         ERR_SET(err_internal);
+      if (j >= job->seed)
+         j = pm[j-job->seed];
+      if ((j > 0xFF) != (p[i] == ria_opcode_pushs2))
+         return true;
+      if (j > 0xFFFF)
+         return true;
    }
 
    /*
-    * Should be predefined function
+    * Patch references
     *
     */
-   return ria_compile_func(exec, script, true, ctx);
+   for (i=0; i<job->ccode; i+=k) {
+      if (!ria_get_command_size(&k, p+i, job->ccode-i))
+         return false;
+      switch (p[i]) {
+      case ria_opcode_pushs:
+         if (p[i+1] >= job->seed)
+            p[i+1] = (byte)pm[p[i+1]-job->seed];
+         break;
+      case ria_opcode_pushvs:
+         if (p[i+2] >= job->seed)
+            p[i+2] = (byte)pm[p[i+2]-job->seed];
+         break;
+      case ria_opcode_pushs2:
+         j = (p[i+1] << 8) | p[i+2];
+         if (j >= job->seed)
+            j = pm[j-job->seed];
+         p[i+1] = (byte)(j >> 8);
+         p[i+2] = (byte)(j >> 0);
+         break;
+      }
+   }
+   *fits = true;
+   return true;
 
 }
 
 /*****************************************************************************/
-bool 
-   ria_compile_script(                                            
+bool
+   ria_link_compile_jobs(
       mem_blk_t*            IN OUT   exec,
-      mem_blk_t*            IN OUT   script,
+      usize*                IN OUT   offset,
       ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Compiles single scenario script 
+ * Compiles collected functions on worker threads and links results
+ * in order, so code and strings are the same as of serial compiler;
+ * jobs are freed as they are linked. Workers which can't be created 
+ * are left out, down to compiling on calling thread only, and job 
+ * failed on worker is compiled again right into module code
  *
  */
 {
 
-   usize i;
+   usize i, j, k, n, e, w;
+   ria_compile_pool_t    pool;
+   ria_compile_worker_t* workers = NULL;
+   ria_compile_job_t*    job;
    mem_blk_t te;
+   buf_t map;
+   byte* p;
+   bool  ok, fits;
+   const byte* perror;
+   const char* errmsg;
+   bool  ret = false;
+
+   enum {
+      cleanup_mutex   = 0x01,
+      cleanup_workers = 0x02,
+      cleanup_map     = 0x04
+   } cleanup = 0x00;
 
-   assert(ctx    != NULL);
-   assert(script != NULL);
    assert(exec   != NULL);
+   assert(offset != NULL);
+   assert(ctx    != NULL);
 
-   /*
-    * Initialize context 
-    *
-    */
-   buf_set_empty(&ctx->varp);
-   buf_set_empty(&ctx->varc);
+   n = buf_get_length(&ctx->jobs) / sizeof(*job);
+   if (n == 0)
+      return true;
+   pool.master = ctx;
+   pool.jobs   = (ria_compile_job_t*)buf_get_ptr_bytes(&ctx->jobs);
+   pool.count  = n;
+   pool.next   = 0;
+   pool.last   = 0;
+   pool.seed   = 0;
+   pool.room   = exec->c;
+   w = (ctx->workers < n) ? ctx->workers : n;
 
    /*
-    * Compile chunk by chunk
+    * Create workers
     *
     */
-   for (i=0; script->c>0; i+=te.c) {
-      te.p = exec->p + i;
-      te.c = exec->c - i;
-      if (!ria_compile_chunk(&te, script, ctx))
-         return false;
-      if (!ctx->ok)
-         return true;
+   sync_mutex_create(&pool.mutex);
+   cleanup |= cleanup_mutex;
+   if (!buf_create(sizeof(usize), 0, 0, &map, ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_map;
+   if (!heap_alloc((void**)&workers, w*sizeof(*workers), ctx->mem))
+      goto exit;
+   else
+      cleanup |= cleanup_workers;
+   MemSet(workers, 0, w*sizeof(*workers));
+   for (k=0; k<w; k++) {
+      workers[k].pool = &pool;
+      if (!ria_compiler_create(&workers[k].ctx, ctx->mem))
+         break;
+   }
+   if (k < w) {
+      w = k;
+      if (w == 0)
+         goto exit;
+      ERR_SET_NO_RET(err_none);
    }
 
    /*
-    * Finalize
+    * Compile and link in order, first compilation error takes 
+    * precedence over error found while scanning module
     *
     */
-   if ((i == 0) || (exec->p[i-1] != ria_opcode_ret)) {
-      if (exec->c < i+1)
-         ERR_SET(err_bad_length);
-      exec->p[i] = ria_opcode_retn;
-      i++;   
+   ok     = ctx->ok;
+   perror = ctx->perror;
+   errmsg = ctx->errmsg;
+   for (j=0, e=w, i=*offset; j<n; j++) {
+      job = pool.jobs + j;
+      if (j == pool.last)
+         if (!ria_run_compile_batch(&pool, &e, workers, w))
+            goto exit;
+      fits = false;
+      if (job->done && job->ok)
+         if (!ria_link_compile_job(&fits, job, &map, ctx))
+            goto exit;
+
+      /*
+       * Index sizes differ from serial compiler ones, compile the rest
+       * of jobs with preloaded strings if possible
+       *
+       */
+      if (job->done && job->ok && !fits)
+         if ((pool.seed == 0) && 
+             (buf_get_length(&ctx->strp) >= ria_compile_narrow)) {
+            pool.last = j;
+            if (!ria_run_compile_batch(&pool, &e, workers, w))
+               goto exit;
+            if (job->done && job->ok)
+               if (!ria_link_compile_job(&fits, job, &map, ctx))
+                  goto exit;
+         }
+
+      /*
+       * Otherwise, or if job failed on worker, compile with whole pool
+       * right into module code
+       *
+       */
+      if (!job->done || (job->ok && !fits)) {
+         te.p = exec->p + i;
+         te.c = exec->c - i;
+         job->done = 
+            ria_run_compile_job(
+               job, 
+               buf_get_length(&ctx->strp), 
+               ctx, 
+               &workers[0].ctx, 
+               &te);
+         job->inplace = true;
+         if (job->done && job->ok) {
+            if (!ria_link_compile_job(&fits, job, &map, ctx))
+               goto exit;
+            if (!fits) {
+               ERR_SET_NO_RET(err_internal);
+               goto exit;
+            }
+         }
+      }
+      if (!job->done)
+         goto exit;
+      if (!job->ok) {
+         ok     = false;
+         perror = job->perror;
+         errmsg = job->errmsg;
+         break;
+      }
+      if (exec->c-i < job->ccode) {
+         ERR_SET_NO_RET(err_bad_length);
+         goto exit;
+      }
+      if (!job->inplace)
+         MemCpy(exec->p+i, job->pcode, job->ccode);
+      if (!ria_drop_compile_job(job, ctx->mem))
+         goto exit;
+      p = buf_get_ptr_bytes(&ctx->table) + job->entry;
+      p += *p + 2;
+      p[0] = (byte)(i >> 16);
+      p[1] = (byte)(i >>  8);
+      p[2] = (byte)(i >>  0);
+      i += job->ccode;
    }
-   exec->c = i;
-   return true;
+   ctx->ok     = ok;
+   ctx->perror = perror;
+   ctx->errmsg = errmsg;
+   *offset = i;
+   ret = true;
+
+exit:
+   if (cleanup & cleanup_workers) {
+      for (k=0; k<w; k++) {
+         /*
+          * Folded strings may be referenced by module pool now
+          *
+          */
+         n = buf_get_length(&ctx->strf);
+         j = buf_get_length(&workers[k].ctx.strf);
+         if (j > 0) {
+            if (buf_expand(n+j, &ctx->strf)) {
+               MemCpy(
+                  buf_get_ptr_ptrs(&ctx->strf) + n,
+                  buf_get_ptr_ptrs(&workers[k].ctx.strf),
+                  j * sizeof(byte*));
+               ret = buf_set_length(n+j, &ctx->strf) && ret;
+               buf_set_empty(&workers[k].ctx.strf);
+            }
+            else
+               ret = false;
+         }
+         if (workers[k].code.p != NULL)
+            ret = heap_free(workers[k].code.p, ctx->mem) && ret;
+         ret = ria_compiler_destroy(&workers[k].ctx) && ret;
+      }
+      ret = heap_free(workers, ctx->mem) && ret;
+   }
+   for (j=pool.count; j>0; j--)
+      ret = ria_drop_compile_job(pool.jobs + j - 1, ctx->mem) && ret;
+   buf_set_empty(&ctx->jobs);
+   if (cleanup & cleanup_map)
+      ret = buf_destroy(&map) && ret;
+   if (cleanup & cleanup_mutex)
+      sync_mutex_destroy(&pool.mutex);
+   return ret;
 
 }
 
+#endif
 
 /******************************************************************************
  *  Async operation context
@@ -2544,7 +7733,15 @@ enum {
    cf_ria_compiler_strc    = 0x08,
    cf_ria_compiler_table   = 0x10,
    cf_ria_compiler_globalp = 0x20,
-   cf_ria_compiler_globalc = 0x40
+   cf_ria_compiler_globalc = 0x40,
+   cf_ria_compiler_globalh = 0x80,
+   cf_ria_compiler_varh    = 0x100,
+   cf_ria_compiler_strh    = 0x200,
+   cf_ria_compiler_strf    = 0x400,
+   cf_ria_compiler_tableh  = 0x800,
+   cf_ria_compiler_tablek  = 0x1000,
+   cf_ria_compiler_jobs    = 0x2000,
+   cf_ria_compiler_lines   = 0x4000
 };
 
 /*****************************************************************************/
@@ -2592,6 +7789,51 @@ bool
       goto failed;
    else
       ctx->cleanup |= cf_ria_compiler_table;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->globalh, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_globalh;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->varh, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_varh;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->strh, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_strh;
+   if (!buf_create(sizeof(byte*), 0, 0, &ctx->strf, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_strf;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->tableh, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_tableh;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->tablek, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_tablek;
+#ifdef USE_RIA_PARALLEL_COMPILE
+   if (!buf_create(sizeof(byte), 0, 0, &ctx->jobs, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_jobs;
+   ctx->workers = ria_compile_workers;
+#endif
+#ifdef USE_RIA_PROFILER
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->srclines, ctx->mem))
+      goto failed;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->lines, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_compiler_lines;
+#endif
+   if (!ria_hash_reset(&ctx->globalh))
+      goto failed;
+   if (!ria_hash_reset(&ctx->varh))
+      goto failed;
+   if (!ria_hash_reset(&ctx->strh))
+      goto failed;
    return true;
 
 failed:
@@ -2628,6 +7870,30 @@ bool
       ret = buf_destroy(&ctx->globalc) && ret;
    if (ctx->cleanup & cf_ria_compiler_table)
       ret = buf_destroy(&ctx->table) && ret;
+   if (ctx->cleanup & cf_ria_compiler_globalh)
+      ret = buf_destroy(&ctx->globalh) && ret;
+   if (ctx->cleanup & cf_ria_compiler_varh)
+      ret = buf_destroy(&ctx->varh) && ret;
+   if (ctx->cleanup & cf_ria_compiler_strh)
+      ret = buf_destroy(&ctx->strh) && ret;
+   if (ctx->cleanup & cf_ria_compiler_tableh)
+      ret = buf_destroy(&ctx->tableh) && ret;
+   if (ctx->cleanup & cf_ria_compiler_tablek)
+      ret = buf_destroy(&ctx->tablek) && ret;
+#ifdef USE_RIA_PARALLEL_COMPILE
+   if (ctx->cleanup & cf_ria_compiler_jobs)
+      ret = buf_destroy(&ctx->jobs) && ret;
+#endif
+#ifdef USE_RIA_PROFILER
+   if (ctx->cleanup & cf_ria_compiler_lines) {
+      ret = buf_destroy(&ctx->srclines) && ret;
+      ret = buf_destroy(&ctx->lines) && ret;
+   }
+#endif
+   if (ctx->cleanup & cf_ria_compiler_strf) {
+      ret = ria_free_folded_strings(ctx) && ret;
+      ret = buf_destroy(&ctx->strf) && ret;
+   }
 
    ctx->cleanup = 0;
    return ret;
@@ -2637,9 +7903,11 @@ bool
 /*****************************************************************************/
 bool 
    ria_canonize_script(                                            
-      mem_blk_t*   IN OUT   script)
+      mem_blk_t*            IN OUT   script,
+      ria_compiler_ctx_t*   IN OUT   ctx)
 /*
- * Converts scenario script into canonic form
+ * Converts scenario script into canonic form; with profiler it keeps
+ * canonic offsets where source lines start
  *
  */
 {
@@ -2649,6 +7917,13 @@ bool
    byte *q;
 
    assert(script != NULL);
+   assert(ctx    != NULL);
+
+#ifdef USE_RIA_PROFILER
+   buf_set_empty(&ctx->srclines);
+   if (!buf_fill(0, 0, 1, &ctx->srclines))
+      return false;
+#endif
 
    /*
     * Remove blanks
@@ -2658,6 +7933,12 @@ bool
     */
    q = script->p; 
    for (i=0, quoted=escaped=comment=false; i<script->c; i++) {
+#ifdef USE_RIA_PROFILER
+      if ((i > 0) && (script->p[i-1] == '\n'))
+         if (!buf_fill(
+                 q-script->p, buf_get_length(&ctx->srclines), 1, &ctx->srclines))
+            return false;
+#endif
       if (comment) {
          switch (script->p[i]) {
          case '\r':
@@ -2715,30 +7996,72 @@ bool
  */
 {
 
+   return ria_compile_script_update(exec, script, NULL, ctx);
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_compile_script_update(                                            
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      const mem_blk_t*      IN       base,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles scenario script module into executable representation,
+ * reusing code of unchanged functions of base module
+ *
+ */
+{
+
    static const char _global[] = "global($";
    static const char _int[]    = "int)";
    static const char _str[]    = "string)";
    static const char _bool[]   = "boolean)";
+   static const char _list[]   = "list)";
 
-   usize i, j, k, l, m, c;
+   usize i, j, k, l, m, c, e, n, o, x;
    mem_blk_t te;
    mem_blk_t ts;
    byte*  p;
    byte*  q;
+   byte*  pf;
    byte** pp;
    usize* pc;
+   const byte* pn;
    ria_type_t type;
+   uint32 h, hg, hb;
 
    assert(ctx    != NULL);
    assert(script != NULL);
    assert(exec   != NULL);
 
+   /*
+    * Base module without hashes can't be reused; with profiler every
+    * function is compiled to get its source lines
+    *
+    */
+#ifdef USE_RIA_PROFILER
+   base = NULL;
+#endif
+   if (base != NULL) {
+      if (!ria_get_module_info(&x, &n, &k, &o, base))
+         return false;
+      if (x != ria_module_v2)
+         base = NULL;
+   }
+
    /*
     * Canonize script
     *
     */
-   if (!ria_canonize_script(script))
+   if (!ria_canonize_script(script, ctx))
       return false;    
+#ifdef USE_RIA_PROFILER
+   ctx->psrclines = buf_get_ptr_usizes(&ctx->srclines);
+   ctx->csrclines = buf_get_length(&ctx->srclines);
+   buf_set_empty(&ctx->lines);
+#endif
     
    ts.p = script->p;
    ts.c = script->c;
@@ -2749,15 +8072,41 @@ bool
     */
    ctx->ok  = true;
    ctx->pstart = script->p;
+   buf_set_empty(&ctx->globalp);
+   buf_set_empty(&ctx->globalc);
+   buf_set_empty(&ctx->varp);
+   buf_set_empty(&ctx->varc);
    buf_set_empty(&ctx->strp);
    buf_set_empty(&ctx->strc);
    buf_set_empty(&ctx->table);
+   buf_set_empty(&ctx->tableh);
+   buf_set_empty(&ctx->tablek);
+#ifdef USE_RIA_PARALLEL_COMPILE
+   buf_set_empty(&ctx->jobs);
+#endif
+   if (!ria_free_folded_strings(ctx))
+      return false;
+   if (!ria_hash_reset(&ctx->globalh))
+      return false;
+   if (!ria_hash_reset(&ctx->varh))
+      return false;
+   if (!ria_hash_reset(&ctx->strh))
+      return false;
+
+   /*
+    * Keep string indices of base module
+    *
+    */
+   if (base != NULL)
+      if (!ria_load_module_strings(base, ctx))
+         return false;
 
    /*
     * Compile script by script
     *
     */
    te.c = 0; 
+   hg = ria_hash_seed;
    for (i=l=0; ts.c>0; i+=te.c) {
    
       /*
@@ -2766,13 +8115,14 @@ bool
        */
       if (ts.c > sizeof(_global)-1)
          if (!StrNICmp((char*)ts.p, _global, sizeof(_global)-1)) {
+            pf    = ts.p;
             ts.c -= sizeof(_global) - 2;
             ts.p += sizeof(_global) - 2;
             if (!ria_find_var(&j, &k, &ts, ctx))
                return false;
             if (k != ria_var_unknown) {
                SET_COMPILE_ERROR(ctx, ts.p, "var was already defined somewhere");
-               return true;
+               goto link;
             }
             k = j;
             type = ria_unknown;
@@ -2799,27 +8149,36 @@ bool
                         type = ria_boolean;
                         j += sizeof(_bool) - 2;
                      }   
+               if (type == ria_unknown)      
+                  if (ts.c >= sizeof(_list)+j)
+                     if (!StrNICmp((char*)ts.p+j, _list, sizeof(_list)-1)) {
+                        type = ria_list;
+                        j += sizeof(_list) - 2;
+                     }   
                if (type == ria_unknown) {
                   SET_COMPILE_ERROR(ctx, ts.p+j, "syntax error");
-                  return true;
+                  goto link;
                }   
             }
             if (ts.p[j] != ')') {
                SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-               return true;
+               goto link;
             }
             if (!ria_create_var(&k, ts.p, k, type, true, ctx))
                return true;
             ts.c -= j + 1;
             ts.p += j + 1;
+            hg    = ria_hash_data(hg, pf, ts.p-pf);
+            te.c  = 0;
             continue;                       
          } 
        
+      pf = ts.p;
       if (!ria_find_char(&p, &ts, '(', 0))
          return false;
       if (p == NULL) {
          SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-         return true;
+         goto link;
       }
 
 
@@ -2831,14 +8190,14 @@ bool
          return false;
       if (p == NULL) {
          SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-         return true;
+         goto link;
       }
 
       /*
        * Add name to table
        *
        */
-      j = buf_get_length(&ctx->table);
+      e = j = buf_get_length(&ctx->table);
       if (!buf_expand(j+p-ts.p+5, &ctx->table))
          return false;
       q = buf_get_ptr_bytes(&ctx->table) + j;
@@ -2858,12 +8217,12 @@ bool
          return false;
       if (p == NULL) {
          SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-         return true;
+         goto link;
       }
       for (j=0; ts.p<p; ts.p++, ts.c--) {
          if ((ts.p[0] < '0') || (ts.p[0] > '9')) {
             SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-            return true;
+            goto link;
          }
          j = j*10 + ts.p[0] - '0';
       }
@@ -2885,7 +8244,7 @@ bool
        */
       if ((ts.c < 1) || (ts.p[0] != '{')) {
          SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-         return true;
+         goto link;
       }
       ts.p++;
       ts.c--;
@@ -2893,12 +8252,72 @@ bool
          return false;
       if (p == NULL) {
          SET_COMPILE_ERROR(ctx, ts.p, "syntax error");
-         return true;
+         goto link;
       }
       c = ts.c;
       ts.c = p - ts.p;
       c -= ts.c;
 
+      /*
+       * Reuse base code if function and globals before it are the same
+       *
+       */
+      h = ria_hash_data(hg, pf, p-pf+1);
+      if (base != NULL) {
+         if (!ria_find_module_entry(
+                 &k, pf, buf_get_ptr_bytes(&ctx->table)[e], base))
+            return false;
+         if (k != 0) {
+            if (!ria_get_module_entry(
+                    &pn, &j, &x, &o, &hb, &m, ria_module_v2, 
+                    base->p+k, base->c-k))
+               return false;
+            if (hb == h) {
+               if (!buf_set_length(e, &ctx->table))
+                  return false;
+               m = buf_get_length(&ctx->tablek);
+               if (!buf_expand(m+1, &ctx->tablek))
+                  return false;
+               buf_get_ptr_usizes(&ctx->tablek)[m] = k;
+               if (!buf_set_length(m+1, &ctx->tablek))
+                  return false;
+               ts.p = p + 1;
+               ts.c = c - 1;
+               te.c = 0;
+               continue;
+            }
+         }
+      }
+      m = buf_get_length(&ctx->tableh);
+      if (!buf_expand(m+1, &ctx->tableh))
+         return false;
+      buf_get_ptr_usizes(&ctx->tableh)[m] = h;
+      if (!buf_set_length(m+1, &ctx->tableh))
+         return false;
+
+#ifdef USE_RIA_PARALLEL_COMPILE
+      /*
+       * Leave compilation to workers, entry point is set on linking
+       *
+       */
+      if (ctx->workers > 1) {
+         if (!ria_add_compile_job(&ts, e, ctx))
+            return false;
+         ts.p = p + 1;
+         ts.c = c - 1;
+         te.c = 0;
+         l++;
+         if (buf_get_length(&ctx->jobs) >= 
+                ria_compile_batch*sizeof(ria_compile_job_t)) {
+            if (!ria_link_compile_jobs(exec, &i, ctx))
+               return false;
+            if (!ctx->ok)
+               goto link;
+         }
+         continue;
+      }
+#endif
+
       /*
        * Compile
        *
@@ -2908,7 +8327,7 @@ bool
       if (!ria_compile_script(&te, &ts, ctx))
          return false;
       if (!ctx->ok)
-         return true;
+         goto link;
       if (ts.p != p) 
          ERR_SET(err_internal);
       ts.p++;
@@ -2918,54 +8337,179 @@ bool
 
    }
 
+link:
+#ifdef USE_RIA_PARALLEL_COMPILE
    /*
-    * Check number of functions
+    * Compile functions collected above, errors found while scanning
+    * are reported only if functions before them are fine
     *
     */
-   if (l > 0xFF)
-      ERR_SET(err_not_supported);
+   if (!ria_link_compile_jobs(exec, &i, ctx))
+      return false;
+#endif
+   if (!ctx->ok)
+      return true;
 
    /*
-    * Asjust entry points
+    * Optimize code
     *
     */
-   m = ria_header_size + buf_get_length(&ctx->table);
+   te.p = exec->p;
+   te.c = i;
+   if (!ria_optimize_code(&te, exec->c, ctx))
+      return false;
+   i = te.c;
+
+   /*
+    * Drop string constants which became unused after folding,
+    * reused code refers to string indices of base module
+    *
+    */
+   if (base == NULL)
+      if (!ria_compact_strings(&te, ctx))
+         return false;
+
+   /*
+    * Get size of header, functions table and reused code
+    *
+    */
+   m = ria_header_size_v2;
    for (k=buf_get_length(&ctx->table), 
         p=buf_get_ptr_bytes(&ctx->table); k>0; ) {
       j = *p;
-      if (k < j+1)
+      if (k < j+ria_fextra_size)
          ERR_SET(err_internal);
-      k -= j + 1;
-      p += j + 1;
-      if (k < 4)
-         ERR_SET(err_internal);
-      c  = (p[1] << 16) | (p[2] << 8) | p[3];
-      c += m;
-      p[1] = (byte)(c >> 16);
-      p[2] = (byte)(c >>  8);
-      p[3] = (byte)(c >>  0);
-      p += 4;
-      k -= 4;
+      m += ((j < 0x80) ? 1 : 2) + j + ((p[j+1] < 0x80) ? 1 : 2) + 8;
+      k -= j + ria_fextra_size;
+      p += j + ria_fextra_size;
+   }
+   for (k=c=0; k<buf_get_length(&ctx->tablek); k++) {
+      e = buf_get_ptr_usizes(&ctx->tablek)[k];
+      if (!ria_get_module_entry(
+              &pn, &j, &x, &o, &hb, &n, ria_module_v2, base->p+e, base->c-e))
+         return false;
+      m += ((j < 0x80) ? 1 : 2) + j + ((x < 0x80) ? 1 : 2) + 8;
+      if (!ria_get_module_chunk(&o, &n, e, base))
+         return false;
+      c += n;
    }
 
+#ifdef USE_RIA_REGISTER_CODE
+   /*
+    * Translate to register code, which is to leave room for header, 
+    * functions table, reused code and string constants
+    *
+    */
+   for (k=x=0; k<buf_get_length(&ctx->strc); k++)
+      x += buf_get_ptr_usizes(&ctx->strc)[k] + 2;
+   if (exec->c < m + c + x) 
+      ERR_SET(err_bad_length);
+   if (!ria_reg_translate(&te, exec->c-m-c-x, ctx))
+      return false;
+   i = te.c;
+#endif
+
    /*
     * Write the header
     *
     */
-   te.p = exec->p + i;
-   te.c = exec->c - i;
-   if (te.c < m) 
+   if (exec->c - i < m + c) 
       ERR_SET(err_bad_length);
-   MemMove(exec->p+m, exec->p, i);
-   i += m;
-   exec->p[0] = (byte)l;
-   exec->p[1] = (byte)(i >> 16);
-   exec->p[2] = (byte)(i >>  8);
-   exec->p[3] = (byte)(i >>  0);
-   MemCpy(
-      exec->p+ria_header_size, 
-      buf_get_ptr_bytes(&ctx->table), 
-      buf_get_length(&ctx->table));
+   MemMove(exec->p+m+c, exec->p, i);
+   i += m + c;
+   l += buf_get_length(&ctx->tablek);
+   exec->p[0] = ria_module_mark;
+   exec->p[1] = ria_module_v2;
+   exec->p[2] = (byte)(l >> 24);
+   exec->p[3] = (byte)(l >> 16);
+   exec->p[4] = (byte)(l >>  8);
+   exec->p[5] = (byte)(l >>  0);
+   exec->p[6] = (byte)(i >> 24);
+   exec->p[7] = (byte)(i >> 16);
+   exec->p[8] = (byte)(i >>  8);
+   exec->p[9] = (byte)(i >>  0);
+
+#ifdef USE_RIA_PROFILER
+   /*
+    * Make line table module-relative; register code has no line table
+    *
+    */
+#ifdef USE_RIA_REGISTER_CODE
+   buf_set_empty(&ctx->lines);
+#endif
+   for (k=0; k<buf_get_length(&ctx->lines); k+=2)
+      buf_get_ptr_usizes(&ctx->lines)[k] += m + c;
+#endif
+
+   /*
+    * Write reused functions first, their code is copied from base module
+    *
+    */
+   te.p = exec->p + ria_header_size_v2;
+   te.c = m - ria_header_size_v2;
+   for (k=0, c=m; k<buf_get_length(&ctx->tablek); k++) {
+      e = buf_get_ptr_usizes(&ctx->tablek)[k];
+      if (!ria_get_module_entry(
+              &pn, &j, &x, &o, &hb, &n, ria_module_v2, base->p+e, base->c-e))
+         return false;
+      if (!ria_encode_varint(&te.p, &te.c, j))
+         return false;
+      MemCpy(te.p, pn, j);
+      te.p += j;
+      te.c -= j;
+      if (!ria_encode_varint(&te.p, &te.c, x))
+         return false;
+      if (te.c < 8)
+         ERR_SET(err_internal);
+      te.p[0] = (byte)(c  >> 24);
+      te.p[1] = (byte)(c  >> 16);
+      te.p[2] = (byte)(c  >>  8);
+      te.p[3] = (byte)(c  >>  0);
+      te.p[4] = (byte)(hb >> 24);
+      te.p[5] = (byte)(hb >> 16);
+      te.p[6] = (byte)(hb >>  8);
+      te.p[7] = (byte)(hb >>  0);
+      te.p += 8;
+      te.c -= 8;
+      if (!ria_get_module_chunk(&o, &n, e, base))
+         return false;
+      MemCpy(exec->p+c, base->p+o, n);
+      c += n;
+   }
+
+   /*
+    * Write compiled functions, entry points are made module-relative
+    *
+    */
+   o = c;
+   for (k=buf_get_length(&ctx->table), n=0,
+        p=buf_get_ptr_bytes(&ctx->table); k>0; n++) {
+      j = *p;
+      if (!ria_encode_varint(&te.p, &te.c, j))
+         return false;
+      MemCpy(te.p, p+1, j);
+      te.p += j;
+      te.c -= j;
+      if (!ria_encode_varint(&te.p, &te.c, p[j+1]))
+         return false;
+      if (te.c < 8)
+         ERR_SET(err_internal);
+      c  = (p[j+2] << 16) | (p[j+3] << 8) | p[j+4];
+      c += o;
+      h  = (uint32)buf_get_ptr_usizes(&ctx->tableh)[n];
+      te.p[0] = (byte)(c >> 24);
+      te.p[1] = (byte)(c >> 16);
+      te.p[2] = (byte)(c >>  8);
+      te.p[3] = (byte)(c >>  0);
+      te.p[4] = (byte)(h >> 24);
+      te.p[5] = (byte)(h >> 16);
+      te.p[6] = (byte)(h >>  8);
+      te.p[7] = (byte)(h >>  0);
+      te.p += 8;
+      te.c -= 8;
+      k -= j + ria_fextra_size;
+      p += j + ria_fextra_size;
+   }
 
    /*
     * Embed string constants into executable format
@@ -2979,8 +8523,6 @@ bool
       te.c = exec->c - i;
       if (te.c < pc[j]+2)
          ERR_SET(err_internal);
-      if (pc[j] >= 0xFF)
-         ERR_SET(err_internal);
       for (k=l=0; k<pc[j]; k++, l++) {
          if ((pp[j])[k] == '\\') {
             if (k+1 == pc[j])
@@ -3003,6 +8545,8 @@ bool
          else
             te.p[l+1] = (pp[j])[k];
       }
+      if (l >= 0xFF)
+         ERR_SET(err_internal);
       te.p[0]   = (byte)(l + 1);
       te.p[l+1] = 0x00;
       i += l + 2;
@@ -3013,7 +8557,7 @@ bool
     *
     */
    exec->c = i;
-   return true;
+   return ria_free_folded_strings(ctx);
 
 }
 
@@ -8,7 +8,9 @@
 
 
 /*
- * Support for async operations
+ * Support for async operations: HTTP requests suspend the script with
+ * pending status, it is resumed by ria_uapi_continue() once request is 
+ * completed; on Android requests are driven by ria_uapi_poll()
  *
  */
 //#define USE_RIA_ASYNC_CALLS 
@@ -17,6 +19,35 @@
 #define RIA_ASYNC_RECEIVE
 #endif
 
+/*
+ * Register-based executable code instead of stack-based one
+ *
+ */
+//#define USE_RIA_REGISTER_CODE
+
+/*
+ * Compilation of script functions on worker threads, the result is 
+ * the same as of serial compilation
+ *
+ */
+//#define USE_RIA_PARALLEL_COMPILE
+
+/*
+ * Profiler of executed commands, predefined functions and source lines; 
+ * compiler keeps line table of the module
+ *
+ */
+//#define USE_RIA_PROFILER
+
+/*
+ * Direct-threaded dispatch of validated stack code, relies on labels as 
+ * values and so is available with GCC/Clang only
+ *
+ */
+#if defined(__GNUC__) && !defined(USE_RIA_REGISTER_CODE)
+#define USE_RIA_DIRECT_DISPATCH
+#endif
+
 /*
  * Forwards
  *
@@ -26,76 +57,134 @@ struct ria_exec_state_s;
 /*
  *  Tracing 
  *
+ *  Trace support is compiled in by USE_RIA_TRACE and selected at run time 
+ *  by ria_trace_level: while it is off each trace point costs one branch 
+ *  on a local copy of the level. Messages between RIA_TRACE_START and 
+ *  RIA_TRACE_STOP are staged as binary items (string chunks and integers) 
+ *  and on stop either formatted to platform log or put as one record into 
+ *  ring buffer, which is drained to text by ria_trace_drain from any thread
+ *
  */
 
 #define USE_RIA_TRACE
 
+typedef enum ria_trace_level_e {
+   ria_trace_off  = 0x00,  /* No tracing                                 */
+   ria_trace_ring = 0x01,  /* Binary records into ring buffer            */
+   ria_trace_log  = 0x02   /* Text messages into platform log            */
+} ria_trace_level_t;
+
 #ifdef USE_RIA_TRACE
-#if defined(ANDROID)
 
+enum {
+   ria_trace_buf_size = 0x80
+};
+
+/*
+ * Staged trace record: items of tag octet followed by string chunk 
+ * length and data or by 4-octet integer
+ *
+ */
+typedef struct ria_trace_buf_s {
+   usize   c;
+   byte    p[ria_trace_buf_size];
+} ria_trace_buf_t;
+
+extern ria_trace_level_t ria_trace_level;
+
+/*@@ria_trace_put_str
+ *
+ * Stages string into trace record
+ *
+ * Parameters:     buf            trace record
+ *                 str            string
+ *                 len            string length
+ *                 level          trace level
+ *
+ * Return:         none
+ *
+ */
+void 
+   ria_trace_put_str(
+      ria_trace_buf_t*    IN OUT   buf,
+      const char*         IN       str,
+      usize               IN       len,
+      ria_trace_level_t   IN       level);
+
+/*@@ria_trace_put_int
+ *
+ * Stages integer into trace record
+ *
+ * Parameters:     buf            trace record
+ *                 value          integer
+ *                 level          trace level
+ *
+ * Return:         none
+ *
+ */
 void 
-   do_android_log(
-      char*         IN OUT   buf,
-      uint*         IN OUT   cval,
-      uint          IN       cbuf,
-      const char*   IN       str,
-      uint          IN       len,
-      bool          IN       flush);
+   ria_trace_put_int(
+      ria_trace_buf_t*    IN OUT   buf,
+      int                 IN       value,
+      ria_trace_level_t   IN       level);
+
+/*@@ria_trace_flush
+ *
+ * Writes staged trace record to log or ring buffer and empties it
+ *
+ * Parameters:     buf            trace record
+ *                 level          trace level
+ *
+ * Return:         none
+ *
+ */
+void 
+   ria_trace_flush(
+      ria_trace_buf_t*    IN OUT   buf,
+      ria_trace_level_t   IN       level);
+
+/*@@ria_trace_drain
+ *
+ * Moves records from ring buffer into text, one line per record; 
+ * records which do not fit stay in ring buffer
+ *
+ * Parameters:     text           text buffer
+ *                 ctext          buffer size on entry, text size on exit
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_trace_drain(
+      char*    OUT      text,
+      usize*   IN OUT   ctext);
 
 #define RIA_TRACE_START                                                       \
    {                                                                          \
-      char _sz[100];                                                          \
-      uint _cc = 0;                                                 
+      ria_trace_level_t _tl = ria_trace_level;                                \
+      ria_trace_buf_t _tb;                                                    \
+      _tb.c = 0;
 #define RIA_TRACE_MSG(_s)                                                     \
    {                                                                          \
-      do_android_log(_sz, &_cc, sizeof(_sz), _s, StrLen(_s), false);          \
-   } 
+      if (_tl != ria_trace_off)                                               \
+         ria_trace_put_str(&_tb, _s, StrLen(_s), _tl);                        \
+   }
 #define RIA_TRACE_STR(_p, _c)                                                 \
    {                                                                          \
-      do_android_log(_sz, &_cc, sizeof(_sz), _p, _c, false);                  \
+      if (_tl != ria_trace_off)                                               \
+         ria_trace_put_str(&_tb, (const char*)(_p), (usize)(_c), _tl);        \
    }
 #define RIA_TRACE_INT(_i)                                                     \
    {                                                                          \
-      char _si[15];                                                           \
-      Sprintf(_si, sizeof(_si), "%d", _i);                                   \
-      do_android_log(_sz, &_cc, sizeof(_sz), _si, StrLen(_si), false);        \
-   } 
+      if (_tl != ria_trace_off)                                               \
+         ria_trace_put_int(&_tb, (int)(_i), _tl);                             \
+   }
 #define RIA_TRACE_STOP                                                        \
-      do_android_log(_sz, &_cc, sizeof(_sz), NULL, 0, true);                  \
+      if (_tl != ria_trace_off)                                               \
+         ria_trace_flush(&_tb, _tl);                                          \
    }
    
-#else /* ANDROID */
-
-#define RIA_TRACE_START                                                       
-#define RIA_TRACE_MSG(s)                                                      \
-   {                                                                          \
-      Fprintf(Stdout, s);                                                     \
-      Fflush(Stdout);                                                         \
-   } 
-#define RIA_TRACE_STR(_p, _c)                                                 \
-   {                                                                          \
-      char _sz[100];                                                          \
-      usize _i, _j;                                                           \
-      for (_i=_j=0; (_i<sizeof(_sz)-1)&&(_j<(unsigned)(_c)); _j++) {          \
-         if (_p[_j] == '%') {                                                 \
-            if (_i == sizeof(_sz)-2)                                          \
-               break;                                                         \
-            _sz[_i++] = '%';                                                  \
-         }                                                                    \
-         _sz[_i++] = _p[_j];                                                  \
-      }                                                                       \
-      _sz[_i] = 0x00;                                                         \
-      Fprintf(Stdout, _sz);                                                   \
-      Fflush(Stdout);                                                         \
-   }
-#define RIA_TRACE_INT(_i)                                                     \
-   {                                                                          \
-      Fprintf(Stdout, "%d", _i);                                              \
-      Fflush(Stdout);                                                         \
-   } 
-#define RIA_TRACE_STOP
-
-#endif /* !ANDROID */       
 #else  /* !USE_RIA_TRACE */
 #define RIA_TRACE_START
 #define RIA_TRACE_MSG(s)                                                      
@@ -105,7 +194,7 @@ void
 #endif
 
 /*
- * Executable module format:
+ * Executable module format, version 1:
  * COOOLN...NKPPP...LN...NKPPPE...ELS...S...LS...S
  * C - number of functions in module (1 byte)
  * O - offset of strings table (3 bytes)
@@ -116,20 +205,61 @@ void
  * E - executable code
  * S - string data
  *
+ * Executable module format, version 2:
+ * MVCCCCOOOOLN...NKPPPPHHHH...LN...NKPPPPHHHHE...ELS...S...LS...S
+ * M - format mark, always 0 (1 byte)
+ * V - format version, always 2 (1 byte)
+ * C - number of functions in module (4 bytes)
+ * O - offset of strings table (4 bytes)
+ * L - length of next field (varint)
+ * N - function name
+ * K - number of function parameters (varint)
+ * P - offset of function entry point (4 bytes)
+ * H - hash of function source and global declarations before it (4 bytes)
+ * E - executable code, function by function
+ * S - string data
+ *
+ * Varint keeps 7 bits per octet, least significant group first,
+ * high bit is set in every octet but the last one (4 octets max)
+ *
  */
 enum {
-   ria_header_size = 0x04,
-   ria_fextra_size = 0x05
+   ria_header_size    = 0x04,
+   ria_fextra_size    = 0x05,
+   ria_header_size_v2 = 0x0A,
+   ria_module_mark    = 0x00,
+   ria_module_v1      = 0x01,
+   ria_module_v2      = 0x02,
+   ria_varint_size    = 0x04
 };
 
 /* 
- * Internal contants for executor
+ * Internal contants for executor: variables below threshold are local,
+ * short references (1 octet) to globals start from narrow limit
  *
  */
 enum {
-   ria_var_threshold = 128
+   ria_var_narrow    = 0x80,
+   ria_var_threshold = 0x00800000
 };
 
+/*@@ria_get_narrow_var
+ *
+ * Converts 1 octet variable reference into variable index
+ *
+ */
+#define /* usize */ ria_get_narrow_var(_b)                                   \
+   (((_b) < ria_var_narrow) ?                                                 \
+      (usize)(_b) : (usize)(_b) - ria_var_narrow + ria_var_threshold)
+
+/*@@ria_get_wide_var
+ *
+ * Converts varint variable reference into variable index
+ *
+ */
+#define /* usize */ ria_get_wide_var(_u)                                     \
+   (((_u) & 1) ? ((usize)(_u) >> 1) + ria_var_threshold : (usize)(_u) >> 1)
+
 /*
  * Data types 
  *
@@ -138,15 +268,42 @@ typedef enum _ria_type_e {
    ria_unknown = 0x00,
    ria_string  = 0x01,
    ria_int     = 0x02,
-   ria_boolean = 0x03
+   ria_boolean = 0x03,
+   ria_list    = 0x04
 } ria_type_t;
 
+/*
+ * List value, held by variables and temporaries only:
+ * CCCC NNNN OOOO ... OOOO IIII ... IIII
+ * C - capacity of offsets table (4 octets, native)
+ * N - number of items (4 octets, native)
+ * O - offset of item from the start of items area (4 octets, native)
+ * I - items, nul-terminated strings in order of appending;
+ * table capacity is doubled when full, so append is amortized O(1)
+ *
+ */
+
+/*
+ * Integer value, kept in native form by variables and temporaries;
+ * literals of executable code are 1..4 octets, unsigned, big endian
+ *
+ */
+typedef int64 ria_int_t;
+
 /*
 
   Push-value-of-variable-to-stack (pushv x)
-  000000-- xxxxxxxx
+  00000000 xxxxxxxx
            index of variable (local: 0..127, global: 128...255)
 
+  Push-value-of-variable-to-stack, wide form (pushvw x)
+  00000011 xxxxxxxx ... xxxxxxxx
+           varint, index of variable multiplied by 2, plus 1 for global
+
+  Push-variable-and-string-constant-to-stack (pushvs x y)
+  00000001 xxxxxxxx yyyyyyyy
+           index of variable, then index of string (1 octet)
+
   Push-value-of-parameter-to-stack (pushp x)
   000011-- xxxxxxxx
            index of parameter
@@ -180,15 +337,38 @@ typedef enum _ria_type_e {
       1111 -                      -(u)
 
   Pop-stack-top-element: (pop x)
-  0011---- xxxxxxxx
+  00110000 xxxxxxxx
            index of variable (local: 0..127, global: 128...255)
 
+  Pop-stack-top-element, wide form: (popw x)
+  00110001 xxxxxxxx ... xxxxxxxx
+           varint, index of variable multiplied by 2, plus 1 for global
+
+  Increment/decrement-integer-variable-by-constant: (incv/decv x y)
+  0011001x xxxxxxxx yyyyyyyy
+         0 - increment
+         1 - decrement
+           index of variable, then constant (1 octet)
+
+  Append-stack-top-element-to-string-variable: (appv x)
+  00110100 xxxxxxxx
+           index of variable (local: 0..127, global: 128...255);
+           variable storage grows in place, $x = $x + ... is compiled 
+           into it
+
+  Release-local-variable: (kill x)
+  00110101 xxxxxxxx
+           index of local variable (0..127); inserted by the optimizer 
+           where the variable is dead and stack is empty, so that its 
+           storage is released before the end of execution
+
   Evaluate-predefined-function: (call x)
-  0001--yx yyyyyyyy yyyyyyyy
+  0001-zyx yyyyyyyy yyyyyyyy zzzzzzzz
          0 - function index is 1 octet
          1 - function index is 2 octets
         0 - push return value to stack
         1 - ignore return value
+       1 - store return value to variable given by last octet (y is 0)
               
            00000001 - load_cookie(site, user, key)->string
            00000010 - get_html(url)->status code, cache response
@@ -208,28 +388,84 @@ typedef enum _ria_type_e {
            00010000 - post_with_dump(url, values, dump)->status code, cache resp
            00010001 - post_to_file_with_dump(file, url, values, dump)->status code
            00010010 - set_header(name, value)->status code
-           00010011 - length(str)->length
+           00010011 - length(str or list)->length or number of items
            00010100 - int_to_string(int)->string
            00010101 - create_parser_for_file(filename, type)->none
            00010110 - add_parsing_rule(name, begin, end, hint)->none
+           00010111 - load_from_file(filename)->string
+           00011000 - save_to_file(filename, str)->none
+           00011001 - string_to_int(str)->int
+           00011010 - list()->empty list
+           00011011 - append(list variable, str)->none, list grows in place
+           00011100 - item(list, index)->string, empty if out of range
+           00011101 - join(list, separator)->string
+           00011110 - split(str, separator)->list
+           00011111 - get_html_many(files, urls, limit)->list of status codes
            
   Conditional-jump: (jit/jif x)
-  0100x--y zzzzzzzz zzzzzzzz
-         0 - jump offset is 1 octet
-         1 - jump offset is 2 octets
+  0100x-yy zzzzzzzz zzzzzzzz zzzzzzzz zzzzzzzz
+        00 - jump offset is 1 octet
+        01 - jump offset is 2 octets
+        10 - jump offset is 4 octets
       0 - jump if stack top is not true
       1 - jump if stack top is true
 
   Unconditional-jump: (jmp x)
-  0101---y zzzzzzzz zzzzzzzz
-         0 - jump offset is 1 octet
-         1 - jump offset is 2 octets
+  0101--yy zzzzzzzz zzzzzzzz zzzzzzzz zzzzzzzz
+        00 - jump offset is 1 octet
+        01 - jump offset is 2 octets
+        10 - jump offset is 4 octets
+
+  Wide forms of commands (pushvw, popw, 4 octets jumps) are valid 
+  in modules of version 2 only
 
   Stop execution: (ret)
   0110---x
          0 - pop stack top
          1 - do not touch stack
 
+  Source-line-mark: (line x)
+  01111111 xxxxxxxx ... xxxxxxxx
+           varint, source line of the statement which follows; emitted
+           with USE_RIA_PROFILER only and moved into line table by the
+           optimizer, so executable modules never contain it
+
+  Register code (USE_RIA_REGISTER_CODE)
+
+  Stack code is translated into three-address commands over operands.
+  Operand is encoded as push command of stack format (pushv, pushs, 
+  pushs2, pushi, pushp) or as temporary register reference:
+  00000010 xxxxxxxx
+           index of register, register is released once read
+
+  Destination is variable (pushv x or pushvw x form) or register 
+  (reg x form).
+  Offsets of jumps are 2 octets (4 octets if code is larger than 16K), 
+  relative to the command start.
+
+  mov d a            00110000 d a
+  op d a b           0010xxxx d a b        - type is resolved at run time
+  op d a b           0111xxxx d a b        - typed operation:
+      0000 -         int +
+      0001 -         int -
+      0010 -         string +
+      0011 -         bool ||
+      0100 -         bool &&
+  neg d a            00101111 d a
+  call f d a...      0001000x f d a...     - one operand per parameter
+  calli f d a...     0001001x f d a...     - d is released after call
+  jif/jit a o        0100x0yy a o
+  jmp o              010100yy o
+  ret a              01100000 a
+  retn               01100001
+  incv/decv x y      same as in stack code
+  kill x             same as in stack code
+  appv x a           00110100 x a
+  stack              01111110              - rest of function is stack code,
+                                             emitted at entry of function 
+                                             having commands without 
+                                             register form
+
 */
 
 /*
@@ -238,6 +474,9 @@ typedef enum _ria_type_e {
  */
 enum {
    ria_opcode_pushv   = 0x00,
+   ria_opcode_pushvs  = 0x01,
+   ria_opcode_reg     = 0x02,
+   ria_opcode_pushvw  = 0x03,
    ria_opcode_pushs   = 0x04,
    ria_opcode_pushs2  = 0x05,
    ria_opcode_pushi1  = 0x08,
@@ -249,6 +488,8 @@ enum {
    ria_opcode_call2p  = 0x11,
    ria_opcode_calli   = 0x12,
    ria_opcode_call2i  = 0x13,
+   ria_opcode_callv   = 0x14,
+   ria_opcode_call2v  = 0x15,
    ria_opcode_add     = 0x20,
    ria_opcode_lor     = 0x20,
    ria_opcode_less    = 0x21,
@@ -269,16 +510,39 @@ enum {
    ria_opcode_not     = 0x2E,
    ria_opcode_neg     = 0x2F,
    ria_opcode_pop     = 0x30,
+   ria_opcode_popw    = 0x31,
+   ria_opcode_incv    = 0x32,
+   ria_opcode_decv    = 0x33,
+   ria_opcode_appv    = 0x34,
+   ria_opcode_kill    = 0x35,
    ria_opcode_jif     = 0x40,
    ria_opcode_jif2    = 0x41,
+   ria_opcode_jif4    = 0x42,
    ria_opcode_jit     = 0x48,
    ria_opcode_jit2    = 0x49,
+   ria_opcode_jit4    = 0x4A,
    ria_opcode_jmp     = 0x50,
    ria_opcode_jmp2    = 0x51,
+   ria_opcode_jmp4    = 0x52,
    ria_opcode_ret     = 0x60,
-   ria_opcode_retn    = 0x61
+   ria_opcode_retn    = 0x61,
+   ria_opcode_add_i   = 0x70,
+   ria_opcode_sub_i   = 0x71,
+   ria_opcode_add_s   = 0x72,
+   ria_opcode_lor_b   = 0x73,
+   ria_opcode_land_b  = 0x74,
+   ria_opcode_stack   = 0x7E,
+   ria_opcode_line    = 0x7F
 };
 
+/*@@ria_get_offset4
+ *
+ * Extracts 4 octets jump offset
+ *
+ */
+#define /* int */ ria_get_offset4(_p)                                        \
+   (int)(((usize)(_p)[0] << 24) | ((_p)[1] << 16) | ((_p)[2] << 8) | (_p)[3])
+
 /*
  * Function codes
  *
@@ -308,7 +572,13 @@ enum {
    ria_func_add_parsing_rule           = 0x16,
    ria_func_load_from_file             = 0x17,
    ria_func_save_to_file               = 0x18,
-   ria_func_string_to_int              = 0x19
+   ria_func_string_to_int              = 0x19,
+   ria_func_list                       = 0x1A,
+   ria_func_append                     = 0x1B,
+   ria_func_item                       = 0x1C,
+   ria_func_join                       = 0x1D,
+   ria_func_split                      = 0x1E,
+   ria_func_get_html_many              = 0x1F
 };
 
 /*
@@ -470,7 +740,9 @@ typedef enum ria_option_e {
 } ria_option_t; 
 
 /*
- * Compiler context
+ * Compiler context; with USE_RIA_PROFILER it keeps offsets of canonized 
+ * script where source lines start and line table of compiled module, 
+ * pairs of code offset and source line ordered by offset
  *
  */
 typedef struct ria_compiler_ctx_s {
@@ -481,11 +753,27 @@ typedef struct ria_compiler_ctx_s {
    ria_type_t    expr_type;
    buf_t         globalp;
    buf_t         globalc;
+   buf_t         globalh;
    buf_t         varp;
    buf_t         varc;
+   buf_t         varh;
    buf_t         strp;
    buf_t         strc;
+   buf_t         strh;
+   buf_t         strf;
    buf_t         table;
+   buf_t         tableh;
+   buf_t         tablek;
+#ifdef USE_RIA_PARALLEL_COMPILE
+   usize         workers;
+   buf_t         jobs;
+#endif
+#ifdef USE_RIA_PROFILER
+   buf_t         srclines;
+   const usize*  psrclines;
+   usize         csrclines;
+   buf_t         lines;
+#endif
    heap_ctx_t*   mem;
    umask         cleanup;
 } ria_compiler_ctx_t;
@@ -538,6 +826,162 @@ bool
       mem_blk_t*            IN OUT   script,
       ria_compiler_ctx_t*   IN OUT   ctx);
 
+/*@@ria_compile_script_update
+ *
+ * Compiles scenario script module into executable representation,
+ * reusing code of unchanged functions of base module
+ *
+ * Parameters:     exec           buffer with executable data
+ *                 script         buffer with script data
+ *                 base           base executable module or NULL
+ *                 ctx            compiler context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_compile_script_update(     
+      mem_blk_t*            IN OUT   exec,
+      mem_blk_t*            IN OUT   script,
+      const mem_blk_t*      IN       base,
+      ria_compiler_ctx_t*   IN OUT   ctx);
+
+/*@@ria_decode_varint
+ *
+ * Decodes varint value
+ *
+ * Parameters:     value          decoded value
+ *                 size           number of octets taken
+ *                 p              pointer to encoded value
+ *                 c              available size
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_decode_varint(                   
+      usize*        OUT   value,
+      usize*        OUT   size,
+      const byte*   IN    p,
+      usize         IN    c);
+
+/*
+ * Seed of FNV-1a hash over names and sources
+ *
+ */
+enum {
+   ria_hash_seed = 0x811C9DC5
+};
+
+/*@@ria_hash_data
+ *
+ * Continues FNV-1a hash over data
+ *
+ * Parameters:     h              hash so far, ria_hash_seed to start
+ *                 p              pointer to data
+ *                 c              size of data
+ *
+ * Return:         updated hash
+ *
+ */
+uint32
+   ria_hash_data(
+      uint32        IN   h,
+      const byte*   IN   p,
+      usize         IN   c);
+
+/*@@ria_get_command_size
+ *
+ * Returns size of executable command
+ *
+ * Parameters:     size           command size
+ *                 p              pointer to command
+ *                 c              available size
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_get_command_size(
+      usize*        OUT   size,
+      const byte*   IN    p,
+      usize         IN    c);
+
+/*@@ria_get_module_info
+ *
+ * Parses executable module header
+ *
+ * Parameters:     version        format version
+ *                 count          number of functions
+ *                 table          offset of functions table
+ *                 strs           offset of strings table
+ *                 module         executable module
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_module_info(                   
+      usize*             OUT   version,
+      usize*             OUT   count,
+      usize*             OUT   table,
+      usize*             OUT   strs,
+      const mem_blk_t*   IN    module);
+
+/*@@ria_get_module_entry
+ *
+ * Parses entry of executable module functions table
+ *
+ * Parameters:     name           function name
+ *                 len            length of function name
+ *                 params         number of function parameters
+ *                 offset         offset of function entry point
+ *                 hash           function hash (0 for version 1)
+ *                 size           size of table entry
+ *                 version        format version
+ *                 p              pointer to table entry
+ *                 c              available size
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_module_entry(                   
+      const byte**   OUT   name,
+      usize*         OUT   len,
+      usize*         OUT   params,
+      usize*         OUT   offset,
+      uint32*        OUT   hash,
+      usize*         OUT   size,
+      usize          IN    version,
+      const byte*    IN    p,
+      usize          IN    c);
+
+/*@@ria_find_module_entry
+ *
+ * Searches executable module functions table for function
+ *
+ * Parameters:     entry          offset of table entry, 0 if not found
+ *                 name           function name
+ *                 len            length of function name
+ *                 module         executable module
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_find_module_entry(                   
+      usize*             OUT   entry,
+      const byte*        IN    name,
+      usize              IN    len,
+      const mem_blk_t*   IN    module);
+
 /*@@ria_get_function_info
  *
  * Returns information about predefind function 
@@ -558,6 +1002,26 @@ bool
       function_fn**   OUT   impl,
       unumber         IN    func);
 
+#ifdef USE_RIA_PROFILER
+/*@@ria_get_function_name
+ *
+ * Returns name of predefind function 
+ *
+ * Parameters:     name           function name, not nul-terminated
+ *                 len            length of function name
+ *                 func           function code
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_function_name(                   
+      const char**   OUT   name,
+      usize*         OUT   len,
+      unumber        IN    func);
+#endif
+
 
 #endif
 
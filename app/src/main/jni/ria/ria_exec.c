@@ -1,6 +1,7 @@
 #include "ria_exec.h"
 #include "ria_func.h"
 #include "ria_core.h"
+#include "ria_papi.h"
 
 
 /******************************************************************************
@@ -22,6 +23,48 @@
  *  Data handling
  */
 
+/*
+ * Released data of this size keeps its storage, so that integers and 
+ * booleans do not reallocate temporaries
+ *
+ */
+enum {
+   ria_keep_storage_size = 0x10
+};
+
+/*
+ * Max number of predefined function parameters
+ *
+ */
+enum {
+   ria_max_func_params = 0x08
+};
+
+/*
+ * List layout: words of list header and offsets table, minimal capacity
+ * of the table and max size of items area
+ *
+ */
+enum {
+   ria_list_capacity     = 0x00,
+   ria_list_count        = 0x01,
+   ria_list_table        = 0x02,
+   ria_list_min_capacity = 0x04,
+   ria_list_max_size     = 0x7FFFFFFF
+};
+
+/*
+ * Function index record: bucket chain link (function number + 1), table
+ * entry offset and max stack depth, (usize)-1 if not executed directly
+ *
+ */
+enum {
+   ria_index_link  = 0x00,
+   ria_index_entry = 0x01,
+   ria_index_depth = 0x02,
+   ria_index_size  = 0x03
+};
+
 /*****************************************************************************/
 bool 
    ria_get_datatype_from_buf(                                            
@@ -47,6 +90,7 @@ bool
    case ria_string:
    case ria_int:
    case ria_boolean:
+   case ria_list:
       return true;
    default:
       ERR_SET(err_internal);
@@ -95,10 +139,16 @@ bool
    if (buf == NULL)
       ERR_SET(err_internal);
    if ((type == ria_unknown) && (buf_get_length(buf) > 1)) {
-      if (!buf_destroy(buf))
-         return false;
-      if (!buf_fill(0x00, 0, 1, buf))
-         return false;   
+      if (buf_get_length(buf) <= ria_keep_storage_size) {
+         if (!buf_set_length(1, buf))
+            return false;
+      }
+      else {
+         if (!buf_destroy(buf))
+            return false;
+         if (!buf_fill(0x00, 0, 1, buf))
+            return false;   
+      }
    }   
    if (buf_get_length(buf) < 1)
       ERR_SET(err_internal);
@@ -133,6 +183,262 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_get_int_from_buf(                                            
+      ria_int_t*     OUT   value,
+      const buf_t*   IN    buf)
+/*
+ * Fetches integer value from buffer 
+ *
+ */
+{
+
+   assert(value != NULL);
+   assert(buf   != NULL);
+
+   if (buf_get_length(buf) != sizeof(ria_int_t)+1)
+      ERR_SET(err_internal);
+   if (buf_get_ptr_bytes(buf)[0] != ria_int)
+      ERR_SET(err_internal);
+   MemCpy(value, buf_get_ptr_bytes(buf)+1, sizeof(ria_int_t));
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_set_int_into_buf(                                            
+      buf_t*      IN OUT   buf,
+      ria_int_t   IN       value)
+/*
+ * Stores integer value into buffer 
+ *
+ */
+{
+
+   byte* p;
+
+   assert(buf != NULL);
+
+   if (!ria_prealloc_datatype_in_buf(&p, ria_int, sizeof(ria_int_t), buf))
+      return false;
+   MemCpy(p, &value, sizeof(ria_int_t));
+   return true;
+
+}
+
+/*****************************************************************************/
+static usize 
+   _get_list_word(                                            
+      const byte*   IN   ptr,
+      usize         IN   idx)
+/*
+ * Fetches word of list header or offsets table
+ *
+ */
+{
+
+   uint32 u;
+
+   MemCpy(&u, ptr + idx*sizeof(uint32), sizeof(uint32));
+   return (usize)u;
+
+}
+
+/*****************************************************************************/
+static void 
+   _set_list_word(                                            
+      byte*   IN OUT   ptr,
+      usize   IN       idx,
+      usize   IN       value)
+/*
+ * Stores word of list header or offsets table
+ *
+ */
+{
+
+   uint32 u = (uint32)value;
+
+   MemCpy(ptr + idx*sizeof(uint32), &u, sizeof(uint32));
+
+}
+
+/*****************************************************************************/
+static bool 
+   _get_list_header(                                            
+      usize*        OUT   capacity,
+      usize*        OUT   count,
+      const byte*   IN    ptr,
+      usize         IN    len)
+/*
+ * Validates list and returns its header
+ *
+ */
+{
+
+   assert(capacity != NULL);
+   assert(count    != NULL);
+
+   if (len < ria_list_table*sizeof(uint32))
+      ERR_SET(err_internal);
+   *capacity = _get_list_word(ptr, ria_list_capacity);
+   *count    = _get_list_word(ptr, ria_list_count);
+   if ((*count > *capacity) || 
+       (len < (ria_list_table+*capacity)*sizeof(uint32)+*count))
+      ERR_SET(err_internal);
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_create_list_in_buf(                                            
+      buf_t*   IN OUT   buf)
+/*
+ * Stores empty list into buffer 
+ *
+ */
+{
+
+   byte* p;
+
+   assert(buf != NULL);
+
+   if (!ria_prealloc_datatype_in_buf(
+           &p, 
+           ria_list, 
+           ria_list_table*sizeof(uint32), 
+           buf))
+      return false;
+   _set_list_word(p, ria_list_capacity, 0);
+   _set_list_word(p, ria_list_count, 0);
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_append_to_list_in_buf(                                            
+      buf_t*        IN OUT   buf,
+      const byte*   IN       item,
+      usize         IN       len)
+/*
+ * Appends string to list kept in buffer
+ *
+ */
+{
+
+   ria_type_t type;
+   usize n, k, c, d, e;
+   byte* p;
+
+   assert(buf  != NULL);
+   assert((len == 0) || (item != NULL));
+
+   if (!ria_get_datainfo_from_buf(&type, &p, &c, buf))
+      return false;
+   if (type != ria_list)
+      ERR_SET(err_internal);
+   if (!_get_list_header(&n, &k, p, c))
+      return false;
+
+   /*
+    * Grow offsets table, items area is moved behind it
+    *
+    */
+   if (k == n) {
+      d = (n == 0) ? ria_list_min_capacity : n;
+      e = c - (ria_list_table+n)*sizeof(uint32);
+      if (!buf_expand(c+1+d*sizeof(uint32), buf))
+         return false;
+      if (!buf_set_length(c+1+d*sizeof(uint32), buf))
+         return false;
+      p = buf_get_ptr_bytes(buf) + 1;
+      MemMove(
+         p + (ria_list_table+n+d)*sizeof(uint32), 
+         p + (ria_list_table+n)*sizeof(uint32), 
+         e);
+      n += d;
+      c += d*sizeof(uint32);
+      _set_list_word(p, ria_list_capacity, n);
+   }
+
+   /*
+    * Add item at the end of items area
+    *
+    */
+   e = c - (ria_list_table+n)*sizeof(uint32);
+   if ((len >= ria_list_max_size) || (e >= ria_list_max_size-len))
+      ERR_SET(err_bad_length);
+   if (!buf_expand(c+len+2, buf))
+      return false;
+   if (!buf_set_length(c+len+2, buf))
+      return false;
+   p = buf_get_ptr_bytes(buf) + 1;
+   if (len > 0)
+      MemCpy(p+c, item, len);
+   p[c+len] = 0x00;
+   _set_list_word(p, ria_list_table+k, e);
+   _set_list_word(p, ria_list_count, k+1);
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_get_list_count(                                            
+      usize*        OUT   count,
+      const byte*   IN    ptr,
+      usize         IN    len)
+/*
+ * Returns number of list items
+ *
+ */
+{
+
+   usize n;
+
+   assert(count != NULL);
+
+   return _get_list_header(&n, count, ptr, len);
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_get_list_item(                                            
+      const byte**   OUT   item,
+      usize*         OUT   ilen,
+      const byte*    IN    ptr,
+      usize          IN    len,
+      usize          IN    idx)
+/*
+ * Returns list item, which is nul-terminated string
+ *
+ */
+{
+
+   usize n, k, e, o1, o2;
+
+   assert(item != NULL);
+   assert(ilen != NULL);
+
+   if (!_get_list_header(&n, &k, ptr, len))
+      return false;
+   if (idx >= k)
+      ERR_SET(err_internal);
+   e  = len - (ria_list_table+n)*sizeof(uint32);
+   o1 = _get_list_word(ptr, ria_list_table+idx);
+   o2 = (idx+1 < k) ? _get_list_word(ptr, ria_list_table+idx+1) : e;
+   if ((o1 >= o2) || (o2 > e))
+      ERR_SET(err_internal);
+   *item = ptr + (ria_list_table+n)*sizeof(uint32) + o1;
+   *ilen = o2 - o1 - 1;
+   return true;
+
+}
+
 /*****************************************************************************/
 bool 
    ria_get_var(                                            
@@ -180,12 +486,20 @@ bool
             for (i=c; i<idx; i++)
                buf_get_ptr_ptrs(pvars)[i] = NULL;
          }      
-         if (!heap_alloc((void**)&pb, sizeof(buf_t), ctx->mem))
-            return false;
-         if (!buf_create(1, 1, 0, pb, ctx->mem))
-            return false;
-         if (!ria_prealloc_datatype_in_buf(&p, ria_unknown, 0, pb))
-            return false;
+         c = buf_get_length(&ctx->spares);
+         if (c > 0) {
+            pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->spares)[c-1]);
+            if (!buf_set_length(c-1, &ctx->spares))
+               return false;
+         }
+         else {
+            if (!heap_alloc((void**)&pb, sizeof(buf_t), ctx->mem))
+               return false;
+            if (!buf_create(1, 1, 0, pb, ctx->mem))
+               return false;
+            if (!ria_prealloc_datatype_in_buf(&p, ria_unknown, 0, pb))
+               return false;
+         }
          buf_get_ptr_ptrs(pvars)[idx] = (byte*)pb;
          *ptr = pb;
       }
@@ -197,6 +511,44 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_kill_var(                                            
+      usize               IN       idx,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Releases dead local variable: its buffer goes to spares, storage of 
+ * large value is freed; variable which does not exist is skipped
+ *
+ */
+{
+
+   usize c;
+   buf_t* pb;
+
+   assert(ctx != NULL);
+
+   if (idx >= ria_var_threshold)
+      ERR_SET(err_internal);
+   if (idx >= buf_get_length(&ctx->vars))
+      return true;
+   pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->vars)[idx]);
+   if (pb == NULL)
+      return true;
+
+   if (!ria_set_datatype_into_buf(pb, ria_unknown))
+      return false;
+   c = buf_get_length(&ctx->spares);
+   if (!buf_expand(c+1, &ctx->spares))
+      return false;
+   buf_get_ptr_ptrs(&ctx->spares)[c] = (byte*)pb;
+   if (!buf_set_length(c+1, &ctx->spares))
+      return false;
+   buf_get_ptr_ptrs(&ctx->vars)[idx] = NULL;
+   return true;
+
+}
+
 /*****************************************************************************/
 bool 
    ria_get_str(                                            
@@ -204,7 +556,7 @@ bool
       usize               IN       idx,
       ria_exec_state_t*   IN OUT   ctx)
 /*
- * Returns pointer to string
+ * Returns pointer to string, which points into compiled module
  *
  */
 {
@@ -217,6 +569,10 @@ bool
    *ptr = NULL;
 
    p = ctx->ptr_strs;
+   if (idx < ctx->coffs) {
+      *ptr = p + ctx->ptr_offs[idx] + 1;
+      return true;
+   }
    for (; idx>0; idx--)
       p += *p + 1;
 
@@ -282,6 +638,8 @@ bool
 {
 
    usize i;
+   byte* p;
+   buf_t* pb;
 
    assert(ptr != NULL);
    assert(ctx != NULL);
@@ -289,128 +647,171 @@ bool
    *ptr = NULL;
 
    /*
-    * Try to find free temporary var
+    * Take last released one
     *
     */
-   for (i=buf_get_length(&ctx->tmps); i>0; i--) {
-      ria_type_t type;
-      buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->tmps)[i-1]);
-      if (!ria_get_datatype_from_buf(&type, pb))
-         return false;
-      if (type == ria_unknown) {
-         *ptr = pb;
-         break; 
-      }
+   i = buf_get_length(&ctx->frees);
+   if (i > 0) {
+      *ptr = buf_get_ptr_ptrs(&ctx->frees)[i-1];
+      return buf_set_length(i-1, &ctx->frees);
    }
 
    /*
-    * Create new if not found
+    * Create new if none; room in released list is reserved as well
     *
     */
-   if (*ptr == NULL) {
-      byte* p;
-      buf_t* pb;
-      i = buf_get_length(&ctx->tmps);
-      if (!buf_expand(i+1, &ctx->tmps))
-         return false;
-      if (!buf_set_length(i+1, &ctx->tmps))
-         return false;
-      if (!heap_alloc((void**)&pb, sizeof(buf_t), ctx->mem))
-         return false;
-      if (!buf_create(1, 1, 0, pb, ctx->mem))
-         return false;
-      if (!ria_prealloc_datatype_in_buf(&p, ria_unknown, 0, pb))
-         return false;
-      buf_get_ptr_ptrs(&ctx->tmps)[i] = (byte*)pb;
-      *ptr = pb;
-   }
-
+   i = buf_get_length(&ctx->tmps);
+   if (!buf_expand(i+1, &ctx->tmps))
+      return false;
+   if (!buf_expand(i+1, &ctx->frees))
+      return false;
+   if (!buf_set_length(i+1, &ctx->tmps))
+      return false;
+   if (!heap_alloc((void**)&pb, sizeof(buf_t), ctx->mem))
+      return false;
+   if (!buf_create(1, 1, 0, pb, ctx->mem))
+      return false;
+   if (!ria_prealloc_datatype_in_buf(&p, ria_unknown, 0, pb))
+      return false;
+   buf_get_ptr_ptrs(&ctx->tmps)[i] = (byte*)pb;
+   *ptr = pb;
    return true;
 
 }
 
 /*****************************************************************************/
 bool 
-   ria_push_to_stack(                                            
+   ria_release_tmp(                                            
       ria_data_kind_t     IN       kind,
       void*               IN       ptr,
       ria_exec_state_t*   IN OUT   ctx)
 /*
- * Pushes data to stack
+ * Releases temporary variable after its value was consumed
  *
  */
 {
 
-   usize c;
-   byte** pp;
+   usize i;
 
    assert(ptr != NULL);
    assert(ctx != NULL);
 
-   c = buf_get_length(&ctx->stack);
-   if (c & 0x01)
-      ERR_SET(err_internal);
-   if (!buf_expand(c+2, &ctx->stack))
+   if (kind != ria_data_tmp)
+      return true;
+   if (!ria_set_datatype_into_buf((buf_t*)ptr, ria_unknown))
       return false;
 
-   pp = buf_get_ptr_ptrs(&ctx->stack);
-   pp[c+0] = (byte*)(usize)kind;
-   pp[c+1] = ptr;
-   return buf_set_length(c+2, &ctx->stack);
+   i = buf_get_length(&ctx->frees);
+   if (i >= buf_get_length(&ctx->tmps))
+      ERR_SET(err_internal);
+   buf_get_ptr_ptrs(&ctx->frees)[i] = (byte*)ptr;
+   return buf_set_length(i+1, &ctx->frees);
 
 }
 
 /*****************************************************************************/
 bool 
-   ria_pop_from_stack(    
-      ria_type_t*         OUT      type,
-      ria_data_kind_t*    OUT      kind,
-      void**              OUT      ptr,
+   ria_push_to_stack(                                            
+      ria_data_kind_t     IN       kind,
+      void*               IN       ptr,
       ria_exec_state_t*   IN OUT   ctx)
 /*
- * Pushes data to stack
+ * Pushes data to stack; literals are decoded into immediate values and 
+ * immediate values are copied into the stack slot
  *
  */
 {
 
    usize c;
-   byte** pp;
+   const byte* p;
+   ria_value_t* pv;
 
-   assert(kind != NULL);
-   assert(ptr  != NULL);
-   assert(ctx  != NULL);
+   assert(ptr != NULL);
+   assert(ctx != NULL);
 
    c = buf_get_length(&ctx->stack);
-   if ((c == 0) || (c & 0x01))
-      ERR_SET(err_internal);
-
-   pp = buf_get_ptr_ptrs(&ctx->stack);
-   *kind = (ria_data_kind_t)(usize)pp[c-2];
-   *ptr  = pp[c-1];
-   if (*ptr == NULL)
+   if (ctx->cstack > c)
       ERR_SET(err_internal);
+   if (ctx->cstack == c) {
+      if (!buf_expand(c+1, &ctx->stack))
+         return false;
+      if (!buf_set_length(buf_get_allocated_size(&ctx->stack), &ctx->stack))
+         return false;
+   }
 
-   /*
-    * Detect type
-    *
-    */
-   switch (*kind) {
+   pv = (ria_value_t*)buf_get_ptr_bytes(&ctx->stack) + ctx->cstack;
+   switch (kind) {
+   case ria_data_int:
+      p = (const byte*)ptr;
+      for (c=(p[0] & 0x03)+1, pv->u.n=0; c>0; c--)
+         pv->u.n = (pv->u.n << 8) | *(++p);
+      pv->kind = ria_data_imm;
+      pv->type = ria_int;
+      break;
+   case ria_data_imm:
+      *pv = *((const ria_value_t*)ptr);
+      break;
+   default:
+      pv->kind  = kind;
+      pv->type  = ria_unknown;
+      pv->u.ptr = ptr;
+   }
+   ctx->cstack++;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_pop_from_stack(    
+      ria_type_t*         OUT      type,
+      ria_data_kind_t*    OUT      kind,
+      void**              OUT      ptr,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Pops data from stack; immediate value is returned as pointer to its 
+ * stack slot, which stays valid till next push
+ *
+ */
+{
+
+   ria_value_t* pv;
+
+   assert(kind != NULL);
+   assert(ptr  != NULL);
+   assert(ctx  != NULL);
+
+   if ((ctx->cstack == 0) || (ctx->cstack > buf_get_length(&ctx->stack)))
+      ERR_SET(err_internal);
+
+   pv = (ria_value_t*)buf_get_ptr_bytes(&ctx->stack) + (--ctx->cstack);
+   *kind = pv->kind;
+
+   /*
+    * Detect type
+    *
+    */
+   switch (*kind) {
    case ria_data_var:
    case ria_data_tmp:
+      *ptr = pv->u.ptr;
+      if (*ptr == NULL)
+         ERR_SET(err_internal);
       if (!ria_get_datatype_from_buf(type, (buf_t*)*ptr))
          ERR_SET(err_internal);
       break;
-   case ria_data_int:
-      *type = ria_int;
+   case ria_data_imm:
+      *ptr  = pv;
+      *type = pv->type;
       break;         
    default:
+      *ptr = pv->u.ptr;
+      if (*ptr == NULL)
+         ERR_SET(err_internal);
       *type = ria_string;
    }
 
-   if (c == 2)
-      return buf_destroy(&ctx->stack);
-   else
-      return buf_set_length(c-2, &ctx->stack);
+   return true;
 
 }
 
@@ -451,6 +852,17 @@ bool
       *c = (*((byte*)oper) & 0x03) + 1;
       *type = ria_int;      
       break;   
+   case ria_data_imm:
+      *type = ((ria_value_t*)oper)->type;
+      if (*type == ria_int) {
+         *p = (byte*)&((ria_value_t*)oper)->u.n;
+         *c = sizeof(ria_int_t);
+      }
+      else {
+         *p = &((ria_value_t*)oper)->u.b;
+         *c = 1;
+      }
+      break;   
    default:
       ERR_SET(err_internal);
    }
@@ -459,6 +871,48 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_get_operand_int( 
+      ria_int_t*          OUT      value,
+      ria_data_kind_t     IN       kind,
+      void*               IN       oper,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Returns value of integer operand
+ *
+ */
+{
+
+   const byte* p;
+   usize c;
+
+   assert(value != NULL);
+   assert(oper  != NULL);
+   UNUSED(ctx);
+
+   switch (kind) {
+   case ria_data_var:
+   case ria_data_tmp:
+      return ria_get_int_from_buf(value, (buf_t*)oper);
+   case ria_data_int:
+      /* Literal is decoded straight from push command */
+      p = (const byte*)oper;
+      c = (p[0] & 0x03) + 1;
+      for (*value=0; c>0; c--)
+         *value = (*value << 8) | *(++p);
+      return true;
+   case ria_data_imm:
+      if (((ria_value_t*)oper)->type != ria_int)
+         ERR_SET(err_internal);
+      *value = ((ria_value_t*)oper)->u.n;
+      return true;
+   default:
+      ERR_SET(err_internal);
+   }
+
+}
+
 
 /******************************************************************************
  *  Execution 
@@ -482,6 +936,8 @@ bool
    byte*  p1;
    byte*  p3;
    usize  c1;
+   ria_int_t  n;
+   byte       b[sizeof(ria_int_t)];
    ria_type_t type;
 
    assert(data3 != NULL);
@@ -494,6 +950,9 @@ bool
     */
    if (!ria_get_operand_info(&type, &p1, &c1, kind1, data1, ctx))
       return false;
+   if (type == ria_int)
+      if (!ria_get_operand_int(&n, kind1, data1, ctx))
+         return false;
 
    /*
     * Prepare result
@@ -503,17 +962,33 @@ bool
    case ria_data_var:
    case ria_data_tmp:
       pr = (buf_t*)data3;
+      if (type == ria_int)
+         return ria_set_int_into_buf(pr, n);
       if (!ria_prealloc_datatype_in_buf(&p3, type, c1, pr))
          return false;
       MemMove(p3, p1, c1);
       break;
    case ria_data_res:
       pr = (buf_t*)data3;
+      if (type == ria_int) {
+         /* Integer result is returned big endian */
+         for (c1=sizeof(b); c1>0; c1--, n>>=8)
+            b[c1-1] = (byte)n;
+         p1 = b;
+         c1 = sizeof(b);
+      }
       if (type == ria_string) {
          if (c1 == 0)
             ERR_SET(err_internal);
          c1--;    
       }
+      if (type == ria_list)
+         ERR_SET(err_internal);
+      /* Result buffer is caller's one, keep size it needs */
+      if (c1 > buf_get_allocated_size(pr)) {
+         ctx->cresult = c1;
+         ERR_SET(err_bad_length);
+      }
       if (!buf_load(p1, 0, c1, pr))
          return false;
       break;
@@ -592,6 +1067,61 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_append(                                            
+      void*               IN       data3,
+      ria_data_kind_t     IN       kind1,
+      void*               IN       data1,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Appends string data to string variable in place, variable storage 
+ * grows geometrically
+ *
+ */
+{
+
+   buf_t* pr;
+   byte*  p1;
+   byte*  p3;
+   usize  c1;
+   usize  c3;
+   ria_type_t type;
+
+   assert(data3 != NULL);
+   assert(data1 != NULL);
+   assert(ctx   != NULL);
+
+   /*
+    * Get operands, variable cannot be appended to itself
+    *
+    */
+   if (!ria_get_operand_info(&type, &p1, &c1, kind1, data1, ctx))
+      return false;
+   if (type != ria_string)
+      ERR_SET(err_internal);
+   pr = (buf_t*)data3;
+   if (!ria_get_datainfo_from_buf(&type, &p3, &c3, pr))
+      return false;
+   if ((type != ria_string) || (c3 == 0) || (data1 == data3))
+      ERR_SET(err_internal);
+
+   /*
+    * Append over zero terminator
+    *
+    */
+   c1--;
+   if (!buf_expand(c3+c1+1, pr))
+      return false;
+   if (!buf_set_length(c3+c1+1, pr))
+      return false;
+   p3 = buf_get_ptr_bytes(pr) + c3;
+   MemMove(p3, p1, c1);
+   p3[c1] = 0x00;
+   return true;
+
+}
+
 /*****************************************************************************/
 bool 
    ria_math(                                            
@@ -609,16 +1139,9 @@ bool
  */
 {
 
-   buf_t*  pr;
-   byte*   p1 = NULL;
-   byte*   p2 = NULL;
-   byte*   p3 = NULL;
-   usize   c1 = 0;
-   usize   c2 = 0;
-   unumber u1 = 0;
-   unumber u2 = 0;
-   bool    unary = false;
-   ria_type_t type;
+   ria_int_t n1 = 0;
+   ria_int_t n2 = 0;
+   bool      unary = false;
 
    assert(data3 != NULL);
    assert(data1 != NULL);
@@ -628,18 +1151,13 @@ bool
     * Get operands
     *
     */
-   if (!ria_get_operand_info(&type, &p1, &c1, kind1, data1, ctx))
+   if (!ria_get_operand_int(&n1, kind1, data1, ctx))
       return false;
-   if (type != ria_int)
-      ERR_SET(err_internal);
    if (data2 == NULL)
       unary = true;
-   else {      
-      if (!ria_get_operand_info(&type, &p2, &c2, kind2, data2, ctx))
+   else      
+      if (!ria_get_operand_int(&n2, kind2, data2, ctx))
          return false;
-      if (type != ria_int)
-         ERR_SET(err_internal);
-   }
    if (unary)
       switch (oper) {
       case '-':
@@ -652,29 +1170,27 @@ bool
     * Prepare result
     *
     */
+   switch (oper) {
+   case '-':
+      if (unary)
+         n1 = -n1;
+      else   
+         n1 -= n2;
+      break;
+   case '+':
+      n1 += n2;
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
    switch (kind3) {
    case ria_data_var:
    case ria_data_tmp:
-      pr = (buf_t*)data3;
-      if (!ria_prealloc_datatype_in_buf(&p3, ria_int, 4, pr))
-         return false;
-      OS_B_U_COUNT(u1, p1, c1);  
-      if (!unary) 
-         OS_B_U_COUNT(u2, p2, c2);   
-      switch (oper) {
-      case '-':
-         if (unary)
-            u1 = -(signed)u1;
-         else   
-            u1 -= u2;
-         break;
-      case '+':
-         u1 += u2;
-         break;
-      default:
-         ERR_SET(err_internal);
-      }
-      U_OS_B_COUNT(p3, 4, u1);
+      return ria_set_int_into_buf((buf_t*)data3, n1);
+   case ria_data_imm:
+      ((ria_value_t*)data3)->kind = ria_data_imm;
+      ((ria_value_t*)data3)->type = ria_int;
+      ((ria_value_t*)data3)->u.n  = n1;
       break;
    default:
       ERR_SET(err_internal);
@@ -707,6 +1223,7 @@ bool
    byte*   p3 = NULL;
    usize   c1 = 0;
    usize   c2 = 0;
+   byte    b3;
    bool    unary = false;
    ria_type_t type;
 
@@ -742,25 +1259,31 @@ bool
     * Prepare result
     *
     */
+   switch (oper) {
+   case '!':
+      b3 = !(*p1);
+      break;
+   case '|':
+      b3 = (*p1) || (*p2);
+      break;
+   case '&':
+      b3 = (*p1) && (*p2);
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
    switch (kind3) {
    case ria_data_var:
    case ria_data_tmp:
       pr = (buf_t*)data3;
       if (!ria_prealloc_datatype_in_buf(&p3, ria_boolean, 1, pr))
          return false;
-      switch (oper) {
-      case '!':
-         *p3 = !(*p1);
-         break;
-      case '|':
-         *p3 = (*p1) || (*p2);
-         break;
-      case '&':
-         *p3 = (*p1) && (*p2);
-         break;
-      default:
-         ERR_SET(err_internal);
-      }
+      *p3 = b3;
+      break;
+   case ria_data_imm:
+      ((ria_value_t*)data3)->kind = ria_data_imm;
+      ((ria_value_t*)data3)->type = ria_boolean;
+      ((ria_value_t*)data3)->u.b  = b3;
       break;
    default:
       ERR_SET(err_internal);
@@ -795,6 +1318,8 @@ bool
    usize  c2;
    ria_type_t type1;
    ria_type_t type2;
+   ria_int_t  n1, n2;
+   byte b3;
    int i; 
 
    assert(data3 != NULL);
@@ -813,6 +1338,50 @@ bool
    if (type1 != type2)
       ERR_SET(err_internal);
 
+   /*
+    * Compare
+    *
+    */
+   if (type1 == ria_int) {
+      if (!ria_get_operand_int(&n1, kind1, data1, ctx))
+         return false;
+      if (!ria_get_operand_int(&n2, kind2, data2, ctx))
+         return false;
+      i = (n1 < n2) ? -1 : (n1 > n2) ? 1 : 0;
+   }
+   else 
+      if (c1 < c2) {
+         i = MemCmp(p1, p2, c1);
+         i = (i == 0) ? -1 : i;
+      }
+      else {
+         i = MemCmp(p1, p2, c2);
+         if (c1 > c2) 
+            i = (i == 0) ? 1 : i;
+      }
+   switch (opcode) {
+   case ria_opcode_less:
+      b3 = (i <  0) ? true : false;
+      break;
+   case ria_opcode_more:
+      b3 = (i >  0) ? true : false;
+      break;
+   case ria_opcode_less_eq:
+      b3 = (i <= 0) ? true : false;
+      break;
+   case ria_opcode_more_eq:
+      b3 = (i >= 0) ? true : false;
+      break;
+   case ria_opcode_eq:
+      b3 = (i == 0) ? true : false;
+      break;
+   case ria_opcode_not_eq:
+      b3 = (i != 0) ? true : false;
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
+
    /*
     * Prepare result
     *
@@ -823,55 +1392,12 @@ bool
       pr = (buf_t*)data3;
       if (!ria_prealloc_datatype_in_buf(&p3, ria_boolean, 1, pr))
          return false;
-      if (type1 == ria_int) {
-         i = 0;
-         if (c1 < c2) {
-            for (; c1<c2; c2--, p2++) 
-               if (p2[0] != 0) {
-                  i = -1;
-                  break;
-               }
-         }
-         else {
-            for (; c2<c1; c1--, p1++) 
-               if (p1[0] != 0) {
-                  i = 1;
-                  break;
-               }
-         }
-         if (i == 0)
-            i = MemCmp(p1, p2, c1);
-      }
-      else 
-         if (c1 < c2) {
-            i = MemCmp(p1, p2, c1);
-            i = (i == 0) ? -1 : i;
-         }
-         else {
-            i = MemCmp(p1, p2, c2);
-            if (c1 > c2) 
-               i = (i == 0) ? 1 : i;
-         }
-      switch (opcode) {
-      case ria_opcode_less:
-         *p3 = (i <  0) ? true : false;
-         break;
-      case ria_opcode_more:
-         *p3 = (i >  0) ? true : false;
-         break;
-      case ria_opcode_less_eq:
-         *p3 = (i <= 0) ? true : false;
-         break;
-      case ria_opcode_more_eq:
-         *p3 = (i >= 0) ? true : false;
-         break;
-      case ria_opcode_eq:
-         *p3 = (i == 0) ? true : false;
-         break;
-      case ria_opcode_not_eq:
-         *p3 = (i != 0) ? true : false;
-         break;
-      }
+      *p3 = b3;
+      break;
+   case ria_data_imm:
+      ((ria_value_t*)data3)->kind = ria_data_imm;
+      ((ria_value_t*)data3)->type = ria_boolean;
+      ((ria_value_t*)data3)->u.b  = b3;
       break;
    default:
       ERR_SET(err_internal);
@@ -939,11 +1465,9 @@ bool
     * Unwind the stack
     *
     */
-   c = buf_get_length(&ctx->stack);
-   if ((c & 0x01) || (c < cunwind*2))
+   if (ctx->cstack < cunwind)
       ERR_SET(err_internal);
-   if (!buf_set_length(c-2*cunwind, &ctx->stack))
-      return false;
+   ctx->cstack -= cunwind;
 
    /*
     * Fix result if needed
@@ -977,9 +1501,14 @@ bool
    usize k, c;
    unumber i, j;
    function_fn* impl;
-   byte** pp;
+   ria_value_t* pv;
+   void*  pt[ria_max_func_params];
    byte*  p;
    ria_type_t type;
+#ifdef USE_RIA_PROFILER
+   unumber f;
+   uint64 t0, t1;
+#endif
 
    assert(data3 != NULL);
    assert(ctx   != NULL);
@@ -991,6 +1520,9 @@ bool
    i = (b1 == 0x00) ? b0 : (b0 << 8) | b1;
    if (!ria_get_function_info(&type, &j, &impl, i))
       return false;
+#ifdef USE_RIA_PROFILER
+   f = i;
+#endif
 
    /*
     * Check output 
@@ -1008,56 +1540,193 @@ bool
     * Repack parameters
     *
     */
-   c = buf_get_length(&ctx->stack);
-   if ((c & 0x01) || (c < j*2))
+   if ((ctx->cstack < j) || (j > ria_max_func_params))
       ERR_SET(err_internal);
-   pp = buf_get_ptr_ptrs(&ctx->stack) + c - 2*j;
-   for (i=0, p=(byte*)pp, k=2*sizeof(void*); i<j; i++, k+=2*sizeof(void*)) 
-      if (!ria_pack_func_param(&p, &k, (ria_data_kind_t)(usize)pp[i*2], pp[i*2+1]))
+   pv = (ria_value_t*)buf_get_ptr_bytes(&ctx->stack) + ctx->cstack - j;
+   for (i=0, c=0; i<j; i++)
+      if (pv[i].kind == ria_data_tmp)
+         pt[c++] = pv[i].u.ptr;
+   for (i=0, p=(byte*)pv, k=sizeof(ria_value_t); i<j; i++, k+=sizeof(ria_value_t)) 
+      if (!ria_pack_func_param(&p, &k, pv[i].kind, 
+              (pv[i].kind == ria_data_imm) ? (void*)&pv[i] : pv[i].u.ptr))
          return false;
 
    /*
     * Invoke 
     *
     */
-   return ria_invoke_func(data3, impl, (byte*)pp, p-(byte*)pp, j, type, ctx);
+#ifdef USE_RIA_PROFILER
+   if (ctx->profile.on)
+      if (!ria_papi_get_time(&t0))
+         return false;
+#endif
+   if (!ria_invoke_func(data3, impl, (byte*)pv, p-(byte*)pv, j, type, ctx))
+      return false;
+#ifdef USE_RIA_PROFILER
+   if (ctx->profile.on && (f < ria_profile_max_funcs)) {
+      if (!ria_papi_get_time(&t1))
+         return false;
+      ctx->profile.funcs[f].count++;
+      ctx->profile.funcs[f].time += t1 - t0;
+   }
+#endif
+#ifdef USE_RIA_ASYNC_CALLS   
+   if (ctx->status == ria_exec_pending)
+      return true;
+#endif      
+
+   /*
+    * Release temporaries passed by val; register code releases its 
+    * operands itself
+    *
+    */
+#ifndef USE_RIA_REGISTER_CODE
+   for (i=0; i<c; i++)
+      if (!ria_release_tmp(ria_data_tmp, pt[i], ctx))
+         return false;
+#endif
+   return true;
 
 }
 
 /*****************************************************************************/
 bool 
-   ria_execute_command(                                            
+   ria_start_limits(                                            
       ria_exec_state_t*   IN OUT   ctx)
 /*
- * Executes single command
+ * Starts counting execution limits
  *
  */
 {
 
-   void* pd1 = NULL;
-   void* pd2 = NULL;
-   void* pd3 = NULL;
-   ria_data_kind_t kind1 = 0;
-   ria_data_kind_t kind2 = 0;
-   ria_data_kind_t kind3 = 0;
-   ria_type_t type1;
-   ria_type_t type2;
-   byte b0, b1 = 0;
-   byte* pd;
-   usize u;
+   uint64 t;
 
    assert(ctx != NULL);
 
-   if (ctx->cexec < 1) {
-      SET_EXECUTE_ERROR(ctx);
+   ctx->limit = ria_limit_none;
+   ctx->ops   = 0;
+   ctx->check = (uint64)-1;
+   if ((ctx->limits.time == 0) && (ctx->limits.ops == 0) && 
+       (ctx->limits.memory == 0))
       return true;
+   ctx->check = (ctx->limits.memory != 0) ? 1 : ria_limit_period;
+   if ((ctx->limits.ops != 0) && (ctx->limits.ops < ctx->check))
+      ctx->check = ctx->limits.ops;
+   if (ctx->limits.time != 0) {
+      if (!ria_papi_get_time(&t))
+         return false;
+      ctx->deadline = t + ctx->limits.time;
    }
+   return true;
 
-   RIA_TRACE_START;
+}
 
-   switch (ctx->pexec[0]) {
+/*****************************************************************************/
+bool 
+   ria_check_limits(                                            
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Checks execution limits on backward jump when executed commands reach 
+ * next check point, sets limit status if any of them is exceeded
+ *
+ */
+{
 
-   /* Push */
+   buf_t* bufs[3];
+   buf_t* pb;
+   uint64 t;
+   usize i, j, c;
+
+   assert(ctx != NULL);
+
+   /*
+    * Commands
+    *
+    */
+   if ((ctx->limits.ops != 0) && (ctx->ops >= ctx->limits.ops)) {
+      ctx->limit = ria_limit_ops;
+      goto exceeded;
+   }
+   ctx->check = ctx->ops + ((ctx->limits.memory != 0) ? 1 : ria_limit_period);
+   if ((ctx->limits.ops != 0) && (ctx->limits.ops < ctx->check))
+      ctx->check = ctx->limits.ops;
+
+   /*
+    * Time
+    *
+    */
+   if (ctx->limits.time != 0) {
+      if (!ria_papi_get_time(&t))
+         return false;
+      if (t >= ctx->deadline) {
+         ctx->limit = ria_limit_time;
+         goto exceeded;
+      }
+   }
+
+   /*
+    * Memory held by variables and temporaries
+    *
+    */
+   if (ctx->limits.memory != 0) {
+      bufs[0] = &ctx->vars;
+      bufs[1] = &ctx->globals;
+      bufs[2] = &ctx->tmps;
+      for (j=0, c=0; j<3; j++)
+         for (i=buf_get_length(bufs[j]); i>0; i--) {
+            pb = (buf_t*)(buf_get_ptr_ptrs(bufs[j])[i-1]);
+            if (pb != NULL)
+               c += buf_get_allocated_size(pb);
+         }
+      if (c > ctx->limits.memory) {
+         ctx->limit = ria_limit_memory;
+         goto exceeded;
+      }
+   }
+   return true;
+
+exceeded:
+   ctx->status = ria_exec_limit;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_execute_command(                                            
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Executes single command
+ *
+ */
+{
+
+   void* pd1 = NULL;
+   void* pd2 = NULL;
+   void* pd3 = NULL;
+   ria_data_kind_t kind1 = 0;
+   ria_data_kind_t kind2 = 0;
+   ria_data_kind_t kind3 = 0;
+   ria_type_t type1;
+   ria_type_t type2;
+   byte b0, b1 = 0;
+   byte* pd;
+   usize u, k;
+   ria_int_t n;
+   ria_value_t v;
+
+   assert(ctx != NULL);
+
+   if (ctx->cexec < 1) {
+      SET_EXECUTE_ERROR(ctx);
+      return true;
+   }
+
+   RIA_TRACE_START;
+
+   switch (ctx->pexec[0]) {
+
+   /* Push */
    case ria_opcode_pushi4:
       if (ctx->cexec < 5) {
          SET_EXECUTE_ERROR(ctx);
@@ -1085,7 +1754,7 @@ bool
       switch (ctx->pexec[0]) {
       case ria_opcode_pushv:
          RIA_TRACE_MSG("PUSHV");
-         if (!ria_get_var(&pd1, ctx->pexec[1], false, ctx))
+         if (!ria_get_var(&pd1, ria_get_narrow_var(ctx->pexec[1]), false, ctx))
             return false;
          kind1 = ria_data_var;
          break;
@@ -1097,7 +1766,7 @@ bool
          break;
       case ria_opcode_pushs2:
          RIA_TRACE_MSG("PUSHS2");
-         if (!ria_get_str(&pd1, (ctx->pexec[1]<<8)|ctx->pexec[0], ctx))
+         if (!ria_get_str(&pd1, (ctx->pexec[1]<<8)|ctx->pexec[2], ctx))
             return false;
          kind1 = ria_data_str;
          break;
@@ -1142,12 +1811,116 @@ bool
       }
       break;
 
+   /* Push variable, wide form */
+   case ria_opcode_pushvw:
+      RIA_TRACE_MSG("PUSHVW");
+      if (!ria_decode_varint(&u, &k, ctx->pexec+1, ctx->cexec-1))
+         return false;
+      if (!ria_get_var(&pd1, ria_get_wide_var(u), false, ctx))
+         return false;
+      if (pd1 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }            
+      if (!ria_push_to_stack(ria_data_var, pd1, ctx))
+         return false;
+      ctx->pexec += k + 1;
+      ctx->cexec -= k + 1;
+      break;
+
+   /* Push variable and string */
+   case ria_opcode_pushvs:
+      RIA_TRACE_MSG("PUSHVS");
+      if (ctx->cexec < 3) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_get_var(&pd1, ria_get_narrow_var(ctx->pexec[1]), false, ctx))
+         return false;
+      if (!ria_get_str(&pd2, ctx->pexec[2], ctx))
+         return false;
+      if ((pd1 == NULL) || (pd2 == NULL)) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }            
+      if (!ria_push_to_stack(ria_data_var, pd1, ctx))
+         return false;
+      if (!ria_push_to_stack(ria_data_str, pd2, ctx))
+         return false;
+      ctx->pexec += 3;
+      ctx->cexec -= 3;
+      break;
+
+   /* Increment/decrement variable */
+   case ria_opcode_incv:
+   case ria_opcode_decv:
+      switch (ctx->pexec[0]) {
+      case ria_opcode_incv:
+         RIA_TRACE_MSG("INCV");
+         break;
+      case ria_opcode_decv:
+         RIA_TRACE_MSG("DECV");
+         break;
+      }
+      if (ctx->cexec < 3) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_get_var(&pd1, ria_get_narrow_var(ctx->pexec[1]), false, ctx))
+         return false;
+      if (pd1 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }            
+      if (!ria_get_int_from_buf(&n, (buf_t*)pd1))
+         return false;
+      if (ctx->pexec[0] == ria_opcode_incv)
+         n += ctx->pexec[2];
+      else
+         n -= ctx->pexec[2];
+      MemCpy(buf_get_ptr_bytes((buf_t*)pd1)+1, &n, sizeof(n));
+      ctx->pexec += 3;
+      ctx->cexec -= 3;
+      break;
+
+   /* Append to variable */
+   case ria_opcode_appv:
+      RIA_TRACE_MSG("APPV");
+      if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+         return false;
+      if (!ria_get_var(&pd3, ria_get_narrow_var(ctx->pexec[1]), false, ctx))
+         return false;
+      if (pd3 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_append(pd3, kind1, pd1, ctx))
+         return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
+      ctx->pexec += 2;
+      ctx->cexec -= 2;
+      break;
+
+   /* Release variable */
+   case ria_opcode_kill:
+      RIA_TRACE_MSG("KILL");
+      if (ctx->cexec < 2) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_kill_var(ria_get_narrow_var(ctx->pexec[1]), ctx))
+         return false;
+      ctx->pexec += 2;
+      ctx->cexec -= 2;
+      break;
+
    /* Pop */
    case ria_opcode_pop:
       RIA_TRACE_MSG("POP");
       if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
          return false;
-      if (!ria_get_var(&pd3, ctx->pexec[1], true, ctx))
+      if (!ria_get_var(&pd3, ria_get_narrow_var(ctx->pexec[1]), true, ctx))
          return false;
       if (pd3 == NULL) {
          SET_EXECUTE_ERROR(ctx);
@@ -1155,21 +1928,40 @@ bool
       }
       if (!ria_copy(ria_data_var, pd3, kind1, pd1, ctx))
          return false;
-      if (kind1 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd1, ria_unknown))
-            return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
       ctx->pexec += 2;
       ctx->cexec -= 2;
       break;
 
+   /* Pop, wide form */
+   case ria_opcode_popw:
+      RIA_TRACE_MSG("POPW");
+      if (!ria_decode_varint(&u, &k, ctx->pexec+1, ctx->cexec-1))
+         return false;
+      if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+         return false;
+      if (!ria_get_var(&pd3, ria_get_wide_var(u), true, ctx))
+         return false;
+      if (pd3 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_copy(ria_data_var, pd3, kind1, pd1, ctx))
+         return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
+      ctx->pexec += k + 1;
+      ctx->cexec -= k + 1;
+      break;
+
    /* Unary arithmetics*/
    case ria_opcode_neg:
       RIA_TRACE_MSG("NEG");
       if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
          return false;
-      if (!ria_get_tmp(&pd3, ctx))
-         return false;
-      kind3 = ria_data_tmp;
+      pd3 = &v;
+      kind3 = ria_data_imm;
       if (type1 == ria_int) 
          switch (ctx->pexec[0]) {
          case ria_opcode_neg:
@@ -1181,9 +1973,8 @@ bool
          }
       else
          ERR_SET(err_internal);
-      if (kind1 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd1, ria_unknown))
-            return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
       if (!ria_push_to_stack(kind3, pd3, ctx))
          return false;
       ctx->pexec++;
@@ -1199,9 +1990,13 @@ bool
          return false;
       if (type1 != type2)
          ERR_SET(err_internal);
-      if (!ria_get_tmp(&pd3, ctx))
-         return false;
-      kind3 = ria_data_tmp;
+      pd3 = &v;
+      kind3 = ria_data_imm;
+      if (type1 == ria_string) {
+         if (!ria_get_tmp(&pd3, ctx))
+            return false;
+         kind3 = ria_data_tmp;
+      }
       if (type1 == ria_string) 
          switch (ctx->pexec[0]) {
          case ria_opcode_add:
@@ -1246,12 +2041,10 @@ bool
          }
       else
          ERR_SET(err_internal);
-      if (kind1 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd1, ria_unknown))
-            return false;
-      if (kind2 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd2, ria_unknown))
-            return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
+      if (!ria_release_tmp(kind2, pd2, ctx))
+         return false;
       if (!ria_push_to_stack(kind3, pd3, ctx))
          return false;
       ctx->pexec++;
@@ -1264,9 +2057,8 @@ bool
          return false;
       if (!ria_copy(ria_data_res, &ctx->result, kind1, pd1, ctx))
          return false;
-      if (kind1 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd1, ria_unknown))
-            return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
    case ria_opcode_retn:
       if (ctx->pexec[0] == ria_opcode_retn)
          buf_set_length(0, &ctx->result);   
@@ -1302,6 +2094,15 @@ bool
       case ria_opcode_call2p:
          if (!ria_push_to_stack(kind3, pd3, ctx))
             return false;
+         break;
+      default:
+         /* Ignored result is released, unless call is pending */
+#ifdef USE_RIA_ASYNC_CALLS   
+         if (ctx->status == ria_exec_pending)
+            break;
+#endif
+         if (!ria_release_tmp(kind3, pd3, ctx))
+            return false;
       }            
       if (b1 == 0) {
          ctx->pexec += 2;
@@ -1313,6 +2114,35 @@ bool
       }
       break;
 
+   /* Calls with store to variable */
+   case ria_opcode_call2v:
+      if (ctx->cexec < 4) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      b1 = ctx->pexec[2];
+   case ria_opcode_callv:
+      u = (ctx->pexec[0] == ria_opcode_call2v) ? 4 : 3;
+      if (ctx->cexec < u) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      b0 = ctx->pexec[1];
+      if (!ria_get_var(&pd3, ria_get_narrow_var(ctx->pexec[u-1]), true, ctx))
+         return false;
+      if (pd3 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      kind3 = ria_data_var;
+      RIA_TRACE_MSG("CALLV ");
+      RIA_TRACE_INT((b1 == 0x00) ? b0 : (b0 << 8) | b1);
+      if (!ria_call(kind3, pd3, b0, b1, ctx))
+         return false;
+      ctx->pexec += u;
+      ctx->cexec -= u;
+      break;
+
    /* Comparations */
    case ria_opcode_less:
    case ria_opcode_more:
@@ -1346,17 +2176,14 @@ bool
          return false;
       if (type1 != type2)
          ERR_SET(err_internal);
-      if (!ria_get_tmp(&pd3, ctx))
-         return false;
-      kind3 = ria_data_tmp;
+      pd3 = &v;
+      kind3 = ria_data_imm;
       if (!ria_cmp(kind3, pd3, kind1, pd1, kind2, pd2, ctx->pexec[0], ctx))
          return false;
-      if (kind1 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd1, ria_unknown))
-            return false;
-      if (kind2 == ria_data_tmp)
-         if (!ria_set_datatype_into_buf((buf_t*)pd2, ria_unknown))
-            return false;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
+      if (!ria_release_tmp(kind2, pd2, ctx))
+         return false;
       if (!ria_push_to_stack(kind3, pd3, ctx))
          return false;
       ctx->pexec++;
@@ -1366,8 +2193,10 @@ bool
    /* Conditional jumps */
    case ria_opcode_jif:
    case ria_opcode_jif2:
+   case ria_opcode_jif4:
    case ria_opcode_jit:
    case ria_opcode_jit2:
+   case ria_opcode_jit4:
       if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
          return false;
       if (type1 != ria_boolean)
@@ -1393,7 +2222,17 @@ bool
          u = (int16)(((*pd != 0) ? (ctx->pexec[1] << 8) | ctx->pexec[2] : 0));
          u = ((int)u < 0) ? u : u+3;
          break;
+      case ria_opcode_jif4:
+         u = (*pd == 0) ? ria_get_offset4(ctx->pexec+1) : 0;
+         u = ((int)u < 0) ? u : u+5;
+         break;
+      case ria_opcode_jit4:
+         u = (*pd != 0) ? ria_get_offset4(ctx->pexec+1) : 0;
+         u = ((int)u < 0) ? u : u+5;
+         break;
       }
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         return false;
       ctx->pexec += (int)u;
       ctx->cexec -= (int)u;
       break;
@@ -1411,6 +2250,12 @@ bool
       ctx->pexec += (int)u;
       ctx->cexec -= (int)u;
       break;
+   case ria_opcode_jmp4:
+      u = ria_get_offset4(ctx->pexec+1);
+      u = ((int)u < 0) ? u : u+5;
+      ctx->pexec += (int)u;
+      ctx->cexec -= (int)u;
+      break;
 
    default:
       ERR_SET(err_internal);
@@ -1440,58 +2285,1118 @@ bool
 }
 
 
-/******************************************************************************
- *  Execution state
+#ifdef USE_RIA_DIRECT_DISPATCH
+
+/*
+ * Dispatches next command of validated code
+ *
  */
+#define RIA_DIRECT_NEXT(_k)                                                   \
+       {                                                                      \
+          p += (_k);                                                          \
+          ops++;                                                              \
+          goto *_dispatch[*p];                                                \
+       }
 
-enum {
-   cf_ria_exec_state_params  = 0x001,
-   cf_ria_exec_state_vars    = 0x002,
-   cf_ria_exec_state_stack   = 0x004,
-   cf_ria_exec_state_tmps    = 0x008,
-   cf_ria_exec_state_result  = 0x010,
-   cf_ria_exec_state_http    = 0x020,
-   cf_ria_exec_state_globals = 0x040,
-   cf_ria_exec_state_parser  = 0x080
-};
+/*
+ * Jumps backward, checking execution limits when check point is reached
+ *
+ */
+#define RIA_DIRECT_BACK(_k)                                                   \
+       {                                                                      \
+          p += (_k);                                                          \
+          ops++;                                                              \
+          if (ctx->ops + ops >= ctx->check)                                   \
+             goto limits;                                                     \
+          goto *_dispatch[*p];                                                \
+       }
+
+/*
+ * Sixteen entries of dispatch table which are not commands
+ *
+ */
+#define RIA_DIRECT_BAD16                                                      \
+       &&op_bad, &&op_bad, &&op_bad, &&op_bad,                                \
+       &&op_bad, &&op_bad, &&op_bad, &&op_bad,                                \
+       &&op_bad, &&op_bad, &&op_bad, &&op_bad,                                \
+       &&op_bad, &&op_bad, &&op_bad, &&op_bad
+
+/*
+ * Pushes to stack of validated code, which is pre-sized to its max depth
+ *
+ */
+#define RIA_DIRECT_PUSH(_kind, _ptr)                                          \
+       {                                                                      \
+          assert(ctx->cstack < buf_get_length(&ctx->stack));                  \
+          ps[ctx->cstack].kind  = (_kind);                                    \
+          ps[ctx->cstack].type  = ria_unknown;                                \
+          ps[ctx->cstack].u.ptr = (_ptr);                                     \
+          ctx->cstack++;                                                      \
+       }
+#define RIA_DIRECT_PUSH_INT(_n)                                               \
+       {                                                                      \
+          assert(ctx->cstack < buf_get_length(&ctx->stack));                  \
+          ps[ctx->cstack].kind = ria_data_imm;                                \
+          ps[ctx->cstack].type = ria_int;                                     \
+          ps[ctx->cstack].u.n  = (_n);                                        \
+          ctx->cstack++;                                                      \
+       }
 
 /*****************************************************************************/
 bool 
-   ria_exec_state_clean_locals(     
+   ria_execute_direct(                                            
       ria_exec_state_t*   IN OUT   ctx)
 /*
- * Cleans local state 
+ * Executes validated function code command by command with direct-threaded
+ * dispatch; bounds and jump targets are checked by ria_validate_script, so
+ * operands are decoded in place without size checks
  *
  */
 {
 
-   bool ret = true;
-   usize i;
+   /*
+    * Commands are dispatched by opcode, table is positional
+    *
+    */
+   static const void* const _dispatch[0x100] = {
+      /* 0x00 */ &&op_pushv,    &&op_pushvs,   &&op_bad,      &&op_pushvw,
+      /* 0x04 */ &&op_pushs,    &&op_pushs2,   &&op_bad,      &&op_bad,
+      /* 0x08 */ &&op_pushi1,   &&op_pushi2,   &&op_pushi3,   &&op_pushi4,
+      /* 0x0C */ &&op_pushp,    &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x10 */ &&op_call,     &&op_call2,    &&op_call,     &&op_call2,
+      /* 0x14 */ &&op_callv,    &&op_call2v,   &&op_bad,      &&op_bad,
+      /* 0x18 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x1C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x20 */ &&op_binary,   &&op_cmp,      &&op_cmp,      &&op_cmp,
+      /* 0x24 */ &&op_cmp,      &&op_cmp,      &&op_cmp,      &&op_binary,
+      /* 0x28 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x2C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_neg,
+      /* 0x30 */ &&op_pop,      &&op_popw,     &&op_incv,     &&op_incv,
+      /* 0x34 */ &&op_appv,     &&op_kill,     &&op_bad,      &&op_bad,
+      /* 0x38 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x3C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x40 */ &&op_jcond,    &&op_jcond,    &&op_jcond,    &&op_bad,
+      /* 0x44 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x48 */ &&op_jcond,    &&op_jcond,    &&op_jcond,    &&op_bad,
+      /* 0x4C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x50 */ &&op_jmp,      &&op_jmp2,     &&op_jmp4,     &&op_bad,
+      /* 0x54 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x58 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x5C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x60 */ &&op_ret,      &&op_retn,     &&op_bad,      &&op_bad,
+      /* 0x64 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x68 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x6C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x70 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x74 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x78 */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x7C */ &&op_bad,      &&op_bad,      &&op_bad,      &&op_bad,
+      /* 0x80 */ RIA_DIRECT_BAD16, RIA_DIRECT_BAD16,
+      /* 0xA0 */ RIA_DIRECT_BAD16, RIA_DIRECT_BAD16,
+      /* 0xC0 */ RIA_DIRECT_BAD16, RIA_DIRECT_BAD16,
+      /* 0xE0 */ RIA_DIRECT_BAD16, RIA_DIRECT_BAD16
+   };
+
+   void* pd1 = NULL;
+   void* pd2 = NULL;
+   void* pd3 = NULL;
+   ria_data_kind_t kind1 = 0;
+   ria_data_kind_t kind2 = 0;
+   ria_data_kind_t kind3 = 0;
+   ria_type_t type1;
+   ria_type_t type2;
+   ria_value_t  v;
+   ria_value_t* ps;
+   const byte* p;
+   byte  b1;
+   byte* pd;
+   usize u, k;
+   ria_int_t n;
+   uint64 ops = 0;
+   bool  ret = false;
 
    assert(ctx != NULL);
 
-   if (ctx->cleanup & cf_ria_exec_state_vars) {
-      for (i=buf_get_length(&ctx->vars); i>0; i--) {
-         buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->vars)[i-1]);
-         if (pb == NULL)
-            continue;
-         ret = buf_destroy(pb) && ret;
-         ret = heap_free(pb, ctx->mem) && ret;
-      }
-      ret = buf_destroy(&ctx->vars) && ret;
-   }
-   if (ctx->cleanup & cf_ria_exec_state_tmps) {
-      for (i=buf_get_length(&ctx->tmps); i>0; i--) {
-         buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->tmps)[i-1]);
-         if (pb == NULL)
-            continue;
-         ret = buf_destroy(pb) && ret;
+   ps = (ria_value_t*)buf_get_ptr_bytes(&ctx->stack);
+   p  = ctx->pexec;
+   goto *_dispatch[*p];
+
+   /* Push */
+op_pushv:
+   if (!ria_get_var(&pd1, ria_get_narrow_var(p[1]), false, ctx))
+      goto exit;
+   if (pd1 == NULL)
+      goto failed;
+   RIA_DIRECT_PUSH(ria_data_var, pd1);
+   RIA_DIRECT_NEXT(2);
+
+op_pushvw:
+   if (!ria_decode_varint(&u, &k, p+1, ctx->cexec-(p-ctx->pexec)-1))
+      goto exit;
+   if (!ria_get_var(&pd1, ria_get_wide_var(u), false, ctx))
+      goto exit;
+   if (pd1 == NULL)
+      goto failed;
+   RIA_DIRECT_PUSH(ria_data_var, pd1);
+   RIA_DIRECT_NEXT(k+1);
+
+op_pushvs:
+   if (!ria_get_var(&pd1, ria_get_narrow_var(p[1]), false, ctx))
+      goto exit;
+   if (!ria_get_str(&pd2, p[2], ctx))
+      goto exit;
+   if ((pd1 == NULL) || (pd2 == NULL))
+      goto failed;
+   RIA_DIRECT_PUSH(ria_data_var, pd1);
+   RIA_DIRECT_PUSH(ria_data_str, pd2);
+   RIA_DIRECT_NEXT(3);
+
+op_pushs:
+   if (!ria_get_str(&pd1, p[1], ctx))
+      goto exit;
+   RIA_DIRECT_PUSH(ria_data_str, pd1);
+   RIA_DIRECT_NEXT(2);
+
+op_pushs2:
+   if (!ria_get_str(&pd1, (p[1]<<8)|p[2], ctx))
+      goto exit;
+   RIA_DIRECT_PUSH(ria_data_str, pd1);
+   RIA_DIRECT_NEXT(3);
+
+op_pushp:
+   if (!ria_get_par(&pd1, p[1], ctx))
+      goto exit;
+   if (pd1 == NULL)
+      goto failed;
+   RIA_DIRECT_PUSH(ria_data_par, pd1);
+   RIA_DIRECT_NEXT(2);
+
+op_pushi1:
+   RIA_DIRECT_PUSH_INT(p[1]);
+   RIA_DIRECT_NEXT(2);
+
+op_pushi2:
+   RIA_DIRECT_PUSH_INT((p[1] << 8) | p[2]);
+   RIA_DIRECT_NEXT(3);
+
+op_pushi3:
+   RIA_DIRECT_PUSH_INT((p[1] << 16) | (p[2] << 8) | p[3]);
+   RIA_DIRECT_NEXT(4);
+
+op_pushi4:
+   RIA_DIRECT_PUSH_INT(((ria_int_t)p[1] << 24) | (p[2] << 16) | (p[3] << 8) | p[4]);
+   RIA_DIRECT_NEXT(5);
+
+   /* Increment/decrement variable */
+op_incv:
+   if (!ria_get_var(&pd1, ria_get_narrow_var(p[1]), false, ctx))
+      goto exit;
+   if (pd1 == NULL)
+      goto failed;
+   if (!ria_get_int_from_buf(&n, (buf_t*)pd1))
+      goto exit;
+   if (p[0] == ria_opcode_incv)
+      n += p[2];
+   else
+      n -= p[2];
+   MemCpy(buf_get_ptr_bytes((buf_t*)pd1)+1, &n, sizeof(n));
+   RIA_DIRECT_NEXT(3);
+
+   /* Append to variable */
+op_appv:
+   if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+      goto exit;
+   if (!ria_get_var(&pd3, ria_get_narrow_var(p[1]), false, ctx))
+      goto exit;
+   if (pd3 == NULL)
+      goto failed;
+   if (!ria_append(pd3, kind1, pd1, ctx))
+      goto exit;
+   if (!ria_release_tmp(kind1, pd1, ctx))
+      goto exit;
+   RIA_DIRECT_NEXT(2);
+
+   /* Release variable */
+op_kill:
+   if (!ria_kill_var(ria_get_narrow_var(p[1]), ctx))
+      goto exit;
+   RIA_DIRECT_NEXT(2);
+
+   /* Pop */
+op_pop:
+   k = 2;
+   u = ria_get_narrow_var(p[1]);
+   goto op_pop_any;
+op_popw:
+   if (!ria_decode_varint(&u, &k, p+1, ctx->cexec-(p-ctx->pexec)-1))
+      goto exit;
+   u = ria_get_wide_var(u);
+   k++;
+op_pop_any:
+   if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+      goto exit;
+   if (!ria_get_var(&pd3, u, true, ctx))
+      goto exit;
+   if (pd3 == NULL)
+      goto failed;
+   if (!ria_copy(ria_data_var, pd3, kind1, pd1, ctx))
+      goto exit;
+   if (!ria_release_tmp(kind1, pd1, ctx))
+      goto exit;
+   RIA_DIRECT_NEXT(k);
+
+   /* Unary arithmetics */
+op_neg:
+   if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+      goto exit;
+   if (type1 != ria_int)
+      goto internal;
+   if (!ria_math(ria_data_imm, &v, kind1, pd1, ria_data_tmp, NULL, '-', ctx))
+      goto exit;
+   if (!ria_release_tmp(kind1, pd1, ctx))
+      goto exit;
+   ps[ctx->cstack++] = v;
+   RIA_DIRECT_NEXT(1);
+
+   /* Binary arithmetics and comparations */
+op_binary:
+op_cmp:
+   if (!ria_pop_from_stack(&type2, &kind2, &pd2, ctx))
+      goto exit;
+   if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+      goto exit;
+   if (type1 != type2)
+      goto internal;
+   pd3 = &v;
+   kind3 = ria_data_imm;
+   switch (p[0]) {
+   case ria_opcode_add:
+      switch (type1) {
+      case ria_string:
+         if (!ria_get_tmp(&pd3, ctx))
+            goto exit;
+         kind3 = ria_data_tmp;
+         ret = ria_concat(kind3, pd3, kind1, pd1, kind2, pd2, ctx);
+         break;
+      case ria_int:
+         ret = ria_math(kind3, pd3, kind1, pd1, kind2, pd2, '+', ctx);
+         break;
+      case ria_boolean:
+         ret = ria_bool(kind3, pd3, kind1, pd1, kind2, pd2, '|', ctx);
+         break;
+      default:
+         goto internal;
+      }
+      break;
+   case ria_opcode_sub:
+      switch (type1) {
+      case ria_int:
+         ret = ria_math(kind3, pd3, kind1, pd1, kind2, pd2, '-', ctx);
+         break;
+      case ria_boolean:
+         ret = ria_bool(kind3, pd3, kind1, pd1, kind2, pd2, '&', ctx);
+         break;
+      default:
+         goto internal;
+      }
+      break;
+   default:
+      ret = ria_cmp(kind3, pd3, kind1, pd1, kind2, pd2, p[0], ctx);
+   }
+   if (!ret)
+      goto exit;
+   ret = false;
+   if (!ria_release_tmp(kind1, pd1, ctx))
+      goto exit;
+   if (!ria_release_tmp(kind2, pd2, ctx))
+      goto exit;
+   if (kind3 == ria_data_imm)
+      ps[ctx->cstack++] = v;
+   else
+      RIA_DIRECT_PUSH(kind3, pd3);
+   RIA_DIRECT_NEXT(1);
+
+   /* Calls */
+op_call:
+   b1 = 0x00;
+   k  = 2;
+   goto op_call_any;
+op_call2:
+   b1 = p[2];
+   k  = 3;
+op_call_any:
+   if (!ria_get_tmp(&pd3, ctx))
+      goto exit;
+   if (!ria_call(ria_data_tmp, pd3, p[1], b1, ctx))
+      goto exit;
+   if ((p[0] == ria_opcode_callp) || (p[0] == ria_opcode_call2p))
+      RIA_DIRECT_PUSH(ria_data_tmp, pd3);
+#ifdef USE_RIA_ASYNC_CALLS   
+   if (ctx->status == ria_exec_pending) {
+      p += k;
+      goto done;
+   }
+#endif
+   if ((p[0] == ria_opcode_calli) || (p[0] == ria_opcode_call2i))
+      if (!ria_release_tmp(ria_data_tmp, pd3, ctx))
+         goto exit;
+   RIA_DIRECT_NEXT(k);
+
+   /* Calls with store to variable */
+op_callv:
+   b1 = 0x00;
+   k  = 3;
+   goto op_callv_any;
+op_call2v:
+   b1 = p[2];
+   k  = 4;
+op_callv_any:
+   if (!ria_get_var(&pd3, ria_get_narrow_var(p[k-1]), true, ctx))
+      goto exit;
+   if (pd3 == NULL)
+      goto failed;
+   if (!ria_call(ria_data_var, pd3, p[1], b1, ctx))
+      goto exit;
+#ifdef USE_RIA_ASYNC_CALLS   
+   if (ctx->status == ria_exec_pending) {
+      p += k;
+      goto done;
+   }
+#endif
+   RIA_DIRECT_NEXT(k);
+
+   /* Conditional jumps */
+op_jcond:
+   if ((ctx->cstack > 0) && (ps[ctx->cstack-1].kind == ria_data_imm)) {
+      /* Comparation result is taken in place */
+      if (ps[--ctx->cstack].type != ria_boolean)
+         goto internal;
+      b1 = ps[ctx->cstack].u.b;
+   }
+   else {
+      if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+         goto exit;
+      if (type1 != ria_boolean)
+         goto internal;
+      if (!ria_get_operand_info(&type1, &pd, &u, kind1, pd1, ctx))
+         goto exit;
+      if (u != 1)
+         goto internal;
+      b1 = *pd;
+      if (!ria_release_tmp(kind1, pd1, ctx))
+         goto exit;
+   }
+   if ((b1 == 0) == ((p[0] & 0x08) != 0)) 
+      switch (p[0]) {
+      case ria_opcode_jif:
+      case ria_opcode_jit:
+         RIA_DIRECT_NEXT(2);
+      case ria_opcode_jif2:
+      case ria_opcode_jit2:
+         RIA_DIRECT_NEXT(3);
+      default:
+         RIA_DIRECT_NEXT(5);
+      }
+   switch (p[0]) {
+   case ria_opcode_jif:
+   case ria_opcode_jit:
+      goto op_jmp;
+   case ria_opcode_jif2:
+   case ria_opcode_jit2:
+      goto op_jmp2;
+   default:
+      goto op_jmp4;
+   }
+
+   /* Unconditional jumps */
+op_jmp:
+   u = (int8)p[1];
+   if ((int)u < 0)
+      RIA_DIRECT_BACK((int)u);
+   RIA_DIRECT_NEXT((int)u+2);
+op_jmp2:
+   u = (int16)((p[1] << 8) | p[2]);
+   if ((int)u < 0)
+      RIA_DIRECT_BACK((int)u);
+   RIA_DIRECT_NEXT((int)u+3);
+op_jmp4:
+   u = ria_get_offset4(p+1);
+   if ((int)u < 0)
+      RIA_DIRECT_BACK((int)u);
+   RIA_DIRECT_NEXT((int)u+5);
+
+   /* Execution limits */
+limits:
+   ctx->ops += ops;
+   ops = 0;
+   if (!ria_check_limits(ctx))
+      goto exit;
+   if (ctx->status == ria_exec_limit)
+      goto done;
+   goto *_dispatch[*p];
+
+   /* Ret */
+op_ret:
+   if (!ria_pop_from_stack(&type1, &kind1, &pd1, ctx))
+      goto exit;
+   if (!ria_copy(ria_data_res, &ctx->result, kind1, pd1, ctx))
+      goto exit;
+   if (!ria_release_tmp(kind1, pd1, ctx))
+      goto exit;
+   ctx->status = ria_exec_ok;
+   p++;
+   goto done;
+op_retn:
+   buf_set_length(0, &ctx->result);   
+   ctx->status = ria_exec_ok;
+   p++;
+   goto done;
+
+op_bad:
+internal:
+   ERR_SET_NO_RET(err_internal);
+   goto exit;
+
+failed:
+   SET_EXECUTE_ERROR(ctx);
+done:
+   ret = true;
+exit:
+   ctx->ops   += ops;
+   ctx->cexec -= p - ctx->pexec;
+   ctx->pexec  = p;
+   return ret;
+
+}
+
+#endif
+
+#ifdef USE_RIA_REGISTER_CODE
+
+/*****************************************************************************/
+bool 
+   ria_get_reg(                                            
+      void**              IN       ptr,
+      usize               IN       idx,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Returns pointer to temporary register, creates it if absent
+ *
+ */
+{
+
+   usize i, c;
+   byte*  p;
+   buf_t* pb;
+
+   assert(ptr != NULL);
+   assert(ctx != NULL);
+
+   *ptr = NULL;
+
+   c = buf_get_length(&ctx->tmps);
+   if (c <= idx) {
+      if (!buf_expand(idx+1, &ctx->tmps))
+         return false;
+      if (!buf_set_length(idx+1, &ctx->tmps))
+         return false;
+      for (i=c; i<=idx; i++)
+         buf_get_ptr_ptrs(&ctx->tmps)[i] = NULL;
+      for (i=c; i<=idx; i++) {
+         if (!heap_alloc((void**)&pb, sizeof(buf_t), ctx->mem))
+            return false;
+         if (!buf_create(1, 1, 0, pb, ctx->mem))
+            return false;
+         buf_get_ptr_ptrs(&ctx->tmps)[i] = (byte*)pb;
+         if (!ria_prealloc_datatype_in_buf(&p, ria_unknown, 0, pb))
+            return false;
+      }
+   }
+   *ptr = buf_get_ptr_ptrs(&ctx->tmps)[idx];
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_get_reg_operand(                                            
+      ria_data_kind_t*    OUT      kind,
+      void**              OUT      ptr,
+      const byte**        IN OUT   pp,
+      usize*              IN OUT   pc,
+      bool                IN       dest,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Decodes operand of register command and moves past it,
+ * pointer is NULL if operand is not valid
+ *
+ */
+{
+
+   const byte* p;
+   usize k, u;
+
+   assert(kind != NULL);
+   assert(ptr  != NULL);
+   assert(pp   != NULL);
+   assert(pc   != NULL);
+   assert(ctx  != NULL);
+
+   *ptr = NULL;
+   p = *pp;
+   if (*pc < 2)
+      return true;
+
+   k = 2;
+   switch (p[0]) {
+   case ria_opcode_pushv:
+      if (!ria_get_var(ptr, ria_get_narrow_var(p[1]), dest, ctx))
+         return false;
+      *kind = ria_data_var;
+      break;
+   case ria_opcode_pushvw:
+      if (!ria_decode_varint(&u, &k, p+1, *pc-1))
+         return false;
+      if (!ria_get_var(ptr, ria_get_wide_var(u), dest, ctx))
+         return false;
+      *kind = ria_data_var;
+      k++;
+      break;
+   case ria_opcode_reg:
+      if (!ria_get_reg(ptr, p[1], ctx))
+         return false;
+      *kind = ria_data_tmp;
+      break;
+   case ria_opcode_pushs:
+   case ria_opcode_pushs2:
+   case ria_opcode_pushp:
+   case ria_opcode_pushi1:
+   case ria_opcode_pushi2:
+   case ria_opcode_pushi3:
+   case ria_opcode_pushi4:
+      if (dest)
+         return true;
+      switch (p[0]) {
+      case ria_opcode_pushs:
+         if (!ria_get_str(ptr, p[1], ctx))
+            return false;
+         *kind = ria_data_str;
+         break;
+      case ria_opcode_pushs2:
+         if (*pc < 3)
+            return true;
+         if (!ria_get_str(ptr, (p[1]<<8)|p[2], ctx))
+            return false;
+         *kind = ria_data_str;
+         k = 3;
+         break;
+      case ria_opcode_pushp:
+         if (!ria_get_par(ptr, p[1], ctx))
+            return false;
+         *kind = ria_data_par;
+         break;
+      default:
+         k = (p[0] & 0x03) + 2;
+         if (*pc < k)
+            return true;
+         *ptr  = (byte*)p;
+         *kind = ria_data_int;
+      }
+      break;
+   default:
+      return true;
+   }
+
+   *pp += k;
+   *pc -= k;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_release_reg_operand(                                            
+      ria_data_kind_t     IN       kind,
+      void*               IN       ptr)
+/*
+ * Releases register after its value was consumed
+ *
+ */
+{
+
+   if (kind != ria_data_tmp)
+      return true;
+   return ria_set_datatype_into_buf((buf_t*)ptr, ria_unknown);
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_execute_register_command(                                            
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Executes single command of register code
+ *
+ */
+{
+
+   void* pd1 = NULL;
+   void* pd2 = NULL;
+   void* pd3 = NULL;
+   ria_data_kind_t kind1 = 0;
+   ria_data_kind_t kind2 = 0;
+   ria_data_kind_t kind3 = 0;
+   ria_type_t type1;
+   function_fn* impl;
+   const byte* p;
+   const byte* q;
+   byte  op, b0, b1;
+   byte* pd;
+   usize c, u;
+   unumber i, j;
+
+   assert(ctx != NULL);
+
+   if (ctx->flags & ria_ef_stack_code)
+      return ria_execute_command(ctx);
+   if (ctx->cexec < 1) {
+      SET_EXECUTE_ERROR(ctx);
+      return true;
+   }
+   op = ctx->pexec[0];
+   p  = ctx->pexec + 1;
+   c  = ctx->cexec - 1;
+
+   RIA_TRACE_START;
+
+   switch (op) {
+
+   /* Move */
+   case ria_opcode_pop:
+      RIA_TRACE_MSG("MOV");
+      if (!ria_get_reg_operand(&kind3, &pd3, &p, &c, true, ctx))
+         return false;
+      if (!ria_get_reg_operand(&kind1, &pd1, &p, &c, false, ctx))
+         return false;
+      if ((pd1 == NULL) || (pd3 == NULL)) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_copy(kind3, pd3, kind1, pd1, ctx))
+         return false;
+      if (!ria_release_reg_operand(kind1, pd1))
+         return false;
+      break;
+
+   /* Append to variable */
+   case ria_opcode_appv:
+      RIA_TRACE_MSG("APPV");
+      if (c < 1) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_get_var(&pd3, ria_get_narrow_var(p[0]), false, ctx))
+         return false;
+      p++;
+      c--;
+      if (!ria_get_reg_operand(&kind1, &pd1, &p, &c, false, ctx))
+         return false;
+      if ((pd1 == NULL) || (pd3 == NULL)) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_append(pd3, kind1, pd1, ctx))
+         return false;
+      if (!ria_release_reg_operand(kind1, pd1))
+         return false;
+      break;
+
+   /* Operations */
+   case ria_opcode_neg:
+   case ria_opcode_add:
+   case ria_opcode_sub:
+   case ria_opcode_add_i:
+   case ria_opcode_sub_i:
+   case ria_opcode_add_s:
+   case ria_opcode_lor_b:
+   case ria_opcode_land_b:
+   case ria_opcode_less:
+   case ria_opcode_more:
+   case ria_opcode_less_eq:
+   case ria_opcode_more_eq:
+   case ria_opcode_eq:
+   case ria_opcode_not_eq:
+      if (!ria_get_reg_operand(&kind3, &pd3, &p, &c, true, ctx))
+         return false;
+      if (!ria_get_reg_operand(&kind1, &pd1, &p, &c, false, ctx))
+         return false;
+      if (op != ria_opcode_neg)
+         if (!ria_get_reg_operand(&kind2, &pd2, &p, &c, false, ctx))
+            return false;
+      if ((pd1 == NULL) || (pd3 == NULL) || 
+          ((pd2 == NULL) && (op != ria_opcode_neg))) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+
+      /*
+       * Resolve type of untyped operation
+       *
+       */
+      if ((op == ria_opcode_add) || (op == ria_opcode_sub)) {
+         if (!ria_get_operand_info(&type1, &pd, &u, kind1, pd1, ctx))
+            return false;
+         switch (type1) {
+         case ria_int:
+            op = (op == ria_opcode_add) ? ria_opcode_add_i : ria_opcode_sub_i;
+            break;
+         case ria_string:
+            if (op != ria_opcode_add)
+               ERR_SET(err_internal);
+            op = ria_opcode_add_s;
+            break;
+         case ria_boolean:
+            op = (op == ria_opcode_add) ? ria_opcode_lor_b : ria_opcode_land_b;
+            break;
+         default:
+            ERR_SET(err_internal);
+         }
+      }
+
+      switch (op) {
+      case ria_opcode_neg:
+         RIA_TRACE_MSG("NEG");
+         if (!ria_math(kind3, pd3, kind1, pd1, ria_data_tmp, NULL, '-', ctx))
+            return false;
+         break;
+      case ria_opcode_add_i:
+         RIA_TRACE_MSG("+");
+         if (!ria_math(kind3, pd3, kind1, pd1, kind2, pd2, '+', ctx))
+            return false;
+         break;
+      case ria_opcode_sub_i:
+         RIA_TRACE_MSG("-");
+         if (!ria_math(kind3, pd3, kind1, pd1, kind2, pd2, '-', ctx))
+            return false;
+         break;
+      case ria_opcode_add_s:
+         RIA_TRACE_MSG("CONCAT");
+         if (!ria_concat(kind3, pd3, kind1, pd1, kind2, pd2, ctx))
+            return false;
+         break;
+      case ria_opcode_lor_b:
+         RIA_TRACE_MSG("||");
+         if (!ria_bool(kind3, pd3, kind1, pd1, kind2, pd2, '|', ctx))
+            return false;
+         break;
+      case ria_opcode_land_b:
+         RIA_TRACE_MSG("&&");
+         if (!ria_bool(kind3, pd3, kind1, pd1, kind2, pd2, '&', ctx))
+            return false;
+         break;
+      default:
+         RIA_TRACE_MSG("CMP");
+         if (!ria_cmp(kind3, pd3, kind1, pd1, kind2, pd2, op, ctx))
+            return false;
+      }
+      if (!ria_release_reg_operand(kind1, pd1))
+         return false;
+      if (op != ria_opcode_neg)
+         if (!ria_release_reg_operand(kind2, pd2))
+            return false;
+      break;
+
+   /* Calls */
+   case ria_opcode_callp:
+   case ria_opcode_call2p:
+   case ria_opcode_calli:
+   case ria_opcode_call2i:
+      if (c < 1) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      b0 = p[0];
+      b1 = 0x00;
+      i  = b0;
+      if ((op == ria_opcode_call2p) || (op == ria_opcode_call2i)) {
+         if (c < 2) {
+            SET_EXECUTE_ERROR(ctx);
+            return true;
+         }
+         b1 = p[1];
+         i  = (b0 << 8) | b1;
+         p++;
+         c--;
+      }
+      p++;
+      c--;
+      RIA_TRACE_MSG("CALL ");
+      RIA_TRACE_INT(i);
+      if (!ria_get_function_info(&type1, &j, &impl, i))
+         return false;
+      if (!ria_get_reg_operand(&kind3, &pd3, &p, &c, true, ctx))
+         return false;
+      if (pd3 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+
+      /*
+       * Pass operands through stack as parameters
+       *
+       */
+      for (q=p, u=c, i=0; i<j; i++) {
+         if (!ria_get_reg_operand(&kind1, &pd1, &p, &c, false, ctx))
+            return false;
+         if (pd1 == NULL) {
+            SET_EXECUTE_ERROR(ctx);
+            return true;
+         }
+         if (!ria_push_to_stack(kind1, pd1, ctx))
+            return false;
+      }
+      if (!ria_call(kind3, pd3, b0, b1, ctx))
+         return false;
+      for (i=0; i<j; i++) {
+         if (!ria_get_reg_operand(&kind1, &pd1, &q, &u, false, ctx))
+            return false;
+         if (!ria_release_reg_operand(kind1, pd1))
+            return false;
+      }
+      if ((op == ria_opcode_calli) || (op == ria_opcode_call2i))
+         if (!ria_release_reg_operand(kind3, pd3))
+            return false;
+      break;
+
+   /* Jumps */
+   case ria_opcode_jif2:
+   case ria_opcode_jit2:
+   case ria_opcode_jif4:
+   case ria_opcode_jit4:
+      switch (op) {
+      case ria_opcode_jif2:
+      case ria_opcode_jif4:
+         RIA_TRACE_MSG("JIF");
+         break;
+      case ria_opcode_jit2:
+      case ria_opcode_jit4:
+         RIA_TRACE_MSG("JIT");
+         break;
+      }
+      u = ((op == ria_opcode_jif4) || (op == ria_opcode_jit4)) ? 4 : 2;
+      if (!ria_get_reg_operand(&kind1, &pd1, &p, &c, false, ctx))
+         return false;
+      if ((pd1 == NULL) || (c < u)) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      b1 = (byte)u;
+      if (!ria_get_operand_info(&type1, &pd, &u, kind1, pd1, ctx))
+         return false;
+      if ((type1 != ria_boolean) || (u != 1))
+         ERR_SET(err_internal);
+      b0 = (*pd != 0) ? 1 : 0;
+      if (!ria_release_reg_operand(kind1, pd1))
+         return false;
+      if (b0 != (((op == ria_opcode_jit2) || (op == ria_opcode_jit4)) ? 1 : 0))
+         p += b1;
+      else
+      if (b1 == 2)
+         p = ctx->pexec + (int16)((p[0] << 8) | p[1]);
+      else
+         p = ctx->pexec + ria_get_offset4(p);
+      break;
+   case ria_opcode_jmp2:
+   case ria_opcode_jmp4:
+      RIA_TRACE_MSG("JMP");
+      u = (op == ria_opcode_jmp4) ? 4 : 2;
+      if (c < u) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (u == 2)
+         p = ctx->pexec + (int16)((p[0] << 8) | p[1]);
+      else
+         p = ctx->pexec + ria_get_offset4(p);
+      break;
+
+   /* Returns */
+   case ria_opcode_ret:
+      RIA_TRACE_MSG("RET");
+      if (!ria_get_reg_operand(&kind1, &pd1, &p, &c, false, ctx))
+         return false;
+      if (pd1 == NULL) {
+         SET_EXECUTE_ERROR(ctx);
+         return true;
+      }
+      if (!ria_copy(ria_data_res, &ctx->result, kind1, pd1, ctx))
+         return false;
+      if (!ria_release_reg_operand(kind1, pd1))
+         return false;
+      ctx->status = ria_exec_ok;
+      break;
+   case ria_opcode_retn:
+      RIA_TRACE_MSG("RETN");
+      buf_set_length(0, &ctx->result);   
+      ctx->status = ria_exec_ok;
+      break;
+
+   /* Same as in stack code */
+   case ria_opcode_incv:
+   case ria_opcode_decv:
+   case ria_opcode_kill:
+      return ria_execute_command(ctx);
+
+   /* Function left in stack code */
+   case ria_opcode_stack:
+      RIA_TRACE_MSG("STACK");
+      ctx->flags |= ria_ef_stack_code;
+      break;
+
+   default:
+      ERR_SET(err_internal);
+   }
+
+   ctx->cexec -= p - ctx->pexec;
+   ctx->pexec  = p;
+
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+
+   return true;
+
+}
+
+#endif
+
+#ifdef USE_RIA_PROFILER
+/*****************************************************************************/
+bool 
+   ria_profile_command(                                            
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Executes single command, adds its time to counters of its opcode and 
+ * of line table entry it belongs to
+ *
+ */
+{
+
+   usize l, h, m, pos;
+   const usize* p;
+   ria_profile_counter_t* pc;
+   uint64 t0, t1;
+   byte op;
+
+   assert(ctx != NULL);
+
+   if (ctx->cexec < 1) {
+      SET_EXECUTE_ERROR(ctx);
+      return true;
+   }
+   op  = ctx->pexec[0];
+   pos = ctx->pexec - ctx->pstart;
+
+   if (!ria_papi_get_time(&t0))
+      return false;
+#ifdef USE_RIA_REGISTER_CODE
+   if (!ria_execute_register_command(ctx))
+#else
+   if (!ria_execute_command(ctx))
+#endif
+      return false;
+   if (!ria_papi_get_time(&t1))
+      return false;
+
+   ctx->profile.ops[op].count++;
+   ctx->profile.ops[op].time += t1 - t0;
+
+   /*
+    * Find last line table entry not after command
+    *
+    */
+   p = buf_get_ptr_usizes(&ctx->profile.lines);
+   for (l=0, h=buf_get_length(&ctx->profile.lines)/2; l<h; ) {
+      m = (l + h) / 2;
+      if (p[2*m] <= pos)
+         l = m + 1;
+      else
+         h = m;
+   }
+   if (l > 0) {
+      pc = (ria_profile_counter_t*)buf_get_ptr_bytes(&ctx->profile.hits);
+      pc[l-1].count++;
+      pc[l-1].time += t1 - t0;
+   }
+   return true;
+
+}
+#endif
+
+/******************************************************************************
+ *  Execution state
+ */
+
+enum {
+   cf_ria_exec_state_params  = 0x001,
+   cf_ria_exec_state_vars    = 0x002,
+   cf_ria_exec_state_stack   = 0x004,
+   cf_ria_exec_state_tmps    = 0x008,
+   cf_ria_exec_state_result  = 0x010,
+   cf_ria_exec_state_http    = 0x020,
+   cf_ria_exec_state_globals = 0x040,
+   cf_ria_exec_state_parser  = 0x080,
+   cf_ria_exec_state_spares  = 0x100,
+   cf_ria_exec_state_lines   = 0x200,
+   cf_ria_exec_state_hits    = 0x400
+};
+
+/*****************************************************************************/
+bool 
+   ria_exec_state_clean_locals(     
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Cleans local state 
+ *
+ */
+{
+
+   bool ret = true;
+   usize i;
+
+   assert(ctx != NULL);
+
+   if (ctx->cleanup & cf_ria_exec_state_vars) {
+      for (i=buf_get_length(&ctx->vars); i>0; i--) {
+         buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->vars)[i-1]);
+         if (pb == NULL)
+            continue;
+         ret = buf_destroy(pb) && ret;
+         ret = heap_free(pb, ctx->mem) && ret;
+      }
+      ret = buf_destroy(&ctx->vars) && ret;
+   }
+   if (ctx->cleanup & cf_ria_exec_state_spares) {
+      for (i=buf_get_length(&ctx->spares); i>0; i--) {
+         buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->spares)[i-1]);
+         ret = buf_destroy(pb) && ret;
+         ret = heap_free(pb, ctx->mem) && ret;
+      }
+      ret = buf_destroy(&ctx->spares) && ret;
+   }
+   if (ctx->cleanup & cf_ria_exec_state_tmps) {
+      for (i=buf_get_length(&ctx->tmps); i>0; i--) {
+         buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->tmps)[i-1]);
+         if (pb == NULL)
+            continue;
+         ret = buf_destroy(pb) && ret;
          ret = heap_free(pb, ctx->mem) && ret;
       }
       ret = buf_destroy(&ctx->tmps) && ret;
+      ret = buf_destroy(&ctx->frees) && ret;
    }
    if (ctx->cleanup & cf_ria_exec_state_stack)
       ret = buf_destroy(&ctx->stack) && ret;
+   ctx->cstack = 0;
    if (ctx->cleanup & cf_ria_exec_state_result)
       ret = buf_destroy(&ctx->result) && ret;
 
@@ -1499,6 +3404,64 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_exec_state_reset_locals(     
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Resets local state between executions keeping its storage: variables go 
+ * to spares, all temporaries become free and stack keeps its size
+ *
+ */
+{
+
+   usize i, c, l;
+   buf_t* pb;
+
+   assert(ctx != NULL);
+
+   /*
+    * Move variables to spares
+    *
+    */
+   c = buf_get_length(&ctx->vars);
+   l = buf_get_length(&ctx->spares);
+   if (!buf_expand(l+c, &ctx->spares))
+      return false;
+   for (i=0; i<c; i++) {
+      pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->vars)[i]);
+      if (pb == NULL)
+         continue;
+      if (!ria_set_datatype_into_buf(pb, ria_unknown))
+         return false;
+      buf_get_ptr_ptrs(&ctx->spares)[l++] = (byte*)pb;
+   }
+   if (!buf_set_length(l, &ctx->spares))
+      return false;
+   if (!buf_set_length(0, &ctx->vars))
+      return false;
+
+   /*
+    * Release all temporaries
+    *
+    */
+   c = buf_get_length(&ctx->tmps);
+   if (!buf_expand(c, &ctx->frees))
+      return false;
+   for (i=0; i<c; i++) {
+      pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->tmps)[i]);
+      if (!ria_set_datatype_into_buf(pb, ria_unknown))
+         return false;
+      buf_get_ptr_ptrs(&ctx->frees)[i] = (byte*)pb;
+   }
+   if (!buf_set_length(c, &ctx->frees))
+      return false;
+
+   ctx->cstack = 0;
+   return buf_destroy(&ctx->result);
+
+}
+
 /*****************************************************************************/
 bool 
    ria_exec_state_destroy(     
@@ -1510,17 +3473,32 @@ bool
 {
 
    bool ret = true;
+   usize i;
 
    assert(ctx != NULL);
 
-   if (ctx->cleanup & cf_ria_exec_state_globals)
+   if (ctx->cleanup & cf_ria_exec_state_globals) {
+      for (i=buf_get_length(&ctx->globals); i>0; i--) {
+         buf_t* pb = (buf_t*)(buf_get_ptr_ptrs(&ctx->globals)[i-1]);
+         if (pb == NULL)
+            continue;
+         ret = buf_destroy(pb) && ret;
+         ret = heap_free(pb, ctx->mem) && ret;
+      }
       ret = buf_destroy(&ctx->globals) && ret;
+   }
    if (ctx->cleanup & cf_ria_exec_state_http)
       ret = ria_http_destroy(&ctx->http) && ret;
    if (ctx->cleanup & cf_ria_exec_state_params)
       ret = buf_destroy(&ctx->params) && ret;
    if (ctx->cleanup & cf_ria_exec_state_parser)
       ret = ria_parser_destroy(&ctx->parser) && ret;
+#ifdef USE_RIA_PROFILER
+   if (ctx->cleanup & cf_ria_exec_state_lines)
+      ret = buf_destroy(&ctx->profile.lines) && ret;
+   if (ctx->cleanup & cf_ria_exec_state_hits)
+      ret = buf_destroy(&ctx->profile.hits) && ret;
+#endif
    ret = ria_exec_state_clean_locals(ctx);
 
    ctx->cleanup = 0;
@@ -1554,12 +3532,18 @@ bool
       goto failed;
    else
       ctx->cleanup |= cf_ria_exec_state_vars;
-   if (!buf_create(sizeof(byte*), 0, 0, &ctx->stack, ctx->mem))
+   if (!buf_create(sizeof(byte*), 0, 0, &ctx->spares, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_exec_state_spares;
+   if (!buf_create(sizeof(ria_value_t), 0, 0, &ctx->stack, ctx->mem))
       goto failed;
    else
       ctx->cleanup |= cf_ria_exec_state_stack;
    if (!buf_create(sizeof(byte*), 0, 0, &ctx->tmps, ctx->mem))
       goto failed;
+   if (!buf_create(sizeof(byte*), 0, 0, &ctx->frees, ctx->mem))
+      goto failed;
    else
       ctx->cleanup |= cf_ria_exec_state_tmps;
    if (!buf_create(sizeof(byte), 0, 0, &ctx->result, ctx->mem))
@@ -1578,6 +3562,17 @@ bool
       goto failed;
    else
       ctx->cleanup |= cf_ria_exec_state_parser;
+#ifdef USE_RIA_PROFILER
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->profile.lines, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_exec_state_lines;
+   if (!buf_create(sizeof(ria_profile_counter_t), 0, 0, 
+           &ctx->profile.hits, ctx->mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_exec_state_hits;
+#endif
    return true;
 
 failed:
@@ -1586,6 +3581,65 @@ failed:
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_exec_state_clone(     
+      ria_exec_state_t*         IN OUT   dst,
+      const ria_exec_state_t*   IN       src)
+/*
+ * Copies state kept between executions: global variables by value and 
+ * HTTP session
+ *
+ */
+{
+
+   usize i, c;
+   buf_t* ps;
+   buf_t* pb;
+
+   assert(dst != NULL);
+   assert(src != NULL);
+
+#ifdef USE_RIA_ASYNC_CALLS   
+   switch (src->status) {
+   case ria_exec_pending:
+   case ria_exec_proceed:
+      ERR_SET(err_unexpected_call); 
+   }      
+#endif      
+   if (buf_get_length(&dst->globals) != 0)
+      ERR_SET(err_unexpected_call); 
+
+   /*
+    * Copy globals
+    *
+    */
+   c = buf_get_length(&src->globals);
+   if (!buf_expand(c, &dst->globals))
+      return false;
+   for (i=0; i<c; i++)
+      buf_get_ptr_ptrs(&dst->globals)[i] = NULL;
+   if (!buf_set_length(c, &dst->globals))
+      return false;
+   for (i=0; i<c; i++) {
+      ps = (buf_t*)(buf_get_ptr_ptrs(&src->globals)[i]);
+      if (ps == NULL)
+         continue;
+      if (!heap_alloc((void**)&pb, sizeof(buf_t), dst->mem))
+         return false;
+      if (!buf_create(1, 1, 0, pb, dst->mem)) {
+         heap_free(pb, dst->mem);
+         return false;
+      }
+      buf_get_ptr_ptrs(&dst->globals)[i] = (byte*)pb;
+      if (!buf_load(buf_get_ptr_bytes(ps), 0, buf_get_length(ps), pb))
+         return false;
+   }
+
+   return ria_http_clone(&dst->http, &src->http);
+
+}
+
 
 /******************************************************************************
  *  Configuration
@@ -1659,7 +3713,9 @@ failed:
 
 enum {
    cf_ria_executor_state  = 0x01,
-   cf_ria_executor_config = 0x02
+   cf_ria_executor_config = 0x02,
+   cf_ria_executor_index  = 0x04,
+   cf_ria_executor_strs   = 0x08
 };
 
 /*****************************************************************************/
@@ -1684,6 +3740,14 @@ bool
       goto failed;
    else
       ctx->cleanup |= cf_ria_executor_state;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->index, mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_executor_index;
+   if (!buf_create(sizeof(usize), 0, 0, &ctx->strs, mem))
+      goto failed;
+   else
+      ctx->cleanup |= cf_ria_executor_strs;
    return true;
 
 failed:
@@ -1710,6 +3774,10 @@ bool
       ret = ria_exec_state_destroy(&ctx->state) && ret;
    if (ctx->cleanup & cf_ria_executor_config)
       ret = ria_config_destroy(&ctx->config) && ret;
+   if (ctx->cleanup & cf_ria_executor_index)
+      ret = buf_destroy(&ctx->index) && ret;
+   if (ctx->cleanup & cf_ria_executor_strs)
+      ret = buf_destroy(&ctx->strs) && ret;
 
    ctx->cleanup = 0;
    return ret;
@@ -1763,6 +3831,79 @@ bool
 
 } 
 
+/*****************************************************************************/
+bool 
+   ria_set_limits(
+      const ria_limits_t*   IN       limits,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Sets execution limits
+ *
+ */
+{
+
+   assert(limits != NULL);
+   assert(ctx    != NULL);
+
+   ctx->state.limits = *limits;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_executor_clone(
+      ria_executor_ctx_t*         IN OUT   dst,
+      const ria_executor_ctx_t*   IN       src)
+/*
+ * Copies execution context
+ *
+ */
+{
+
+   assert(dst != NULL);
+   assert(src != NULL);
+
+   /*
+    * Copy configuration
+    *
+    */
+   if (!buf_load(
+           buf_get_ptr_bytes(&src->config.workdir), 0, 
+           buf_get_length(&src->config.workdir), &dst->config.workdir))
+      return false;
+   if (!buf_load(
+           buf_get_ptr_bytes(&src->config.tempdir), 0, 
+           buf_get_length(&src->config.tempdir), &dst->config.tempdir))
+      return false;
+
+   /*
+    * Copy index of prepared module, module itself is shared
+    *
+    */
+   if (!buf_load(
+           buf_get_ptr_usizes(&src->index), 0, 
+           buf_get_length(&src->index), &dst->index))
+      return false;
+   if (!buf_load(
+           buf_get_ptr_usizes(&src->strs), 0, 
+           buf_get_length(&src->strs), &dst->strs))
+      return false;
+   dst->buckets = src->buckets;
+   dst->pindex  = src->pindex;
+   dst->cindex  = src->cindex;
+#ifdef USE_RIA_PROFILER
+   if (!ria_set_line_table(
+           buf_get_ptr_usizes(&src->state.profile.lines),
+           buf_get_length(&src->state.profile.lines)/2, dst))
+      return false;
+#endif
+
+   dst->state.limits = src->state.limits;
+   return ria_exec_state_clone(&dst->state, &src->state);
+
+} 
+
 /*****************************************************************************/
 bool 
    ria_set_exec_param(
@@ -1770,69 +3911,504 @@ bool
       unumber               IN       idx,
       ria_executor_ctx_t*   IN OUT   ctx)
 /*
- * Sets parameter for scenario script 
+ * Sets parameter for scenario script 
+ *
+ */
+{
+
+   byte *p, *q;
+   usize c, l;
+
+   assert(param != NULL);
+   assert(ctx   != NULL);
+
+   if (idx >= 0x100)
+      ERR_SET(err_bad_param);
+      
+   /*
+    * Delete parameter if already exists
+    *
+    */
+   if (!ria_get_par((void**)&p, idx, &ctx->state))
+      return false;
+   if (p != NULL) {
+      c = StrLen((char*)p);
+      l = buf_get_length(&ctx->state.params);
+      q = buf_get_ptr_bytes(&ctx->state.params) + l;
+      MemMove(p-1, p+c+1, (q-p)-c-1);
+      if (!buf_set_length(l-c-2, &ctx->state.params))
+         return false;
+   }                                              
+       
+   /*
+    * Append new parameter
+    *
+    */
+   c = StrLen(param);
+   l = buf_get_length(&ctx->state.params);
+   if (!buf_expand(l+c+2, &ctx->state.params))
+      return false;
+   p = buf_get_ptr_bytes(&ctx->state.params) + l;
+   *(p++) = (byte)idx;
+   MemCpy(p, param, c);
+   p[c] = 0x00;
+   return buf_set_length(l+c+2, &ctx->state.params);
+
+}
+
+#ifdef USE_RIA_DIRECT_DISPATCH
+/*****************************************************************************/
+bool 
+   ria_get_command_flow(       
+      usize*        OUT   pops,
+      usize*        OUT   pushes,
+      usize*        OUT   target,
+      bool*         OUT   next,
+      usize         IN    i,
+      const byte*   IN    p)
+/*
+ * Returns stack effect of command at offset i, its jump target, if any, 
+ * and whether it passes control to the next command
+ *
+ */
+{
+
+   ria_type_t type;
+   function_fn* impl;
+   unumber j;
+
+   assert(pops   != NULL);
+   assert(pushes != NULL);
+   assert(target != NULL);
+   assert(next   != NULL);
+   assert(p      != NULL);
+
+   *pops   = 0;
+   *pushes = 0;
+   *target = (usize)-1;
+   *next   = true;
+
+   switch (p[i]) {
+   case ria_opcode_pushvs:
+      (*pushes)++;
+   case ria_opcode_pushv:
+   case ria_opcode_pushvw:
+   case ria_opcode_pushs:
+   case ria_opcode_pushs2:
+   case ria_opcode_pushp:
+   case ria_opcode_pushi1:
+   case ria_opcode_pushi2:
+   case ria_opcode_pushi3:
+   case ria_opcode_pushi4:
+      (*pushes)++;
+      break;
+   case ria_opcode_incv:
+   case ria_opcode_decv:
+   case ria_opcode_kill:
+   case ria_opcode_retn:
+      *next = (p[i] != ria_opcode_retn);
+      break;
+   case ria_opcode_neg:
+      *pops = *pushes = 1;
+      break;
+   case ria_opcode_add:
+   case ria_opcode_sub:
+   case ria_opcode_less:
+   case ria_opcode_more:
+   case ria_opcode_less_eq:
+   case ria_opcode_more_eq:
+   case ria_opcode_eq:
+   case ria_opcode_not_eq:
+      *pops = 2;
+      *pushes = 1;
+      break;
+   case ria_opcode_pop:
+   case ria_opcode_popw:
+   case ria_opcode_appv:
+   case ria_opcode_ret:
+      *pops = 1;
+      *next = (p[i] != ria_opcode_ret);
+      break;
+   case ria_opcode_callp:
+   case ria_opcode_calli:
+   case ria_opcode_callv:
+   case ria_opcode_call2p:
+   case ria_opcode_call2i:
+   case ria_opcode_call2v:
+      switch (p[i]) {
+      case ria_opcode_call2p:
+      case ria_opcode_call2i:
+      case ria_opcode_call2v:
+         j = (p[i+1] << 8) | p[i+2];
+         break;
+      default:
+         j = p[i+1];
+      }
+      if (!ria_get_function_info(&type, &j, &impl, j))
+         return false;
+      *pops = j;
+      if ((p[i] == ria_opcode_callp) || (p[i] == ria_opcode_call2p))
+         *pushes = 1;
+      break;
+   case ria_opcode_jif:
+   case ria_opcode_jit:
+   case ria_opcode_jmp:
+      *target = (int8)p[i+1];
+      *target = ((int)*target < 0) ? i+*target : i+*target+2;
+      break;
+   case ria_opcode_jif2:
+   case ria_opcode_jit2:
+   case ria_opcode_jmp2:
+      *target = (int16)((p[i+1] << 8) | p[i+2]);
+      *target = ((int)*target < 0) ? i+*target : i+*target+3;
+      break;
+   case ria_opcode_jif4:
+   case ria_opcode_jit4:
+   case ria_opcode_jmp4:
+      *target = ria_get_offset4(p+i+1);
+      *target = ((int)*target < 0) ? i+*target : i+*target+5;
+      break;
+   default:
+      ERR_SET(err_internal);
+   }
+
+   switch (p[i]) {
+   case ria_opcode_jif:
+   case ria_opcode_jif2:
+   case ria_opcode_jif4:
+   case ria_opcode_jit:
+   case ria_opcode_jit2:
+   case ria_opcode_jit4:
+      *pops = 1;
+      break;
+   case ria_opcode_jmp:
+   case ria_opcode_jmp2:
+   case ria_opcode_jmp4:
+      *next = false;
+      break;
+   }
+
+   return true;
+
+}
+#endif
+
+#ifdef USE_RIA_DIRECT_DISPATCH
+/*****************************************************************************/
+bool 
+   ria_validate_script(       
+      const mem_blk_t*      IN       module,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Validates compiled module functions for direct-threaded dispatch and
+ * keeps max stack depth of each one in function index; lack of memory
+ * leaves all functions to switch dispatch
+ *
+ */
+{
+
+   usize v, n, t, u, i, j, k, l, x, o, e, c, d, m, r, w, f;
+   const byte* pn;
+   const byte* p;
+   byte*   pm = NULL;
+   uint16* pd = NULL;
+   usize*  pr;
+   uint32 h;
+   bool ok, next, more;
+   bool ret = false;
+
+   enum {
+      vf_entry   = 0x01,
+      vf_command = 0x02
+   };
+
+   enum {
+      vd_unknown = 0xFFFF
+   };
+
+   assert(module != NULL);
+   assert(ctx    != NULL);
+
+   /*
+    * Prepare command marks and stack depths
+    *
+    */
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
+      return false;
+   if (!heap_alloc((void**)&pm, u+1, ctx->state.mem))
+      goto exit;
+   MemSet(pm, 0x00, u+1);
+   if (!heap_alloc((void**)&pd, (u+1)*sizeof(uint16), ctx->state.mem))
+      goto exit;
+   for (k=0, j=t; k<n; k++, j+=c) {
+      if (!ria_get_module_entry(&pn, &l, &x, &o, &h, &c, v, module->p+j, u-j))
+         goto exit;
+      if (o >= u) {
+         ERR_SET_NO_RET(err_bad_param);
+         goto exit;
+      }
+      pm[o] |= vf_entry;
+   }
+
+   /*
+    * Validate each function, which runs up to next entry point; every 
+    * command has to fit, jumps have to target commands of the function 
+    * and the last command cannot fall through
+    *
+    */
+   p = module->p;
+   for (f=0; f<n; f++) {
+      pr = buf_get_ptr_usizes(&ctx->index) + ctx->buckets + f*ria_index_size;
+      j  = pr[ria_index_entry];
+      if (!ria_get_module_entry(&pn, &l, &x, &o, &h, &c, v, p+j, u-j))
+         goto exit;
+      ok = true;
+      for (i=o, d=o; (i<u) && ((i == o) || !(pm[i] & vf_entry)); i+=k) {
+         if (!ria_get_command_size(&k, p+i, u-i)) {
+            ok = false;
+            break;
+         }
+         pm[i] |= vf_command;
+         pd[i] = vd_unknown;
+         d = i;
+      }
+      e = i;
+      if (ok) 
+         switch (p[d]) {
+         case ria_opcode_ret:
+         case ria_opcode_retn:
+         case ria_opcode_jmp:
+         case ria_opcode_jmp2:
+         case ria_opcode_jmp4:
+            break;
+         default:
+            ok = false;
+         }
+      for (i=o; ok && (i<e); i+=k) {
+         if (!ria_get_command_size(&k, p+i, e-i))
+            goto exit;
+         if (!ria_get_command_flow(&r, &w, &x, &next, i, p)) {
+            ok = false;
+            break;
+         }
+         if (x == (usize)-1)
+            continue;
+         if ((x < o) || (x >= e) || !(pm[x] & vf_command))
+            ok = false;
+      }
+
+      /*
+       * Propagate stack depth along the control flow; each command has to 
+       * be reached with the same depth and cannot pop more than pushed
+       *
+       */
+      if (ok)
+         pd[o] = 0;
+      for (m=0, more=ok; more; ) {
+         more = false;
+         for (i=o; ok && (i<e); i+=k) {
+            if (!ria_get_command_size(&k, p+i, e-i))
+               goto exit;
+            if (pd[i] == vd_unknown)
+               continue;
+            if (!ria_get_command_flow(&r, &w, &x, &next, i, p))
+               goto exit;
+            if (pd[i] < r) {
+               ok = false;
+               break;
+            }
+            d = pd[i] - r + w;
+            if (d >= vd_unknown) {
+               ok = false;
+               break;
+            }
+            m = (d > m) ? d : m;
+            for (j=0; j<2; j++) {
+               l = (j == 0) ? (next ? i+k : (usize)-1) : x;
+               if ((l == (usize)-1) || (l >= e))
+                  continue;
+               if (pd[l] == vd_unknown) {
+                  pd[l] = (uint16)d;
+                  more = true;
+               }
+               else
+                  if (pd[l] != d)
+                     ok = false;
+            }
+         }
+      }
+
+      /*
+       * Keep stack depth of validated function
+       *
+       */
+      if (ok) 
+         pr[ria_index_depth] = m;
+      for (i=o; i<e; i++)
+         pm[i] &= ~vf_command;
+   }
+   ret = true;
+
+exit:
+   if ((pd == NULL) && (GET_ERR_CONTEXT->err == err_no_memory)) {
+      ERR_SET_NO_RET(err_none);
+      ret = true;
+   }
+   if (pd != NULL)
+      ret = heap_free(pd, ctx->state.mem) && ret;
+   if (pm != NULL)
+      ret = heap_free(pm, ctx->state.mem) && ret;
+   return ret;
+
+}
+#endif
+
+/*****************************************************************************/
+bool 
+   ria_prepare_script(       
+      const mem_blk_t*      IN       module,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Builds index of compiled module functions by name and offsets of its 
+ * strings
  *
  */
 {
 
-   byte *p, *q;
-   usize c, l;
+   usize v, n, t, u, k, j, x, o, c, b, i;
+   const byte* pn;
+   usize* pr;
+   uint32 h;
 
-   assert(param != NULL);
-   assert(ctx   != NULL);
+   assert(module != NULL);
+   assert(ctx    != NULL);
+
+   ctx->pindex = NULL;
+   ctx->cindex = 0;
 
-   if (idx >= 0x100)
-      ERR_SET(err_bad_param);
-      
    /*
-    * Delete parameter if already exists
+    * Allocate buckets, at least one per function, and function records
     *
     */
-   if (!ria_get_par((void**)&p, idx, &ctx->state))
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
       return false;
-   if (p != NULL) {
-      c = StrLen((char*)p);
-      l = buf_get_length(&ctx->state.params);
-      q = buf_get_ptr_bytes(&ctx->state.params) + l;
-      MemMove(p-1, p+c+1, (q-p)-c-1);
-      if (!buf_set_length(l-c-2, &ctx->state.params))
+   for (b=1; b<n; b<<=1);
+   if (!buf_set_length(0, &ctx->index))
+      return false;
+   if (!buf_fill(0, 0, b+n*ria_index_size, &ctx->index))
+      return false;
+   ctx->buckets = b;
+
+   /*
+    * Chain functions by hash of their names
+    *
+    */
+   pr = buf_get_ptr_usizes(&ctx->index);
+   for (k=0; k<n; k++, t+=c) {
+      if (!ria_get_module_entry(
+              &pn, &j, &x, &o, &h, &c, v, module->p+t, u-t))
          return false;
-   }                                              
-       
+      i = ria_hash_data(ria_hash_seed, pn, j) & (b-1);
+      pr[b+k*ria_index_size+ria_index_link]  = pr[i];
+      pr[b+k*ria_index_size+ria_index_entry] = t;
+      pr[b+k*ria_index_size+ria_index_depth] = (usize)-1;
+      pr[i] = k + 1;
+   }
+
    /*
-    * Append new parameter
+    * Record offsets of strings, so that they are found without scanning
     *
     */
-   c = StrLen(param);
-   l = buf_get_length(&ctx->state.params);
-   if (!buf_expand(l+c+2, &ctx->state.params))
+   if (!buf_set_length(0, &ctx->strs))
       return false;
-   p = buf_get_ptr_bytes(&ctx->state.params) + l;
-   *(p++) = (byte)idx;
-   MemCpy(p, param, c);
-   p[c] = 0x00;
-   return buf_set_length(l+c+2, &ctx->state.params);
+   for (i=u; (i < module->c) && (i+module->p[i] < module->c); ) {
+      o = i - u;
+      if (!buf_append(&o, 1, &ctx->strs))
+         return false;
+      i += module->p[i] + 1;
+   }
+
+#ifdef USE_RIA_DIRECT_DISPATCH
+   if (!ria_validate_script(module, ctx))
+      return false;
+#endif
+
+   ctx->pindex = module->p;
+   ctx->cindex = module->c;
+   return true;
 
 }
 
 /*****************************************************************************/
 bool 
-   ria_execute_script(                                            
+   ria_resolve_script(       
+      usize*                OUT      func,
+      const char*           IN       name,
+      const mem_blk_t*      IN       module,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Resolves function of prepared module by name
+ *
+ */
+{
+
+   usize v, n, t, u, k, j, x, o, c, l;
+   const byte* pn;
+   const usize* pr;
+   uint32 h;
+
+   assert(func   != NULL);
+   assert(name   != NULL);
+   assert(module != NULL);
+   assert(ctx    != NULL);
+
+   *func = 0;
+   if ((module->p != ctx->pindex) || (module->c != ctx->cindex))
+      ERR_SET(err_unexpected_call);
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
+      return false;
+
+   l  = StrLen(name);
+   pr = buf_get_ptr_usizes(&ctx->index);
+   k  = pr[ria_hash_data(ria_hash_seed, (const byte*)name, l) & 
+           (ctx->buckets-1)];
+   for (; k!=0; k=pr[ctx->buckets+(k-1)*ria_index_size+ria_index_link]) {
+      t = pr[ctx->buckets+(k-1)*ria_index_size+ria_index_entry];
+      if (!ria_get_module_entry(
+              &pn, &j, &x, &o, &h, &c, v, module->p+t, u-t))
+         return false;
+      if (j == l)
+         if (!MemCmp(pn, name, l)) {
+            *func = k;
+            break;
+         }
+   }
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_execute_entry(                                            
       ria_exec_status_t*    OUT      status,
       mem_blk_t*            IN OUT   result,
-      const char*           IN       name,
+      usize                 IN       entry,
+      usize                 IN       depth,
       const mem_blk_t*      IN OUT   module,
       ria_executor_ctx_t*   IN OUT   ctx)
 /*
- * Executes compiled scenario script 
+ * Executes compiled module function given its table entry and max stack 
+ * depth, (usize)-1 if function cannot be executed directly
  *
  */
 {
 
-   usize u, l;
+   usize u, c, n, o, t, v, j, x;
+   const byte* pn;
+   const byte* p;
+   uint32 h;
 
    assert(ctx    != NULL);
-   assert(name   != NULL);
    assert(module != NULL);
    assert(result != NULL);
    assert(status != NULL);
@@ -1851,63 +4427,97 @@ bool
    ctx->state.status = ria_exec_unknown;
    ctx->state.flags  = 0;
    ctx->state.pstart = module->p;
-   if (!ria_exec_state_clean_locals(&ctx->state))
+   if (!ria_exec_state_reset_locals(&ctx->state))
+      return false;
+   if (!ria_start_limits(&ctx->state))
       return false;
       
    /*
     * Attach result buffer
     *
     */
+   ctx->state.cresult = 0;
    if (!buf_attach(result->p, result->c, result->c, true, &ctx->state.result))
       return false;    
 
    /*
-    * Load header
+    * Load header and entry point
     *
     */
-   if (module->c <= ria_header_size)
-      ERR_SET(err_bad_param);
-   u = (module->p[1] << 16) | (module->p[2] << 8) | (module->p[3]);
-   if (module->c <= ria_header_size + u)
-      ERR_SET(err_bad_param);
+   if (!ria_get_module_info(&v, &n, &t, &u, module))
+      return false;
    ctx->state.ptr_strs = module->p + u;
-
-   /*
-    * Find entry point
-    *
-    */
-   l = StrLen(name);
-   for (ctx->state.cexec=0, 
-        ctx->state.pexec=module->p+ria_header_size; 
-        ctx->state.cexec<module->p[0]; 
-        ctx->state.cexec++) {
-      if (*ctx->state.pexec == l)
-         if (!MemCmp(ctx->state.pexec+1, name, l)) {
-            ctx->state.cexec = 
-                (ctx->state.pexec[l+2] << 16)|
-                (ctx->state.pexec[l+3] <<  8)|
-                 ctx->state.pexec[l+4];
-            ctx->state.pexec = module->p + ctx->state.cexec;
-            ctx->state.cexec = u - ctx->state.cexec;
-            break;
-         }
-      ctx->state.pexec += *ctx->state.pexec + ria_fextra_size;
+   if ((module->p == ctx->pindex) && (module->c == ctx->cindex)) {
+      ctx->state.ptr_offs = buf_get_ptr_usizes(&ctx->strs);
+      ctx->state.coffs    = buf_get_length(&ctx->strs);
    }
-   if (ctx->state.cexec == module->p[0])
+   else {
+      ctx->state.ptr_offs = NULL;
+      ctx->state.coffs    = 0;
+   }
+   if ((entry < t) || (entry >= u))
+      ERR_SET(err_bad_param);
+   if (!ria_get_module_entry(
+           &pn, &j, &x, &o, &h, &c, v, module->p+entry, u-entry))
+      return false;
+   if (o >= u)
       ERR_SET(err_bad_param);
+   ctx->state.pexec = module->p + o;
+   ctx->state.cexec = u - o;
 
    RIA_TRACE_START;
    RIA_TRACE_MSG("Call execute ");
-   RIA_TRACE_STR(name, StrLen(name));
+   RIA_TRACE_STR(((const char*)pn), j);
    RIA_TRACE_MSG("\n");
    RIA_TRACE_STOP;
 
+   /*
+    * Execute validated function with direct-threaded dispatch, profiler
+    * counts command by command
+    *
+    */   
+#ifdef USE_RIA_DIRECT_DISPATCH
+#ifdef USE_RIA_PROFILER
+   if (ctx->state.profile.on)
+      depth = (usize)-1;
+#endif
+   if (depth != (usize)-1) {
+      if (!buf_expand(depth, &ctx->state.stack))
+         return false;
+      if (!buf_set_length(buf_get_allocated_size(&ctx->state.stack), 
+              &ctx->state.stack))
+         return false;
+      if (!ria_execute_direct(&ctx->state))
+         return false;
+      *status = ctx->state.status;  
+#ifdef USE_RIA_ASYNC_CALLS   
+      if (*status == ria_exec_pending)
+         return true;
+#endif         
+      if ((*status == ria_exec_failed) || (*status == ria_exec_limit))
+         return true;
+   }
+   else
+#endif
+
    /*
     * Execute command by command
     *
     */   
    for (; ctx->state.cexec>0; ) {
+      p = ctx->state.pexec;
+#ifdef USE_RIA_PROFILER
+      if (ctx->state.profile.on) {
+         if (!ria_profile_command(&ctx->state))
+            return false;
+      }
+      else
+#endif
+#ifdef USE_RIA_REGISTER_CODE
+      if (!ria_execute_register_command(&ctx->state))
+#else
       if (!ria_execute_command(&ctx->state))
+#endif
          return false;
       *status = ctx->state.status;  
 #ifdef USE_RIA_ASYNC_CALLS   
@@ -1918,6 +4528,14 @@ bool
          return true;
       if (*status == ria_exec_ok)
          break;
+      ctx->state.ops++;
+      if ((ctx->state.pexec < p) && (ctx->state.ops >= ctx->state.check)) {
+         if (!ria_check_limits(&ctx->state))
+            return false;
+         *status = ctx->state.status;  
+         if (*status == ria_exec_limit)
+            return true;
+      }
    }
    if (ctx->state.status == ria_exec_unknown) {
       ctx->state.status = ria_exec_ok;
@@ -1936,12 +4554,268 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_execute_script(                                            
+      ria_exec_status_t*    OUT      status,
+      mem_blk_t*            IN OUT   result,
+      const char*           IN       name,
+      const mem_blk_t*      IN OUT   module,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Executes compiled scenario script 
+ *
+ */
+{
+
+   usize f, t, d;
+   const usize* pr;
+
+   assert(ctx    != NULL);
+   assert(name   != NULL);
+   assert(module != NULL);
+
+   /*
+    * Find entry point through function index of prepared module, or scan
+    * functions table otherwise
+    *
+    */
+   if ((module->p == ctx->pindex) && (module->c == ctx->cindex)) {
+      if (!ria_resolve_script(&f, name, module, ctx))
+         return false;
+      if (f == 0)
+         ERR_SET(err_bad_param);
+      pr = buf_get_ptr_usizes(&ctx->index) + 
+              ctx->buckets + (f-1)*ria_index_size;
+      t  = pr[ria_index_entry];
+      d  = pr[ria_index_depth];
+   }
+   else {
+      if (!ria_find_module_entry(&t, (const byte*)name, StrLen(name), module))
+         return false;
+      if (t == 0)
+         ERR_SET(err_bad_param);
+      d = (usize)-1;
+   }
+   return ria_execute_entry(status, result, t, d, module, ctx);
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_execute_function(                                            
+      ria_exec_status_t*    OUT      status,
+      mem_blk_t*            IN OUT   result,
+      usize                 IN       func,
+      const mem_blk_t*      IN OUT   module,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Executes function of prepared module resolved by ria_resolve_script
+ *
+ */
+{
+
+   const usize* pr;
+
+   assert(ctx    != NULL);
+   assert(module != NULL);
+
+   if ((module->p != ctx->pindex) || (module->c != ctx->cindex))
+      ERR_SET(err_unexpected_call);
+   if ((func == 0) || 
+       (func > (buf_get_length(&ctx->index)-ctx->buckets)/ria_index_size))
+      ERR_SET(err_bad_param);
+   pr = buf_get_ptr_usizes(&ctx->index) + 
+           ctx->buckets + (func-1)*ria_index_size;
+   return ria_execute_entry(
+             status, result, pr[ria_index_entry], pr[ria_index_depth], 
+             module, ctx);
+
+}
+
+#ifdef USE_RIA_PROFILER
+/*****************************************************************************/
+bool 
+   ria_set_profile(       
+      bool                  IN       on,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Turns profiler on or off
+ *
+ */
+{
+
+   usize c;
+
+   assert(ctx != NULL);
+
+   if (on) {
+      MemSet(ctx->state.profile.ops, 0x00, sizeof(ctx->state.profile.ops));
+      MemSet(ctx->state.profile.funcs, 0x00, sizeof(ctx->state.profile.funcs));
+      c = buf_get_length(&ctx->state.profile.hits);
+      MemSet(buf_get_ptr_bytes(&ctx->state.profile.hits), 0x00, 
+         c*sizeof(ria_profile_counter_t));
+   }
+   ctx->state.profile.on = on;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_set_line_table(       
+      const usize*          IN       plines,
+      usize                 IN       clines,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Sets line table of loaded module
+ *
+ */
+{
+
+   assert(ctx != NULL);
+   assert((plines != NULL) || (clines == 0));
+
+   if (!buf_expand(2*clines, &ctx->state.profile.lines))
+      return false;
+   if (!buf_expand(clines, &ctx->state.profile.hits))
+      return false;
+   MemCpy(buf_get_ptr_bytes(&ctx->state.profile.lines), plines, 
+      2*clines*sizeof(usize));
+   MemSet(buf_get_ptr_bytes(&ctx->state.profile.hits), 0x00, 
+      clines*sizeof(ria_profile_counter_t));
+   if (!buf_set_length(2*clines, &ctx->state.profile.lines))
+      return false;
+   return buf_set_length(clines, &ctx->state.profile.hits);
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_put_profile_counter(       
+      mem_blk_t*                     IN OUT   report,
+      usize*                         IN OUT   len,
+      const char*                    IN       kind,
+      const char*                    IN       pname,
+      usize                          IN       cname,
+      const ria_profile_counter_t*   IN       counter)
+/*
+ * Appends one report line
+ *
+ */
+{
+
+   char s[0x40];
+   usize c;
+
+   assert(report  != NULL);
+   assert(len     != NULL);
+   assert(kind    != NULL);
+   assert(pname   != NULL);
+   assert(counter != NULL);
+
+   c = StrLen(kind);
+   if (*len + c + 1 + cname > report->c)
+      ERR_SET(err_bad_length);
+   MemCpy(report->p + *len, kind, c);
+   report->p[*len + c] = ' ';
+   MemCpy(report->p + *len + c + 1, pname, cname);
+   *len += c + 1 + cname;
+
+   Sprintf(s, sizeof(s), " %llu %llu\n", 
+      (unsigned long long)counter->count, (unsigned long long)counter->time);
+   c = StrLen(s);
+   if (*len + c > report->c)
+      ERR_SET(err_bad_length);
+   MemCpy(report->p + *len, s, c);
+   *len += c;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_get_profile_report(       
+      mem_blk_t*            IN OUT   report,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Writes profiler report as text
+ *
+ */
+{
+
+   usize i, j, k, c, l = 0;
+   const usize* pl;
+   ria_profile_counter_t* ph;
+   ria_profile_counter_t t;
+   const char* pn;
+   char s[0x20];
+
+   assert(ctx    != NULL);
+   assert(report != NULL);
+
+   /*
+    * Opcodes
+    *
+    */
+   for (i=0; i<0x100; i++) {
+      if (ctx->state.profile.ops[i].count == 0)
+         continue;
+      Sprintf(s, sizeof(s), "%02X", (unsigned)i);
+      if (!ria_put_profile_counter(report, &l, "op", s, StrLen(s), 
+              &ctx->state.profile.ops[i]))
+         return false;
+   }
+
+   /*
+    * Predefined functions
+    *
+    */
+   for (i=0; i<ria_profile_max_funcs; i++) {
+      if (ctx->state.profile.funcs[i].count == 0)
+         continue;
+      if (!ria_get_function_name(&pn, &c, (unumber)i))
+         return false;
+      if (!ria_put_profile_counter(report, &l, "func", pn, c, 
+              &ctx->state.profile.funcs[i]))
+         return false;
+   }
+
+   /*
+    * Source lines, entries of the same line are summed up
+    *
+    */
+   pl = buf_get_ptr_usizes(&ctx->state.profile.lines);
+   ph = (ria_profile_counter_t*)buf_get_ptr_bytes(&ctx->state.profile.hits);
+   c  = buf_get_length(&ctx->state.profile.hits);
+   for (i=0; i<c; i++) {
+      if (ph[i].count == 0)
+         continue;
+      for (j=0; (j<i) && ((ph[j].count == 0) || (pl[2*j+1] != pl[2*i+1])); j++);
+      if (j < i)
+         continue;
+      for (k=i, t.count=t.time=0; k<c; k++) 
+         if (pl[2*k+1] == pl[2*i+1]) {
+            t.count += ph[k].count;
+            t.time  += ph[k].time;
+         }
+      Sprintf(s, sizeof(s), "%u", (unsigned)pl[2*i+1]);
+      if (!ria_put_profile_counter(report, &l, "line", s, StrLen(s), &t))
+         return false;
+   }
+
+   report->c = l;
+   return true;
+
+}
+#endif
+
 /*****************************************************************************/
 #ifdef USE_RIA_ASYNC_CALLS   
 bool 
    ria_continue_script(       
       ria_exec_status_t*    OUT      status,
-      ria_buf_t*            IN OUT   result,
+      mem_blk_t*            IN OUT   result,
       ria_executor_ctx_t*   IN OUT   ctx)
 /*
  * Continues execution of pending scenario script 
@@ -1949,6 +4823,8 @@ bool
  */
  {
 
+   const byte* p;
+
    assert(ctx    != NULL);
    assert(result != NULL);
    assert(status != NULL);
@@ -1968,10 +4844,13 @@ bool
     * Attach result buffer
     *
     */
+   ctx->state.cresult = 0;
    if (!buf_attach(result->p, result->c, result->c, true, &ctx->state.result))
       return false;    
   
+   RIA_TRACE_START;
    RIA_TRACE_MSG("Call continue\n");
+   RIA_TRACE_STOP;
       
    /*
     * Reinvoke interrupted function
@@ -1995,7 +4874,12 @@ bool
     *
     */   
    for (; ctx->state.cexec>0; ) {
+      p = ctx->state.pexec;
+#ifdef USE_RIA_REGISTER_CODE
+      if (!ria_execute_register_command(&ctx->state))
+#else
       if (!ria_execute_command(&ctx->state))
+#endif
          return false;
       *status = ctx->state.status;  
       if (*status == ria_exec_pending)
@@ -2004,6 +4888,14 @@ bool
          return true;
       if (*status == ria_exec_ok)
          break;
+      ctx->state.ops++;
+      if ((ctx->state.pexec < p) && (ctx->state.ops >= ctx->state.check)) {
+         if (!ria_check_limits(&ctx->state))
+            return false;
+         *status = ctx->state.status;  
+         if (*status == ria_exec_limit)
+            return true;
+      }
    }
    if (ctx->state.status == ria_exec_unknown) {
       ctx->state.status = ria_exec_ok;
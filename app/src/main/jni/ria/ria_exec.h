@@ -17,9 +17,25 @@ typedef enum ria_data_kind_e {
    ria_data_par = 0x03,
    ria_data_tmp = 0x04,
    ria_data_res = 0x05,
-   ria_data_int = 0x06
+   ria_data_int = 0x06,
+   ria_data_imm = 0x07
 } ria_data_kind_t;
 
+/*
+ * Stack value: immediate integers and booleans are held in place, other 
+ * kinds refer to string constant, parameter or data buffer
+ *
+ */
+typedef struct ria_value_s {
+   ria_data_kind_t   kind;
+   ria_type_t        type;
+   union _uv {
+      ria_int_t   n;
+      byte        b;
+      void*       ptr;
+   } u;
+} ria_value_t;
+
 /*
  * Execution result
  *
@@ -29,6 +45,7 @@ typedef enum ria_exec_status_e {
    ria_exec_ok              = 0x01,
    ria_exec_failed          = 0x02,
    ria_exec_ok_parser_ready = 0x03,
+   ria_exec_limit           = 0x07,
 #ifdef USE_RIA_ASYNC_CALLS   
    ria_exec_pending         = 0x04,
    ria_exec_transit         = 0x05,
@@ -51,12 +68,67 @@ typedef struct ria_pending_s {
 } ria_pending_t; 
 #endif   
 
+#ifdef USE_RIA_PROFILER
+/*
+ * Profiler counters: executed commands or calls and their cumulative 
+ * time in nanoseconds
+ *
+ */
+enum {
+   ria_profile_max_funcs = 0x100
+};
+
+typedef struct ria_profile_counter_s {
+   uint64   count;
+   uint64   time;
+} ria_profile_counter_t;
+
+/*
+ * Profiler state: counters per opcode and per predefined function, line 
+ * table as (module offset, source line) pairs sorted by offset and 
+ * counters per line table entry
+ *
+ */
+typedef struct ria_profile_s {
+   bool                    on;
+   ria_profile_counter_t   ops[0x100];
+   ria_profile_counter_t   funcs[ria_profile_max_funcs];
+   buf_t                   lines;
+   buf_t                   hits;
+} ria_profile_t;
+#endif
+
+/*
+ * Execution limits, zero means no limit: wall-clock time in nanoseconds, 
+ * number of executed commands and memory held by variables and 
+ * temporaries in bytes; they are checked on backward jumps once per 
+ * ria_limit_period commands, or on each backward jump if memory is limited
+ *
+ */
+typedef struct ria_limits_s {
+   uint64   time;
+   uint64   ops;
+   usize    memory;
+} ria_limits_t;
+
+typedef enum ria_limit_e {
+   ria_limit_none   = 0x00,
+   ria_limit_time   = 0x01,
+   ria_limit_ops    = 0x02,
+   ria_limit_memory = 0x03
+} ria_limit_t;
+
+enum {
+   ria_limit_period = 0x400
+};
+
 /*
  * Execution state flags
  *
  */
 typedef enum ria_exec_state_flags_e {
-   ria_ef_parser_ready = 0x01
+   ria_ef_parser_ready = 0x01,
+   ria_ef_stack_code   = 0x02
 } ria_exec_state_flags_t;
 
 /*
@@ -70,17 +142,31 @@ typedef struct ria_exec_state_s {
    usize               cexec;
    const byte*         pstart;
    byte*               ptr_strs;
+   const usize*        ptr_offs;
+   usize               coffs;
    buf_t               globals;
    buf_t               params;
    buf_t               vars;
+   buf_t               spares;
    buf_t               tmps;
+   buf_t               frees;
    buf_t               stack;
+   usize               cstack;
    buf_t               result;
+   usize               cresult;
 #ifdef USE_RIA_ASYNC_CALLS   
    ria_pending_t       pending;
 #endif
    ria_http_t          http;
    ria_parser_t        parser;
+#ifdef USE_RIA_PROFILER
+   ria_profile_t       profile;
+#endif
+   ria_limits_t        limits;
+   ria_limit_t         limit;
+   uint64              ops;
+   uint64              check;
+   uint64              deadline;
    heap_ctx_t*         mem;
    umask               cleanup;
 } ria_exec_state_t; 
@@ -92,6 +178,11 @@ typedef struct ria_exec_state_s {
 typedef struct ria_executor_ctx_s {
    ria_exec_state_t   state;
    ria_config_t       config;
+   buf_t              index;
+   usize              buckets;
+   buf_t              strs;
+   const byte*        pindex;
+   usize              cindex;
    umask              cleanup;
 } ria_executor_ctx_t;
 
@@ -145,6 +236,40 @@ bool
       usize                 IN       cval,
       ria_executor_ctx_t*   IN OUT   ctx);
 
+/*@@ria_executor_clone
+ *
+ * Copies configuration, prepared module index, global variables and HTTP
+ * session of execution context into newly created one; compiled module 
+ * is not copied, both contexts should execute the same one
+ *
+ * Parameters:     dst            destination execution context
+ *                 src            source execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_executor_clone(
+      ria_executor_ctx_t*         IN OUT   dst,
+      const ria_executor_ctx_t*   IN       src);
+
+/*@@ria_set_limits
+ *
+ * Sets limits applied to each following execution
+ *
+ * Parameters:     limits         execution limits
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_set_limits(
+      const ria_limits_t*   IN       limits,
+      ria_executor_ctx_t*   IN OUT   ctx);
+
 /*@@ria_set_exec_param
  *
  * Sets parameter for scenario script 
@@ -163,6 +288,45 @@ bool
       unumber               IN       idx,
       ria_executor_ctx_t*   IN OUT   ctx);
 
+/*@@ria_prepare_script
+ *
+ * Builds index of compiled module functions by name; when direct-threaded 
+ * dispatch is available, validates bounds and jump targets of functions 
+ * and computes their max stack depth, so that valid ones are executed 
+ * over pre-sized stack; has to be called whenever the module changes
+ *
+ * Parameters:     module         compiled module
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_prepare_script(       
+      const mem_blk_t*      IN       module,
+      ria_executor_ctx_t*   IN OUT   ctx);
+
+/*@@ria_resolve_script
+ *
+ * Resolves function of prepared module by name
+ *
+ * Parameters:     func           function handle, 0 if not found
+ *                 name           function name
+ *                 module         compiled module
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_resolve_script(       
+      usize*                OUT      func,
+      const char*           IN       name,
+      const mem_blk_t*      IN       module,
+      ria_executor_ctx_t*   IN OUT   ctx);
+
 /*@@ria_execute_script
  *
  * Executes compiled scenario script 
@@ -185,6 +349,28 @@ bool
       const mem_blk_t*      IN OUT   module,
       ria_executor_ctx_t*   IN OUT   ctx);
 
+/*@@ria_execute_function
+ *
+ * Executes function of prepared module resolved by ria_resolve_script
+ *
+ * Parameters:     status         execution status 
+ *                 result         result buffer
+ *                 func           function handle
+ *                 module         compiled module
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_execute_function(       
+      ria_exec_status_t*    OUT      status,
+      mem_blk_t*            IN OUT   result,
+      usize                 IN       func,
+      const mem_blk_t*      IN OUT   module,
+      ria_executor_ctx_t*   IN OUT   ctx);
+
 #ifdef USE_RIA_ASYNC_CALLS   
 /*@@ria_continue_script
  *
@@ -205,6 +391,64 @@ bool
       ria_executor_ctx_t*   IN OUT   ctx);
 #endif      
 
+#ifdef USE_RIA_PROFILER
+/*@@ria_set_profile
+ *
+ * Turns profiler on or off, counters are reset when turned on; while 
+ * profiling, functions are executed command by command
+ *
+ * Parameters:     on             true to turn on
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_set_profile(       
+      bool                  IN       on,
+      ria_executor_ctx_t*   IN OUT   ctx);
+
+/*@@ria_set_line_table
+ *
+ * Sets line table of loaded module produced by compiler, line counters
+ * are reset
+ *
+ * Parameters:     plines         (module offset, source line) pairs
+ *                 clines         number of pairs
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_set_line_table(       
+      const usize*          IN       plines,
+      usize                 IN       clines,
+      ria_executor_ctx_t*   IN OUT   ctx);
+
+/*@@ria_get_profile_report
+ *
+ * Writes profiler report as text, one counter per line:
+ *
+ *    op <opcode, hex> <count> <time, ns>
+ *    func <name> <count> <time, ns>
+ *    line <source line> <count> <time, ns>
+ *
+ * Parameters:     report         report buffer
+ *                 ctx            execution context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_profile_report(       
+      mem_blk_t*            IN OUT   report,
+      ria_executor_ctx_t*   IN OUT   ctx);
+#endif
+
 /*@@ria_get_datainfo_from_buf
  *
  * Fetches service info about data from buffer representation
@@ -245,6 +489,110 @@ bool
       usize        IN    len,
       buf_t*       IN    buf);
 
+/*@@ria_get_int_from_buf
+ *
+ * Fetches integer value from buffer representation
+ *
+ * Parameters:     value          value storage
+ *                 buf            buffer
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_int_from_buf(                                            
+      ria_int_t*     OUT   value,
+      const buf_t*   IN    buf);
+
+/*@@ria_set_int_into_buf
+ *
+ * Stores integer value into buffer representation
+ *
+ * Parameters:     buf            buffer
+ *                 value          value
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_set_int_into_buf(                                            
+      buf_t*      IN OUT   buf,
+      ria_int_t   IN       value);
+
+/*@@ria_create_list_in_buf
+ *
+ * Stores empty list into buffer representation
+ *
+ * Parameters:     buf            buffer
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_create_list_in_buf(                                            
+      buf_t*   IN OUT   buf);
+
+/*@@ria_append_to_list_in_buf
+ *
+ * Appends string to list in buffer representation
+ *
+ * Parameters:     buf            buffer
+ *                 item           string (no terminator)
+ *                 len            string length
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_append_to_list_in_buf(                                            
+      buf_t*        IN OUT   buf,
+      const byte*   IN       item,
+      usize         IN       len);
+
+/*@@ria_get_list_count
+ *
+ * Returns number of list items
+ *
+ * Parameters:     count          number of items
+ *                 ptr            list data (after type octet)
+ *                 len            list data length
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_list_count(                                            
+      usize*        OUT   count,
+      const byte*   IN    ptr,
+      usize         IN    len);
+
+/*@@ria_get_list_item
+ *
+ * Returns list item
+ *
+ * Parameters:     item           pointer to nul-terminated item
+ *                 ilen           item length (no terminator)
+ *                 ptr            list data (after type octet)
+ *                 len            list data length
+ *                 idx            index of item
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_get_list_item(                                            
+      const byte**   OUT   item,
+      usize*         OUT   ilen,
+      const byte*    IN    ptr,
+      usize          IN    len,
+      usize          IN    idx);
+
 /*@@ria_get_exec_error_pos
  *
  * Returns execution error position
@@ -258,6 +606,33 @@ bool
                       /* const ria_executor_ctx_t*   IN */   _ctx)            \
        ( assert((_ctx)!=NULL), (_ctx)->state.pexec-(_ctx)->state.pstart )
 
+/*@@ria_get_exec_result_size
+ *
+ * Returns size of result which did not fit into result buffer, execution
+ * fails with err_bad_length in this case
+ *
+ * Parameters:     ctx            execution context
+ *
+ * Return:         result size
+ *
+ */
+#define /* usize */ ria_get_exec_result_size(                                 \
+                      /* const ria_executor_ctx_t*   IN */   _ctx)            \
+       ( assert((_ctx)!=NULL), (_ctx)->state.cresult )
+
+/*@@ria_get_exec_limit
+ *
+ * Returns limit which stopped execution with ria_exec_limit status
+ *
+ * Parameters:     ctx            execution context
+ *
+ * Return:         limit kind
+ *
+ */
+#define /* ria_limit_t */ ria_get_exec_limit(                                 \
+                      /* const ria_executor_ctx_t*   IN */   _ctx)            \
+       ( assert((_ctx)!=NULL), (_ctx)->state.limit )
+
 /*@@ria_parser_action
  *
  * Executes parser action
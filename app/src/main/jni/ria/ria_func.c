@@ -29,9 +29,9 @@ enum {
  *
  */
 typedef struct ria_param_s {
-   bool   is_buf;
-   buf_t* buf;
-   usize  len;
+   bool      is_buf;
+   buf_t*    buf;
+   usize     len;
    union _up {
       const char* str;
       const byte* ptr;
@@ -44,6 +44,19 @@ typedef struct ria_param_s {
 #define UNPACK_INT(_v, _p, _c)                                                \
            if (!ria_unpack_func_param(&(_v), ria_int, &(_p), &(_c)))          \
               return false;
+#define UNPACK_LIST(_v, _p, _c)                                               \
+           if (!ria_unpack_func_param(&(_v), ria_list, &(_p), &(_c)))         \
+              return false;
+#define GET_INT(_n, _v)                                                       \
+           if ((_v).len != sizeof(ria_int_t))                                 \
+              ERR_SET(err_internal);                                          \
+           MemCpy(&(_n), (_v).uptr.ptr, sizeof(ria_int_t));
+#define GET_POS(_u, _v)                                                       \
+           {                                                                  \
+              ria_int_t _n;                                                   \
+              GET_INT(_n, _v);                                                \
+              _u = (_n < 0) ? (usize)-1 : (usize)_n;                          \
+           }
 
 /*
  * Multi-header delimiter
@@ -217,6 +230,36 @@ static bool
 
 }
 
+/*****************************************************************************/
+static bool 
+   _set_cookie_header(
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * Moves cookies set by script into request headers
+ *
+ */
+{
+
+   static const char _cookie[] = "Cookie";
+
+   assert(ctx != NULL);
+
+   if (buf_get_length(&ctx->http.cookie) == 0) 
+      return true;
+   if (!ria_http_pack_cookies(&ctx->http.cookie))
+      return false;
+   if (!ria_http_set_header(
+           _cookie,
+           sizeof(_cookie)-1,
+           (char*)buf_get_ptr_bytes(&ctx->http.cookie),
+           buf_get_length(&ctx->http.cookie),
+           &ctx->http))
+      return false;       
+   buf_set_empty(&ctx->http.cookie);       
+   return true;
+
+}
+
 /*****************************************************************************/
 static bool 
    _get_post(
@@ -235,12 +278,10 @@ static bool
 
    static const char _http[]   = "http://";
    static const char _defurl[] = "/";
-   static const char _cookie[] = "Cookie";
 
    const char* psite;
    usize csite;
    usize curl;
-   byte* p;
    bool  reentry = false;
    bool  pending;
 
@@ -261,7 +302,9 @@ static bool
           * Restore last URL 
           *
           */
+         RIA_TRACE_START;
          RIA_TRACE_MSG("_get_post(): call after ria_http_async_connect\n");
+         RIA_TRACE_STOP;
          if (!ria_http_get_string(&purl, ria_str_last_url, &ctx->http))
             return false;
          curl = StrLen(purl);
@@ -269,12 +312,23 @@ static bool
 #endif         
 #ifdef RIA_ASYNC_RECEIVE
       case ria_http_async_receive:
+         RIA_TRACE_START;
          RIA_TRACE_MSG("_get_post(): call after ria_http_async_receive\n");
+         RIA_TRACE_STOP;
+#ifdef RIA_HTTP_ATOMIC
+         pending = true;
+         goto complete;
+#else
          goto receive;
+#endif
+#ifndef RIA_HTTP_ATOMIC
       case ria_http_async_rcvmore:
+         RIA_TRACE_START;
          RIA_TRACE_MSG("_get_post(): call after ria_http_async_rcvmore\n");
+         RIA_TRACE_STOP;
          reentry = true;
          goto receive;
+#endif         
 #endif         
       default:
          ERR_SET(err_internal);
@@ -333,18 +387,8 @@ again:
     * Set cookies
     *
     */
-   if (buf_get_length(&ctx->http.cookie) > 0) { 
-      if (!ria_http_pack_cookies(&ctx->http.cookie))
-         return false;
-      if (!ria_http_set_header(
-              _cookie,
-              sizeof(_cookie)-1,
-              (char*)buf_get_ptr_bytes(&ctx->http.cookie),
-              buf_get_length(&ctx->http.cookie),
-              &ctx->http))
-         return false;       
-      buf_set_empty(&ctx->http.cookie);       
-   }      
+   if (!_set_cookie_header(ctx))
+      return false;
     
    /*
     * Connect
@@ -379,6 +423,9 @@ again:
 
 #ifdef RIA_HTTP_ATOMIC    
 
+#ifdef RIA_ASYNC_RECEIVE
+send:
+#endif   
    /*
     * Setup receive parameters for atomic callback
     *
@@ -389,9 +436,16 @@ again:
    ctx->http.reentry   = false;
 
    /*
-    * Perform HTTP request as atomic operation
+    * Perform HTTP request as atomic operation, with async calls it is 
+    * completed when platform switches script to proceed state
     *
     */
+#ifdef RIA_ASYNC_RECEIVE
+   ria_async_set_state(
+      &ctx->http.async, 
+      ria_http_async_receive,
+      ctx);
+#endif   
    if (!ria_http_send(
            &pending,
            purl, 
@@ -400,8 +454,26 @@ again:
            (pval==NULL)?0:StrLen(pval), 
            &ctx->http))
       return false;
+#ifdef RIA_ASYNC_RECEIVE
+   if (pending)
+      if (ria_async_set_status(&ctx->http.async, ria_exec_pending) 
+            == ria_exec_pending) 
+         return true;
+complete:
+   if (pending) {
+      /*
+       * Request may complete before script is suspended, so drop proceed
+       * state to not confuse next request
+       *
+       */
+      if (!ria_http_complete(&ctx->http))
+         return false;
+      ctx->status = ria_exec_unknown;   
+   }   
+#else
    if (pending)
       ERR_SET(err_internal);   
+#endif
 #else /* RIA_HTTP_ATOMIC */
 
    /*
@@ -487,10 +559,7 @@ receive:
     * Save status code
     *
     */
-   if (!ria_prealloc_datatype_in_buf(&p, ria_int, 4, dst))
-      return false;                                            
-   U_OS_B_COUNT(p, 4, ctx->http.http_code);
-   return true;
+   return ria_set_int_into_buf(dst, ctx->http.http_code);
 
 }
 
@@ -573,6 +642,7 @@ bool
 {
 
    ria_type_t type;
+   byte  b[sizeof(ria_int_t)];
    byte* ptr;
    usize len;
 
@@ -630,23 +700,24 @@ bool
       (*pdst) += 4;
       (*cdst) -= 4;
       break;
-   case ria_data_int:
+   case ria_data_imm:
       /*
-       * Integers are passed as immediate value
+       * Integers and booleans are passed as immediate value; the value is 
+       * taken before the write, which may overlap the stack slot
        *
        */
-      if (*cdst < 6)
+      if (*cdst < sizeof(ria_int_t)+2)
          ERR_SET(err_internal);
-      len = (*((byte*)ppar) & 0x03) + 1;
-      ptr = (byte*)ppar + 1;
+      type = ((ria_value_t*)ppar)->type;
+      len  = (type == ria_int) ? sizeof(ria_int_t) : 1;
+      ptr  = (type == ria_int) ? (byte*)&((ria_value_t*)ppar)->u.n 
+                               : &((ria_value_t*)ppar)->u.b;
+      MemCpy(b, ptr, len);
       (*pdst)[0] = (byte)ria_param_immediate;
-      (*pdst)[1] = (byte)ria_int;
-      (*pdst)[2] = (len>3) ? *(ptr++) : 0;
-      (*pdst)[3] = (len>2) ? *(ptr++) : 0;
-      (*pdst)[4] = (len>1) ? *(ptr++) : 0;
-      (*pdst)[5] = *ptr;
-      (*pdst) += 6;
-      (*cdst) -= 6;
+      (*pdst)[1] = (byte)type;
+      MemCpy((*pdst)+2, b, len);
+      (*pdst) += len + 2;
+      (*cdst) -= len + 2;
       return true;   
    default:
       ERR_SET(err_internal);
@@ -658,6 +729,46 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_peek_func_param(
+      ria_type_t*   OUT   type,
+      const byte*   IN    psrc,
+      usize         IN    csrc)
+/*
+ * Returns data type of function parameter without unpacking it
+ *
+ */
+{
+
+   void* pt;
+   byte* p;
+   usize c;
+
+   assert(type != NULL);
+   assert(psrc != NULL);
+
+   if (csrc < 1)
+      ERR_SET(err_internal);
+   switch (psrc[0]) {
+   case ria_param_by_ref:
+      if (csrc < sizeof(void*)+1)
+         ERR_SET(err_internal);
+      psrc++;
+      OS_PTR(pt, psrc);
+      return ria_get_datainfo_from_buf(type, &p, &c, (buf_t*)pt);
+   case ria_param_by_val:
+   case ria_param_immediate:
+      if (csrc < 2)
+         ERR_SET(err_internal);
+      *type = (ria_type_t)psrc[1];
+      return true;
+   default:
+      ERR_SET(err_internal);
+   }
+
+}
+
 /*****************************************************************************/
 bool 
    ria_unpack_func_param(
@@ -707,16 +818,14 @@ bool
          ERR_SET(err_internal);
       if ((byte)type != (*psrc)[1])
          ERR_SET(err_internal);
-      if (type == ria_int) {
-         if (*csrc < 6)
-            ERR_SET(err_internal);
-         par->is_buf = false;
-         par->len = 4;
-         par->uptr.ptr = (*psrc) + 2;
-         (*psrc) += 6;
-         (*csrc) -= 6;
-         return true;
-      }
+      par->is_buf = false;
+      par->len = (type == ria_int) ? sizeof(ria_int_t) : 1;
+      if (*csrc < par->len+2)
+         ERR_SET(err_internal);
+      par->uptr.ptr = (*psrc) + 2;
+      (*psrc) += par->len + 2;
+      (*csrc) -= par->len + 2;
+      return true;
    default:
       ERR_SET(err_internal);
    }
@@ -812,6 +921,52 @@ bool
     
 }
 
+/*****************************************************************************/
+bool 
+   ria_implement_append(
+      buf_t*              IN OUT   dst,
+      umask*              OUT      flags,                     
+      byte*               IN       ppar,
+      usize               IN       cpar,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * append (to list) implementation
+ *
+ */
+{
+
+   /*
+    * par1 - list <list>, variable only
+    * par2 - item <string>
+    *
+    */
+    
+   ria_param_t list;
+   ria_param_t item;
+   
+   assert(dst   != NULL);
+   assert(ppar  != NULL);
+   assert(ctx   != NULL);
+   assert(flags != NULL);
+   UNUSED(ctx);
+
+   UNPACK_LIST(list, ppar, cpar);
+   UNPACK_STRING(item, ppar, cpar);
+   if (cpar != 0)
+      ERR_SET(err_internal);
+   if (!list.is_buf)
+      ERR_SET(err_internal);
+   buf_set_empty(dst);
+   *flags = 0;      
+
+   /*
+    * Append in place
+    *
+    */
+   return ria_append_to_list_in_buf(list.buf, item.uptr.ptr, item.len);
+
+}
+
 /*****************************************************************************/
 bool 
    ria_implement_create_parser_for_file(
@@ -1046,7 +1201,6 @@ bool
    const char* p;
    const char* q;
    const char* r;
-   byte* pt;
    usize u;
 
    ria_param_t src;
@@ -1076,8 +1230,7 @@ bool
     * Apply position
     *
     */
-   pt = (byte*)pos.uptr.ptr; 
-   OS_B_U_COUNT(u, pt, pos.len);
+   GET_POS(u, pos);
 
 #ifdef EXTRACT_STRING_TRACE
    RIA_TRACE_START;
@@ -1138,11 +1291,9 @@ bool
     *
     */
 update_pos:
-   if (pos.is_buf) {
-      if (!ria_prealloc_datatype_in_buf(&pt, ria_int, 4, pos.buf))
+   if (pos.is_buf)
+      if (!ria_set_int_into_buf(pos.buf, u))
          return false;                                            
-      U_OS_B_COUNT(pt, 4, u);
-   }
 #ifdef EXTRACT_STRING_TRACE
    RIA_TRACE_START;
    RIA_TRACE_MSG("Updated pos=");
@@ -1216,8 +1367,7 @@ bool
     * Apply position
     *
     */
-   pt = (byte*)pos.uptr.ptr; 
-   OS_B_U_COUNT(u, pt, pos.len);
+   GET_POS(u, pos);
 
 #ifdef EXTRACT_STRING_FROM_FILE_TRACE
    RIA_TRACE_START;
@@ -1325,11 +1475,9 @@ not_found:
     *
     */
 update_pos:    
-   if (pos.is_buf) {
-      if (!ria_prealloc_datatype_in_buf(&pt, ria_int, 4, pos.buf))
+   if (pos.is_buf)
+      if (!ria_set_int_into_buf(pos.buf, u))
          goto exit;                                            
-      U_OS_B_COUNT(pt, 4, u);
-   }
 #ifdef EXTRACT_STRING_FROM_FILE_TRACE
    RIA_TRACE_START;
    RIA_TRACE_MSG("Updated pos=");
@@ -1609,6 +1757,165 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_implement_get_html_many(
+      buf_t*              IN OUT   dst,
+      umask*              OUT      flags,                     
+      byte*               IN       ppar,
+      usize               IN       cpar,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * HTTP GET implementation, HTML case, performs requests concurrently and
+ * stores results in files
+ *
+ */
+{
+
+   /*
+    * par1 - file names <list>
+    * par2 - urls <list>
+    * par3 - max number of concurrent requests, no limit if <= 0 <int>
+    *
+    */
+
+   static const char _http[] = "http://";
+
+   ria_param_t files;
+   ria_param_t urls;
+   ria_param_t limit;
+   ria_int_t n;
+   const byte* pi;
+   const char* psite;
+   const char** purls = NULL;
+   const char** pfiles;
+   unumber* codes;
+   usize i, k, c, l, csite;
+   byte* p;
+   byte num[12];
+   buf_t tmp;
+   bool ret = false;
+
+   enum {
+      cleanup_arrays = 0x01,
+      cleanup_tmp    = 0x02
+   } cleanup = 0x00;
+
+   assert(dst   != NULL);
+   assert(ppar  != NULL);
+   assert(ctx   != NULL);
+   assert(flags != NULL);
+
+   UNPACK_LIST(files, ppar, cpar);
+   UNPACK_LIST(urls,  ppar, cpar);
+   UNPACK_INT(limit,  ppar, cpar);
+   if (cpar != 0)
+      ERR_SET(err_internal);
+   *flags = ria_func_dst_ready;   
+   GET_INT(n, limit);
+   if (!ria_get_list_count(&k, files.uptr.ptr, files.len))
+      return false;
+   if (!ria_get_list_count(&c, urls.uptr.ptr, urls.len))
+      return false;
+   if (c != k)
+      ERR_SET(err_bad_param);
+
+   /*
+    * Relative URLs refer to site of previous request
+    *
+    */
+   if (!ria_http_get_string(&psite, ria_str_site_address, &ctx->http))
+      return false;
+   csite = (psite == NULL) ? 0 : StrLen(psite);
+   for (i=0, l=0; i<k; i++) {
+      if (!ria_get_list_item(&pi, &c, urls.uptr.ptr, urls.len, i))
+         return false;
+      if ((c <= sizeof(_http)-1) || 
+          (StrNICmp(_http, (const char*)pi, sizeof(_http)-1) != 0)) {
+         if (psite == NULL)
+            ERR_SET(err_bad_param);
+         l += sizeof(_http) - 1 + csite;
+      }
+      l += c + 1;
+   }
+   if (!_set_cookie_header(ctx))
+      return false;
+
+   /*
+    * Build absolute URLs
+    *
+    */
+   if (!heap_alloc(
+           (void**)&purls, 
+           k*(2*sizeof(char*) + sizeof(unumber)), 
+           ctx->http.mem))
+      goto exit;
+   cleanup |= cleanup_arrays;
+   pfiles = purls + k;
+   codes  = (unumber*)(pfiles + k);
+   if (!buf_create(1, 0, 0, &tmp, ctx->http.mem))
+      goto exit;
+   cleanup |= cleanup_tmp;
+   if (!buf_expand(l, &tmp))
+      goto exit;
+   p = buf_get_ptr_bytes(&tmp);
+   for (i=0; i<k; i++) {
+      if (!ria_get_list_item(&pi, &c, files.uptr.ptr, files.len, i))
+         goto exit;
+      pfiles[i] = (const char*)pi;
+      if (!ria_get_list_item(&pi, &c, urls.uptr.ptr, urls.len, i))
+         goto exit;
+      purls[i] = (const char*)p;
+      if ((c <= sizeof(_http)-1) || 
+          (StrNICmp(_http, (const char*)pi, sizeof(_http)-1) != 0)) {
+         MemCpy(p, _http, sizeof(_http)-1);
+         p += sizeof(_http) - 1;
+         MemCpy(p, psite, csite);
+         p += csite;
+      }
+      MemCpy(p, pi, c+1);
+      p += c + 1;
+   }
+
+   /*
+    * Fetch and collect status codes
+    *
+    */
+   RIA_TRACE_START;
+   RIA_TRACE_MSG("get_html_many(): requests=");
+   RIA_TRACE_INT(k);
+   RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
+   if (!ria_http_get_many(
+           codes, 
+           purls, 
+           pfiles, 
+           k, 
+           (n <= 0) ? 0 : (usize)n, 
+           &ctx->http))
+      goto exit;
+   if (!ria_create_list_in_buf(dst))
+      goto exit;
+   for (i=0; i<k; i++) {
+      l = sizeof(num);
+      do {
+         num[--l] = (byte)('0' + codes[i]%10);
+         codes[i] /= 10;
+      } while ((codes[i] != 0) && (l > 0));
+      if (!ria_append_to_list_in_buf(dst, num+l, sizeof(num)-l))
+         goto exit;
+   }
+   ret = true;
+
+exit:
+   if (cleanup & cleanup_tmp)
+      ret = buf_destroy(&tmp) && ret;
+   if (cleanup & cleanup_arrays)
+      ret = heap_free(purls, ctx->http.mem) && ret;
+   return ret;
+
+}
+
 /*****************************************************************************/
 bool 
    ria_implement_int_to_string(
@@ -1629,7 +1936,8 @@ bool
     */
     
    ria_param_t src;
-   byte  buf[12];
+   byte  buf[24];
+   ria_int_t n;
    usize u;
    byte* pt;
    
@@ -1648,14 +1956,17 @@ bool
     * Convert 
     *
     */
-   pt = (byte*)src.uptr.ptr; 
-   OS_B_U_COUNT(u, pt, src.len);
+   GET_INT(n, src);
    pt = buf + sizeof(buf) - 1;
-   for (; u>0; u/=10) {
-      if (pt == buf-1)
+   do {
+      if (pt == buf)
          ERR_SET(err_internal);
-      *(pt--) = u%10 + '0';
-   }
+      *(pt--) = (byte)((n < 0) ? '0' - n%10 : '0' + n%10);
+      n /= 10;
+   } while (n != 0);
+   GET_INT(n, src);
+   if (n < 0)
+      *(pt--) = '-';
    u = sizeof(buf) - (pt-buf) - 1;
    if (!ria_prealloc_datatype_in_buf(&pt, ria_string, u+1, dst))
       return false;                                         
@@ -1665,6 +1976,137 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_implement_item(
+      buf_t*              IN OUT   dst,
+      umask*              OUT      flags,                     
+      byte*               IN       ppar,
+      usize               IN       cpar,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * item (of list) implementation
+ *
+ */
+{
+
+   /*
+    * par1 - list <list>
+    * par2 - index <int>
+    *
+    */
+    
+   ria_param_t list;
+   ria_param_t idx;
+   const byte* pi;
+   usize u, k, c;
+   byte* pt;
+   
+   assert(dst   != NULL);
+   assert(ppar  != NULL);
+   assert(ctx   != NULL);
+   assert(flags != NULL);
+   UNUSED(ctx);
+
+   UNPACK_LIST(list, ppar, cpar);
+   UNPACK_INT(idx, ppar, cpar);
+   if (cpar != 0)
+      ERR_SET(err_internal);
+   *flags = ria_func_dst_ready;      
+
+   /*
+    * Get item, empty string if out of range
+    *
+    */
+   GET_POS(u, idx);
+   if (!ria_get_list_count(&k, list.uptr.ptr, list.len))
+      return false;
+   pi = NULL;
+   c  = 0;
+   if (u < k)
+      if (!ria_get_list_item(&pi, &c, list.uptr.ptr, list.len, u))
+         return false;
+   if (!ria_prealloc_datatype_in_buf(&pt, ria_string, c+1, dst))
+      return false;
+   if (c > 0)
+      MemCpy(pt, pi, c);
+   pt[c] = 0x00;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_implement_join(
+      buf_t*              IN OUT   dst,
+      umask*              OUT      flags,                     
+      byte*               IN       ppar,
+      usize               IN       cpar,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * join (list items into string) implementation
+ *
+ */
+{
+
+   /*
+    * par1 - list <list>
+    * par2 - separator <string>
+    *
+    */
+    
+   ria_param_t list;
+   ria_param_t sep;
+   const byte* pi;
+   usize i, k, c, l;
+   byte* pt;
+   
+   assert(dst   != NULL);
+   assert(ppar  != NULL);
+   assert(ctx   != NULL);
+   assert(flags != NULL);
+   UNUSED(ctx);
+
+   UNPACK_LIST(list, ppar, cpar);
+   UNPACK_STRING(sep, ppar, cpar);
+   if (cpar != 0)
+      ERR_SET(err_internal);
+   *flags = ria_func_dst_ready;      
+
+   /*
+    * Compute result length
+    *
+    */
+   if (!ria_get_list_count(&k, list.uptr.ptr, list.len))
+      return false;
+   for (i=0, l=0; i<k; i++) {
+      if (!ria_get_list_item(&pi, &c, list.uptr.ptr, list.len, i))
+         return false;
+      l += c + ((i > 0) ? sep.len : 0);
+   }
+
+   /*
+    * Join
+    *
+    */
+   if (!ria_prealloc_datatype_in_buf(&pt, ria_string, l+1, dst))
+      return false;
+   for (i=0; i<k; i++) {
+      if (!ria_get_list_item(&pi, &c, list.uptr.ptr, list.len, i))
+         return false;
+      if ((i > 0) && (sep.len > 0)) {
+         MemCpy(pt, sep.uptr.ptr, sep.len);
+         pt += sep.len;
+      }
+      if (c > 0)
+         MemCpy(pt, pi, c);
+      pt += c;
+   }
+   *pt = 0x00;
+   return true;
+
+}
+
 /*****************************************************************************/
 bool 
    ria_implement_last_response(
@@ -1711,18 +2153,19 @@ bool
       usize               IN       cpar,
       ria_exec_state_t*   IN OUT   ctx)
 /*
- * length (of string) implementation
+ * length (of string or list) implementation
  *
  */
 {
 
    /*
-    * par1 - string <string>
+    * par1 - string <string> or list <list>
     *
     */
     
    ria_param_t str;
-   byte* pt;
+   ria_type_t type;
+   usize k;
    
    assert(dst   != NULL);
    assert(ppar  != NULL);
@@ -1730,19 +2173,60 @@ bool
    assert(flags != NULL);
    UNUSED(ctx);
 
-   UNPACK_STRING(str, ppar, cpar);
+   if (!ria_peek_func_param(&type, ppar, cpar))
+      return false;
+   if (type == ria_list) {
+      UNPACK_LIST(str, ppar, cpar);
+   }
+   else {
+      UNPACK_STRING(str, ppar, cpar);
+   }
    if (cpar != 0)
       ERR_SET(err_internal);
    *flags = ria_func_dst_ready;      
 
    /*
-    * Save length
+    * Save length or number of items
     *
     */
-   if (!ria_prealloc_datatype_in_buf(&pt, ria_int, 4, dst))
-      return false;                                            
-   U_OS_B_COUNT(pt, 4, str.len);
-   return true;  
+   if (type != ria_list)
+      return ria_set_int_into_buf(dst, str.len);
+   if (!ria_get_list_count(&k, str.uptr.ptr, str.len))
+      return false;
+   return ria_set_int_into_buf(dst, k);
+
+}
+
+/*****************************************************************************/
+bool 
+   ria_implement_list(
+      buf_t*              IN OUT   dst,
+      umask*              OUT      flags,                     
+      byte*               IN       ppar,
+      usize               IN       cpar,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * list (empty list creation) implementation
+ *
+ */
+{
+
+   /*
+    * No params
+    *
+    */
+
+   assert(dst   != NULL);
+   assert(ctx   != NULL);
+   assert(flags != NULL);
+   UNUSED(ppar);
+   UNUSED(ctx);
+
+   if (cpar != 0)
+      ERR_SET(err_internal);
+   *flags = ria_func_dst_ready;
+   
+   return ria_create_list_in_buf(dst);
 
 }
 
@@ -2476,6 +2960,72 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_implement_split(
+      buf_t*              IN OUT   dst,
+      umask*              OUT      flags,                     
+      byte*               IN       ppar,
+      usize               IN       cpar,
+      ria_exec_state_t*   IN OUT   ctx)
+/*
+ * split (string into list) implementation
+ *
+ */
+{
+
+   /*
+    * par1 - string <string>
+    * par2 - separator <string>
+    *
+    */
+    
+   ria_param_t str;
+   ria_param_t sep;
+   usize i, j;
+   
+   assert(dst   != NULL);
+   assert(ppar  != NULL);
+   assert(ctx   != NULL);
+   assert(flags != NULL);
+   UNUSED(ctx);
+
+   UNPACK_STRING(str, ppar, cpar);
+   UNPACK_STRING(sep, ppar, cpar);
+   if (cpar != 0)
+      ERR_SET(err_internal);
+   *flags = ria_func_dst_ready;      
+   if (!ria_create_list_in_buf(dst))
+      return false;
+
+   /*
+    * Empty string gives empty list, empty separator gives single item
+    *
+    */
+   if (str.len == 0)
+      return true;
+   if (sep.len == 0)
+      return ria_append_to_list_in_buf(dst, str.uptr.ptr, str.len);
+
+   /*
+    * Split
+    *
+    */
+   for (i=j=0; i+sep.len<=str.len; ) {
+      if ((str.uptr.ptr[i] != sep.uptr.ptr[0]) || 
+          MemCmp(str.uptr.ptr+i, sep.uptr.ptr, sep.len)) {
+         i++;
+         continue;
+      }
+      if (!ria_append_to_list_in_buf(dst, str.uptr.ptr+j, i-j))
+         return false;
+      i += sep.len;
+      j  = i;
+   }
+   return ria_append_to_list_in_buf(dst, str.uptr.ptr+j, str.len-j);
+
+}
+
 /*****************************************************************************/
 bool 
    ria_implement_string_to_int(
@@ -2497,7 +3047,6 @@ bool
     
    ria_param_t src;
    usize i, u;
-   byte* pt;
    
    assert(dst   != NULL);
    assert(ppar  != NULL);
@@ -2522,11 +3071,7 @@ bool
       }
       u = u*10 + src.uptr.str[i] - '0';
    }
-   i = (u > 0xFFFFFF) ? 4 : (u > 0xFFFF) ? 3 : (u > 0xFF) ? 2 : 1;
-   if (!ria_prealloc_datatype_in_buf(&pt, ria_int, i, dst))
-      return false;                                         
-   U_OS_B_COUNT(pt, i, u);
-   return true;
+   return ria_set_int_into_buf(dst, (u == (usize)-1) ? -1 : (ria_int_t)u);
 
 }
 
@@ -2555,7 +3100,6 @@ bool
    ria_param_t pos;
    ria_param_t len;    
    usize l, u;
-   byte* pt;
    
    assert(dst   != NULL);
    assert(ppar  != NULL);
@@ -2576,13 +3120,11 @@ bool
     * Get substring
     *
     */
-   pt = (byte*)pos.uptr.ptr; 
-   OS_B_U_COUNT(u, pt, pos.len);
+   GET_POS(u, pos);
    if (u >= str.len)
       return true;
-   pt = (byte*)len.uptr.ptr; 
-   OS_B_U_COUNT(l, pt, len.len);
-   if (u+l > str.len)
+   GET_POS(l, len);
+   if (l > str.len-u)
       l = str.len - u;
    if (!buf_expand(l+1, dst))
       return true;
@@ -35,6 +35,7 @@ extern const char* _multiheader;
               ria_exec_state_t*   IN OUT   ctx)
 
 DECLARE_IMPLEMENT(add_parsing_rule);
+DECLARE_IMPLEMENT(append);
 DECLARE_IMPLEMENT(create_parser_for_file);
 DECLARE_IMPLEMENT(dehtml);
 DECLARE_IMPLEMENT(extract_string);
@@ -42,12 +43,16 @@ DECLARE_IMPLEMENT(extract_string_from_file);
 DECLARE_IMPLEMENT(get_binary_to_file);
 DECLARE_IMPLEMENT(get_header);
 DECLARE_IMPLEMENT(get_html);
+DECLARE_IMPLEMENT(get_html_many);
 DECLARE_IMPLEMENT(get_html_with_dump);
 DECLARE_IMPLEMENT(get_html_to_file);
 DECLARE_IMPLEMENT(get_html_to_file_with_dump);
 DECLARE_IMPLEMENT(int_to_string);
+DECLARE_IMPLEMENT(item);
+DECLARE_IMPLEMENT(join);
 DECLARE_IMPLEMENT(last_response);
 DECLARE_IMPLEMENT(length);
+DECLARE_IMPLEMENT(list);
 DECLARE_IMPLEMENT(load_cookie);
 DECLARE_IMPLEMENT(load_from_file);
 DECLARE_IMPLEMENT(post);
@@ -57,6 +62,7 @@ DECLARE_IMPLEMENT(post_with_dump);
 DECLARE_IMPLEMENT(save_cookie);
 DECLARE_IMPLEMENT(save_to_file);
 DECLARE_IMPLEMENT(set_header);
+DECLARE_IMPLEMENT(split);
 DECLARE_IMPLEMENT(string_to_int);
 DECLARE_IMPLEMENT(substring);
 
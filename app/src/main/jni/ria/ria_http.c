@@ -342,6 +342,16 @@ bool
 
    assert(ctx != NULL);
 
+#ifdef RIA_HTTP_ATOMIC
+#ifdef USE_RIA_ASYNC_CALLS   
+   /*
+    * Pending request may still be driven by platform
+    *
+    */
+   if (ctx->proto != NULL)
+      ret = ria_papi_http_shutdown(ctx) && ret;
+#endif
+#endif
    if (ctx->request != NULL) {
       ret = ria_papi_http_close_request(ctx) && ret;
       ctx->request = NULL;
@@ -371,6 +381,41 @@ bool
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_http_clone(     
+      ria_http_t*         IN OUT   dst,
+      const ria_http_t*   IN       src)
+/*
+ * Copies session state of HTTP context
+ *
+ */
+{
+
+   unumber i;
+
+   assert(dst != NULL);
+   assert(src != NULL);
+
+   if (!buf_load(
+           buf_get_ptr_bytes(&src->pool), 0, 
+           buf_get_length(&src->pool), &dst->pool))
+      return false;
+   if (!buf_load(
+           buf_get_ptr_bytes(&src->cookie), 0, 
+           buf_get_length(&src->cookie), &dst->cookie))
+      return false;
+   if (!buf_load(
+           buf_get_ptr_bytes(&src->hdrs), 0, 
+           buf_get_length(&src->hdrs), &dst->hdrs))
+      return false;
+   for (i=0; i<ria_str_max; i++)
+      dst->strs[i] = src->strs[i];
+   dst->hdrs_recv = src->hdrs_recv;
+   return true;
+
+}
+
 /*****************************************************************************/
 bool 
    ria_http_get_string(     
@@ -1094,6 +1139,102 @@ exit:
 
 }
 
+/*****************************************************************************/
+bool 
+   ria_http_get_many(     
+      unumber*             OUT   codes,
+      const char* const*   IN    urls,
+      const char* const*   IN    files,
+      usize                IN    count,
+      usize                IN    limit,
+      ria_http_t*          IN    ctx)
+/*
+ * Performs GET requests concurrently, stores responses to files
+ *
+ */
+{
+
+   ria_http_t* slots;
+   const char* agent;
+   usize i, n;
+   bool ret = false;
+
+   assert(codes != NULL);
+   assert(urls  != NULL);
+   assert(files != NULL);
+   assert(ctx   != NULL);
+
+   if (count == 0)
+      return true;
+   if ((limit == 0) || (limit > count))
+      limit = count;
+   if (!ria_http_get_string(&agent, ria_str_user_agent, ctx))
+      return false;
+
+   /*
+    * Create slot contexts, each one serves single request at a time
+    *
+    */
+   if (!heap_alloc((void**)&slots, limit*sizeof(*slots), ctx->mem))
+      return false;
+   for (n=0; n<limit; n++) {
+      if (!ria_http_create(slots+n, ctx->config, ctx->mem))
+         goto exit;
+      if (agent != NULL) 
+         if (!ria_http_set_string(
+                 agent, 
+                 StrLen(agent), 
+                 ria_str_user_agent, 
+                 slots+n)) {
+            n++;
+            goto exit;
+         }
+      if (!ria_http_init(slots+n)) {
+         n++;
+         goto exit;
+      }
+   }
+
+   /* 
+    * Call platform 
+    *
+    */
+   ret = ria_papi_http_get_many(codes, urls, files, count, slots, limit, ctx);
+
+exit:
+   for (i=0; i<n; i++) {
+      if (slots[i].proto != NULL)
+         ret = ria_papi_http_shutdown(slots+i) && ret;
+      ret = ria_http_destroy(slots+i) && ret;
+   }
+   return heap_free(slots, ctx->mem) && ret;
+
+}
+
+/*****************************************************************************/
+#ifdef RIA_HTTP_ATOMIC
+#ifdef USE_RIA_ASYNC_CALLS   
+bool 
+   ria_http_complete(     
+      ria_http_t*   IN    ctx)
+/*
+ * Completes atomic request which was pending
+ *
+ */
+{
+
+   assert(ctx != NULL);
+   
+   /*
+    * Redirect to platform
+    *
+    */
+   return ria_papi_http_complete(ctx);
+
+}
+#endif
+#endif
+
 /*****************************************************************************/
 bool 
    ria_http_get_header(     
@@ -6,17 +6,13 @@
 
 
 /*
- * Maintain different HTTP protocol operation principles
+ * Maintain different HTTP protocol operation principles; with async
+ * calls atomic request is completed asynchronously as a whole
  *
  */
 #ifdef ANDROID
 #define RIA_HTTP_ATOMIC
 #endif 
-#ifdef RIA_USE_ASYNC_CALLS
-#ifdef RIA_HTTP_ATOMIC
-#error HTTP configuration mismatch
-#endif
-#endif 
 
 
 /*
@@ -94,6 +90,10 @@ typedef struct ria_http_s {
    bool            reentry;
    void*           pdata;
    usize           cdata;
+#ifdef USE_RIA_ASYNC_CALLS   
+   void*           hdrlist;
+   unumber         result;
+#endif   
 #endif   
 #ifdef USE_RIA_ASYNC_CALLS   
    ria_async_t     async;
@@ -135,6 +135,23 @@ bool
    ria_http_destroy(     
       ria_http_t*   IN OUT   ctx);
 
+/*@@ria_http_clone
+ *
+ * Copies session state of HTTP context: cookies, headers and strings; 
+ * connection is not copied, destination makes its own one
+ *
+ * Parameters:     dst            destination HTTP context
+ *                 src            source HTTP context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_http_clone(     
+      ria_http_t*         IN OUT   dst,
+      const ria_http_t*   IN       src);
+
 /*@@ria_http_get_string
  *
  * Fetches HTTP string value
@@ -255,6 +272,48 @@ bool
       bool          IN    reentry,
       ria_http_t*   IN    ctx);
 
+/*@@ria_http_get_many
+ *
+ * Performs GET requests concurrently, stores responses to files
+ *
+ * Parameters:     codes          status codes, 0 if request failed
+ *                 urls           absolute URLs
+ *                 files          destination filenames
+ *                 count          number of requests
+ *                 limit          max number of concurrent requests
+ *                 ctx            HTTP context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool 
+   ria_http_get_many(     
+      unumber*             OUT   codes,
+      const char* const*   IN    urls,
+      const char* const*   IN    files,
+      usize                IN    count,
+      usize                IN    limit,
+      ria_http_t*          IN    ctx);
+
+/*@@ria_http_complete
+ *
+ * Completes atomic request which was pending
+ *
+ * Parameters:     ctx            HTTP context
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+#ifdef RIA_HTTP_ATOMIC
+#ifdef USE_RIA_ASYNC_CALLS   
+bool 
+   ria_http_complete(     
+      ria_http_t*   IN    ctx);
+#endif
+#endif
+
 /*@@ria_http_get_header
  *
  * Fetches HTTP header value
@@ -5,6 +5,10 @@
 #include "ria_core.h"
 #ifdef ANDROID
 #include <curl/curl.h>
+#include <time.h>
+#ifdef USE_RIA_ASYNC_CALLS
+#include <sys/select.h>
+#endif
 #endif
 #ifdef WISE12
 #include "..\..\StdPxe.h"
@@ -276,10 +280,296 @@ bool
 }
 
 
+/******************************************************************************
+ *   Thread API
+ */
+
+#if defined(WIN32_APP)
+/*****************************************************************************/
+static DWORD WINAPI
+   ria_papi_thread_start(
+      LPVOID   IN   arg)
+/*
+ * Calls thread routine
+ *
+ */
+{
+
+   ria_papi_thread_t* thread = arg;
+
+   thread->proc(thread->arg);
+   return 0;
+
+}
+#elif defined(ANDROID)
+/*****************************************************************************/
+static void*
+   ria_papi_thread_start(
+      void*   IN   arg)
+/*
+ * Calls thread routine
+ *
+ */
+{
+
+   ria_papi_thread_t* thread = arg;
+
+   thread->proc(thread->arg);
+   return NULL;
+
+}
+#endif
+
+/*****************************************************************************/
+bool
+   ria_papi_thread_create(
+      ria_papi_thread_t*       OUT   thread,
+      ria_papi_thread_proc_t   IN    proc,
+      void*                    IN    arg)
+/*
+ * Thread creation from platform
+ *
+ */
+{
+
+   assert(thread != NULL);
+   assert(proc   != NULL);
+
+   thread->proc = proc;
+   thread->arg  = arg;
+#if defined(WIN32_APP)
+   thread->thread = CreateThread(NULL, 0, ria_papi_thread_start, thread, 0, NULL);
+   if (thread->thread != NULL)
+      return true;
+   ERR_SET(err_internal);
+#elif defined(ANDROID)
+   if (pthread_create(&thread->thread, NULL, ria_papi_thread_start, thread) == 0)
+      return true;
+   ERR_SET(err_internal);
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_thread_join(
+      ria_papi_thread_t*   IN OUT   thread)
+/*
+ * Thread join from platform
+ *
+ */
+{
+
+   assert(thread != NULL);
+
+#if defined(WIN32_APP)
+   if (WaitForSingleObject(thread->thread, INFINITE) != WAIT_OBJECT_0)
+      ERR_SET(err_internal);
+   if (CloseHandle(thread->thread))
+      return true;
+   ERR_SET(err_internal);
+#elif defined(ANDROID)
+   if (pthread_join(thread->thread, NULL) == 0)
+      return true;
+   ERR_SET(err_internal);
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_sem_create(
+      ria_papi_sem_t*   OUT   sem,
+      unumber           IN    count)
+/*
+ * Semaphore creation from platform
+ *
+ */
+{
+
+   assert(sem != NULL);
+
+#if defined(WIN32_APP)
+   sem->sem = CreateSemaphore(NULL, (LONG)count, 0x7FFFFFFF, NULL);
+   if (sem->sem != NULL)
+      return true;
+   ERR_SET(err_internal);
+#elif defined(ANDROID)
+   sem->count = count;
+   if (pthread_mutex_init(&sem->mutex, NULL) != 0)
+      ERR_SET(err_internal);
+   if (pthread_cond_init(&sem->cond, NULL) != 0) {
+      pthread_mutex_destroy(&sem->mutex);
+      ERR_SET(err_internal);
+   }
+   return true;
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_sem_destroy(
+      ria_papi_sem_t*   IN OUT   sem)
+/*
+ * Semaphore destruction from platform
+ *
+ */
+{
+
+   assert(sem != NULL);
+
+#if defined(WIN32_APP)
+   if (CloseHandle(sem->sem))
+      return true;
+   ERR_SET(err_internal);
+#elif defined(ANDROID)
+   if (pthread_cond_destroy(&sem->cond) != 0) {
+      pthread_mutex_destroy(&sem->mutex);
+      ERR_SET(err_internal);
+   }
+   if (pthread_mutex_destroy(&sem->mutex) != 0)
+      ERR_SET(err_internal);
+   return true;
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_sem_post(
+      ria_papi_sem_t*   IN OUT   sem)
+/*
+ * Semaphore post from platform
+ *
+ */
+{
+
+   assert(sem != NULL);
+
+#if defined(WIN32_APP)
+   if (ReleaseSemaphore(sem->sem, 1, NULL))
+      return true;
+   ERR_SET(err_internal);
+#elif defined(ANDROID)
+   pthread_mutex_lock(&sem->mutex);
+   sem->count++;
+   pthread_cond_signal(&sem->cond);
+   pthread_mutex_unlock(&sem->mutex);
+   return true;
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_sem_wait(
+      ria_papi_sem_t*   IN OUT   sem)
+/*
+ * Semaphore wait from platform
+ *
+ */
+{
+
+   assert(sem != NULL);
+
+#if defined(WIN32_APP)
+   if (WaitForSingleObject(sem->sem, INFINITE) == WAIT_OBJECT_0)
+      return true;
+   ERR_SET(err_internal);
+#elif defined(ANDROID)
+   pthread_mutex_lock(&sem->mutex);
+   while (sem->count == 0)
+      pthread_cond_wait(&sem->cond, &sem->mutex);
+   sem->count--;
+   pthread_mutex_unlock(&sem->mutex);
+   return true;
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+
+/******************************************************************************
+ *   Time API
+ */
+
+/*****************************************************************************/
+bool
+   ria_papi_get_time(
+      uint64*   OUT   time)
+/*
+ * Monotonic time from platform
+ *
+ */
+{
+
+#if defined(WIN32_APP)
+   LARGE_INTEGER c, f;
+#elif defined(ANDROID)
+   struct timespec t;
+#endif
+
+   assert(time != NULL);
+
+#if defined(WIN32_APP)
+   if (!QueryPerformanceCounter(&c) || !QueryPerformanceFrequency(&f))
+      ERR_SET(err_internal);
+   *time = (uint64)(c.QuadPart / f.QuadPart) * 1000000000 +
+           (uint64)(c.QuadPart % f.QuadPart) * 1000000000 / f.QuadPart;
+   return true;
+#elif defined(ANDROID)
+   if (clock_gettime(CLOCK_MONOTONIC, &t) != 0)
+      ERR_SET(err_internal);
+   *time = (uint64)t.tv_sec * 1000000000 + (uint64)t.tv_nsec;
+   return true;
+#elif defined(WISE12)
+   ERR_SET(err_not_supported);
+#else
+#error Not implemented
+#endif
+
+}
+
+
 /******************************************************************************
  *   HTTP API
  */
 
+#ifdef ANDROID
+#ifdef USE_RIA_ASYNC_CALLS
+/*
+ * Multi handle shared by all HTTP contexts and its guard
+ *
+ */
+static CURLM*          _multi = NULL;
+static generic_mutex_t _multi_sync;
+#endif
+#endif
+
 /*****************************************************************************/
 #ifdef WIN32_APP
 #ifdef USE_RIA_ASYNC_CALLS
@@ -312,9 +602,11 @@ void CALLBACK
       return;    
    }   
 
+   RIA_TRACE_START;
    RIA_TRACE_MSG("Internet status =");
    RIA_TRACE_INT(dwInternetStatus);
    RIA_TRACE_MSG("\n");
+   RIA_TRACE_STOP;
 
    /*
     * Check for status
@@ -330,14 +622,18 @@ void CALLBACK
    }   
    switch (ctx->async.state) {
    case ria_http_async_connect:
+      RIA_TRACE_START;
       RIA_TRACE_MSG("HTTP async state: CONNECT\n");
+      RIA_TRACE_STOP;
       if (dwInternetStatus != INTERNET_STATUS_HANDLE_CREATED)
          return;
       if (lpvStatusInformation != NULL)   
          ctx->connect = *((void**)lpvStatusInformation);
       break;
    case ria_http_async_receive:
+      RIA_TRACE_START;
       RIA_TRACE_MSG("HTTP async state: RECEIVE\n");
+      RIA_TRACE_STOP;
       if (dwInternetStatus == INTERNET_STATUS_HANDLE_CREATED) {
          if (lpvStatusInformation != NULL)   
             ctx->request = *((void**)lpvStatusInformation);
@@ -347,7 +643,9 @@ void CALLBACK
          return;
       break;
    case ria_http_async_rcvmore:
+      RIA_TRACE_START;
       RIA_TRACE_MSG("HTTP async state: RCVMORE\n");
+      RIA_TRACE_STOP;
       if (dwInternetStatus != INTERNET_STATUS_REQUEST_COMPLETE)
          return;
       break;
@@ -661,6 +959,20 @@ bool
    
 #elif defined(ANDROID) /* WIN32_APP */
 
+#ifdef USE_RIA_ASYNC_CALLS
+   /*
+    * Detach pending request from multi handle
+    *
+    */
+   sync_mutex_lock(&_multi_sync);
+   if (_multi != NULL)
+      curl_multi_remove_handle(_multi, p);
+   sync_mutex_unlock(&_multi_sync);
+   if (ctx->hdrlist != NULL) {
+      curl_slist_free_all(ctx->hdrlist);
+      ctx->hdrlist = NULL;
+   }
+#endif
    curl_easy_cleanup(p);
    return true;   
 
@@ -806,6 +1118,61 @@ bool
 
 }
 
+/*****************************************************************************/
+#ifdef ANDROID
+static bool
+   _build_header_list(
+      struct curl_slist**   OUT      list,
+      ria_http_t*           IN OUT   ctx)
+/*
+ * Converts request headers set by script into libCurl header list, 
+ * headers are consumed
+ *
+ */
+{
+
+   uint  c;
+   byte* p;
+   byte* q;
+
+   assert(list != NULL);
+   assert(ctx  != NULL);
+
+   *list = NULL;
+   if (ctx->hdrs_recv) 
+      return true;
+   c = buf_get_length(&ctx->hdrs);
+   p = buf_get_ptr_bytes(&ctx->hdrs);
+   for (; c>0; p=q+2, c-=2) {
+      for (q=p; c>0; c--, q++) 
+         if (q[0] == 0x0D)
+            break;
+      if ((c == 1) || (q[1] != 0x0A)) {
+         ERR_SET_NO_RET(err_internal);
+         goto failed;
+      }   
+      q[0] = 0x00;      
+      p = (byte*)curl_slist_append(*list, (const char*)p);
+      q[0] = 0x0D;
+      if (p == NULL) {
+         ERR_SET_NO_RET(err_internal);
+         goto failed;
+      }   
+      *list = (struct curl_slist*)p;
+   }
+   if (!buf_destroy(&ctx->hdrs)) 
+      goto failed;
+   return true;
+
+failed:
+   if (*list != NULL) 
+      curl_slist_free_all(*list);
+   *list = NULL;
+   return false;
+
+}
+#endif
+
 /*****************************************************************************/
 bool
    ria_papi_http_send(
@@ -828,7 +1195,6 @@ bool
 #ifdef ANDROID 
    uint  c, curl;
    byte* p;
-   byte* q;
    bool  ret = false;
    struct curl_slist *headerlist = NULL;
 #endif
@@ -914,30 +1280,8 @@ bool
     * Add required HTTP headers 
     *
     */
-   if (!ctx->hdrs_recv) {
-      c = buf_get_length(&ctx->hdrs);
-      p = buf_get_ptr_bytes(&ctx->hdrs);
-      for (; c>0; p=q+2, c-=2) {
-         for (q=p; c>0; c--, q++) 
-            if (q[0] == 0x0D)
-               break;
-         if (c == 1) {
-            ERR_SET_NO_RET(err_internal);
-            goto cleanup;
-         }   
-         if (q[1] != 0x0A) {
-            ERR_SET_NO_RET(err_internal);
-            goto cleanup;
-         }   
-         q[0] = 0x00;      
-         headerlist = curl_slist_append(headerlist, (const char*)p);
-         if (headerlist == NULL) {
-            ERR_SET_NO_RET(err_internal);
-            goto cleanup;
-         }   
-         q[0] = 0x0D;
-      }
-   }   
+   if (!_build_header_list(&headerlist, ctx))
+      goto cleanup;
    if (curl_easy_setopt(
           ctx->proto, 
           CURLOPT_HTTPHEADER, 
@@ -1008,12 +1352,39 @@ bool
     * Do the HTTP job
     *
     */
+#ifdef USE_RIA_ASYNC_CALLS
+   /*
+    * Queue request to multi handle, it is driven by ria_papi_http_poll() 
+    * and header list is released by ria_papi_http_complete()
+    *
+    */
+   if (curl_easy_setopt(ctx->proto, CURLOPT_PRIVATE, ctx) != CURLE_OK) {
+      ERR_SET_NO_RET(err_internal);
+      goto cleanup;
+   }   
+   ctx->result  = CURLE_OK;
+   ctx->hdrlist = headerlist;
+   sync_mutex_lock(&_multi_sync);
+   if (_multi == NULL)
+      curl = CURLM_BAD_HANDLE;
+   else   
+      curl = curl_multi_add_handle(_multi, ctx->proto);
+   sync_mutex_unlock(&_multi_sync);
+   if (curl != CURLM_OK) {
+      ctx->hdrlist = NULL;
+      ERR_SET_NO_RET(err_internal);
+      goto cleanup;
+   }   
+   headerlist = NULL;
+   *pending = true;
+#else
    curl = curl_easy_perform(ctx->proto);
    if (curl != CURLE_OK) {
       if (GET_ERR_CONTEXT->err == err_none)
          ERR_SET_NO_RET(err_internal);
       goto cleanup;
    }   
+#endif
    ret = true;   
       
 cleanup:      
@@ -1156,7 +1527,9 @@ bool
          ERR_SET(err_internal);
       *pending = true;
       *cdata   = 0;
+      RIA_TRACE_START;
       RIA_TRACE_MSG("PENDING RECEIVE\n"); 
+      RIA_TRACE_STOP;
       return true;
    }         
    if (dw < cbuf)
@@ -1230,6 +1603,366 @@ bool
    
 }
 
+/*****************************************************************************/
+bool
+   ria_papi_http_complete(
+      ria_http_t*   OUT   ctx)
+/*
+ * Completes request which was pending
+ *
+ */
+{
+
+   assert(ctx != NULL);
+
+#if defined(ANDROID) && defined(USE_RIA_ASYNC_CALLS)
+   /*
+    * Request is already detached from multi handle by poller
+    *
+    */
+   if (ctx->hdrlist != NULL) {
+      curl_slist_free_all(ctx->hdrlist);
+      ctx->hdrlist = NULL;
+   }
+   if (ctx->result != CURLE_OK) 
+      ERR_SET(err_internal);
+   return true;
+#else
+   ERR_SET(err_unexpected_call);
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_http_startup(void)
+/*
+ * Creates platform objects shared by all HTTP contexts
+ *
+ */
+{
+
+#if defined(ANDROID) && defined(USE_RIA_ASYNC_CALLS)
+   sync_mutex_create(&_multi_sync);
+   _multi = curl_multi_init();
+   if (_multi == NULL) {
+      sync_mutex_destroy(&_multi_sync);
+      ERR_SET(err_internal);
+   }
+#endif
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_http_cleanup(void)
+/*
+ * Destroys platform objects shared by all HTTP contexts
+ *
+ */
+{
+
+#if defined(ANDROID) && defined(USE_RIA_ASYNC_CALLS)
+   CURLMcode code;
+
+   code = curl_multi_cleanup(_multi);
+   _multi = NULL;
+   sync_mutex_destroy(&_multi_sync);
+   if (code != CURLM_OK)
+      ERR_SET(err_internal);
+#endif
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_papi_http_poll(
+      unumber*   OUT   completed,
+      unumber    IN    timeout)
+/*
+ * Drives pending requests of all HTTP contexts
+ *
+ */
+{
+
+#if defined(ANDROID) && defined(USE_RIA_ASYNC_CALLS)
+   struct timeval tv;
+   fd_set r, w, e;
+   CURLMsg* msg;
+   CURL* easy;
+   char* p;
+   ria_http_t* ctx;
+   int running, left, n;
+#endif
+
+   assert(completed != NULL);
+   
+   *completed = 0;
+
+#if defined(ANDROID) && defined(USE_RIA_ASYNC_CALLS)
+
+   /*
+    * Wait for network activity, multi handle is not locked meanwhile so
+    * that new requests can be queued
+    *
+    */
+   FD_ZERO(&r);
+   FD_ZERO(&w);
+   FD_ZERO(&e);
+   n = -1;
+   sync_mutex_lock(&_multi_sync);
+   if (_multi == NULL) {
+      sync_mutex_unlock(&_multi_sync);
+      ERR_SET(err_unexpected_call);
+   }
+   if (curl_multi_fdset(_multi, &r, &w, &e, &n) != CURLM_OK) {
+      sync_mutex_unlock(&_multi_sync);
+      ERR_SET(err_internal);
+   }
+   sync_mutex_unlock(&_multi_sync);
+   if ((n >= 0) && (timeout > 0)) {
+      tv.tv_sec  = timeout / 1000;
+      tv.tv_usec = (timeout % 1000) * 1000;
+      select(n+1, &r, &w, &e, &tv);
+   }
+
+   /*
+    * Drive transfers and pick completed ones; owner callback is called 
+    * unlocked as it may continue script, which queues next request
+    *
+    */
+   sync_mutex_lock(&_multi_sync);
+   while (curl_multi_perform(_multi, &running) == CURLM_CALL_MULTI_PERFORM)
+      ;
+   for (;;) {
+      msg = curl_multi_info_read(_multi, &left);
+      if (msg == NULL)
+         break;
+      if (msg->msg != CURLMSG_DONE)
+         continue;
+      easy = msg->easy_handle;   
+      p = NULL;
+      if ((curl_easy_getinfo(easy, CURLINFO_PRIVATE, &p) != CURLE_OK) || 
+          (p == NULL)) {
+         curl_multi_remove_handle(_multi, easy);
+         continue;
+      }   
+      ctx = (ria_http_t*)p;
+      ctx->result = msg->data.result;
+      curl_multi_remove_handle(_multi, easy);
+      sync_mutex_unlock(&_multi_sync);
+      
+      RIA_TRACE_START;
+      RIA_TRACE_MSG("HTTP async request complete, result =");
+      RIA_TRACE_INT(ctx->result);
+      RIA_TRACE_MSG("\n");
+      RIA_TRACE_STOP;
+      ria_async_set_status(&ctx->async, ria_exec_proceed);
+      if (ctx->async.callback != NULL)
+         (*ctx->async.callback)(ctx->async.owner);
+      (*completed)++;
+      
+      sync_mutex_lock(&_multi_sync);
+   }
+   sync_mutex_unlock(&_multi_sync);
+   return true;
+
+#else
+   UNUSED(timeout);
+   return true;
+#endif
+
+}
+
+/*****************************************************************************/
+#ifdef ANDROID
+static bool
+   _start_get_many(
+      const char*          IN       url,
+      const char*          IN       file,
+      struct curl_slist*   IN       headerlist,
+      CURLM*               IN       multi,
+      ria_http_t*          IN OUT   slot)
+/*
+ * Starts single GET of ria_papi_http_get_many(), response is normalized
+ * and stored into file by receive callback
+ *
+ */
+{
+
+   assert(url   != NULL);
+   assert(file  != NULL);
+   assert(multi != NULL);
+   assert(slot  != NULL);
+
+   slot->tofile    = file;
+   slot->todump    = NULL;
+   slot->normalize = true;
+   slot->reentry   = false;
+   if ((curl_easy_setopt(slot->proto, CURLOPT_URL, url) != CURLE_OK) ||
+       (curl_easy_setopt(
+           slot->proto, 
+           CURLOPT_HTTPHEADER, 
+           headerlist) != CURLE_OK) ||
+       (curl_easy_setopt(
+           slot->proto, 
+           CURLOPT_WRITEFUNCTION, 
+           ria_papi_receive_callback) != CURLE_OK) ||
+       (curl_easy_setopt(slot->proto, CURLOPT_WRITEDATA, slot) != CURLE_OK) ||
+       (curl_easy_setopt(
+           slot->proto, 
+           CURLOPT_HEADERFUNCTION, 
+           ria_papi_header_callback) != CURLE_OK) ||
+       (curl_easy_setopt(slot->proto, CURLOPT_WRITEHEADER, slot) != CURLE_OK) ||
+       (curl_easy_setopt(slot->proto, CURLOPT_FOLLOWLOCATION, 0) != CURLE_OK) ||
+       (curl_easy_setopt(slot->proto, CURLOPT_HTTPGET, 1) != CURLE_OK) ||
+       (curl_easy_setopt(slot->proto, CURLOPT_PRIVATE, slot) != CURLE_OK))
+      ERR_SET(err_internal);
+   if (curl_multi_add_handle(multi, slot->proto) != CURLM_OK)
+      ERR_SET(err_internal);
+   return true;
+
+}
+#endif
+
+/*****************************************************************************/
+bool
+   ria_papi_http_get_many(
+      unumber*             OUT      codes,
+      const char* const*   IN       urls,
+      const char* const*   IN       files,
+      usize                IN       count,
+      ria_http_t*          IN OUT   slots,
+      usize                IN       cslots,
+      ria_http_t*          IN OUT   ctx)
+/*
+ * Performs GET requests concurrently
+ *
+ */
+{
+
+#ifdef ANDROID
+   struct timeval tv;
+   fd_set r, w, e;
+   CURLM* multi;
+   CURLMsg* msg;
+   struct curl_slist* headerlist = NULL;
+   ria_http_t* slot;
+   usize* serving = NULL;
+   usize next, active, i;
+   char* p;
+   int running, left, n;
+   bool ret = false;
+#endif
+
+   assert(codes != NULL);
+   assert(urls  != NULL);
+   assert(files != NULL);
+   assert(slots != NULL);
+   assert(ctx   != NULL);
+
+#ifdef ANDROID
+
+   for (i=0; i<count; i++)
+      codes[i] = 0;
+   if ((count == 0) || (cslots == 0))
+      return true;
+   multi = curl_multi_init();
+   if (multi == NULL)
+      ERR_SET(err_internal);
+   if (!heap_alloc((void**)&serving, cslots*sizeof(*serving), ctx->mem))
+      goto cleanup;
+   if (!_build_header_list(&headerlist, ctx))
+      goto cleanup;
+
+   /*
+    * Fill all slots, then refill slot as soon as its request completes
+    *
+    */
+   for (next=active=0; (active<cslots) && (next<count); active++, next++) {
+      serving[active] = next;
+      if (!_start_get_many(
+              urls[next], 
+              files[next], 
+              headerlist, 
+              multi, 
+              slots+active))
+         goto cleanup;
+   }
+   while (active > 0) {
+      FD_ZERO(&r);
+      FD_ZERO(&w);
+      FD_ZERO(&e);
+      n = -1;
+      if (curl_multi_fdset(multi, &r, &w, &e, &n) != CURLM_OK) {
+         ERR_SET_NO_RET(err_internal);
+         goto cleanup;
+      }
+      /*
+       * Without sockets to wait for curl asks for a short pause, Delay 
+       * does nothing on this platform, so select sleeps in both cases
+       *
+       */
+      tv.tv_sec  = 0;
+      tv.tv_usec = (n >= 0) ? 100000 : 10000;
+      select(n+1, &r, &w, &e, &tv);
+      while (curl_multi_perform(multi, &running) == CURLM_CALL_MULTI_PERFORM)
+         ;
+      for (;;) {
+         msg = curl_multi_info_read(multi, &left);
+         if (msg == NULL)
+            break;
+         if (msg->msg != CURLMSG_DONE)
+            continue;
+         p = NULL;
+         curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &p);
+         slot = (ria_http_t*)p;
+         if ((slot < slots) || (slot >= slots+cslots)) {
+            ERR_SET_NO_RET(err_internal);
+            goto cleanup;
+         }
+         i = slot - slots;
+         if (msg->data.result == CURLE_OK) 
+            if (!ria_papi_http_get_status(codes+serving[i], slot))
+               codes[serving[i]] = 0;
+         curl_multi_remove_handle(multi, slot->proto);
+         if (next < count) {
+            serving[i] = next;
+            if (!_start_get_many(
+                    urls[next], 
+                    files[next], 
+                    headerlist, 
+                    multi, 
+                    slot))
+               goto cleanup;
+            next++;
+         }
+         else
+            active--;
+      }
+   }
+   ret = true;
+
+cleanup:
+   for (i=0; i<cslots; i++)
+      curl_multi_remove_handle(multi, slots[i].proto);
+   curl_multi_cleanup(multi);
+   if (headerlist != NULL) 
+      curl_slist_free_all(headerlist);
+   if (serving != NULL)
+      ret = heap_free(serving, ctx->mem) && ret;
+   return ret;
+
+#elif defined(WIN32_APP) || defined(WISE12) /* ANDROID */
+   ERR_SET(err_internal); 
+#else /* WIN32_APP || WISE12 */
+#error Not implemented
+#endif
+
+}
+
 #if 0
 /*****************************************************************************/
 bool
@@ -121,6 +121,154 @@ bool
       void*   IN   file);
 
 
+/******************************************************************************
+ *   Thread API
+ */
+
+/*
+ * Thread routine
+ *
+ */
+typedef void (*ria_papi_thread_proc_t)(void* arg);
+
+/*
+ * Thread object
+ *
+ */
+typedef struct ria_papi_thread_s {
+#if defined(WIN32_APP)
+   HANDLE                   thread;
+#elif defined(ANDROID)
+   pthread_t                thread;
+#endif
+   ria_papi_thread_proc_t   proc;
+   void*                    arg;
+} ria_papi_thread_t;
+
+/*@@ria_papi_thread_create
+ *
+ * Starts new thread
+ *
+ * Parameters:     thread         thread object
+ *                 proc           thread routine
+ *                 arg            routine argument
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_thread_create(
+      ria_papi_thread_t*       OUT   thread,
+      ria_papi_thread_proc_t   IN    proc,
+      void*                    IN    arg);
+
+/*@@ria_papi_thread_join
+ *
+ * Waits for thread completion
+ *
+ * Parameters:     thread         thread object
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_thread_join(
+      ria_papi_thread_t*   IN OUT   thread);
+
+/*
+ * Counting semaphore
+ *
+ */
+typedef struct ria_papi_sem_s {
+#if defined(WIN32_APP)
+   HANDLE                   sem;
+#elif defined(ANDROID)
+   pthread_mutex_t          mutex;
+   pthread_cond_t           cond;
+   unumber                  count;
+#endif
+} ria_papi_sem_t;
+
+/*@@ria_papi_sem_create
+ *
+ * Creates semaphore
+ *
+ * Parameters:     sem            semaphore object
+ *                 count          initial count
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_sem_create(
+      ria_papi_sem_t*   OUT   sem,
+      unumber           IN    count);
+
+/*@@ria_papi_sem_destroy
+ *
+ * Destroys semaphore
+ *
+ * Parameters:     sem            semaphore object
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_sem_destroy(
+      ria_papi_sem_t*   IN OUT   sem);
+
+/*@@ria_papi_sem_post
+ *
+ * Increments semaphore count, wakes up single waiter
+ *
+ * Parameters:     sem            semaphore object
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_sem_post(
+      ria_papi_sem_t*   IN OUT   sem);
+
+/*@@ria_papi_sem_wait
+ *
+ * Waits for positive semaphore count and decrements it
+ *
+ * Parameters:     sem            semaphore object
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_sem_wait(
+      ria_papi_sem_t*   IN OUT   sem);
+
+
+/******************************************************************************
+ *   Time API
+ */
+
+/*@@ria_papi_get_time
+ *
+ * Monotonic time from platform
+ *
+ * Parameters:     time           time in nanoseconds
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_get_time(
+      uint64*   OUT   time);
+
+
 /******************************************************************************
  *   HTTP API
  */
@@ -261,4 +409,85 @@ bool
    ria_papi_http_close_request(
       ria_http_t*   OUT   ctx);
 
+/*@@ria_papi_http_complete
+ *
+ * Completes request which was pending
+ *
+ * Parameters:     ctx            HTTP context
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_http_complete(
+      ria_http_t*   OUT   ctx);
+
+/*@@ria_papi_http_startup
+ *
+ * Creates platform objects shared by all HTTP contexts
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_http_startup(void);
+
+/*@@ria_papi_http_cleanup
+ *
+ * Destroys platform objects shared by all HTTP contexts
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_http_cleanup(void);
+
+/*@@ria_papi_http_poll
+ *
+ * Drives pending requests of all HTTP contexts, waiting up to timeout 
+ * for network activity; owners of completed requests are switched to
+ * proceed state
+ *
+ * Parameters:     completed      number of completed requests
+ *                 timeout        timeout, ms
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_http_poll(
+      unumber*   OUT   completed,
+      unumber    IN    timeout);
+
+/*@@ria_papi_http_get_many
+ *
+ * Performs GET requests concurrently, each slot context serves one
+ * request at a time; redirects are not followed
+ *
+ * Parameters:     codes          status codes, 0 if request failed
+ *                 urls           absolute URLs
+ *                 files          destination filenames
+ *                 count          number of requests
+ *                 slots          slot HTTP contexts, initialized
+ *                 cslots         number of slots
+ *                 ctx            HTTP context with request headers
+ *
+ * Return:         true           if successful,
+ *                 false          if failed
+ *
+ */
+bool
+   ria_papi_http_get_many(
+      unumber*             OUT      codes,
+      const char* const*   IN       urls,
+      const char* const*   IN       files,
+      usize                IN       count,
+      ria_http_t*          IN OUT   slots,
+      usize                IN       cslots,
+      ria_http_t*          IN OUT   ctx);
+
 #endif
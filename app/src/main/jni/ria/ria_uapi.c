@@ -19,22 +19,94 @@ static unumber         _ref = 0;
 static unumber         _ctr = 0;
 static generic_mutex_t _sync;
 static list_entry_t    _engines;
+static list_entry_t    _modules;
 static heap_ctx_t*     _heap;
 
+/*
+ * Compiled module, read-only image shared by all engines which loaded 
+ * the same code
+ *
+ */
+typedef struct ria_module_s {
+   list_entry_t linkage;
+   unumber      ref;
+   uint32       hash;
+   buf_t        exec;
+} ria_module_t;
+
+#define LIST_TO_MODULE(_p)                                                    \
+       ( (ria_module_t*)((byte*)(_p) - OFFSETOF(ria_module_t, linkage)) )
+
 typedef struct ria_engine_s {
    list_entry_t       linkage;
    ria_handle_t       id;
    bool               locked;
+   bool               scheduled;
+   list_entry_t       backlog;
+   ria_job_t          parked;
    char               errmsg[MSG_SIZE];
-   buf_t              exec;
+   unumber            serial;
+   ria_module_t*      module;
    ria_compiler_ctx_t compiler;
    ria_executor_ctx_t executor;
    umask              cleanup;
 } ria_engine_t;
 
+#define DUMP_LIMIT_ERROR(_eng)                                                \
+           {                                                                  \
+              static const char* const _limits[] = {                         \
+                 "", "time", "commands", "memory"                             \
+              };                                                              \
+              Sprintf(                                                        \
+                 (_eng)->errmsg,                                              \
+                 sizeof((_eng)->errmsg),                                      \
+                 "Script execution limit exceeded: %s, at pos: 0x%02X\n",    \
+                 _limits[ria_get_exec_limit(&(_eng)->executor)],              \
+                 (unsigned)ria_get_exec_error_pos(&(_eng)->executor));        \
+           }
+
 #define LIST_TO_ENGINE(_p)                                                    \
        ( (ria_engine_t*)((byte*)(_p) - OFFSETOF(ria_engine_t, linkage)) )
 
+/*
+ * Scheduled job, parameters and result buffer follow the structure
+ *
+ */
+struct ria_job_s {
+   list_entry_t            linkage;
+   ria_handle_t            engine;
+   ria_function_t          func;
+   const char**            pparams;
+   usize                   cparams;
+   char*                   presult;
+   usize                   cresult;
+   ria_exec_status_t       status;
+   bool                    ok;
+   ria_uapi_job_callback_t callback;
+   void*                   arg;
+   ria_papi_sem_t          done;
+};
+
+#define LIST_TO_JOB(_p)                                                       \
+       ( (ria_job_t)((byte*)(_p) - OFFSETOF(struct ria_job_s, linkage)) )
+
+/*
+ * Scheduler worker, owns deque of jobs
+ *
+ */
+typedef struct ria_worker_s {
+   list_entry_t       jobs;
+   generic_mutex_t    sync;
+   ria_papi_thread_t  thread;
+   usize              index;
+} ria_worker_t;
+
+static ria_worker_t*  _workers = NULL;
+static usize          _cworkers = 0;
+static usize          _next = 0;
+static bool           _stop = false;
+static ria_papi_sem_t _ready;
+
 #define DUMP_SYS_ERROR(_eng)                                                  \
            {                                                                  \
               err_ctx_t* _perr = GET_ERR_CONTEXT;                             \
@@ -74,12 +146,97 @@ typedef struct ria_engine_s {
 #endif 
        
 
+/*****************************************************************************/
+static bool
+   ria_module_acquire(
+      ria_module_t**      OUT   module,
+      const mem_blk_t*    IN    exec)
+/*
+ * Gets compiled module holding given code: module already loaded by any 
+ * engine is shared, otherwise new one is created
+ *
+ */
+{
+
+   list_entry_t* pl;
+   ria_module_t* pm;
+   uint32 hash;
+
+   assert(module != NULL);
+   assert(exec != NULL);
+
+   hash = ria_hash_data(ria_hash_seed, exec->p, exec->c);
+   sync_mutex_lock(&_sync);
+   list_for_each(&_modules, &pl) {
+      pm = LIST_TO_MODULE(pl);
+      if ((pm->hash == hash) &&
+          (buf_get_length(&pm->exec) == exec->c) &&
+          ((exec->c == 0) ||
+           (MemCmp(buf_get_ptr_bytes(&pm->exec), exec->p, exec->c) == 0))) {
+         pm->ref++;
+         sync_mutex_unlock(&_sync);
+         *module = pm;
+         return true;
+      }
+   }
+   sync_mutex_unlock(&_sync);
+
+   if (!heap_alloc((void**)&pm, sizeof(*pm), _heap))
+      return false;
+   list_init_entry(&pm->linkage);
+   pm->ref  = 1;
+   pm->hash = hash;
+   /* Shared code does not grow, it takes exactly its size */
+   if (!buf_create(sizeof(byte), 0, buf_no_growth, &pm->exec, _heap)) {
+      heap_free(pm, _heap);
+      return false;
+   }
+   if ((exec->c > 0) && !buf_load(exec->p, 0, exec->c, &pm->exec)) {
+      buf_destroy(&pm->exec);
+      heap_free(pm, _heap);
+      return false;
+   }
+   sync_mutex_lock(&_sync);
+   list_insert_tail(&_modules, &pm->linkage);
+   sync_mutex_unlock(&_sync);
+   *module = pm;
+   return true;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_module_release(
+      ria_module_t*   IN OUT   module)
+/*
+ * Releases compiled module, the last reference destroys it
+ *
+ */
+{
+
+   unumber ref;
+   bool ret;
+
+   assert(module != NULL);
+
+   sync_mutex_lock(&_sync);
+   ref = --module->ref;
+   if (ref == 0)
+      list_remove_entry_simple(&module->linkage);
+   sync_mutex_unlock(&_sync);
+   if (ref > 0)
+      return true;
+   ret = buf_destroy(&module->exec);
+   return heap_free(module, _heap) && ret;
+
+}
+
 /*****************************************************************************/
 
 enum {
    cf_ria_engine_compiler = 0x01,
    cf_ria_engine_executor = 0x02,
-   cf_ria_engine_exec     = 0x04
+   cf_ria_engine_module   = 0x04
 };
 
 /*****************************************************************************/
@@ -100,8 +257,8 @@ static bool
       ret = ria_compiler_destroy(&engine->compiler) && ret;
    if (engine->cleanup & cf_ria_engine_executor)
       ret = ria_executor_destroy(&engine->executor) && ret;
-   if (engine->cleanup & cf_ria_engine_exec)
-      ret = buf_destroy(&engine->exec) && ret;
+   if (engine->cleanup & cf_ria_engine_module)
+      ret = ria_module_release(engine->module) && ret;
       
    engine->cleanup = 0x00;  
    return ret;
@@ -111,17 +268,22 @@ static bool
 /*****************************************************************************/
 static bool
    ria_engine_create(
-      ria_engine_t*   IN OUT   engine)
+      ria_engine_t*   IN OUT   engine,
+      ria_module_t*   IN OUT   module)
 /*
- * Initializes internal RIA engine object
+ * Initializes internal RIA engine object, which either shares compiled 
+ * module of other engine or gets empty one
  *
  */
 {
 
+   mem_blk_t empty;
+
    assert(engine != NULL);
 
    MemSet(engine, 0x00, sizeof(*engine));
    list_init_entry(&engine->linkage);
+   list_init_head(&engine->backlog);
 
    if (!ria_compiler_create(&engine->compiler, _heap))
       goto failed;
@@ -131,10 +293,19 @@ static bool
       goto failed;
    else
       engine->cleanup |= cf_ria_engine_executor;
-   if (!buf_create(sizeof(byte), 0, 0, &engine->exec, _heap))
-      goto failed;
-   else
-      engine->cleanup |= cf_ria_engine_exec;
+   if (module != NULL) {
+      sync_mutex_lock(&_sync);
+      module->ref++;
+      sync_mutex_unlock(&_sync);
+      engine->module = module;
+   }
+   else {
+      empty.p = NULL;
+      empty.c = 0;
+      if (!ria_module_acquire(&engine->module, &empty))
+         goto failed;
+   }
+   engine->cleanup |= cf_ria_engine_module;
    return true;
    
 failed:
@@ -143,6 +314,28 @@ failed:
    
 }      
 
+/*****************************************************************************/
+static ria_engine_t*
+   ria_find_engine(
+      handle   IN   engine)
+/*
+ * Finds engine by handle, engines list should be locked by caller
+ *
+ */
+{
+
+   list_entry_t* pl;
+   ria_engine_t* pe;
+   
+   list_for_each(&_engines, &pl) {
+      pe = LIST_TO_ENGINE(pl);
+      if (pe->id == engine)
+         return pe;
+   }
+   return NULL;
+
+}
+
 /*****************************************************************************/
 static ria_engine_t*
    ria_lock_engine(
@@ -153,8 +346,7 @@ static ria_engine_t*
  */
 {
 
-   list_entry_t* pl;
-   ria_engine_t* pe = NULL;
+   ria_engine_t* pe;
    
    /*
     * Check for initialization
@@ -170,12 +362,7 @@ static ria_engine_t*
     *
     */
    sync_mutex_lock(&_sync);
-   list_for_each(&_engines, &pl) {
-      pe = LIST_TO_ENGINE(pl);
-      if (pe->id == engine)
-         break;
-      pe = NULL;
-   }
+   pe = ria_find_engine(engine);
    if (pe != NULL) {
       if (pe->locked) 
          pe = NULL;
@@ -187,6 +374,27 @@ static ria_engine_t*
 
 }
 
+/*****************************************************************************/
+static bool
+   ria_push_job(
+      ria_job_t       IN OUT   job,
+      ria_worker_t*   IN OUT   worker)
+/*
+ * Puts job into worker's deque and wakes up single worker; owner takes jobs
+ * from the tail, other workers steal them from the head. Jobs of other 
+ * threads are pushed under engines list lock, so that stopping scheduler 
+ * does not release deques under them
+ *
+ */
+{
+
+   sync_mutex_lock(&worker->sync);
+   list_insert_tail(&worker->jobs, &job->linkage);
+   sync_mutex_unlock(&worker->sync);
+   return ria_papi_sem_post(&_ready);
+
+}
+
 /*****************************************************************************/
 static bool
    ria_unlock_engine(
@@ -197,6 +405,9 @@ static bool
  */
 {
 
+   ria_job_t job;
+   bool ret = true;
+
    assert(engine != NULL);
 
    /*
@@ -207,13 +418,72 @@ static bool
       ERR_SET(err_unexpected_call);
    
    /*
-    * Unlock
+    * Unlock, job parked by worker while engine was held by direct caller 
+    * is dispatched again; once scheduler is stopping, the job stays parked
+    * and is failed by the stop
     *
     */
    sync_mutex_lock(&_sync);
    engine->locked = false;
+   job = engine->parked;
+   if ((job != NULL) && (_cworkers != 0)) {
+      engine->parked = NULL;
+      ret = ria_push_job(job, &_workers[_next++ % _cworkers]);
+   }
    sync_mutex_unlock(&_sync);
-   return true;
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_complete_job(
+      ria_job_t   IN OUT   job)
+/*
+ * Delivers job result either to callback, which is followed by job 
+ * destruction, or to waiter
+ *
+ */
+{
+
+   assert(job != NULL);
+   
+   if (job->callback == NULL)
+      return ria_papi_sem_post(&job->done);
+   job->callback(
+      job, job->ok, job->status, job->presult, job->cresult, job->arg);
+   return heap_free(job, _heap);
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_fail_jobs(
+      list_entry_t*   IN OUT   jobs)
+/*
+ * Completes not executed jobs as failed ones
+ *
+ */
+{
+
+   list_entry_t* pl;
+   ria_job_t job;
+   bool ret = true;
+   
+   assert(jobs != NULL);
+
+   for (;;) {
+      list_remove_head(jobs, &pl);
+      if (pl == NULL)
+         break;
+      job = LIST_TO_JOB(pl);
+      job->ok         = false;
+      job->status     = ria_exec_unknown;
+      job->presult[0] = 0x00;
+      job->cresult    = 1;
+      ret = ria_complete_job(job) && ret;
+   }
+   return ret;
 
 }
    
@@ -266,7 +536,13 @@ ria_handle_t
          Free(_heap);
          goto init_failed;
       }         
+      if (!ria_papi_http_startup()) {
+         heap_destroy(_heap);
+         Free(_heap);
+         goto init_failed;
+      }         
       list_init_head(&_engines);
+      list_init_head(&_modules);
       sync_mutex_create(&_sync);
    }   
    _ref++;
@@ -278,7 +554,7 @@ ria_handle_t
     */
    if (!heap_alloc((void**)&engine, sizeof(*engine), _heap))
       return NULL; 
-   if (!ria_engine_create(engine)) {
+   if (!ria_engine_create(engine, NULL)) {
       heap_free(engine, _heap);
       return NULL;
    }  
@@ -319,6 +595,8 @@ bool
 {
  
    ria_engine_t* pe;
+   list_entry_t backlog;
+   list_entry_t* pl;
    bool ret;
 
    /*
@@ -330,18 +608,28 @@ bool
       return false;
    
    /*
-    * Remove engine from list
+    * Remove engine from list, jobs waiting for it are failed
     *
     */
+   list_init_head(&backlog);
    sync_mutex_lock(&_sync);
    list_remove_entry_simple(&pe->linkage);
+   if (pe->parked != NULL)
+      list_insert_tail(&backlog, &pe->parked->linkage);
+   for (;;) {
+      list_remove_head(&pe->backlog, &pl);
+      if (pl == NULL)
+         break;
+      list_insert_tail(&backlog, pl);
+   }
    sync_mutex_unlock(&_sync);
+   ret = ria_fail_jobs(&backlog);
    
    /*
     * Destroy engine 
     *
     */
-   ret = ria_engine_destroy(pe);
+   ret = ria_engine_destroy(pe) && ret;
    ret = heap_free(pe, _heap) && ret;
 
    /*
@@ -356,10 +644,11 @@ bool
    _ref--;   
    if (_ref == 0) {   
       sync_mutex_destroy(&_sync);
-      if (!list_is_empty(&_engines)) {
+      if (!list_is_empty(&_engines) || !list_is_empty(&_modules)) {
          ERR_SET_NO_RET(err_internal);
          ret = false;
       }   
+      ret = ria_papi_http_cleanup() && ret;
       ret = heap_destroy(_heap) && ret;
       Free(_heap);   
    }   
@@ -368,6 +657,69 @@ bool
 
 }     
 
+/*****************************************************************************/
+ria_handle_t
+   ria_uapi_clone(
+      ria_handle_t   IN   engine)
+/*
+ * Clones RIA engine
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   ria_engine_t* clone;
+   
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return 0;
+
+   /*
+    * Create engine sharing compiled module and copy the rest of state
+    *
+    */
+   if (!heap_alloc((void**)&clone, sizeof(*clone), _heap)) {
+      DUMP_SYS_ERROR(pe);
+      ria_unlock_engine(pe);
+      return 0;
+   }
+   if (!ria_engine_create(clone, pe->module)) {
+      DUMP_SYS_ERROR(pe);
+      heap_free(clone, _heap);
+      ria_unlock_engine(pe);
+      return 0;
+   }  
+   if (!ria_executor_clone(&clone->executor, &pe->executor)) {
+      DUMP_SYS_ERROR(pe);
+      ria_engine_destroy(clone);
+      heap_free(clone, _heap);
+      ria_unlock_engine(pe);
+      return 0;
+   }
+   clone->serial = pe->serial;
+   
+   /*
+    * Make shared initialization, source engine keeps it alive
+    *
+    */
+   while (sync_interlocked_exchange32(&_init_sync, 1) == 1) 
+      Delay(10);
+   _ref++;
+   sync_interlocked_exchange32(&_init_sync, 0);
+
+   /*
+    * Add to list
+    *
+    */
+   sync_mutex_lock(&_sync);
+   clone->id = (ria_handle_t)(usize)(++_ctr);
+   list_insert_tail(&_engines, &clone->linkage);
+   sync_mutex_unlock(&_sync);
+   ria_unlock_engine(pe);
+   return clone->id;
+
+}
+
 /*****************************************************************************/
 const char*
    ria_uapi_error_msg(
@@ -421,20 +773,24 @@ bool
 
 /*****************************************************************************/
 bool
-   ria_uapi_load(     
+   ria_load_script(     
       const char*    IN   path,
+      bool           IN   update,
       ria_handle_t   IN   engine)
 /*
- * Loads
+ * Loads script, reusing unchanged functions of loaded one if requested
  *
  */
 {
 
    ria_engine_t* pe;
+   ria_module_t* module;
    mem_blk_t script;
    mem_blk_t exec;
+   mem_blk_t base;
    void* file;
    usize c;
+   usize x = 0;
    byte* p = NULL;
    bool  ret = false;
    
@@ -474,7 +830,17 @@ bool
       Sprintf(pe->errmsg, sizeof(pe->errmsg), "Cannot define script size");
       goto exit;
    }
-   if (!heap_alloc((void**)&p, c*2, _heap)) {
+   base.p = buf_get_ptr_bytes(&pe->module->exec);
+   base.c = (update) ? buf_get_length(&pe->module->exec) : 0;
+#ifdef USE_RIA_REGISTER_CODE
+   /*
+    * Register code is longer than stack one, and function left in stack
+    * code takes one more octet; function takes six characters at least
+    *
+    */
+   x = c / 4;
+#endif
+   if (!heap_alloc((void**)&p, c*2+x+base.c, _heap)) {
       DUMP_SYS_ERROR(pe);
       goto exit;
    }
@@ -488,13 +854,43 @@ bool
    script.p = p;   
    script.c = c;
    exec.p   = p + c;
-   exec.c   = c;
+   exec.c   = c + x + base.c;
 
    /*
     * Compile
     *
     */
-   ret = ria_compile_script_module(&exec, &script, &pe->compiler);
+   ret = ria_compile_script_update(
+            &exec, &script, (base.c > 0) ? &base : NULL, &pe->compiler);
+#ifdef USE_RIA_PARALLEL_COMPILE
+   /*
+    * Workers hold memory of their own; without enough of it script is 
+    * read again, it was canonized in place, and compiled on this thread
+    *
+    */
+   if (!ret && 
+       (GET_ERR_CONTEXT->err == err_no_memory) && 
+       (pe->compiler.workers > 1)) {
+      usize w = pe->compiler.workers;
+      ERR_SET_NO_RET(err_none);
+      if (!ria_papi_fseek(0, ria_file_seek_begin, file)) {
+         Sprintf(pe->errmsg, sizeof(pe->errmsg), "Cannot read script file");
+         goto exit;
+      }
+      if (!ria_papi_fread(&c, p, c, file)) {
+         Sprintf(pe->errmsg, sizeof(pe->errmsg), "Cannot read script file");
+         goto exit;   
+      }      
+      script.p = p;   
+      script.c = c;
+      exec.p   = p + c;
+      exec.c   = c + x + base.c;
+      pe->compiler.workers = 1;
+      ret = ria_compile_script_update(
+               &exec, &script, (base.c > 0) ? &base : NULL, &pe->compiler);
+      pe->compiler.workers = w;
+   }
+#endif
    if (!ret) {
       DUMP_SYS_ERROR(pe);
       goto exit;
@@ -520,14 +916,62 @@ bool
    }      
    
    /*
-    * Save executable code
+    * Save executable code; engines which loaded the same code share it, 
+    * module of previous load is left to engines still using it
+    *
+    */
+   if (!ria_module_acquire(&module, &exec)) {
+      DUMP_SYS_ERROR(pe);
+      ret = false;
+      goto exit;
+   }
+   ria_module_release(pe->module);
+   pe->module = module;
+
+   /*
+    * Script and its compiled copy are not needed any more, free them
+    * before tables of executor are built
+    *
+    */
+   cleanup &= ~cleanup_p;
+   if (!heap_free(p, _heap)) {
+      DUMP_SYS_ERROR(pe);
+      ret = false;
+      goto exit;
+   }
+
+   /*
+    * Index functions, so that previously resolved ones become stale
     *
     */
-   if (!buf_load(exec.p, 0, exec.c, &pe->exec)) {
+   pe->serial++;
+   exec.p = buf_get_ptr_bytes(&pe->module->exec);
+   exec.c = buf_get_length(&pe->module->exec);
+   if (!ria_prepare_script(&exec, &pe->executor)) {
       DUMP_SYS_ERROR(pe);
       ret = false;
       goto exit;
    }
+#ifdef USE_RIA_PROFILER
+   /*
+    * Lack of memory for line table leaves profiler without line counters
+    *
+    */
+   if (!ria_set_line_table(
+           buf_get_ptr_usizes(&pe->compiler.lines), 
+           buf_get_length(&pe->compiler.lines)/2, &pe->executor)) {
+      if (GET_ERR_CONTEXT->err == err_no_memory) {
+         ERR_SET_NO_RET(err_none);
+         ret = ria_set_line_table(NULL, 0, &pe->executor);
+      }
+      else
+         ret = false;
+      if (!ret) {
+         DUMP_SYS_ERROR(pe);
+         goto exit;
+      }
+   }
+#endif
    
 exit:   
    if (cleanup & cleanup_p)
@@ -540,35 +984,63 @@ exit:
 
 /*****************************************************************************/
 bool
-   ria_uapi_execute(     
+   ria_uapi_load(     
+      const char*    IN   path,
+      ria_handle_t   IN   engine)
+/*
+ * Loads
+ *
+ */
+{
+
+   return ria_load_script(path, false, engine);
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_reload(     
+      const char*    IN   path,
+      ria_handle_t   IN   engine)
+/*
+ * Reloads
+ *
+ */
+{
+
+   return ria_load_script(path, true, engine);
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_execute_engine(     
       ria_exec_status_t*   OUT      status,    
       char*                IN OUT   presult,
       usize*               IN OUT   cresult,
       const char*          IN       name,
+      usize                IN       func,
       const char**         IN       pparams,
       usize                IN       cparams,
-      ria_handle_t         IN       engine)
+      ria_engine_t*        IN OUT   pe)
 /*
- * Executes script
+ * Executes script function of locked engine either by name or, if name is 
+ * NULL, by its index
  *
  */
 {
 
-   ria_engine_t* pe;
    mem_blk_t exec;
    mem_blk_t result;
-   bool ret = false;
+   bool ret;
    unumber i;
    
    assert(pparams != NULL);
    assert(presult != NULL);
    assert(cresult != NULL);
    assert(status  != NULL);
+   assert(pe      != NULL);
    
-   pe = ria_lock_engine(engine);
-   if (pe == NULL)
-      return false;
-      
    /*
     * Apply params
     *
@@ -576,18 +1048,37 @@ bool
    for (i=0; i<cparams; i++) 
       if (!ria_set_exec_param(pparams[i], i, &pe->executor)) {
          DUMP_SYS_ERROR(pe);
-         goto exit;
+         return false;
       }         
       
-   exec.p   = buf_get_ptr_bytes(&pe->exec);
-   exec.c   = buf_get_length(&pe->exec);
+   exec.p   = buf_get_ptr_bytes(&pe->module->exec);
+   exec.c   = buf_get_length(&pe->module->exec);
    result.p = (byte*)presult;
    result.c = *cresult - 1;
-   ret = ria_execute_script(status, &result, name, &exec, &pe->executor);
-   if (!ret) {
-      DUMP_SYS_ERROR(pe);
-      goto exit;
-   }
+   if (name != NULL)
+      ret = ria_execute_script(status, &result, name, &exec, &pe->executor);
+   else
+      ret = ria_execute_function(status, &result, func, &exec, &pe->executor);
+   if (!ret && 
+       (GET_ERR_CONTEXT->err == err_bad_length) && 
+       (ria_get_exec_result_size(&pe->executor) > 0)) {
+      *cresult = ria_get_exec_result_size(&pe->executor) + 1;
+      Sprintf(
+         pe->errmsg, 
+         sizeof(pe->errmsg), 
+         "Result buffer is too small, %u octets are required", 
+         (unsigned)*cresult);
+      return false;
+   }
+   if (!ret) {
+      DUMP_SYS_ERROR(pe);
+      return false;
+   }
+   else
+   if (*status == ria_exec_limit) {
+      DUMP_LIMIT_ERROR(pe);
+      return false;
+   }
    else
    if (*status == ria_exec_failed) {
       err_ctx_t* perr = GET_ERR_CONTEXT;                             
@@ -598,24 +1089,410 @@ bool
          ria_get_exec_error_pos(&pe->executor),
          perr->file,                                              
          perr->line);                                             
-      ret = false;   
-      goto exit;
+      return false;
+   }
+#ifdef USE_RIA_ASYNC_CALLS   
+   if (*status == ria_exec_pending) {
+      /*
+       * Result is delivered by ria_uapi_continue()
+       *
+       */
+      presult[0] = 0x00;
+      *cresult = 1;
+      return true;
    }
+#endif
 
    if (result.p != (byte*)presult) {
       ERR_SET_NO_RET(err_internal);
       DUMP_SYS_ERROR(pe);
-      ret = false;
-      goto exit;
+      return false;
    }
    result.p[result.c] = 0x00;
    *cresult = result.c + 1;
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_execute(     
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      const char*          IN       name,
+      const char**         IN       pparams,
+      usize                IN       cparams,
+      ria_handle_t         IN       engine)
+/*
+ * Executes script
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   bool ret;
+   
+   assert(name != NULL);
+
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+   ret = ria_execute_engine(
+            status, presult, cresult, name, 0, pparams, cparams, pe);
+   return ria_unlock_engine(pe) && ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_resolve(     
+      ria_function_t*   OUT   func,
+      const char*       IN    name,
+      ria_handle_t      IN    engine)
+/*
+ * Resolves script function of loaded script
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   mem_blk_t exec;
+   usize f;
+   bool ret = false;
+   
+   assert(func != NULL);
+   assert(name != NULL);
+   
+   *func = 0;
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+      
+   exec.p = buf_get_ptr_bytes(&pe->module->exec);
+   exec.c = buf_get_length(&pe->module->exec);
+   if (!ria_resolve_script(&f, name, &exec, &pe->executor)) {
+      DUMP_SYS_ERROR(pe);
+      goto exit;
+   }
+   if ((f == 0) || (f > ria_function_index_mask)) {
+      Sprintf(pe->errmsg, sizeof(pe->errmsg), "Script function not found");
+      goto exit;
+   }
+   *func = (ria_function_t)
+              (((pe->serial & ria_function_serial_mask) << 16) | f);
+   ret = true;
+
+exit:   
+   return ria_unlock_engine(pe) && ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_execute_fn(     
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      ria_function_t       IN       func,
+      const char**         IN       pparams,
+      usize                IN       cparams,
+      ria_handle_t         IN       engine)
+/*
+ * Executes resolved script function
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   bool ret = false;
+   
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+   if ((func >> 16) != (pe->serial & ria_function_serial_mask)) {
+      Sprintf(
+         pe->errmsg, sizeof(pe->errmsg), "Script function handle is stale");
+      goto exit;
+   }
+   ret = ria_execute_engine(
+            status, presult, cresult, NULL, func & ria_function_index_mask, 
+            pparams, cparams, pe);
+
+exit:   
+   return ria_unlock_engine(pe) && ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_execute_batch(     
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      ria_function_t       IN       func,
+      const char**         IN       pparams,
+      usize                IN       cparams,
+      usize                IN       ccalls,
+      ria_handle_t         IN       engine)
+/*
+ * Executes resolved script function over parameter sets
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   usize i, c, l;
+   char* p;
+   char  spare[1];
+   bool  over;
+   bool  ret = false;
+   
+   assert(status  != NULL);
+   assert(presult != NULL);
+   assert(cresult != NULL);
+   
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+   if ((func >> 16) != (pe->serial & ria_function_serial_mask)) {
+      Sprintf(
+         pe->errmsg, sizeof(pe->errmsg), "Script function handle is stale");
+      goto exit;
+   }
+
+   /*
+    * Execute each parameter set; each result is preceded by its size,
+    * failed executions leave empty result and keep going. Once results
+    * don't fit, the rest of calls is executed to get required size
+    *
+    */
+   for (i=0, l=0, over=false; i<ccalls; i++) {
+      if (!over && (l+ria_batch_prefix+1 <= *cresult)) {
+         p = presult + l + ria_batch_prefix;
+         c = *cresult - l - ria_batch_prefix;
+      }
+      else {
+         p = spare;
+         c = sizeof(spare);
+         over = true;
+      }
+      status[i] = ria_exec_unknown;
+      if (!ria_execute_engine(
+              &status[i], p, &c, NULL, func & ria_function_index_mask,
+              pparams+i*cparams, cparams, pe)) {
+         if ((GET_ERR_CONTEXT->err == err_bad_length) && 
+             (ria_get_exec_result_size(&pe->executor) > 0)) {
+            ERR_SET_NO_RET(err_none);
+            c = ria_get_exec_result_size(&pe->executor) + 1;
+            over = true;
+         }
+         else
+         if ((status[i] == ria_exec_failed) || 
+             (status[i] == ria_exec_limit))
+            c = 1;
+         else
+            goto exit;
+      }
+      if (!over) {
+         presult[l+0] = (char)((c-1) >> 24);
+         presult[l+1] = (char)((c-1) >> 16);
+         presult[l+2] = (char)((c-1) >>  8);
+         presult[l+3] = (char)((c-1) >>  0);
+      }
+      l += ria_batch_prefix + c - 1;
+   }
+   if (over) {
+      *cresult = l + 1;
+      ERR_SET_NO_RET(err_bad_length);
+      Sprintf(
+         pe->errmsg, 
+         sizeof(pe->errmsg), 
+         "Result buffer is too small, %u octets are required", 
+         (unsigned)*cresult);
+      goto exit;
+   }
+   *cresult = l;
+   ret = true;
 
 exit:   
    return ria_unlock_engine(pe) && ret;
 
 }
 
+/*****************************************************************************/
+bool
+   ria_uapi_set_limits(     
+      unumber        IN   time,
+      unumber        IN   ops,
+      usize          IN   memory,
+      ria_handle_t   IN   engine)
+/*
+ * Sets execution limits
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   ria_limits_t limits;
+   bool ret;
+   
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+   limits.time   = (uint64)time * 1000000;
+   limits.ops    = ops;
+   limits.memory = memory;
+   ret = ria_set_limits(&limits, &pe->executor);
+   if (!ret)
+      DUMP_SYS_ERROR(pe);
+   return ria_unlock_engine(pe) && ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_profile(     
+      bool           IN   enable,
+      ria_handle_t   IN   engine)
+/*
+ * Turns profiler on or off
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   bool ret = false;
+   
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+
+#ifndef USE_RIA_PROFILER
+   UNUSED(enable);
+   ERR_SET_NO_RET(err_not_supported);
+   DUMP_SYS_ERROR(pe);
+#else
+   ret = ria_set_profile(enable, &pe->executor);
+   if (!ret)
+      DUMP_SYS_ERROR(pe);
+#endif
+
+   return ria_unlock_engine(pe) && ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_profile_report(     
+      char*          IN OUT   presult,
+      usize*         IN OUT   cresult,
+      ria_handle_t   IN       engine)
+/*
+ * Fetches profiler report
+ *
+ */
+{
+
+   ria_engine_t* pe;
+#ifdef USE_RIA_PROFILER
+   mem_blk_t report;
+#endif
+   bool ret = false;
+   
+   assert(presult != NULL);
+   assert(cresult != NULL);
+   
+   pe = ria_lock_engine(engine);
+   if (pe == NULL)
+      return false;
+
+#ifndef USE_RIA_PROFILER
+   ERR_SET_NO_RET(err_not_supported);
+   DUMP_SYS_ERROR(pe);
+#else
+   if (*cresult < 1) {
+      ERR_SET_NO_RET(err_bad_length);
+      DUMP_SYS_ERROR(pe);
+      goto exit;
+   }
+   report.p = (byte*)presult;
+   report.c = *cresult - 1;
+   if (!ria_get_profile_report(&report, &pe->executor)) {
+      DUMP_SYS_ERROR(pe);
+      goto exit;
+   }
+   presult[report.c] = 0x00;
+   *cresult = report.c + 1;
+   ret = true;
+
+exit:   
+#endif
+   return ria_unlock_engine(pe) && ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_trace(     
+      ria_trace_level_t   IN   level)
+/*
+ * Selects trace level for all engines
+ *
+ */
+{
+
+#ifndef USE_RIA_TRACE
+   UNUSED(level);
+   ERR_SET(err_not_supported);
+#else
+   switch (level) {
+   case ria_trace_off:
+   case ria_trace_ring:
+   case ria_trace_log:
+      break;
+   default:
+      ERR_SET(err_bad_param);
+   }
+   ria_trace_level = level;
+   return true;
+#endif
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_trace_drain(     
+      char*    IN OUT   presult,
+      usize*   IN OUT   cresult)
+/*
+ * Fetches trace records from ring buffer as text
+ *
+ */
+{
+
+#ifdef USE_RIA_TRACE
+   usize c;
+#endif
+
+   assert(presult != NULL);
+   assert(cresult != NULL);
+
+#ifndef USE_RIA_TRACE
+   ERR_SET(err_not_supported);
+#else
+   if (*cresult < 1)
+      ERR_SET(err_bad_length);
+   c = *cresult - 1;
+   if (!ria_trace_drain(presult, &c))
+      return false;
+   presult[c] = 0x00;
+   *cresult = c + 1;
+   return true;
+#endif
+
+}
+
 /*****************************************************************************/
 bool
    ria_uapi_continue( 
@@ -632,7 +1509,7 @@ bool
    ria_engine_t* pe;
    bool ret = false;
 #ifdef USE_RIA_ASYNC_CALLS   
-   ria_buf_t result;
+   mem_blk_t result;
 #endif   
 
    assert(presult != NULL);
@@ -661,9 +1538,17 @@ bool
       goto exit;
    }
    else
+   if (*status == ria_exec_limit) {
+      DUMP_LIMIT_ERROR(pe);
+      ret = false;   
+      goto exit;
+   }
+   else
    if (*status == ria_exec_failed) {
       err_ctx_t* perr = GET_ERR_CONTEXT;                             
-      sprintf_s(pe->errmsg, sizeof(pe->errmsg), 
+      Sprintf(
+         pe->errmsg, 
+         sizeof(pe->errmsg), 
          "Script execution error at pos: 0x%02X, file %s, line %d\n", 
          ria_get_exec_error_pos(&pe->executor),
          perr->file,                                              
@@ -671,6 +1556,11 @@ bool
       ret = false;   
       goto exit;
    }
+   if (*status == ria_exec_pending) {
+      presult[0] = 0x00;
+      *cresult = 1;
+      goto exit;
+   }
    
    if (result.p != (byte*)presult) {
       ERR_SET_NO_RET(err_internal);
@@ -688,6 +1578,29 @@ exit:
    
 }
 
+/*****************************************************************************/
+bool
+   ria_uapi_poll( 
+      unumber*   OUT   completed,
+      unumber    IN    timeout)
+/*
+ * Drives pending network requests of all engines
+ *
+ */
+{
+
+   assert(completed != NULL);
+   
+#ifndef USE_RIA_ASYNC_CALLS   
+   *completed = 0;
+   UNUSED(timeout);
+   ERR_SET(err_internal);
+#else
+   return ria_papi_http_poll(completed, timeout);
+#endif
+
+}
+
 /*****************************************************************************/
 bool 
    ria_uapi_parse(       
@@ -741,3 +1654,427 @@ exit:
 
 
 }
+
+
+/******************************************************************************
+ *   Scheduler
+ */
+
+/*****************************************************************************/
+static ria_job_t
+   ria_take_job(
+      usize           IN       workers,
+      ria_worker_t*   IN OUT   worker)
+/*
+ * Takes job from own deque or, if it is empty, steals one from other 
+ * workers
+ *
+ */
+{
+
+   ria_worker_t* pw;
+   list_entry_t* pl = NULL;
+   usize i;
+   
+   for (i=0; (pl == NULL) && (i<workers); i++) {
+      pw = &_workers[(worker->index + i) % workers];
+      sync_mutex_lock(&pw->sync);
+      if (i == 0) {
+         list_remove_tail(&pw->jobs, &pl);
+      }
+      else {
+         list_remove_head(&pw->jobs, &pl);
+      }
+      sync_mutex_unlock(&pw->sync);
+   }
+   return (pl == NULL) ? NULL : LIST_TO_JOB(pl);
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_run_job(
+      ria_job_t       IN OUT   job,
+      ria_worker_t*   IN OUT   worker)
+/*
+ * Executes job on its engine and dispatches next job queued for the engine
+ *
+ */
+{
+
+   ria_handle_t engine = job->engine;
+   ria_engine_t* pe;
+   list_entry_t* pl = NULL;
+   bool busy = false;
+   bool ret = true;
+
+   /*
+    * Lock engine; if it is held by direct caller, job is parked on the 
+    * engine and dispatched again when the caller unlocks it
+    *
+    */
+   sync_mutex_lock(&_sync);
+   pe = ria_find_engine(engine);
+   if (pe != NULL) {
+      if (pe->locked) {
+         pe->parked = job;
+         busy = true;
+      }
+      else
+         pe->locked = true;
+   }
+   sync_mutex_unlock(&_sync);
+   if (busy) 
+      return true;
+   
+   /*
+    * Execute
+    *
+    */
+   job->status = ria_exec_unknown;
+   job->ok     = false;
+   if (pe == NULL) 
+      ERR_SET_NO_RET(err_bad_param);
+   else   
+   if ((job->func >> 16) != (pe->serial & ria_function_serial_mask)) 
+      Sprintf(
+         pe->errmsg, sizeof(pe->errmsg), "Script function handle is stale");
+   else
+      job->ok = ria_execute_engine(
+                   &job->status, job->presult, &job->cresult, NULL,
+                   job->func & ria_function_index_mask, 
+                   job->pparams, job->cparams, pe);
+   if (!job->ok) {
+      job->presult[0] = 0x00;
+      job->cresult    = 1;
+   }                
+   
+   /*
+    * Unlock engine and deliver result before passing engine to the next 
+    * job, so that results of engine come in submission order
+    *
+    */
+   if (pe != NULL) 
+      ret = ria_unlock_engine(pe);
+   ret = ria_complete_job(job) && ret;
+   if (pe != NULL) {
+      sync_mutex_lock(&_sync);
+      pe = ria_find_engine(engine);
+      if (pe != NULL) {
+         list_remove_head(&pe->backlog, &pl);
+         if (pl == NULL)
+            pe->scheduled = false;
+      }   
+      sync_mutex_unlock(&_sync);
+      if (pl != NULL)
+         ret = ria_push_job(LIST_TO_JOB(pl), worker) && ret;
+   }
+   return ret;
+
+}
+
+/*****************************************************************************/
+static void
+   ria_worker_proc(
+      void*   IN   arg)
+/*
+ * Worker thread routine
+ *
+ */
+{
+
+   ria_worker_t* worker = (ria_worker_t*)arg;
+   ria_job_t job;
+   usize workers;
+   bool stop;
+   
+   for (;;) {
+      if (!ria_papi_sem_wait(&_ready))
+         break;
+      sync_mutex_lock(&_sync);
+      stop    = _stop;
+      workers = _cworkers;
+      sync_mutex_unlock(&_sync);
+      if (stop)
+         break;
+         
+      /*
+       * Every wake up is backed by queued job; single pass over deques can 
+       * miss it only if it was pushed behind the pass while other worker 
+       * took one ahead, so the pass is just repeated
+       *
+       */
+      do {
+         job = ria_take_job(workers, worker);
+      } while (job == NULL);
+      ria_run_job(job, worker);
+   }
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_scheduler_start(
+      usize   IN   workers)
+/*
+ * Starts scheduler workers
+ *
+ */
+{
+
+   usize i;
+   
+   if ((_ref == 0) || (_workers != NULL))
+      ERR_SET(err_unexpected_call);
+   if (workers == 0)
+      ERR_SET(err_bad_param);
+      
+   if (!heap_alloc((void**)&_workers, sizeof(*_workers)*workers, _heap))
+      return false;
+   if (!ria_papi_sem_create(&_ready, 0)) {
+      heap_free(_workers, _heap);
+      _workers = NULL;
+      return false;
+   }
+   _stop = false;
+   _next = 0;
+   for (i=0; i<workers; i++) {
+      list_init_head(&_workers[i].jobs);
+      sync_mutex_create(&_workers[i].sync);
+      _workers[i].index = i;
+      if (!ria_papi_thread_create(
+              &_workers[i].thread, ria_worker_proc, &_workers[i])) {
+         sync_mutex_destroy(&_workers[i].sync);
+         break;
+      }
+   }
+   
+   /*
+    * Workers are published at once, so that submission never sees them 
+    * partially started
+    *
+    */
+   sync_mutex_lock(&_sync);
+   _cworkers = i;
+   sync_mutex_unlock(&_sync);
+   if (i < workers) {
+      ria_uapi_scheduler_stop();
+      return false;
+   }
+   return true;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_scheduler_stop(
+      void)
+/*
+ * Stops scheduler workers, not executed jobs are failed
+ *
+ */
+{
+
+   list_entry_t jobs;
+   list_entry_t* pl;
+   ria_engine_t* pe;
+   ria_job_t job;
+   usize i, workers;
+   bool ret = true;
+
+   if (_workers == NULL)
+      ERR_SET(err_unexpected_call);
+   
+   /*
+    * Stop workers, new jobs are not accepted since then
+    *
+    */
+   sync_mutex_lock(&_sync);
+   _stop     = true;
+   workers   = _cworkers;
+   _cworkers = 0;
+   sync_mutex_unlock(&_sync);
+   for (i=0; i<workers; i++)
+      ret = ria_papi_sem_post(&_ready) && ret;
+   for (i=0; i<workers; i++)
+      ret = ria_papi_thread_join(&_workers[i].thread) && ret;
+      
+   /*
+    * Collect queued jobs
+    *
+    */
+   list_init_head(&jobs);
+   for (i=0; i<workers; i++) 
+      for (;;) {
+         list_remove_head(&_workers[i].jobs, &pl);
+         if (pl == NULL)
+            break;
+         job = LIST_TO_JOB(pl);
+         list_insert_tail(&jobs, &job->linkage);
+      }
+   sync_mutex_lock(&_sync);
+   list_for_each(&_engines, &pl) {
+      pe = LIST_TO_ENGINE(pl);
+      pe->scheduled = false;
+      if (pe->parked != NULL) {
+         list_insert_tail(&jobs, &pe->parked->linkage);
+         pe->parked = NULL;
+      }
+      for (;;) {
+         list_entry_t* pj;
+         list_remove_head(&pe->backlog, &pj);
+         if (pj == NULL)
+            break;
+         list_insert_tail(&jobs, pj);
+      }
+   }
+   sync_mutex_unlock(&_sync);
+   ret = ria_fail_jobs(&jobs) && ret;
+   
+   /*
+    * Release workers
+    *
+    */
+   for (i=0; i<workers; i++)
+      sync_mutex_destroy(&_workers[i].sync);
+   ret = ria_papi_sem_destroy(&_ready) && ret;
+   ret = heap_free(_workers, _heap) && ret;
+   _workers = NULL;
+   return ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_submit(     
+      ria_job_t*                IN OUT   job,
+      ria_function_t            IN       func,
+      const char**              IN       pparams,
+      usize                     IN       cparams,
+      usize                     IN       cresult,
+      ria_uapi_job_callback_t   IN       callback,
+      void*                     IN       arg,
+      ria_handle_t              IN       engine)
+/*
+ * Queues execution of resolved script function
+ *
+ */
+{
+
+   ria_engine_t* pe;
+   ria_job_t pj;
+   usize c, i, l;
+   char* p;
+   base_err_t err = err_none;
+   bool ret = true;
+   
+   assert(job != NULL);
+   assert((pparams != NULL) || (cparams == 0));
+   
+   *job = NULL;
+   if (cresult == 0)
+      ERR_SET(err_bad_length);
+      
+   /*
+    * Make job with own copy of parameters
+    *
+    */
+   for (i=0, c=0; i<cparams; i++)
+      c += StrLen(pparams[i]) + 1;
+   c += sizeof(*pj) + sizeof(char*)*cparams + cresult; 
+   if (!heap_alloc((void**)&pj, c, _heap))
+      return false;
+   MemSet(pj, 0x00, sizeof(*pj));
+   list_init_entry(&pj->linkage);
+   pj->engine   = engine;
+   pj->func     = func;
+   pj->pparams  = (const char**)(pj+1);
+   pj->cparams  = cparams;
+   pj->cresult  = cresult;
+   pj->callback = callback;
+   pj->arg      = arg;
+   p = (char*)(pj->pparams + cparams);
+   for (i=0; i<cparams; i++) {
+      l = StrLen(pparams[i]) + 1;
+      MemCpy(p, pparams[i], l);
+      pj->pparams[i] = p;
+      p += l;
+   }
+   pj->presult = p;
+   if ((callback == NULL) && !ria_papi_sem_create(&pj->done, 0)) {
+      heap_free(pj, _heap);
+      return false;
+   }
+   
+   /*
+    * Jobs of busy engine wait in its backlog, so that they are executed in
+    * submission order
+    *
+    */
+   sync_mutex_lock(&_sync);
+   pe = ria_find_engine(engine);
+   if (_cworkers == 0)
+      err = err_unexpected_call;
+   else
+   if (pe == NULL)
+      err = err_bad_param;
+   else
+   if (pe->scheduled) {
+      list_insert_tail(&pe->backlog, &pj->linkage);
+   }
+   else {
+      pe->scheduled = true;
+      ret = ria_push_job(pj, &_workers[_next++ % _cworkers]);
+   }   
+   sync_mutex_unlock(&_sync);
+   if (err != err_none) {
+      if (callback == NULL)
+         ria_papi_sem_destroy(&pj->done);
+      heap_free(pj, _heap);
+      ERR_SET(err);
+   }
+   
+   *job = pj;
+   return ret;
+
+}
+
+/*****************************************************************************/
+bool
+   ria_uapi_wait(     
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      ria_job_t            IN       job)
+/*
+ * Waits for job submitted without callback and destroys it
+ *
+ */
+{
+
+   bool ret;
+   
+   assert(status  != NULL);
+   assert(presult != NULL);
+   assert(cresult != NULL);
+   assert(job     != NULL);
+   
+   if (job->callback != NULL)
+      ERR_SET(err_unexpected_call);
+   if (!ria_papi_sem_wait(&job->done))
+      return false;
+      
+   *status = job->status;
+   ret = job->ok;
+   if (*cresult < job->cresult) {
+      ERR_SET_NO_RET(err_bad_length);
+      ret = false;
+   }
+   else {
+      MemCpy(presult, job->presult, job->cresult);
+      *cresult = job->cresult;
+   }
+   ret = ria_papi_sem_destroy(&job->done) && ret;
+   return heap_free(job, _heap) && ret;
+
+}
@@ -12,6 +12,54 @@
  */
 typedef handle ria_handle_t;
 
+/*
+ * Resolved script function: load serial in high half, function number in 
+ * low half; handles become stale when script is reloaded
+ *
+ */
+typedef uint32 ria_function_t;
+
+enum {
+   ria_function_index_mask  = 0xFFFF,
+   ria_function_serial_mask = 0xFFFF
+};
+
+/*
+ * Batch results: each one is preceded by its size, 4 octets, big endian
+ *
+ */
+enum {
+   ria_batch_prefix = 4
+};
+
+/*
+ * Script result: string is returned as it is, integer as 8 octets, signed,
+ * big endian, boolean as one octet, 0 or 1. Result is followed by nul, 
+ * which is counted in result size; integer result may contain nul octets,
+ * so its size is taken from result size, not from the terminator
+ *
+ */
+
+/*
+ * Scheduled job
+ *
+ */
+typedef struct ria_job_s* ria_job_t;
+
+/*
+ * Job completion callback, called on worker thread; result is valid until
+ * callback returns, job is destroyed after that. Next job of the same 
+ * engine is started after callback returns
+ *
+ */
+typedef void (*ria_uapi_job_callback_t)(
+   ria_job_t           job,
+   bool                ok,
+   ria_exec_status_t   status,
+   const char*         presult,
+   usize               cresult,
+   void*               arg);
+
 /*@@ria_uapi_init
  *
  * Creates RIA engine
@@ -39,6 +87,21 @@ bool
    ria_uapi_shutdown(
       ria_handle_t   IN   engine);     
       
+/*@@ria_uapi_clone
+ *
+ * Creates RIA engine from the state of existing one: compiled script is 
+ * shared, configuration, global variables, cookies and headers are copied;
+ * resolved function handles are valid for both engines
+ *
+ * Parameters:     engine           engine handle
+ *
+ * Return:         engine handle or 0 if error
+ *
+ */
+ria_handle_t
+   ria_uapi_clone(
+      ria_handle_t   IN   engine);
+
 /*@@ria_uapi_error_msg
  *
  * Returns last cached error message
@@ -97,6 +160,23 @@ bool
    ria_uapi_load(     
       const char*    IN   path,
       ria_handle_t   IN   engine);
+
+/*@@ria_uapi_reload
+ *
+ * Reloads scenario script, functions which were not changed since 
+ * previous load keep their code
+ *
+ * Parameters:     path           path to script
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_reload(     
+      const char*    IN   path,
+      ria_handle_t   IN   engine);
      
 /*@@ria_uapi_execute
  *
@@ -104,7 +184,9 @@ bool
  *
  * Parameters:     status         execution status
  *                 presult        buffer with result
- *                 cresult        buffer size on entry, result size on exit
+ *                 cresult        buffer size on entry, result size on exit;
+ *                                required size if buffer is too small, 
+ *                                error is err_bad_length then
  *                 name           script name
  *                 pparams        parameters array (nul-terminated strings)
  *                 cparams        number of parameters
@@ -124,6 +206,179 @@ bool
       usize                IN       cparams,
       ria_handle_t         IN       engine);
      
+/*@@ria_uapi_resolve
+ *
+ * Resolves script function, so that it can be executed without name lookup
+ *
+ * Parameters:     func           function handle
+ *                 name           script name
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_resolve( 
+      ria_function_t*   OUT   func,
+      const char*       IN    name,
+      ria_handle_t      IN    engine);
+
+/*@@ria_uapi_execute_fn
+ *
+ * Executes script resolved by ria_uapi_resolve
+ *
+ * Parameters:     status         execution status
+ *                 presult        buffer with result
+ *                 cresult        buffer size on entry, result size on exit;
+ *                                required size if buffer is too small, 
+ *                                error is err_bad_length then
+ *                 func           function handle
+ *                 pparams        parameters array (nul-terminated strings)
+ *                 cparams        number of parameters
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_execute_fn( 
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      ria_function_t       IN       func,
+      const char**         IN       pparams,
+      usize                IN       cparams,
+      ria_handle_t         IN       engine);
+     
+/*@@ria_uapi_execute_batch
+ *
+ * Executes script resolved by ria_uapi_resolve once per parameter set;
+ * engine is locked and execution state is reused for all of them
+ *
+ * Parameters:     status         execution status of each call
+ *                 presult        buffer with results, one per call, empty
+ *                                if call failed, each is preceded by its 
+ *                                size (ria_batch_prefix octets, big 
+ *                                endian) and is not terminated
+ *                 cresult        buffer size on entry, results size on 
+ *                                exit; buffer needs one spare octet. If
+ *                                it is too small, the rest of calls is
+ *                                still executed, required size is 
+ *                                returned and error is err_bad_length
+ *                 func           function handle
+ *                 pparams        parameter sets, cparams strings each
+ *                 cparams        number of parameters in each set
+ *                 ccalls         number of parameter sets
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_execute_batch( 
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      ria_function_t       IN       func,
+      const char**         IN       pparams,
+      usize                IN       cparams,
+      usize                IN       ccalls,
+      ria_handle_t         IN       engine);
+     
+/*@@ria_uapi_set_limits
+ *
+ * Sets limits applied to each following execution of the engine; script 
+ * exceeding any of them is stopped with ria_exec_limit status, engine 
+ * stays usable
+ *
+ * Parameters:     time           wall-clock time, ms, 0 - no limit
+ *                 ops            executed commands, 0 - no limit
+ *                 memory         memory held by variables, bytes, 
+ *                                0 - no limit
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_set_limits(     
+      unumber        IN   time,
+      unumber        IN   ops,
+      usize          IN   memory,
+      ria_handle_t   IN   engine);
+
+/*@@ria_uapi_profile
+ *
+ * Turns profiler on or off; counters are reset when it is turned on, 
+ * available only if engine is built with USE_RIA_PROFILER
+ *
+ * Parameters:     enable         true to turn on
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_profile( 
+      bool           IN   enable,
+      ria_handle_t   IN   engine);
+
+/*@@ria_uapi_profile_report
+ *
+ * Fetches profiler report, one counter per line as "op <opcode> <count> 
+ * <ns>", "func <name> <count> <ns>" or "line <line> <count> <ns>"
+ *
+ * Parameters:     presult        buffer with report
+ *                 cresult        buffer size on entry, report size on exit
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_profile_report( 
+      char*          IN OUT   presult,
+      usize*         IN OUT   cresult,
+      ria_handle_t   IN       engine);
+     
+/*@@ria_uapi_trace
+ *
+ * Selects trace level for all engines: off, binary records into ring 
+ * buffer drained by ria_uapi_trace_drain, or text into platform log
+ *
+ * Parameters:     level          trace level
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_trace( 
+      ria_trace_level_t   IN   level);
+
+/*@@ria_uapi_trace_drain
+ *
+ * Fetches trace records collected in ring buffer as text, one line per 
+ * record; may be called from any thread while engines are running
+ *
+ * Parameters:     presult        buffer with text
+ *                 cresult        buffer size on entry, text size on exit
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_trace_drain( 
+      char*    IN OUT   presult,
+      usize*   IN OUT   cresult);
+     
 /*@@ria_uapi_continue
  *
  * Continues execution of pending script
@@ -144,6 +399,25 @@ bool
       usize*               IN OUT   cresult,
       ria_handle_t         IN       engine);
 
+/*@@ria_uapi_poll
+ *
+ * Drives pending network requests of all engines, so that single thread 
+ * can serve many scripts; engines whose requests were completed should 
+ * be resumed with ria_uapi_continue, the ones still pending report 
+ * pending status again
+ *
+ * Parameters:     completed      number of completed requests
+ *                 timeout        time to wait for network activity, ms
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_poll( 
+      unumber*   OUT   completed,
+      unumber    IN    timeout);
+
 /*@@ria_uapi_parse
  *
  * Performs parsing action
@@ -166,4 +440,88 @@ bool
       usize*         IN OUT   pos,
       ria_handle_t   IN       engine);
 
+/*@@ria_uapi_scheduler_start
+ *
+ * Starts scheduler, which executes submitted jobs of any engine on fixed 
+ * pool of worker threads; each worker has own job deque and steals jobs 
+ * from other workers when it is empty. Should be called after at least one
+ * engine is created
+ *
+ * Parameters:     workers        number of worker threads
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_scheduler_start(
+      usize   IN   workers);
+
+/*@@ria_uapi_scheduler_stop
+ *
+ * Stops scheduler, jobs which were not executed yet are completed as failed
+ * ones. Should be called before the last engine is destroyed
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_scheduler_stop(
+      void);
+
+/*@@ria_uapi_submit
+ *
+ * Queues execution of resolved script function. Jobs of the same engine 
+ * are executed one by one in submission order, engine busy with other job
+ * or direct caller delays the job instead of rejecting it. Result is 
+ * delivered to callback or, if it is NULL, by ria_uapi_wait; job is 
+ * destroyed after delivery. Pending scripts are resumed by 
+ * ria_uapi_continue as usual
+ *
+ * Parameters:     job            job handle
+ *                 func           function handle
+ *                 pparams        parameters array (nul-terminated strings)
+ *                 cparams        number of parameters
+ *                 cresult        size of result buffer to allocate
+ *                 callback       completion callback or NULL
+ *                 arg            callback argument
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_submit(     
+      ria_job_t*                IN OUT   job,
+      ria_function_t            IN       func,
+      const char**              IN       pparams,
+      usize                     IN       cparams,
+      usize                     IN       cresult,
+      ria_uapi_job_callback_t   IN       callback,
+      void*                     IN       arg,
+      ria_handle_t              IN       engine);
+
+/*@@ria_uapi_wait
+ *
+ * Waits for completion of job submitted without callback and destroys it;
+ * error message of failed job is cached by its engine
+ *
+ * Parameters:     status         execution status
+ *                 presult        buffer with result
+ *                 cresult        buffer size on entry, result size on exit
+ *                 job            job handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+bool
+   ria_uapi_wait(     
+      ria_exec_status_t*   OUT      status,    
+      char*                IN OUT   presult,
+      usize*               IN OUT   cresult,
+      ria_job_t            IN       job);
+
 #endif
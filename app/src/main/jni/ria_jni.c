@@ -7,6 +7,7 @@
 
 
 #define SIZE_RESULT 512
+#define SIZE_REPORT 0x10000
 
 
 /*****************************************************************************/
@@ -31,6 +32,25 @@ jint
    return ret;
 }
 
+/*****************************************************************************/
+jint
+   Java_com_lge_ria_Ria_riaClone(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jengine)
+/*
+ * Creates RIA engine from the state of existing one
+ *
+ * Parameters:     engine           engine handle
+ *
+ * Return:         engine handle or NULL if error
+ *
+ */
+{  
+   handle engine = (handle)jengine;
+   return (jint)ria_uapi_clone(engine);
+}
+
 /*****************************************************************************/
 jstring
    Java_com_lge_ria_Ria_riaErrorMsg(
@@ -98,18 +118,15 @@ jboolean
 
 /*****************************************************************************/
 jboolean
-   Java_com_lge_ria_Ria_riaExecute(
+   Java_com_lge_ria_Ria_riaReload(
       JNIEnv*  env,
       jobject  this,
-      jstring  jname,
-      jarray   jparams,
+      jstring  jpath,
       jint     jengine)
 /*
- * Executes script
+ * Reloads scenario script
  *
- * Parameters:     ctx            execution context
- *                 name           script name
- *                 params         parameters array (nul-terminated strings)
+ * Parameters:     path           path to script
  *                 engine         engine handle
  *
  * Return:         true           if successful
@@ -117,6 +134,31 @@ jboolean
  *
  */
 {
+   jboolean ret; 
+   handle engine = (handle)jengine;
+   const char *path = (*env)->GetStringUTFChars(env, jpath, NULL); 
+   ret = ria_uapi_reload(path, engine);
+   (*env)->ReleaseStringUTFChars(env, jpath, path); 
+   return ret;
+}
+
+/*****************************************************************************/
+static jboolean
+   ria_jni_execute(
+      JNIEnv*          env,
+      jobject          this,
+      jstring          jname,
+      ria_function_t   func,
+      jarray           jparams,
+      jint             jengine)
+/*
+ * Executes script either by name or, if name is NULL, by resolved function
+ * and stores status and result into Ria object; result is converted up to
+ * the terminator, so integer result, 8 octets big endian which may contain
+ * nul, does not pass to Java and has to be converted by script
+ *
+ */
+{
 
    char* presult;
    uint  cresult;
@@ -158,15 +200,26 @@ jboolean
       pparams[i] = (*env)->GetStringUTFChars(env, jparam, NULL); 
    }      
    
-   name= (*env)->GetStringUTFChars(env, jname, NULL); 
-   ret = ria_uapi_execute(
-            &status, 
-            presult,
-            &cresult,
-            name,
-            pparams,
-            cparams,
-            engine);
+   if (jname != NULL) {
+      name= (*env)->GetStringUTFChars(env, jname, NULL); 
+      ret = ria_uapi_execute(
+               &status, 
+               presult,
+               &cresult,
+               name,
+               pparams,
+               cparams,
+               engine);
+   }
+   else
+      ret = ria_uapi_execute_fn(
+               &status, 
+               presult,
+               &cresult,
+               func,
+               pparams,
+               cparams,
+               engine);
 
    jria = (*env)->GetObjectClass(env, this);
    jstatus = (*env)->GetFieldID(env, jria, "Status", "I");
@@ -197,7 +250,8 @@ jboolean
                  (*env)->NewStringUTF(env, ""));
    }   
 
-   (*env)->ReleaseStringUTFChars(env, jname, name); 
+   if (jname != NULL)
+      (*env)->ReleaseStringUTFChars(env, jname, name); 
    for (i=0; i<cparams; i++) {
       jparam = (*env)->GetObjectArrayElement(env, jparams, i);
       (*env)->ReleaseStringUTFChars(env, jparam, pparams[i]); 
@@ -212,7 +266,418 @@ exit:
 
 }
 
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaExecute(
+      JNIEnv*  env,
+      jobject  this,
+      jstring  jname,
+      jarray   jparams,
+      jint     jengine)
+/*
+ * Executes script
+ *
+ * Parameters:     ctx            execution context
+ *                 name           script name
+ *                 params         parameters array (nul-terminated strings)
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+   return ria_jni_execute(env, this, jname, 0, jparams, jengine);
+}
+
+/*****************************************************************************/
+jint
+   Java_com_lge_ria_Ria_riaResolve(
+      JNIEnv*  env,
+      jobject  this,
+      jstring  jname,
+      jint     jengine)
+/*
+ * Resolves script function
+ *
+ * Parameters:     name           script name
+ *                 engine         engine handle
+ *
+ * Return:         function handle or 0 if error
+ *
+ */
+{
+   ria_function_t func; 
+   handle engine = (handle)jengine;
+   const char *name = (*env)->GetStringUTFChars(env, jname, NULL); 
+   if (!ria_uapi_resolve(&func, name, engine))
+      func = 0;
+   (*env)->ReleaseStringUTFChars(env, jname, name); 
+   return (jint)func;
+}
+
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaExecuteFn(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jfunc,
+      jarray   jparams,
+      jint     jengine)
+/*
+ * Executes script resolved by riaResolve
+ *
+ * Parameters:     ctx            execution context
+ *                 func           function handle
+ *                 params         parameters array (nul-terminated strings)
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+   return ria_jni_execute(
+             env, this, NULL, (ria_function_t)jfunc, jparams, jengine);
+}
+
+
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaExecuteBatch(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jfunc,
+      jarray   jparams,
+      jint     jcparams,
+      jint     jengine)
+/*
+ * Executes script resolved by riaResolve once per parameter set
+ *
+ * Parameters:     ctx            execution context
+ *                 func           function handle
+ *                 params         parameter sets, cparams strings each
+ *                 cparams        number of parameters in each set
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+
+   char* presult = NULL;
+   uint  cresult;
+   uint  cparams, ccalls, i;
+   char const** pparams = NULL;
+   ria_exec_status_t* pstatus = NULL;
+   char* p;
+   char  ch;
+   uint  c;
+
+   jboolean ret = false;
+   handle engine = (handle)jengine;
+   jstring  jparam;
+   jclass   jria;
+   jfieldID jstatuses;
+   jfieldID jresults;
+   jintArray    jst;
+   jobjectArray jres;
+
+   enum {
+      cleanup_result = 0x01,
+      cleanup_params = 0x02,
+      cleanup_status = 0x04,
+      cleanup_utf    = 0x08
+   } cleanup = 0;
+
+   cparams = (jparams != NULL) ? (*env)->GetArrayLength(env, jparams) : 0;
+   if ((jcparams <= 0) || (cparams % jcparams != 0)) {
+      ERR_SET_NO_RET(err_bad_param);
+      goto exit;
+   }
+   ccalls = cparams / jcparams;
+
+   if (!ria_uapi_alloc((void**)&presult, cresult=SIZE_RESULT*(ccalls+1)))
+      goto exit;
+   else
+      cleanup |= cleanup_result;
+   if (!ria_uapi_alloc((void**)&pparams, (cparams+1)*sizeof(char*)))
+      goto exit;
+   else
+      cleanup |= cleanup_params;
+   if (!ria_uapi_alloc(
+           (void**)&pstatus, (ccalls+1)*sizeof(ria_exec_status_t)))
+      goto exit;
+   else
+      cleanup |= cleanup_status;
 
+   for (i=0; i<cparams; i++) {
+      jparam = (*env)->GetObjectArrayElement(env, jparams, i);
+      pparams[i] = (*env)->GetStringUTFChars(env, jparam, NULL); 
+   }      
+   cleanup |= cleanup_utf;
+
+   ret = ria_uapi_execute_batch(
+            pstatus, 
+            presult,
+            &cresult,
+            (ria_function_t)jfunc,
+            pparams,
+            jcparams,
+            ccalls,
+            engine);
+   if (!ret)
+      goto exit;
+
+   /*
+    * Store statuses and results into Ria object
+    *
+    */
+   ret  = false;
+   jria = (*env)->GetObjectClass(env, this);
+   jstatuses = (*env)->GetFieldID(env, jria, "Statuses", "[I");
+   jresults  = (*env)->GetFieldID(
+                  env, jria, "Results", "[Ljava/lang/String;");
+   if ((jstatuses == NULL) || (jresults == NULL)) {
+      ERR_SET_NO_RET(err_internal);
+      goto exit;
+   }
+   jst  = (*env)->NewIntArray(env, ccalls);
+   jres = (*env)->NewObjectArray(
+             env, ccalls, (*env)->FindClass(env, "java/lang/String"), NULL);
+   if ((jst == NULL) || (jres == NULL)) {
+      ERR_SET_NO_RET(err_internal);
+      goto exit;
+   }
+   for (i=0, p=presult; i<ccalls; i++, p+=ria_batch_prefix+c) {
+      jint st = pstatus[i];
+      /* 
+       * Results are preceded by size, each is terminated in place for 
+       * a while, buffer has spare octet after the last one 
+       *
+       */
+      c = ((byte)p[0] << 24) | ((byte)p[1] << 16) | 
+          ((byte)p[2] <<  8) | ((byte)p[3] <<  0);
+      ch = p[ria_batch_prefix+c];
+      p[ria_batch_prefix+c] = 0x00;
+      (*env)->SetIntArrayRegion(env, jst, i, 1, &st);
+      (*env)->SetObjectArrayElement(
+                 env, jres, i, (*env)->NewStringUTF(env, p+ria_batch_prefix));
+      p[ria_batch_prefix+c] = ch;
+   }
+   (*env)->SetObjectField(env, this, jstatuses, jst);
+   (*env)->SetObjectField(env, this, jresults, jres);
+   ret = true;
+
+exit:
+   if (cleanup & cleanup_utf)
+      for (i=0; i<cparams; i++) {
+         jparam = (*env)->GetObjectArrayElement(env, jparams, i);
+         (*env)->ReleaseStringUTFChars(env, jparam, pparams[i]); 
+      } 
+   if (cleanup & cleanup_result)     
+      ret = ria_uapi_free(presult) && ret;
+   if (cleanup & cleanup_params)     
+      ret = ria_uapi_free(pparams) && ret;
+   if (cleanup & cleanup_status)     
+      ret = ria_uapi_free(pstatus) && ret;
+   return ret;
+
+}
+
+
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaSetLimits(
+      JNIEnv*   env,
+      jobject   this,
+      jint      jtime,
+      jint      jops,
+      jint      jmemory,
+      jint      jengine)
+/*
+ * Sets execution limits
+ *
+ * Parameters:     time           wall-clock time, ms, 0 - no limit
+ *                 ops            executed commands, 0 - no limit
+ *                 memory         memory held by variables, bytes, 
+ *                                0 - no limit
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+   handle engine = (handle)jengine;
+   return ria_uapi_set_limits(
+             (unumber)jtime, (unumber)jops, (usize)jmemory, engine);
+}
+
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaProfile(
+      JNIEnv*   env,
+      jobject   this,
+      jboolean  jenable,
+      jint      jengine)
+/*
+ * Turns profiler on or off
+ *
+ * Parameters:     enable         true to turn on
+ *                 engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+   handle engine = (handle)jengine;
+   return ria_uapi_profile(jenable ? true : false, engine);
+}
+
+/*****************************************************************************/
+jstring
+   Java_com_lge_ria_Ria_riaProfileReport(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jengine)
+/*
+ * Returns profiler report
+ *
+ * Parameters:     engine         engine handle
+ *
+ * Return:         report text or NULL if error
+ *
+ */
+{
+   char*   presult = NULL;
+   usize   cresult = SIZE_REPORT;
+   jstring ret = NULL;
+   handle  engine = (handle)jengine;
+
+   if (!ria_uapi_alloc((void**)&presult, cresult))
+      return NULL;
+   if (ria_uapi_profile_report(presult, &cresult, engine))
+      ret = (*env)->NewStringUTF(env, presult);
+   ria_uapi_free(presult);
+   return ret;
+}
+
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaTrace(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jlevel)
+/*
+ * Selects trace level for all engines
+ *
+ * Parameters:     level          0 - off, 1 - ring buffer, 2 - log
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+   return ria_uapi_trace((ria_trace_level_t)jlevel);
+}
+
+/*****************************************************************************/
+jstring
+   Java_com_lge_ria_Ria_riaTraceDrain(
+      JNIEnv*  env,
+      jobject  this)
+/*
+ * Returns trace records collected in ring buffer
+ *
+ * Return:         trace text or NULL if error
+ *
+ */
+{
+   char*   presult = NULL;
+   usize   cresult = SIZE_REPORT;
+   jstring ret = NULL;
+
+   if (!ria_uapi_alloc((void**)&presult, cresult))
+      return NULL;
+   if (ria_uapi_trace_drain(presult, &cresult))
+      ret = (*env)->NewStringUTF(env, presult);
+   ria_uapi_free(presult);
+   return ret;
+}
+
+
+/*****************************************************************************/
+jboolean
+   Java_com_lge_ria_Ria_riaContinue(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jengine)
+/*
+ * Continues script which was left pending and stores status and result 
+ * into Ria object
+ *
+ * Parameters:     engine         engine handle
+ *
+ * Return:         true           if successful
+ *                 false          if failed
+ *
+ */
+{
+   char*    presult;
+   usize    cresult;
+   jboolean ret;
+   ria_exec_status_t status;
+   handle   engine = (handle)jengine;
+   jclass   jria;
+   jfieldID jstatus;
+   jfieldID jresult;
+
+   if (!ria_uapi_alloc((void**)&presult, cresult=SIZE_RESULT))
+      return false;
+   ret = ria_uapi_continue(&status, presult, &cresult, engine);
+
+   jria = (*env)->GetObjectClass(env, this);
+   jstatus = (*env)->GetFieldID(env, jria, "Status", "I");
+   jresult = (*env)->GetFieldID(env, jria, "Result", "Ljava/lang/String;");
+   if ((jstatus == NULL) || (jresult == NULL)) {
+      ERR_SET_NO_RET(err_internal);
+      ret = false;
+   }
+   else {
+      (*env)->SetIntField(env, this, jstatus, ret ? status : ria_exec_unknown);
+      (*env)->SetObjectField(
+                 env, 
+                 this, 
+                 jresult, 
+                 (*env)->NewStringUTF(env, ret ? presult : ""));
+   }
+
+   return ria_uapi_free(presult) && ret;
+}
+
+/*****************************************************************************/
+jint
+   Java_com_lge_ria_Ria_riaPoll(
+      JNIEnv*  env,
+      jobject  this,
+      jint     jtimeout)
+/*
+ * Drives pending network requests of all engines
+ *
+ * Parameters:     timeout        time to wait for network activity, ms
+ *
+ * Return:         number of completed requests or -1 if error
+ *
+ */
+{
+   unumber completed;
+   if (!ria_uapi_poll(&completed, (unumber)jtimeout))
+      return -1;
+   return (jint)completed;
+}
 
 /* This is a trivial JNI example where we use a native method
  * to return a new VM String. See the corresponding Java source
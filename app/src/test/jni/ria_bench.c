@@ -0,0 +1,168 @@
+/*
+ * Host microbenchmark of RIA executor: module is compiled once, functions
+ * are run by switch executor and then, after the module is prepared, by
+ * direct-threaded one where available. Build together with sources of
+ * main/jni/ria and main/jni/framework, link with libcurl and pthread;
+ * optional argument is number of runs
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "emb_heap.h"
+#include "ria_core.h"
+#include "ria_exec.h"
+
+
+#define SIZE_EXEC   0x10000
+#define SIZE_RESULT 0x1000
+#define SIZE_HEAP   0x1000000
+
+
+static const char _script[] =
+   "loop(1) {\n"
+   "   $n = string_to_int(@0);\n"
+   "   $i = 0;\n"
+   "   while ($i < $n) {\n"
+   "      $i = $i + 1;\n"
+   "   }\n"
+   "   return(\"done\");\n"
+   "}\n"
+   "math(1) {\n"
+   "   $n = string_to_int(@0);\n"
+   "   $i = 0;\n"
+   "   $a = 0;\n"
+   "   while ($i < $n) {\n"
+   "      $a = $a + $i - 3;\n"
+   "      if ($a > 1000) {\n"
+   "         $a = $a - 1000;\n"
+   "      }\n"
+   "      $i = $i + 1;\n"
+   "   }\n"
+   "   return(\"done\");\n"
+   "}\n"
+   "concat(1) {\n"
+   "   $n = string_to_int(@0);\n"
+   "   $i = 0;\n"
+   "   $acc = \"\";\n"
+   "   while ($i < $n) {\n"
+   "      $acc = $acc + \"x\";\n"
+   "      $i = $i + 1;\n"
+   "   }\n"
+   "   return(\"done\");\n"
+   "}\n";
+
+static const char* _funcs[]  = { "loop",   "math",   "concat" };
+static const char* _counts[] = { "200000", "200000", "3000"   };
+
+
+/*****************************************************************************/
+static double
+   ria_bench_now(void)
+/*
+ * Returns monotonic time in milliseconds
+ *
+ */
+{
+
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec*1000.0 + t.tv_nsec/1000000.0;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_bench_run(
+      const char*           IN       func,
+      const char*           IN       count,
+      usize                 IN       runs,
+      const char*           IN       mode,
+      const mem_blk_t*      IN       module,
+      ria_executor_ctx_t*   IN OUT   ctx)
+/*
+ * Runs function given number of times and prints time taken
+ *
+ */
+{
+
+   char result[SIZE_RESULT];
+   ria_exec_status_t status;
+   mem_blk_t r;
+   double t;
+   usize k;
+
+   if (!ria_set_exec_param(count, 0, ctx))
+      return false;
+   t = ria_bench_now();
+   for (k=0; k<runs; k++) {
+      r.p = (byte*)result;
+      r.c = sizeof(result) - 1;
+      if (!ria_execute_script(&status, &r, func, module, ctx) ||
+          (status != ria_exec_ok)) {
+         printf("%s: execution failed\n", func);
+         return false;
+      }
+   }
+   printf(
+      "%-7s %-7s %8s: %9.1f ms\n", func, mode, count, ria_bench_now()-t);
+   return true;
+
+}
+
+/*****************************************************************************/
+int
+   main(
+      int     argc,
+      char*   argv[])
+/*
+ * Runs benchmark, optional argument is number of runs
+ *
+ */
+{
+
+   static byte mem[SIZE_HEAP];
+   static byte script[sizeof(_script)];
+   static byte exec[SIZE_EXEC];
+   static ria_compiler_ctx_t compiler;
+   static ria_executor_ctx_t executor;
+   heap_ctx_t heap;
+   mem_blk_t te;
+   mem_blk_t ts;
+   usize runs = (argc > 1) ? (usize)atoi(argv[1]) : 5;
+   usize i;
+   bool ret = false;
+
+   if (!heap_create(mem, sizeof(mem), 0, &heap))
+      return 1;
+   if (!ria_compiler_create(&compiler, &heap))
+      return 1;
+   if (!ria_executor_create(&executor, &heap))
+      return 1;
+
+   memcpy(script, _script, sizeof(_script)-1);
+   ts.p = script;
+   ts.c = sizeof(_script) - 1;
+   te.p = exec;
+   te.c = sizeof(exec);
+   if (!ria_compile_script_module(&te, &ts, &compiler) || !compiler.ok)
+      printf("compilation failed\n");
+   else {
+      for (i=0, ret=true; ret && (i<sizeof(_funcs)/sizeof(_funcs[0])); i++)
+         ret = ria_bench_run(
+                  _funcs[i], _counts[i], runs, "switch", &te, &executor);
+      if (ret && !ria_prepare_script(&te, &executor))
+         ret = false;
+      for (i=0; ret && (i<sizeof(_funcs)/sizeof(_funcs[0])); i++)
+         ret = ria_bench_run(
+                  _funcs[i], _counts[i], runs, "direct", &te, &executor);
+   }
+
+   ria_executor_destroy(&executor);
+   ria_compiler_destroy(&compiler);
+   heap_destroy(&heap);
+   return (ret) ? 0 : 1;
+
+}
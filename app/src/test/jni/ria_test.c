@@ -0,0 +1,1383 @@
+/*
+ * Host tests of RIA engine: scripts are written into temporary directory,
+ * loaded and executed through user API; HTTP built-ins talk to a local
+ * server thread. Build together with sources of main/jni/ria and 
+ * main/jni/framework, link with libcurl and pthread
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "ria_uapi.h"
+#ifdef USE_RIA_PARALLEL_COMPILE
+#include "emb_heap.h"
+#include "ria_core.h"
+#endif
+
+
+#define SIZE_SCRIPT 0x10000
+#define SIZE_RESULT 0x1000
+
+
+static char        _script[SIZE_SCRIPT];
+static const char* _tempdir = "/tmp";
+static int         _listener = -1;
+static pthread_t   _server;
+
+
+/*****************************************************************************/
+static bool
+   ria_test_write(
+      char*         OUT   path,
+      const char*   IN    test)
+/*
+ * Writes _script into file in temporary directory
+ *
+ */
+{
+
+   FILE* f;
+
+   sprintf(path, "%s/ria_test.scr", _tempdir);
+   f = fopen(path, "wb");
+   if (f == NULL) {
+      printf("%s: cannot write %s\n", test, path);
+      return false;
+   }
+   fputs(_script, f);
+   fclose(f);
+   return true;
+
+}
+
+/*****************************************************************************/
+static ria_handle_t
+   ria_test_load(
+      const char*   IN   test)
+/*
+ * Creates engine and loads script from _script into it
+ *
+ */
+{
+
+   char path[0x100];
+   ria_handle_t engine;
+
+   if (!ria_test_write(path, test))
+      return 0;
+
+   engine = ria_uapi_init(_tempdir);
+   if (engine == 0)
+      printf("%s: cannot create engine\n", test);
+   else
+   if (!ria_uapi_load(path, engine)) {
+      printf("%s: load failed: %s\n", test, ria_uapi_error_msg(engine));
+      ria_uapi_shutdown(engine);
+      engine = 0;
+   }
+   remove(path);
+   return engine;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_run_params(
+      const char*    IN   test,
+      const char*    IN   func,
+      const char**   IN   params,
+      usize          IN   cparams,
+      const char*    IN   expected)
+/*
+ * Loads script from _script, executes function with parameters and
+ * checks its result
+ *
+ */
+{
+
+   char result[SIZE_RESULT];
+   usize c = sizeof(result);
+   ria_exec_status_t status;
+   ria_handle_t engine;
+   bool ret = false;
+
+   engine = ria_test_load(test);
+   if (engine == 0) {
+      printf("%s: FAILED\n", test);
+      return false;
+   }
+   if (!ria_uapi_execute(
+           &status, result, &c, func, params, cparams, engine))
+      printf("%s: execute failed: %s\n", test, ria_uapi_error_msg(engine));
+   else
+   if ((status != ria_exec_ok) || (strcmp(result, expected) != 0))
+      printf("%s: got status %d, result [%s]\n", test, status, result);
+   else
+      ret = true;
+   ria_uapi_shutdown(engine);
+
+   printf("%s: %s\n", test, (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_run(
+      const char*   IN   test,
+      const char*   IN   func,
+      const char*   IN   expected)
+/*
+ * Loads script from _script, executes function without parameters and
+ * checks its result
+ *
+ */
+{
+
+   const char* params[1] = { "" };
+
+   return ria_test_run_params(test, func, params, 0, expected);
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_call(
+      const char*    IN   test,
+      const char*    IN   func,
+      const char*    IN   expected,
+      ria_handle_t   IN   engine)
+/*
+ * Executes function of loaded engine without parameters and checks its 
+ * result
+ *
+ */
+{
+
+   const char* params[1] = { "" };
+   char result[SIZE_RESULT];
+   usize c = sizeof(result);
+   ria_exec_status_t status;
+
+   if (!ria_uapi_execute(&status, result, &c, func, params, 0, engine)) {
+      printf("%s: %s failed: %s\n", test, func, ria_uapi_error_msg(engine));
+      return false;
+   }
+   if ((status != ria_exec_ok) || (strcmp(result, expected) != 0)) {
+      printf("%s: %s gives status %d, result [%s]\n", 
+             test, func, status, result);
+      return false;
+   }
+   return true;
+
+}
+
+/*****************************************************************************/
+static void
+   ria_test_repeat(
+      char*   IN OUT   p,
+      char    IN       ch,
+      usize   IN       c)
+/*
+ * Fills c characters and terminates string
+ *
+ */
+{
+
+   memset(p, ch, c);
+   p[c] = 0;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_fold(void)
+/*
+ * Constant folding
+ *
+ */
+{
+
+   char a[0x100];
+   char b[0x100];
+   char expected[0x200];
+   bool ret = true;
+
+   strcpy(_script,
+      "fold(0) {\n"
+      "   $s = \"a\" + \"b\" + \"c\";\n"
+      "   $i = 10 + 2 - 5;\n"
+      "   $k = (2 + 3) + (10 - 4);\n"
+      "   return($s + int_to_string($i) + \"/\" + int_to_string($k));\n"
+      "}\n");
+   ret = ria_test_run("fold", "fold", "abc7/11") && ret;
+
+   strcpy(_script,
+      "deadif(0) {\n"
+      "   $r = \"x\";\n"
+      "   if (1 < 2) {\n"
+      "      $r = $r + \"yes\";\n"
+      "   } else {\n"
+      "      $r = $r + \"no\";\n"
+      "   }\n"
+      "   if ((\"a\" + \"b\") == \"ab\") {\n"
+      "      $r = $r + \"ab\";\n"
+      "   }\n"
+      "   while (1 > 2) {\n"
+      "      $r = $r + \"never\";\n"
+      "   }\n"
+      "   return($r);\n"
+      "}\n");
+   ret = ria_test_run("fold dead branch", "deadif", "xyesab") && ret;
+
+   /*
+    * Longest string constant is still folded
+    *
+    */
+   ria_test_repeat(a, 'a', 120);
+   ria_test_repeat(b, 'b', 134);
+   sprintf(_script, "long(0) {\n   return(\"%s\" + \"%s\");\n}\n", a, b);
+   sprintf(expected, "%s%s", a, b);
+   ret = ria_test_run("fold 254 octets", "long", expected) && ret;
+
+   /*
+    * Longer result does not fit into string constant,
+    * concatenation is left for run time
+    *
+    */
+   ria_test_repeat(a, 'a', 200);
+   ria_test_repeat(b, 'b', 200);
+   sprintf(_script,
+      "long(0) {\n"
+      "   $s = \"%s\" + \"%s\";\n"
+      "   return(int_to_string(length($s)));\n"
+      "}\n", a, b);
+   ret = ria_test_run("fold 400 octets", "long", "400") && ret;
+   sprintf(_script,
+      "long(0) {\n"
+      "   $s = \"%s\" + \"%s\" + \"x\";\n"
+      "   return(int_to_string(length($s)));\n"
+      "}\n", a, "b");
+   ret = ria_test_run("fold partially", "long", "202") && ret;
+
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_fused(void)
+/*
+ * Variable compared with many string constants, pushv and pushs are fused
+ * into pushvs whose string index looks like other opcodes
+ *
+ */
+{
+
+   char* p;
+   usize i;
+
+   p = _script;
+   p += sprintf(p, "fused(0) {\n   $r = 1;\n   $v = \"s\";\n");
+   for (i=0; i<100; i++)
+      p += sprintf(p, "   if ($v == \"q%u\") {\n      $r = $r + 1;\n   }\n", 
+              (unsigned)i);
+   sprintf(p, "   return($v + int_to_string($r));\n}\n");
+
+   return ria_test_run("fused string index", "fused", "s1");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_deep(void)
+/*
+ * Expression deeper than register code allows, function is kept in
+ * stack code while others are translated
+ *
+ */
+{
+
+   char* p;
+   usize i;
+
+   p = _script;
+   p += sprintf(p, "first(0) {\n   return(\"one\");\n}\n");
+   p += sprintf(p, "deep(0) {\n   $a = 1;\n   $b = ");
+   for (i=0; i<40; i++)
+      p += sprintf(p, "$a + (");
+   p += sprintf(p, "$a");
+   for (i=0; i<40; i++)
+      p += sprintf(p, ")");
+   sprintf(p, 
+      ";\n"
+      "   if ($b == 41) {\n"
+      "      return(\"ok\");\n"
+      "   }\n"
+      "   return(\"bad\");\n"
+      "}\n"
+      "last(0) {\n   $t = \"two\";\n   return($t);\n}\n");
+
+   return ria_test_run("deep expression", "deep", "ok") &&
+          ria_test_run("after deep expression", "last", "two");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_short(void)
+/*
+ * Short function whose register code is longer than its stack code
+ *
+ */
+{
+
+   const char* params[2] = { "a", "b" };
+
+   strcpy(_script, "f(2) {\n   return(@0 + \"-\" + @1);\n}\n");
+
+   return ria_test_run_params("short function", "f", params, 2, "a-b");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_many(void)
+/*
+ * Many local variables used by many commands, liveness analysis of such
+ * function does not fit into its limit and code is loaded as is
+ *
+ */
+{
+
+   char* p;
+   usize i;
+
+   p = _script;
+   p += sprintf(p, "many(0) {\n   $r = 0;\n");
+   for (i=0; i<100; i++)
+      p += sprintf(p, "   $v%u = \"s%u\";\n", (unsigned)i, (unsigned)i);
+   for (i=0; i<300; i++)
+      p += sprintf(p, "   if ($v%u == \"q%u\") {\n      $r = $r + 1;\n   }\n", 
+              (unsigned)(i%100), (unsigned)i);
+   sprintf(p, "   return(int_to_string($r) + $v7 + $v99 + \"q5\");\n}\n");
+
+   return ria_test_run("many variables", "many", "0s7s99q5");
+
+}
+
+/*****************************************************************************/
+static void
+   ria_test_functions(
+      usize   IN   count)
+/*
+ * Writes count small functions into _script
+ *
+ */
+{
+
+   char* p;
+   usize i;
+
+   for (i=0, p=_script; i<count; i++)
+      p += sprintf(p, 
+              "f%u(0) {\n   $a = \"s%u\";\n   return($a + \"x\");\n}\n", 
+              (unsigned)i, (unsigned)i);
+
+}
+
+#ifdef USE_RIA_PARALLEL_COMPILE
+/*****************************************************************************/
+static bool
+   ria_test_compile(
+      byte*                 OUT      exec,
+      usize*                IN OUT   cexec,
+      usize                 IN       workers,
+      ria_compiler_ctx_t*   IN OUT   ctx)
+/*
+ * Compiles _script with given number of workers
+ *
+ */
+{
+
+   static byte script[SIZE_SCRIPT];
+   mem_blk_t te;
+   mem_blk_t ts;
+
+   ts.c = strlen(_script);
+   ts.p = script;
+   memcpy(script, _script, ts.c);
+   te.p = exec;
+   te.c = *cexec;
+   ctx->workers = workers;
+   if (!ria_compile_script_module(&te, &ts, ctx) || !ctx->ok)
+      return false;
+   *cexec = te.c;
+   return true;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_parallel(void)
+/*
+ * Parallel compiler gives the same module as serial one
+ *
+ */
+{
+
+   static byte mem[0x100000];
+   static byte serial[SIZE_SCRIPT];
+   static byte parallel[SIZE_SCRIPT];
+   heap_ctx_t heap;
+   ria_compiler_ctx_t ctx;
+   usize cserial   = sizeof(serial);
+   usize cparallel = sizeof(parallel);
+   bool ret = false;
+
+   ria_test_functions(300);
+   if (!heap_create(mem, sizeof(mem), 0, &heap))
+      return false;
+   if (ria_compiler_create(&ctx, &heap)) {
+      if (!ria_test_compile(serial, &cserial, 1, &ctx))
+         printf("parallel compile: serial compile failed\n");
+      else
+      if (!ria_test_compile(parallel, &cparallel, 4, &ctx))
+         printf("parallel compile: parallel compile failed\n");
+      else
+         ret = (cserial == cparallel) && !memcmp(serial, parallel, cserial);
+      ria_compiler_destroy(&ctx);
+   }
+   heap_destroy(&heap);
+
+   printf("parallel compile: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+#endif
+
+/*****************************************************************************/
+static bool
+   ria_test_small(void)
+/*
+ * Many small functions
+ *
+ */
+{
+
+   ria_test_functions(300);
+
+   return ria_test_run("small functions", "f299", "s299x");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_batch(void)
+/*
+ * Resolved function executed one by one and over parameter sets, result
+ * buffer which is too small reports required size
+ *
+ */
+{
+
+   static const char* params[] = { "a", "bb", "ccc" };
+   static const char  expected[] =
+      "\0\0\0\2a!" "\0\0\0\3bb!" "\0\0\0\4ccc!";
+   char result[SIZE_RESULT];
+   ria_exec_status_t status[3];
+   ria_function_t func;
+   ria_handle_t engine;
+   usize c;
+   bool ret = false;
+
+   strcpy(_script,
+      "echo(1) {\n"
+      "   return(@0 + \"!\");\n"
+      "}\n");
+   engine = ria_test_load("batch");
+   if (engine == 0) {
+      printf("batch: FAILED\n");
+      return false;
+   }
+   if (!ria_uapi_resolve(&func, "echo", engine)) {
+      printf("batch: resolve failed: %s\n", ria_uapi_error_msg(engine));
+      goto exit;
+   }
+
+   c = sizeof(result);
+   if (!ria_uapi_execute_fn(status, result, &c, func, params, 1, engine) ||
+       (status[0] != ria_exec_ok) || (strcmp(result, "a!") != 0)) {
+      printf("batch: execute_fn failed: %s\n", ria_uapi_error_msg(engine));
+      goto exit;
+   }
+   c = 2;
+   if (ria_uapi_execute_fn(status, result, &c, func, params, 1, engine) ||
+       (c != 3)) {
+      printf("batch: short execute_fn result gives size %u\n", (unsigned)c);
+      goto exit;
+   }
+
+   c = sizeof(result);
+   if (!ria_uapi_execute_batch(
+           status, result, &c, func, params, 1, 3, engine)) {
+      printf("batch: execute failed: %s\n", ria_uapi_error_msg(engine));
+      goto exit;
+   }
+   if ((c != sizeof(expected)-1) || memcmp(result, expected, c) ||
+       (status[0] != ria_exec_ok) || (status[2] != ria_exec_ok)) {
+      printf("batch: got %u octets\n", (unsigned)c);
+      goto exit;
+   }
+   c = 5;
+   if (ria_uapi_execute_batch(
+          status, result, &c, func, params, 1, 3, engine) ||
+       (c != sizeof(expected))) {
+      printf("batch: short buffer gives size %u\n", (unsigned)c);
+      goto exit;
+   }
+   if (!ria_uapi_execute_batch(
+           status, result, &c, func, params, 1, 3, engine) ||
+       (c != sizeof(expected)-1) || memcmp(result, expected, c)) {
+      printf("batch: required size does not fit: %s\n", 
+             ria_uapi_error_msg(engine));
+      goto exit;
+   }
+   ret = true;
+
+exit:
+   ria_uapi_shutdown(engine);
+   printf("batch: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_lists(void)
+/*
+ * List grows by append past its initial capacity, split and join convert
+ * it from and to string
+ *
+ */
+{
+
+   strcpy(_script,
+      "lists(0) {\n"
+      "   $l = list();\n"
+      "   append($l, \"a\");\n"
+      "   append($l, \"bb\");\n"
+      "   $i = 0;\n"
+      "   while ($i < 100) {\n"
+      "      append($l, int_to_string($i));\n"
+      "      $i = $i + 1;\n"
+      "   }\n"
+      "   $s = split(\"p,q,,r\", \",\");\n"
+      "   return(item($l, 1) + \":\" + item($l, 101) + \":\" +\n"
+      "          int_to_string(length($l)) + \":\" +\n"
+      "          join($s, \"-\") + \":\" + int_to_string(length($s)));\n"
+      "}\n");
+
+   return ria_test_run("lists", "lists", "bb:99:102:p-q--r:4");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_append(void)
+/*
+ * Variable appended in place in a loop and then to itself keeps its 
+ * content, while copy made before the appends is not changed
+ *
+ */
+{
+
+   strcpy(_script,
+      "app(0) {\n"
+      "   $x = \"s\";\n"
+      "   $y = $x;\n"
+      "   $i = 0;\n"
+      "   while ($i < 300) {\n"
+      "      $x = $x + \"ab\";\n"
+      "      $i = $i + 1;\n"
+      "   }\n"
+      "   $x = $x + $x;\n"
+      "   $p = split($x, \"s\");\n"
+      "   $r = \"differ\";\n"
+      "   if (item($p, 1) == item($p, 2)) {\n"
+      "      $r = \"same\";\n"
+      "   }\n"
+      "   return($y + \":\" + int_to_string(length($x)) + \":\" + $r);\n"
+      "}\n");
+
+   return ria_test_run("in-place append", "app", "s:1202:same");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_reload(void)
+/*
+ * Reload keeps unchanged functions and takes changed and new ones
+ *
+ */
+{
+
+   static const char* funcs[]    = { "keep", "change", "added" };
+   static const char* expected[] = { "k1",   "c2",     "a2"    };
+   const char* params[1] = { "" };
+   char path[0x100];
+   char result[SIZE_RESULT];
+   ria_exec_status_t status;
+   ria_handle_t engine;
+   usize c, i;
+   bool ret = false;
+
+   strcpy(_script,
+      "keep(0) {\n   return(\"k1\");\n}\n"
+      "change(0) {\n   return(\"c1\");\n}\n");
+   engine = ria_test_load("reload");
+   if (engine == 0) {
+      printf("reload: FAILED\n");
+      return false;
+   }
+   strcat(_script, "added(0) {\n   return(\"a2\");\n}\n");
+   strstr(_script, "c1")[1] = '2';
+   if (!ria_test_write(path, "reload"))
+      goto exit;
+   if (!ria_uapi_reload(path, engine)) {
+      printf("reload: reload failed: %s\n", ria_uapi_error_msg(engine));
+      remove(path);
+      goto exit;
+   }
+   remove(path);
+
+   for (i=0; i<sizeof(funcs)/sizeof(funcs[0]); i++) {
+      c = sizeof(result);
+      if (!ria_uapi_execute(
+              &status, result, &c, funcs[i], params, 0, engine) ||
+          (status != ria_exec_ok) || strcmp(result, expected[i])) {
+         printf("reload: %s gives [%s]\n", funcs[i], result);
+         goto exit;
+      }
+   }
+   ret = true;
+
+exit:
+   ria_uapi_shutdown(engine);
+   printf("reload: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_stale(void)
+/*
+ * Functions are found by name among many, handle resolved before reload
+ * is rejected as stale and the one resolved after it works
+ *
+ */
+{
+
+   const char* params[1] = { "" };
+   char path[0x100];
+   char result[SIZE_RESULT];
+   ria_exec_status_t status;
+   ria_function_t func;
+   ria_function_t old;
+   ria_handle_t engine;
+   usize c;
+   bool ret = false;
+
+   ria_test_functions(50);
+   engine = ria_test_load("stale handle");
+   if (engine == 0) {
+      printf("stale handle: FAILED\n");
+      return false;
+   }
+   if (ria_uapi_resolve(&func, "f50", engine)) {
+      printf("stale handle: missing function is resolved\n");
+      goto exit;
+   }
+   if (!ria_uapi_resolve(&old, "f37", engine)) {
+      printf("stale handle: resolve failed: %s\n", ria_uapi_error_msg(engine));
+      goto exit;
+   }
+
+   ria_test_functions(60);
+   if (!ria_test_write(path, "stale handle"))
+      goto exit;
+   if (!ria_uapi_reload(path, engine)) {
+      printf("stale handle: reload failed: %s\n", ria_uapi_error_msg(engine));
+      remove(path);
+      goto exit;
+   }
+   remove(path);
+
+   c = sizeof(result);
+   if (ria_uapi_execute_fn(&status, result, &c, old, params, 0, engine) ||
+       !strstr(ria_uapi_error_msg(engine), "stale")) {
+      printf("stale handle: old handle is executed\n");
+      goto exit;
+   }
+   c = sizeof(result);
+   if (!ria_uapi_resolve(&func, "f57", engine) ||
+       !ria_uapi_execute_fn(&status, result, &c, func, params, 0, engine) ||
+       (status != ria_exec_ok) || strcmp(result, "s57x")) {
+      printf("stale handle: new handle failed: %s\n", 
+             ria_uapi_error_msg(engine));
+      goto exit;
+   }
+   ret = true;
+
+exit:
+   ria_uapi_shutdown(engine);
+   printf("stale handle: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_clone(void)
+/*
+ * Clone starts with globals of its source, then both change them 
+ * independently; resolved handle serves both, and clone outlives source
+ *
+ */
+{
+
+   const char* params[1] = { "" };
+   char result[SIZE_RESULT];
+   ria_exec_status_t status;
+   ria_function_t func;
+   ria_handle_t engine;
+   ria_handle_t clone = 0;
+   usize c;
+   bool ret = false;
+
+   strcpy(_script,
+      "global($g:int)\n"
+      "global($s:string)\n"
+      "init(0) {\n"
+      "   $g = 5;\n"
+      "   $s = \"a\";\n"
+      "   return(\"ok\");\n"
+      "}\n"
+      "bump(0) {\n"
+      "   $g = $g + 1;\n"
+      "   $s = $s + \"b\";\n"
+      "   return($s + int_to_string($g));\n"
+      "}\n");
+   engine = ria_test_load("clone");
+   if (engine == 0) {
+      printf("clone: FAILED\n");
+      return false;
+   }
+   if (!ria_test_call("clone", "init", "ok", engine) ||
+       !ria_uapi_resolve(&func, "bump", engine))
+      goto exit;
+   clone = ria_uapi_clone(engine);
+   if (clone == 0) {
+      printf("clone: clone failed: %s\n", ria_uapi_error_msg(engine));
+      goto exit;
+   }
+   if (!ria_test_call("clone", "bump", "ab6", engine) ||
+       !ria_test_call("clone", "bump", "abb7", engine))
+      goto exit;
+   c = sizeof(result);
+   if (!ria_uapi_execute_fn(&status, result, &c, func, params, 0, clone) ||
+       (status != ria_exec_ok) || strcmp(result, "ab6")) {
+      printf("clone: clone gives [%s]\n", result);
+      goto exit;
+   }
+   ria_uapi_shutdown(engine);
+   engine = 0;
+   if (!ria_test_call("clone", "bump", "abb7", clone))
+      goto exit;
+   ret = true;
+
+exit:
+   if (clone != 0)
+      ria_uapi_shutdown(clone);
+   if (engine != 0)
+      ria_uapi_shutdown(engine);
+   printf("clone: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_exceed(
+      const char*    IN   func,
+      const char*    IN   limit,
+      ria_handle_t   IN   engine)
+/*
+ * Executes function which should be stopped by given limit
+ *
+ */
+{
+
+   const char* params[1] = { "" };
+   char result[SIZE_RESULT];
+   usize c = sizeof(result);
+   ria_exec_status_t status = ria_exec_ok;
+
+   if (ria_uapi_execute(&status, result, &c, func, params, 0, engine) ||
+       (status != ria_exec_limit) || 
+       !strstr(ria_uapi_error_msg(engine), limit)) {
+      printf("limits: %s is not stopped by %s limit, status %d: %s\n", 
+             func, limit, status, ria_uapi_error_msg(engine));
+      return false;
+   }
+   return true;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_limits(void)
+/*
+ * Endless loops are stopped by time, command and memory limits, engine
+ * runs other functions afterwards and without limits again
+ *
+ */
+{
+
+   ria_handle_t engine;
+   bool ret = false;
+
+   strcpy(_script,
+      "spin(0) {\n"
+      "   $i = 0;\n"
+      "   while ($i >= 0) {\n"
+      "      $i = $i + 1;\n"
+      "   }\n"
+      "   return(\"never\");\n"
+      "}\n"
+      "grow(0) {\n"
+      "   $x = \"s\";\n"
+      "   while ($x != \"\") {\n"
+      "      $x = $x + \"abcdefgh\";\n"
+      "   }\n"
+      "   return(\"never\");\n"
+      "}\n"
+      "quick(0) {\n"
+      "   return(\"ok\");\n"
+      "}\n");
+   engine = ria_test_load("limits");
+   if (engine == 0) {
+      printf("limits: FAILED\n");
+      return false;
+   }
+
+   if (!ria_uapi_set_limits(0, 100000, 0, engine) ||
+       !ria_test_exceed("spin", "commands", engine) ||
+       !ria_test_call("limits", "quick", "ok", engine))
+      goto exit;
+   if (!ria_uapi_set_limits(50, 0, 0, engine) ||
+       !ria_test_exceed("spin", "time", engine) ||
+       !ria_test_call("limits", "quick", "ok", engine))
+      goto exit;
+   if (!ria_uapi_set_limits(0, 0, 20000, engine) ||
+       !ria_test_exceed("grow", "memory", engine) ||
+       !ria_test_exceed("grow", "memory", engine) ||
+       !ria_test_call("limits", "quick", "ok", engine))
+      goto exit;
+   if (!ria_uapi_set_limits(0, 0, 0, engine) ||
+       !ria_test_call("limits", "quick", "ok", engine))
+      goto exit;
+   ret = true;
+
+exit:
+   ria_uapi_shutdown(engine);
+   printf("limits: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_modules(void)
+/*
+ * Engines which loaded the same script share compiled module but not 
+ * globals; reload of one engine and shutdown of the other leave the rest
+ * working, and the released module is compiled again by a new engine
+ *
+ */
+{
+
+   char path[0x100];
+   ria_handle_t engine[3] = { 0, 0, 0 };
+   usize k;
+   bool ret = false;
+
+   strcpy(_script,
+      "global($g:int)\n"
+      "init(0) {\n"
+      "   $g = 0;\n"
+      "   return(\"ok\");\n"
+      "}\n"
+      "bump(0) {\n"
+      "   $g = $g + 1;\n"
+      "   return(\"v1:\" + int_to_string($g));\n"
+      "}\n");
+   for (k=0; k<2; k++) {
+      engine[k] = ria_test_load("modules");
+      if ((engine[k] == 0) || 
+          !ria_test_call("modules", "init", "ok", engine[k]))
+         goto exit;
+   }
+   if (!ria_test_call("modules", "bump", "v1:1", engine[0]) ||
+       !ria_test_call("modules", "bump", "v1:2", engine[0]) ||
+       !ria_test_call("modules", "bump", "v1:1", engine[1]))
+      goto exit;
+
+   strstr(_script, "v1")[1] = '2';
+   if (!ria_test_write(path, "modules"))
+      goto exit;
+   if (!ria_uapi_reload(path, engine[0])) {
+      printf("modules: reload failed: %s\n", ria_uapi_error_msg(engine[0]));
+      remove(path);
+      goto exit;
+   }
+   remove(path);
+   if (!ria_test_call("modules", "bump", "v2:3", engine[0]) ||
+       !ria_test_call("modules", "bump", "v1:2", engine[1]))
+      goto exit;
+
+   ria_uapi_shutdown(engine[1]);
+   engine[1] = 0;
+   strstr(_script, "v2")[1] = '1';
+   engine[2] = ria_test_load("modules");
+   if ((engine[2] == 0) ||
+       !ria_test_call("modules", "init", "ok", engine[2]) ||
+       !ria_test_call("modules", "bump", "v1:1", engine[2]) ||
+       !ria_test_call("modules", "bump", "v2:4", engine[0]))
+      goto exit;
+   ret = true;
+
+exit:
+   for (k=3; k>0; k--)
+      if (engine[k-1] != 0)
+         ria_uapi_shutdown(engine[k-1]);
+   printf("modules: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+static void*
+   ria_test_serve(
+      void*   IN   arg)
+/*
+ * Server thread, answers each request with page naming requested path
+ *
+ */
+{
+
+   char request[0x400];
+   char page[0x400];
+   char* p;
+   usize c;
+   ssize_t n;
+   int s;
+
+   for (;;) {
+      s = accept(_listener, NULL, NULL);
+      if (s < 0)
+         break;
+      for (c=0; c<sizeof(request)-1; c+=n) {
+         n = recv(s, request+c, sizeof(request)-1-c, 0);
+         if (n <= 0)
+            break;
+         request[c+n] = 0;
+         if (strstr(request, "\r\n\r\n") != NULL)
+            break;
+      }
+      request[sizeof(request)-1] = 0;
+      p = strchr(request, ' ');
+      if (p != NULL) {
+         p++;
+         p[strcspn(p, " \r\n")] = 0;
+      }
+      c = strlen((p == NULL) ? "" : p) + 5;
+      sprintf(page,
+         "HTTP/1.0 200 OK\r\n"
+         "Content-Type: text/plain\r\n"
+         "Content-Length: %u\r\n"
+         "\r\n"
+         "page %s",
+         (unsigned)c, (p == NULL) ? "" : p);
+      send(s, page, strlen(page), 0);
+      close(s);
+   }
+   return arg;
+
+}
+
+/*****************************************************************************/
+static unsigned
+   ria_test_server_start(void)
+/*
+ * Starts local HTTP server, returns its port or 0 if failed
+ *
+ */
+{
+
+   struct sockaddr_in addr;
+   socklen_t c = sizeof(addr);
+
+   memset(&addr, 0x00, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   _listener = socket(AF_INET, SOCK_STREAM, 0);
+   if (_listener < 0)
+      return 0;
+   if ((bind(_listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+       (listen(_listener, 8) != 0) ||
+       (getsockname(_listener, (struct sockaddr*)&addr, &c) != 0) ||
+       (pthread_create(&_server, NULL, ria_test_serve, NULL) != 0)) {
+      close(_listener);
+      return 0;
+   }
+   return ntohs(addr.sin_port);
+
+}
+
+/*****************************************************************************/
+static void
+   ria_test_server_stop(void)
+/*
+ * Stops local HTTP server
+ *
+ */
+{
+
+   shutdown(_listener, SHUT_RDWR);
+   close(_listener);
+   pthread_join(_server, NULL);
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_fetch_many(void)
+/*
+ * Pages are fetched concurrently into files named relative to temporary 
+ * directory, with fewer requests in flight than pages; status list 
+ * follows order of URLs
+ *
+ */
+{
+
+   char path[0x100];
+   unsigned port;
+   usize i;
+   bool ret;
+
+   port = ria_test_server_start();
+   if (port == 0) {
+      printf("fetch many: cannot start server\n");
+      printf("fetch many: FAILED\n");
+      return false;
+   }
+   sprintf(_script,
+      "fetch(0) {\n"
+      "   $u = list();\n"
+      "   $f = list();\n"
+      "   $i = 0;\n"
+      "   while ($i < 5) {\n"
+      "      append($u, \"http://127.0.0.1:%u/p\" + int_to_string($i));\n"
+      "      append($f, \"/ria_test\" + int_to_string($i) + \".out\");\n"
+      "      $i = $i + 1;\n"
+      "   }\n"
+      "   append($u, \"http://127.0.0.1:1/none\");\n"
+      "   append($f, \"/ria_test5.out\");\n"
+      "   $c = get_html_many($f, $u, 2);\n"
+      "   return(join($c, \",\") + \":\" +\n"
+      "          load_from_file(\"%s\" + item($f, 3)));\n"
+      "}\n",
+      port, _tempdir);
+   ret = ria_test_run("fetch many", "fetch", "200,200,200,200,200,0:page /p3");
+   ria_test_server_stop();
+   for (i=0; i<6; i++) {
+      sprintf(path, "%s/ria_test%u.out", _tempdir, (unsigned)i);
+      remove(path);
+   }
+   return ret;
+
+}
+
+#ifdef USE_RIA_ASYNC_CALLS
+/*****************************************************************************/
+static bool
+   ria_test_suspend(void)
+/*
+ * Scripts of two engines are suspended on HTTP requests, single thread
+ * polls both requests and resumes each script
+ *
+ */
+{
+
+   const char* params[1];
+   char result[2][SIZE_RESULT];
+   char expected[0x40];
+   ria_exec_status_t status[2];
+   ria_handle_t engine[2] = { 0, 0 };
+   unumber completed;
+   unsigned port;
+   usize c, k, n;
+   bool ret = false;
+
+   port = ria_test_server_start();
+   if (port == 0) {
+      printf("suspend: cannot start server\n");
+      printf("suspend: FAILED\n");
+      return false;
+   }
+   sprintf(_script,
+      "fetch(1) {\n"
+      "   $r = get_html(\"http://127.0.0.1:%u/\" + @0);\n"
+      "   return(int_to_string($r) + \":\" + last_response());\n"
+      "}\n",
+      port);
+   for (k=0; k<2; k++) {
+      engine[k] = ria_test_load("suspend");
+      if (engine[k] == 0)
+         goto exit;
+   }
+   for (k=0; k<2; k++) {
+      params[0] = (k == 0) ? "a" : "b";
+      c = sizeof(result[k]);
+      if (!ria_uapi_execute(
+              &status[k], result[k], &c, "fetch", params, 1, engine[k]) ||
+          (status[k] != ria_exec_pending)) {
+         printf("suspend: script is not suspended, status %d: %s\n", 
+                status[k], ria_uapi_error_msg(engine[k]));
+         goto exit;
+      }
+   }
+
+   /*
+    * Engine whose request is completed proceeds, the other one reports
+    * pending status again
+    *
+    */
+   for (n=0; (n<100) && 
+             ((status[0] == ria_exec_pending) || 
+              (status[1] == ria_exec_pending)); n++) {
+      if (!ria_uapi_poll(&completed, 100)) {
+         printf("suspend: poll failed\n");
+         goto exit;
+      }
+      if (completed == 0)
+         continue;
+      for (k=0; k<2; k++) {
+         if (status[k] != ria_exec_pending)
+            continue;
+         c = sizeof(result[k]);
+         if (!ria_uapi_continue(&status[k], result[k], &c, engine[k])) {
+            printf("suspend: continue failed: %s\n", 
+                   ria_uapi_error_msg(engine[k]));
+            goto exit;
+         }
+      }
+   }
+   ret = true;
+   for (k=0; k<2; k++) {
+      sprintf(expected, "200:page /%s", (k == 0) ? "a" : "b");
+      if ((status[k] != ria_exec_ok) || strcmp(result[k], expected)) {
+         printf("suspend: engine %u gives status %d, result [%s]\n", 
+                (unsigned)k, status[k], 
+                (status[k] == ria_exec_ok) ? result[k] : "");
+         ret = false;
+      }
+   }
+
+exit:
+   for (k=2; k>0; k--)
+      if (engine[k-1] != 0)
+         ria_uapi_shutdown(engine[k-1]);
+   ria_test_server_stop();
+   printf("suspend: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+#endif
+
+/*****************************************************************************/
+static void
+   ria_test_job_done(
+      ria_job_t           IN       job,
+      bool                IN       ok,
+      ria_exec_status_t   IN       status,
+      const char*         IN       presult,
+      usize               IN       cresult,
+      void*               IN OUT   arg)
+/*
+ * Appends result of scheduled job to the order of its engine
+ *
+ */
+{
+
+   char* order = (char*)arg;
+
+   if (!ok || (status != ria_exec_ok))
+      strcat(order, "?");
+   else
+      strcat(order, presult);
+   strcat(order, ",");
+
+}
+
+/*****************************************************************************/
+static bool
+   ria_test_scheduler(void)
+/*
+ * Jobs of two engines on shared workers complete in submission order of 
+ * each engine, also when direct calls hold the engine meanwhile and jobs
+ * are parked on it
+ *
+ */
+{
+
+   static char order[2][0x100];
+   static char expected[0x100];
+   const char* params[1];
+   char value[0x10];
+   char result[SIZE_RESULT];
+   ria_exec_status_t status;
+   ria_function_t func[2];
+   ria_handle_t engine[2];
+   ria_job_t last[2];
+   ria_job_t job;
+   usize c, i, k;
+   bool ret = false;
+
+   strcpy(_script,
+      "echo(1) {\n"
+      "   return(@0);\n"
+      "}\n"
+      "busy(0) {\n"
+      "   $i = 0;\n"
+      "   while ($i < 2000) {\n"
+      "      $i = $i + 1;\n"
+      "   }\n"
+      "   return(\"b\");\n"
+      "}\n");
+   engine[0] = ria_test_load("scheduler");
+   engine[1] = (engine[0] != 0) ? ria_test_load("scheduler") : 0;
+   if (engine[1] == 0) {
+      if (engine[0] != 0)
+         ria_uapi_shutdown(engine[0]);
+      printf("scheduler: FAILED\n");
+      return false;
+   }
+   for (k=0; k<2; k++)
+      if (!ria_uapi_resolve(&func[k], "echo", engine[k])) {
+         printf("scheduler: resolve failed\n");
+         goto exit;
+      }
+   if (!ria_uapi_scheduler_start(3)) {
+      printf("scheduler: start failed\n");
+      goto exit;
+   }
+
+   /*
+    * The last job of each engine is waited for, the rest report to 
+    * callback; direct calls on the first engine find it either free or 
+    * busy, but never reorder its jobs
+    *
+    */
+   params[0] = value;
+   expected[0] = 0;
+   order[0][0] = order[1][0] = 0;
+   for (i=0; i<16; i++) {
+      sprintf(value, "%u", (unsigned)i);
+      if (i < 15)
+         sprintf(expected + strlen(expected), "%s,", value);
+      for (k=0; k<2; k++)
+         if (!ria_uapi_submit(
+                 (k == 0) ? &job : &last[1], func[k], params, 1, 0x10, 
+                 (i < 15) ? ria_test_job_done : NULL, order[k], 
+                 engine[k])) {
+            printf("scheduler: submit failed\n");
+            ria_uapi_scheduler_stop();
+            goto exit;
+         }
+      last[0] = job;
+      c = sizeof(result);
+      ria_uapi_execute(&status, result, &c, "busy", params, 0, engine[0]);
+   }
+   ret = true;
+   for (k=0; k<2; k++) {
+      c = sizeof(result);
+      if (!ria_uapi_wait(&status, result, &c, last[k]) || 
+          (status != ria_exec_ok) || strcmp(result, "15") ||
+          strcmp(order[k], expected)) {
+         printf("scheduler: engine %u got [%s%s]\n", 
+                (unsigned)k, order[k], result);
+         ret = false;
+      }
+   }
+   ret = ria_uapi_scheduler_stop() && ret;
+
+exit:
+   ria_uapi_shutdown(engine[1]);
+   ria_uapi_shutdown(engine[0]);
+   printf("scheduler: %s\n", (ret) ? "ok" : "FAILED");
+   return ret;
+
+}
+
+/*****************************************************************************/
+int
+   main(
+      int     argc,
+      char*   argv[])
+/*
+ * Runs all tests, optional argument is temporary directory
+ *
+ */
+{
+
+   bool ret = true;
+
+   if (argc > 1)
+      _tempdir = argv[1];
+
+   ret = ria_test_fold() && ret;
+   ret = ria_test_fused() && ret;
+   ret = ria_test_deep() && ret;
+   ret = ria_test_short() && ret;
+   ret = ria_test_many() && ret;
+   ret = ria_test_small() && ret;
+   ret = ria_test_batch() && ret;
+   ret = ria_test_lists() && ret;
+   ret = ria_test_append() && ret;
+   ret = ria_test_reload() && ret;
+   ret = ria_test_stale() && ret;
+   ret = ria_test_clone() && ret;
+   ret = ria_test_limits() && ret;
+   ret = ria_test_modules() && ret;
+   ret = ria_test_fetch_many() && ret;
+#ifdef USE_RIA_ASYNC_CALLS
+   ret = ria_test_suspend() && ret;
+#endif
+   ret = ria_test_scheduler() && ret;
+#ifdef USE_RIA_PARALLEL_COMPILE
+   ret = ria_test_parallel() && ret;
+#endif
+
+   printf("%s\n", (ret) ? "PASSED" : "FAILED");
+   return (ret) ? 0 : 1;
+
+}
+